@@ -12,6 +12,9 @@
 #include <Arduino.h>
 #include <Print.h>
 #include <PubSubClient.h>
+#include <atomic>
+#include <logSpool.h>
+#include <publishQueue.h>
 
 enum MqttLoggerMode {
     MqttAndSerialFallback = 0,
@@ -29,8 +32,38 @@ private:
     uint16_t bufferCnt = 0, bufferSize = 0;
     PubSubClient* client;
     MqttLoggerMode mode;
-    void sendBuffer();
+    void sendBuffer(const uint8_t* rest = NULL, size_t restLen = 0);
+    void endLine();
+    bool lineStreamed = false;
     bool retained;
+    uint8_t* ring = NULL;
+    uint16_t ringSize = 0, ringMask = 0;
+    std::atomic<uint32_t> ringHead{0}, ringTail{0};
+    uint32_t droppedBytes = 0;
+    uint16_t highWaterMark = 0;
+    void enqueue(const uint8_t* data, uint16_t len, bool binary = false, const uint8_t* rest = NULL, uint16_t restLen = 0);
+    void ringPut(uint32_t pos, const uint8_t* data, uint16_t len);
+    void ringGet(uint32_t pos, uint8_t* data, uint16_t len);
+    uint16_t ringEntryHeader(uint32_t pos);
+    void ringEmit(Print& out, uint32_t pos, uint16_t len);
+    void ringEmitHex(Print& out, uint32_t pos, uint16_t len);
+    void printHex(const uint8_t* data, uint16_t len);
+    LogSpool* spool = NULL;
+    uint8_t* replayBuffer = NULL;
+    uint32_t replayRate = 0, replayTokens = 0, replayLast = 0;
+    boolean online();
+    void drainRing(bool toMqtt);
+    void spoolEntry(uint32_t pos, uint16_t header);
+    void replay();
+    bool collapse = false;
+    uint32_t lastLineHash = 0;
+    uint32_t repeats = 0, collapsedLines = 0;
+    bool repeatLine();
+    void flushRepeats();
+    PublishQueue* queue = NULL;
+    bool beginPacket(size_t length);
+    Print& packet();
+    void endPacket();
 
 public:
     MqttLogger(MqttLoggerMode mode=MqttLoggerMode::MqttAndSerialFallback);
@@ -43,10 +76,25 @@ public:
     void setRetained(const boolean& retained);
     
     virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t* data, size_t size);
     using Print::write;
+    void writeRecord(const uint8_t* data, uint16_t len);
     
     uint16_t getBufferSize();
     boolean setBufferSize(uint16_t size);
+
+    boolean setAsync(uint16_t size);
+    void drain();
+    uint16_t getQueuedBytes();
+    uint16_t getHighWaterMark();
+    uint32_t getDroppedBytes();
+
+    boolean setSpool(LogSpool* spool, uint32_t bytesPerSecond);
+
+    void setCollapse(bool collapse);
+    uint32_t getCollapsed();
+
+    void setQueue(PublishQueue* queue);
 };
 
 #endif
\ No newline at end of file
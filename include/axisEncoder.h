@@ -0,0 +1,71 @@
+/******************************************************************************
+ * @file axisEncoder.h
+ *
+ * @brief Pulse counting position feedback and counted moves for one DC axis.
+ *
+ * @details Each axis has a single channel encoder or slotted disc on one of
+ * the input only pins. On the ESP32 the pulses are counted by a PCNT unit,
+ * so the CPU does nothing per pulse and the control task reads the counter
+ * once per tick. If no PCNT unit can be set up, and on other targets such
+ * as the native simulation, a GPIO interrupt counts instead. A single
+ * channel cannot tell direction, so pulses are signed by the direction the
+ * motor is driven in, or was last driven in while it coasts to a stop.
+ *
+ * A move of N counts is requested from the network side with requestMove()
+ * and carried out by update() on the control task. The motor runs at the
+ * requested duty and is told to stop once the counts still to go are within
+ * the stopping distance, the measured pulse rate times the time the axis
+ * took to stop after the last move. The first move uses the time the
+ * deceleration ramp needs. Where the axis comes to rest against the target
+ * is kept as the error of the move.
+ ******************************************************************************/
+#ifndef _AXIS_ENCODER_H // Start of conditional preprocessor code that only
+                        // allows this library to be included once.
+#define _AXIS_ENCODER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <motorDriver.h> // The motor a move drives.
+#include <atomic> // Values shared between the network and control side.
+
+const int16_t encoderPcntLimit = 32767; // A PCNT unit counts 0 to this - 1, then starts again at 0.
+const uint16_t encoderGlitchFilter = 100; // APB cycles, ignore pulses shorter than 1.25 micro-seconds.
+const int32_t encoderMaxMove = 0x7FFFFF; // Longest move in counts.
+
+class AxisEncoder
+{
+   public:
+      AxisEncoder(int8_t pin);
+      void begin(int8_t unit);
+      bool requestMove(int32_t counts, uint8_t duty);
+      void cancel();
+      void update(MotorDriver& motor, uint32_t elapsedMs, uint16_t deceleration);
+      int32_t getPosition();
+      int32_t getTarget();
+      int32_t getLastError();
+      uint32_t getRate();
+      uint32_t getMoves();
+      bool isMoving();
+      bool usesPcnt();
+   private:
+      uint32_t readPulses();
+      static void IRAM_ATTR countPulse(void* encoder);
+      int8_t pin; // Encoder input.
+      int8_t unit = -1; // PCNT unit, -1 when a GPIO interrupt counts.
+      std::atomic<uint32_t> isrPulses{0}; // Pulses counted by the interrupt.
+      uint32_t lastRaw = 0; // Counter value at the last update().
+      int8_t direction = 0; // Sign of the last non-zero drive.
+      uint32_t rate = 0; // Pulses per second, smoothed.
+      std::atomic<uint32_t> request{0}; // Move from requestMove(), counts << 8 | duty, 0 for none.
+      int8_t moveDirection = 0; // Sign of the move under way, 0 when there is none.
+      bool settling = false; // Told to stop, waiting for the pulses to end.
+      int32_t brakePosition = 0; // Where the stop was given.
+      uint32_t brakeRate = 0; // Pulse rate when the stop was given.
+      uint32_t stopMs = 0; // Time the axis took to stop after the last move.
+      std::atomic<int32_t> position{0}; // Signed counts since start up.
+      std::atomic<int32_t> target{0}; // Where the last move was to end.
+      std::atomic<int32_t> lastError{0}; // Rest position minus target of the last move.
+      std::atomic<bool> moving{false}; // A move is under way or settling.
+      std::atomic<uint32_t> moves{0}; // Moves finished since start up.
+}; // class AxisEncoder
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * @file commandQueue.h
+ *
+ * @brief Bounded lock-free queue of actuator setpoints from the MQTT 
+ * callback (producer) to the motor control task (consumer).
+ *
+ * @details Exactly one producer and one consumer are supported. Every
+ * command is reduced to a setpoint for one actuator. The consumer takes all
+ * queued setpoints at once with collect() and only the newest per actuator
+ * survives. Older ones are counted as coalesced. A stop does not use a slot.
+ * requestStop() raises a flag that the consumer checks before anything
+ * else. Setpoints queued before the stop are discarded, while those queued
+ * after it are kept, and collect() never takes them ahead of the stop, even
+ * when the stop arrives between takeStop() and collect(). Several setpoints can be staged and committed together
+ * so the consumer always sees a batch whole. With a recorder set, every
+ * committed setpoint and every stop is also handed to it.
+ ******************************************************************************/
+#ifndef _COMMAND_QUEUE_H // Start of conditional preprocessor code that only
+                         // allows this library to be included once.
+#define _COMMAND_QUEUE_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <atomic> // Lock-free head, tail and stop flag.
+#include <commandRecorder.h> // Capture of dispatched commands.
+
+// Actuators that accept setpoints. The motors are in motors[] order.
+enum actuator : uint8_t
+{
+   ACT_SLEW,
+   ACT_HOIST,
+   ACT_LUFF,
+   ACT_SERVO,
+   ACT_COUNT
+}; // actuator
+
+const uint16_t commandQueueSize = 16; // Slots, must be a power of two.
+
+// One queued setpoint.
+struct motorCommand
+{
+   uint8_t actuator; // Which actuator, see enum actuator.
+   int16_t value; // Signed duty for a motor, angle for the servo.
+}; // motorCommand
+
+class CommandQueue
+{
+   public:
+      bool stage(uint8_t actuator, int16_t value);
+      void commit();
+      void abandon();
+      bool push(uint8_t actuator, int16_t value);
+      void requestStop();
+      bool takeStop();
+      uint8_t collect(int16_t latest[ACT_COUNT]);
+      uint16_t getDepth();
+      uint32_t getDrops();
+      uint32_t getCoalesced();
+      uint32_t getStops();
+      void setRecorder(CommandRecorder* recorder);
+   private:
+      motorCommand slots[commandQueueSize]; // Ring storage.
+      std::atomic<uint32_t> head{0}; // Next slot to publish, producer owned.
+      std::atomic<uint32_t> tail{0}; // Next slot to read, consumer owned.
+      uint32_t staged = 0; // Producer only: end of the uncommitted batch.
+      std::atomic<uint32_t> stopMark{0}; // head at the time of the last stop.
+      std::atomic<bool> stopPending{false}; // Set by requestStop().
+      uint32_t drops = 0; // Setpoints refused because the queue was full.
+      uint32_t coalesced = 0; // Setpoints superseded or flushed by a stop.
+      uint32_t stops = 0; // Stops taken by the consumer.
+      CommandRecorder* recorder = NULL; // Sees what the producer commits.
+}; // class CommandQueue
+
+#endif // End of conditional preprocessor code
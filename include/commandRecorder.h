@@ -0,0 +1,119 @@
+/******************************************************************************
+ * @file commandRecorder.h
+ *
+ * @brief Record the commands the MQTT callback dispatches and replay them
+ * from the motor task with the original timing.
+ *
+ * @details While recording, every setpoint committed to the CommandQueue,
+ * every stop, every counted move and every coordinated move is appended to
+ * a RAM buffer with the micro-seconds since the previous one. Recording ends on request or when
+ * the buffer is full, so a recording always starts at its beginning. Each
+ * entry is:
+ * 1. Time since the previous entry in micro-seconds, a LEB128 varint.
+ * 2. One byte, the kind (enum recordKind) in bits 4-7 and the actuator in
+ *    bits 0-3.
+ * 3. For a setpoint the value, for a move the counts, as a zigzag varint.
+ * 4. For a move or a sync entry one byte of duty.
+ * A setpoint sent a second after the last one is 5 bytes. A coordinated move
+ * is a run of sync entries, the counts of each DC axis it moves and the
+ * servo angle if it has one, then one with actuator ACT_COUNT, the duration
+ * in milli-seconds as the value and the highest duty.
+ *
+ * Replay runs in the motor task, which is the only place that reads the
+ * buffer while replaying. Each tick applies every entry that is due, so an
+ * entry lands on the first tick at or after its time from the start of the
+ * replay and the lateness is never more than one tick. A recording can be
+ * replayed a number of times back to back, each cycle as long as the
+ * original including the pause before recording ended.
+ *
+ * Saved recordings and dumps start with a header: "CR", version 1, a zero
+ * byte, the duration in micro-seconds (uint32), the number of entries and
+ * the bytes of entries (uint16 each), all little endian. tools/recording.py
+ * converts them to and from CSV.
+ ******************************************************************************/
+#ifndef _COMMAND_RECORDER_H // Start of conditional preprocessor code that only
+                            // allows this library to be included once.
+#define _COMMAND_RECORDER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <FS.h> // File system interface, LittleFS on the device.
+#include <atomic> // State shared by the network side and the motor task.
+#include <latencyHistogram.h> // Replay lateness.
+
+const uint8_t recordHeaderSize = 12; // Bytes before the entries in a saved recording.
+const uint8_t recordVersion = 1; // Layout of the entries.
+const uint8_t recordMaxEntry = 12; // Longest encoded entry.
+const uint32_t recordMinDuration = 1000; // Shortest replay cycle in micro-seconds.
+
+// What a recorded entry does.
+enum recordKind : uint8_t
+{
+   REC_SETPOINT,
+   REC_STOP,
+   REC_MOVE,
+   REC_SYNC
+}; // recordKind
+
+// What the recorder is doing.
+enum recorderState : uint8_t
+{
+   RECORDER_IDLE,
+   RECORDER_RECORDING,
+   RECORDER_REPLAYING
+}; // recorderState
+
+// One entry handed back by replayNext().
+struct recordedCommand
+{
+   uint8_t kind; // See enum recordKind.
+   uint8_t actuator; // See enum actuator.
+   int32_t value; // Setpoint, or counts for a move.
+   uint8_t duty; // Duty of a move or of the end of a sync run.
+}; // recordedCommand
+
+class CommandRecorder
+{
+   public:
+      bool begin(uint16_t size);
+      bool startRecording();
+      void stopRecording();
+      void add(uint8_t kind, uint8_t actuator, int32_t value, uint8_t duty = 0);
+      bool startReplay(uint16_t cycles);
+      void stopReplay();
+      bool replayNext(uint32_t nowMicros, recordedCommand& command);
+      bool save(fs::FS& fs, const char* path);
+      bool load(fs::FS& fs, const char* path);
+      void header(uint8_t out[recordHeaderSize]);
+      const uint8_t* getData();
+      uint16_t getLength();
+      uint16_t getEntries();
+      uint32_t getDuration();
+      uint8_t getState();
+      bool isFull();
+      uint32_t getCycles();
+      LatencyHistogram& getLateness();
+   private:
+      static uint8_t putVarint(uint8_t* out, uint32_t value);
+      uint8_t getVarint(uint16_t& pos, uint32_t& value);
+      bool check();
+      void finishReplay();
+      uint8_t* data = NULL; // Entries.
+      uint16_t size = 0; // Bytes in data.
+      uint16_t length = 0; // Bytes of entries.
+      uint16_t entries = 0; // Entries recorded.
+      uint32_t duration = 0; // Length of the recording in micro-seconds.
+      bool full = false; // Recording ended because data filled up.
+      std::atomic<uint8_t> state{RECORDER_IDLE}; // See enum recorderState.
+      std::atomic<bool> cancel{false}; // Set by stopReplay().
+      uint32_t recordStart = 0; // micros() when recording started.
+      uint32_t recordLast = 0; // Time of the newest entry from recordStart.
+      uint16_t replayCycles = 0; // Cycles left, 0 to repeat until stopped.
+      bool replayStarted = false; // The motor task has seen the replay.
+      uint32_t replayStart = 0; // micros() at the start of this cycle.
+      uint16_t replayPos = 0; // Next entry to replay.
+      uint32_t replayTime = 0; // Time of the last replayed entry in this cycle.
+      uint32_t cycles = 0; // Cycles finished since start up.
+      LatencyHistogram lateness; // Micro-seconds each entry was applied after its time.
+}; // class CommandRecorder
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * @file fnvHash.h
+ *
+ * @brief FNV-1a 32 bit hash usable at compile time.
+ *
+ * @details Written as single return constexpr functions so the hash of a 
+ * string literal can be computed by a C++11 compiler. Used for log tokens,
+ * the Access Point secrets lookup and MQTT topic routing.
+ ******************************************************************************/
+#ifndef _FNV_HASH_H // Start of conditional preprocessor code that only allows
+                    // this library to be included once.
+#define _FNV_HASH_H // Preprocessor variable used by above check.
+
+#include <stddef.h> // size_t.
+#include <stdint.h> // Fixed width integer types.
+
+/**
+ * @brief One FNV-1a step.
+ *
+ * @param hash Hash so far.
+ * @param octet Next byte to mix in.
+ *
+ * @return Updated hash.
+ */
+constexpr uint32_t fnv1aByte(uint32_t hash, uint8_t octet)
+{
+   return (hash ^ octet) * 16777619u;
+} // fnv1aByte()
+
+/**
+ * @brief FNV-1a hash of a zero terminated string. Usable at compile time.
+ *
+ * @param text String to hash.
+ * @param hash Starting value, the FNV offset basis by default.
+ *
+ * @return 32 bit hash.
+ */
+constexpr uint32_t fnv1a(const char* text, uint32_t hash = 2166136261u)
+{
+   return (*text == '\0') ? hash : fnv1a(text + 1, fnv1aByte(hash, (uint8_t)*text));
+} // fnv1a()
+
+/**
+ * @brief FNV-1a hash of text that is not zero terminated, at run time. Gives
+ * the same result as fnv1a() of the same characters.
+ *
+ * @param text Characters to hash.
+ * @param length Number of characters.
+ * @param hash Starting value, the FNV offset basis by default.
+ *
+ * @return 32 bit hash.
+ */
+inline uint32_t fnv1aSpan(const char* text, size_t length, uint32_t hash = 2166136261u)
+{
+   for(size_t i = 0; i < length; i++)
+   {
+      hash = fnv1aByte(hash, (uint8_t)text[i]);
+   } // for
+   return hash;
+} // fnv1aSpan()
+
+#endif // End of conditional preprocessor code
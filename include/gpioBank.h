@@ -0,0 +1,120 @@
+/******************************************************************************
+ * @file gpioBank.h
+ *
+ * @brief Change several GPIO outputs with one register write per bank.
+ *
+ * @details The ESP32 has 40 GPIOs split into two output banks. Bank 0 holds
+ * GPIO 0-31 and bank 1 holds GPIO 32-39. Each bank has a write-1-to-set
+ * register and a write-1-to-clear register, so every pin named in one write
+ * changes on the same clock cycle. gpioUpdate() writes the clear registers
+ * before the set registers. A transition can therefore only pass through a
+ * state where the affected inputs are low. On an H-bridge that means coast,
+ * never both inputs high.
+ *
+ * gpioDetach() drives a set of pins low and takes them away from any
+ * peripheral routed to them through the GPIO matrix, such as an LEDC PWM
+ * channel, so they stay low whatever that peripheral does next. It runs
+ * from IRAM and may be called from an interrupt. gpioRead() reads an input
+ * straight from the bank's input register, which is also safe there.
+ * gpioAttachEdge() hooks an edge interrupt whose handler runs from IRAM.
+ *
+ * Pin masks are built with gpioMaskOf() at compile time (see
+ * projectPinout.h). Builds for anything other than an ESP32 record the
+ * writes in a fake so the motor code can be exercised on a host.
+ ******************************************************************************/
+#ifndef _GPIO_BANK_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _GPIO_BANK_H // Preprocessor variable used by above check.
+
+#include <stdint.h> // Fixed width integer types.
+
+// A set of GPIO pins, one bit per pin in each output bank.
+struct gpioMask
+{
+   uint32_t bank0; // GPIO 0-31.
+   uint32_t bank1; // GPIO 32-39 in bits 0-7.
+   constexpr gpioMask operator|(const gpioMask& other) const
+   {
+      return gpioMask{bank0 | other.bank0, bank1 | other.bank1};
+   } // operator|()
+}; // gpioMask
+
+/**
+ * @brief Mask for a single GPIO. Usable at compile time.
+ *
+ * @param pin GPIO number, a negative value gives an empty mask.
+ *
+ * @return Mask with the one bit for that pin set.
+ */
+constexpr gpioMask gpioMaskOf(int8_t pin)
+{
+   return (pin < 0) ? gpioMask{0, 0}
+        : (pin < 32) ? gpioMask{(uint32_t)1 << pin, 0}
+        : gpioMask{0, (uint32_t)1 << (pin - 32)};
+} // gpioMaskOf()
+
+const gpioMask gpioNone = {0, 0}; // Empty mask.
+const uint8_t gpioCount = 40; // GPIO numbers in the two banks.
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <soc/gpio_struct.h> // GPIO register block.
+
+/**
+ * @brief Clear one set of pins and then set another, one write per bank.
+ * Always inlined, so gpioDetach() keeps it in IRAM when it runs from an
+ * interrupt while the flash cache is off.
+ *
+ * @param clear Pins to drive low.
+ * @param set Pins to drive high.
+ *
+ * @return NA No return value.
+ */
+inline __attribute__((always_inline)) void gpioUpdate(const gpioMask& clear, const gpioMask& set)
+{
+   GPIO.out_w1tc = clear.bank0;
+   GPIO.out1_w1tc.val = clear.bank1;
+   GPIO.out_w1ts = set.bank0;
+   GPIO.out1_w1ts.val = set.bank1;
+} // gpioUpdate()
+
+/**
+ * @brief Level of one pin from its bank's input register. Inlined, so an
+ * interrupt running from IRAM can call it while the flash cache is off.
+ *
+ * @param pin GPIO number, 0-39.
+ *
+ * @return True if the pin is high.
+ */
+inline __attribute__((always_inline)) bool gpioRead(uint8_t pin)
+{
+   return (pin < 32) ? (GPIO.in >> pin) & 1 : (GPIO.in1.data >> (pin - 32)) & 1;
+} // gpioRead()
+
+void gpioDetach(const gpioMask& pins);
+void gpioAttachEdge(uint8_t pin, bool rising, void (*handler)(void*), void* arg);
+
+#else // Recording fake for host builds.
+
+const uint16_t gpioFakeLogSize = 256; // Writes remembered by the fake.
+
+// One recorded call to gpioUpdate().
+struct gpioFakeWrite
+{
+   unsigned long micros; // When the write happened.
+   gpioMask clear; // Pins driven low.
+   gpioMask set; // Pins driven high.
+}; // gpioFakeWrite
+
+extern gpioMask gpioFakeLevels; // Current level of every output.
+extern gpioFakeWrite gpioFakeLog[gpioFakeLogSize]; // Ring of recent writes.
+extern uint32_t gpioFakeWrites; // Total writes, index into the ring modulo size.
+extern gpioMask gpioFakeDetached; // Pins gpioDetach() took from their peripheral.
+
+void gpioUpdate(const gpioMask& clear, const gpioMask& set);
+void gpioDetach(const gpioMask& pins);
+bool gpioRead(uint8_t pin);
+void gpioAttachEdge(uint8_t pin, bool rising, void (*handler)(void*), void* arg);
+
+#endif
+
+#endif // End of conditional preprocessor code
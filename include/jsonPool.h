@@ -0,0 +1,43 @@
+/******************************************************************************
+ * @file jsonPool.h
+ *
+ * @brief Fixed size memory pool for ArduinoJson so that parsing a command
+ * never touches the heap.
+ *
+ * @details ArduinoJson 7 has no StaticJsonDocument. Instead a JsonDocument
+ * takes an Allocator, and this one hands out memory from a static array by
+ * bumping a pointer. Each block carries its size in front of it so that
+ * reallocate() can grow or shrink the most recent block in place, which is
+ * what the document does with its string and variant pools. Blocks are never
+ * freed one by one. The whole pool is recycled with reset() once the
+ * document has been cleared. When the pool is exhausted allocate() returns
+ * NULL and deserializeJson() reports NoMemory.
+ ******************************************************************************/
+#ifndef _JSON_POOL_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _JSON_POOL_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <ArduinoJson.h> // JSON parsing.
+
+class JsonPool : public ArduinoJson::Allocator
+{
+   public:
+      JsonPool(uint8_t* memory, size_t size);
+      void* allocate(size_t size) override;
+      void deallocate(void* pointer) override;
+      void* reallocate(void* pointer, size_t size) override;
+      void reset();
+      size_t getHighWaterMark();
+      uint32_t getFailures();
+   private:
+      static size_t roundUp(size_t size);
+      uint8_t* memory; // Start of the pool.
+      size_t size; // Bytes in the pool.
+      size_t used = 0; // Bytes handed out, including block headers.
+      size_t last = SIZE_MAX; // Offset of the most recent block's header.
+      size_t highWaterMark = 0; // Most bytes ever in use.
+      uint32_t failures = 0; // Requests that did not fit.
+}; // class JsonPool
+
+#endif // End of conditional preprocessor code
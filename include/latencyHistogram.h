@@ -0,0 +1,41 @@
+/******************************************************************************
+ * @file latencyHistogram.h
+ *
+ * @brief Fixed size histogram of durations with min, average, percentile and
+ * max.
+ *
+ * @details Buckets are logarithmic with four linear steps per power of two,
+ * so any percentile is reported within 25% of the true value. The whole
+ * 32 bit range fits in 128 counters and recording is a few shifts and an
+ * add, cheap enough for a control loop. Values are in whatever unit the
+ * caller records (micro-seconds or CPU cycles).
+ ******************************************************************************/
+#ifndef _LATENCY_HISTOGRAM_H // Start of conditional preprocessor code that
+                             // only allows this library to be included once.
+#define _LATENCY_HISTOGRAM_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+
+const uint8_t latencyBuckets = 128; // 4 sub-buckets for each of 32 powers of 2.
+
+class LatencyHistogram
+{
+   public:
+      void record(uint32_t value);
+      void reset();
+      uint32_t getCount();
+      uint32_t getMin();
+      uint32_t getMax();
+      uint32_t getAverage();
+      uint32_t getPercentile(uint8_t percent);
+   private:
+      static uint8_t bucketOf(uint32_t value);
+      static uint32_t bucketTop(uint8_t bucket);
+      uint32_t buckets[latencyBuckets] = {0}; // Count per bucket.
+      uint32_t count = 0; // Values recorded.
+      uint32_t minimum = UINT32_MAX; // Smallest value recorded.
+      uint32_t maximum = 0; // Largest value recorded.
+      uint64_t sum = 0; // For the average.
+}; // class LatencyHistogram
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,48 @@
+/******************************************************************************
+ * @file logLimit.h
+ *
+ * @brief Per call site rate limit for the LOG macros.
+ *
+ * @details Every LOG and LOGLN call site owns a token bucket, a static
+ * LogSite declared by the macro itself. A site may send burst lines back to
+ * back and earns one more line every period. A line that finds the bucket
+ * empty is dropped together with the LOGNF and LOGLNF calls that finish it.
+ * The next line the site is allowed to send is preceded by a note of how
+ * many of its lines were dropped, so a reconnect storm costs a few lines per
+ * period plus a count instead of the whole storm.
+ *
+ * A LogSite needs no constructor. Zero, which is what a static starts as,
+ * is a full bucket, so the macros add no guard variable or start up code.
+ ******************************************************************************/
+#ifndef _LOG_LIMIT_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _LOG_LIMIT_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+
+// Token bucket of one call site.
+struct LogSite
+{
+   uint8_t spent; // Tokens used, 0 is a full bucket.
+   uint32_t refilled; // millis() when a token was last earned.
+   uint16_t dropped; // Lines dropped since the site last sent one.
+}; // LogSite
+
+class LogLimiter
+{
+   public:
+      LogLimiter(Print* out, uint8_t burst, uint32_t period);
+      bool start(LogSite& site, const char* function);
+      bool pass();
+      void endLine();
+      uint32_t getDropped();
+   private:
+      Print* out; // Where notes go, NULL for none.
+      uint8_t burst; // Lines a site may send back to back.
+      uint32_t period; // Milli-seconds to earn one more line.
+      bool open = true; // The line being built is sent.
+      bool started = false; // Text of the line being built has been sent.
+      uint32_t dropped = 0; // Lines dropped at every site since start up.
+}; // class LogLimiter
+
+#endif // End of conditional preprocessor code
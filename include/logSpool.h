@@ -0,0 +1,77 @@
+/******************************************************************************
+ * @file logSpool.h
+ *
+ * @brief Flash backed store for log lines written while the broker is out of
+ * reach.
+ *
+ * @details Lines are staged in a RAM page and written to flash a page at a
+ * time, or once the oldest staged line is logSpoolFlushAge old, so a long
+ * outage costs one flash write per page rather than one per line. Flash
+ * holds a run of numbered segment files in one directory. Writes only ever
+ * append to the newest segment and a new segment is started once it reaches
+ * the segment size. When the total passes the capacity the oldest segment
+ * is deleted and its unread lines are counted as dropped, so the spool is
+ * bounded and keeps the most recent part of the outage.
+ *
+ * Each entry on flash is the same as in the MqttLogger ring: a two byte
+ * little endian header with the length in bits 0-14 and bit 15 set for a
+ * binary record, followed by the entry. Replay reads entries back in order
+ * with peek() and take(), then removes them with consume() once they are
+ * sent or puts them back with rewind(). A segment is deleted as soon as it
+ * has been consumed to the end. Segments left over from before a restart are replayed
+ * from their start, so lines already replayed from a segment that was only
+ * partly read may be sent twice. Entries longer than a page are dropped.
+ ******************************************************************************/
+#ifndef _LOG_SPOOL_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _LOG_SPOOL_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <FS.h> // File system interface, LittleFS on the device.
+
+const uint16_t logSpoolPage = 512; // Bytes staged in RAM before a flash write.
+const uint32_t logSpoolFlushAge = 5000; // Longest a staged line waits for flash in milli-seconds.
+const uint16_t logSpoolMaxEntry = 0x7FFF; // Longest entry the header can describe.
+
+class LogSpool
+{
+   public:
+      LogSpool(fs::FS& fs, const char* dir, uint32_t capacity, uint32_t segmentSize);
+      bool begin();
+      bool append(const uint8_t* data, uint16_t len, bool binary, const uint8_t* rest = NULL, uint16_t restLen = 0);
+      void flush(bool force);
+      uint16_t peek(uint8_t* out, uint16_t size, bool& binary);
+      void take();
+      void consume();
+      void rewind();
+      uint32_t getPending();
+      uint32_t getBytesWritten();
+      uint32_t getFlushes();
+      uint32_t getDroppedBytes();
+   private:
+      void segmentPath(uint32_t segment, char* path, size_t size);
+      void deleteOldest();
+      bool openReader();
+      fs::FS& fs; // Where the segments live.
+      const char* dir; // Directory that holds the segments.
+      uint32_t capacity; // Most bytes kept on flash.
+      uint32_t segmentSize; // A new segment is started past this size.
+      bool ready = false; // begin() succeeded.
+      uint8_t page[logSpoolPage]; // Entries waiting for the next flash write.
+      uint16_t pageUsed = 0; // Bytes in page.
+      uint32_t pageSince = 0; // millis() when the oldest staged entry arrived.
+      uint32_t readSegment = 0; // Oldest segment, the one replay reads.
+      uint32_t writeSegment = 0; // Newest segment, the one appends go to.
+      uint32_t writeSegmentBytes = 0; // Size of the newest segment.
+      uint32_t flashBytes = 0; // Size of all segments.
+      uint32_t unreadBytes = 0; // Bytes on flash not yet consumed.
+      fs::File reader; // Open on readSegment while replaying.
+      uint32_t readPos = 0; // Offset of the oldest entry in readSegment.
+      uint32_t takePos = 0; // Offset of the entry after the taken ones.
+      uint16_t peekLength = 0; // Body length of the entry peek() returned.
+      uint32_t bytesWritten = 0; // Total written to flash.
+      uint32_t flushes = 0; // Flash writes.
+      uint32_t droppedBytes = 0; // Lost to the capacity limit or too long.
+}; // class LogSpool
+
+#endif // End of conditional preprocessor code
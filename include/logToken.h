@@ -0,0 +1,158 @@
+/******************************************************************************
+ * @file logToken.h
+ *
+ * @brief Compile-time tokenized logging support for the LOG macros.
+ *
+ * @details When LOG_TOKENIZED is set to 1 in platformio.ini the LOG macros
+ * stop building Strings. Each call site is reduced at compile time to a 32
+ * bit token, the FNV-1a hash of the macro argument as written plus the
+ * source line. The device then sends a compact binary record to the logger:
+ *
+ * | Offset | Size | Content                                              |
+ * |:------:|:----:|:-----------------------------------------------------|
+ * | 0      | 1    | Number of bytes that follow in this record.          |
+ * | 1      | 4    | Token (little endian).                               |
+ * | 5      | 4    | Timestamp in milli-seconds (little endian).          |
+ * | 9      | 1    | Bit 7 = end of line, bits 0-2 = argument type.       |
+ * | 10     | 0-48 | Raw argument. Absent for string literals.            |
+ *
+ * The text of every call site is recovered on the host. tools/logtokens.py
+ * builds the token dictionary from the sources at build time and
+ * tools/logdecode.py turns the records published to mqttlogger/log back
+ * into the same text the String based macros would have produced.
+ ******************************************************************************/
+#ifndef _LOG_TOKEN_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _LOG_TOKEN_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <MqttLogger.h> // For logging to serial and/or MQTT.
+#include <fnvHash.h> // Compile-time FNV-1a hash.
+#include <type_traits> // For std::enable_if in the argument overloads.
+
+// Argument type codes carried in the low bits of the flags byte.
+const uint8_t logArgNone = 0; // String literal, text is in the dictionary.
+const uint8_t logArgInt = 1; // Signed 32 bit integer.
+const uint8_t logArgUint = 2; // Unsigned 32 bit integer.
+const uint8_t logArgFloat = 3; // 32 bit IEEE float.
+const uint8_t logArgString = 4; // Raw characters, no terminator.
+const uint8_t logEndOfLine = 0x80; // Flag bit set by the LOGLN variants.
+const uint8_t logMaxStringArg = 48; // Longer string arguments are truncated.
+const uint8_t logRecordHeader = 10; // Bytes in a record before the argument.
+
+/**
+ * @brief Token for a log call site: hash of the argument text then the line.
+ *
+ * @param text The macro argument as stringized by the preprocessor.
+ * @param line Source line of the call site.
+ *
+ * @return 32 bit token.
+ */
+constexpr uint32_t logToken(const char* text, uint32_t line)
+{
+   return fnv1aByte(fnv1aByte(fnv1a(text), line & 0xFF), (line >> 8) & 0xFF);
+} // logToken()
+
+/**
+ * @brief Build one record and hand it to the logger.
+ *
+ * @param logger Logger that transports the record.
+ * @param token Call site token.
+ * @param flags End of line flag and argument type.
+ * @param arg Raw argument bytes, may be NULL when argLen is 0.
+ * @param argLen Number of argument bytes.
+ *
+ * @return NA No return value.
+ */
+inline void logEmit(MqttLogger& logger, uint32_t token, uint8_t flags, const void* arg, uint8_t argLen)
+{
+   uint8_t record[logRecordHeader + logMaxStringArg];
+   uint32_t now = millis();
+   argLen = min(argLen, logMaxStringArg);
+   record[0] = logRecordHeader - 1 + argLen;
+   for(uint8_t i = 0; i < 4; i++)
+   {
+      record[1 + i] = (token >> (8 * i)) & 0xFF;
+      record[5 + i] = (now >> (8 * i)) & 0xFF;
+   } // for
+   record[9] = flags;
+   if(arg != NULL && argLen > 0)
+   {
+      memcpy(record + logRecordHeader, arg, argLen);
+   } // if
+   logger.writeRecord(record, logRecordHeader + argLen);
+} // logEmit()
+
+/**
+ * @brief Emit a 32 bit value in little endian order.
+ *
+ * @param logger Logger that transports the record.
+ * @param token Call site token.
+ * @param flags End of line flag and argument type.
+ * @param value Raw 32 bit pattern of the argument.
+ *
+ * @return NA No return value.
+ */
+inline void logEmit32(MqttLogger& logger, uint32_t token, uint8_t flags, uint32_t value)
+{
+   uint8_t raw[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+   logEmit(logger, token, flags, raw, sizeof(raw));
+} // logEmit32()
+
+// Overloads selected by the type of the LOG macro argument. String literals
+// carry no argument at all since their text is already in the dictionary.
+// A char array that is not const is a buffer filled at run time, such as
+// clientID, and is sent like any other string.
+template<size_t N>
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, const char (&)[N])
+{
+   logEmit(logger, token, eol | logArgNone, NULL, 0);
+} // logTokenized()
+
+template<size_t N>
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, char (&text)[N])
+{
+   logEmit(logger, token, eol | logArgString, text, min(strnlen(text, N), (size_t)logMaxStringArg));
+} // logTokenized()
+
+template<typename T>
+inline typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value>::type
+logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, T text)
+{
+   logEmit(logger, token, eol | logArgString, text, min(strlen(text), (size_t)logMaxStringArg));
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, const String& text)
+{
+   logEmit(logger, token, eol | logArgString, text.c_str(), min((size_t)text.length(), (size_t)logMaxStringArg));
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, int value)
+{
+   logEmit32(logger, token, eol | logArgInt, (uint32_t)value);
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, long value)
+{
+   logEmit32(logger, token, eol | logArgInt, (uint32_t)value);
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, unsigned int value)
+{
+   logEmit32(logger, token, eol | logArgUint, (uint32_t)value);
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, unsigned long value)
+{
+   logEmit32(logger, token, eol | logArgUint, (uint32_t)value);
+} // logTokenized()
+
+inline void logTokenized(MqttLogger& logger, uint32_t token, uint8_t eol, double value)
+{
+   float narrowed = (float)value;
+   uint32_t raw;
+   memcpy(&raw, &narrowed, sizeof(raw));
+   logEmit32(logger, token, eol | logArgFloat, raw);
+} // logTokenized()
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * @file motionPlanner.h
+ *
+ * @brief Coordinated moves of the DC axes and the servo that all start
+ * together and arrive together.
+ *
+ * @details A move gives a signed distance in encoder counts for each DC axis,
+ * an end angle for the servo, and a duration or a highest duty. The network
+ * side hands it over with request() and the motor task carries it out in
+ * update(). Every axis follows the same trapezoidal profile scaled to its own
+ * distance: speed up for a ramp time, cruise, slow down for the ramp time.
+ * The ramp time is what the motor acceleration needs to reach the highest
+ * duty, and the duration is stretched if the slowest axis could not cover
+ * its distance in it at that duty. So each axis only ever asks for as much
+ * speed as its distance needs, and the axes with less to do go slower.
+ *
+ * Each tick an axis gets a duty made of two parts. A feed forward part turns
+ * the profile speed plannerLeadMs ahead into duty with the measured rate of
+ * the axis at full duty, so the motor lag does not leave the axis behind,
+ * and a correction part pushes the axis towards where the profile says it
+ * should be now, enough to remove the error in plannerCorrectionMs. The
+ * full duty rate of each axis is learned whenever it has run at a steady
+ * duty for a while, from any command, starting from a first guess. The
+ * servo angle is moved along the same profile, once per 50 Hz servo frame.
+ *
+ * An axis has arrived once the profile has ended and the distance it still
+ * has to go, less what it will coast in plannerLeadMs at its present rate,
+ * is within the tolerance. It is then stopped. One that is not there
+ * plannerSettleMs after the end is stopped and counted as missed. The time
+ * between the first and the last axis to arrive is the skew of the move.
+ ******************************************************************************/
+#ifndef _MOTION_PLANNER_H // Start of conditional preprocessor code that only
+                          // allows this library to be included once.
+#define _MOTION_PLANNER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <ESP32Servo.h> // The servo a move drives.
+#include <motorDriver.h> // The motors a move drives.
+#include <axisEncoder.h> // Where the axes are.
+#include <latencyHistogram.h> // Arrival skew.
+#include <atomic> // Hand over and results shared with the network side.
+
+const uint8_t plannerAxes = 3; // DC axes, in motors[] order.
+const uint16_t plannerServoFrameMs = 20; // Servo pulse period at 50 Hz.
+const uint16_t plannerCorrectionMs = 250; // Time to take out a position error.
+const uint16_t plannerLeadMs = 200; // Feed forward look ahead, about the slowest motor lag.
+const uint16_t plannerSettleMs = 1000; // Longest wait for an axis after the planned end.
+const uint16_t plannerSteadyMs = 500; // Time at one duty before the rate is measured.
+const int16_t plannerMeasureDuty = 64; // Lowest duty the rate is measured at.
+
+// One coordinated move.
+struct syncMove
+{
+   int32_t counts[plannerAxes]; // Signed distance per DC axis, 0 to leave it.
+   int16_t servo; // Servo angle at the end, -1 to leave it.
+   uint32_t durationMs; // Shortest time for the move, 0 for as fast as duty allows.
+   uint8_t duty; // Highest duty any axis may be planned to need.
+}; // syncMove
+
+class MotionPlanner
+{
+   public:
+      void begin(MotorDriver* const* motors, AxisEncoder* const* encoders, Servo* servo,
+                 uint16_t acceleration, uint32_t fullRate, uint16_t tolerance);
+      bool request(const syncMove& move);
+      void cancel();
+      void update(uint32_t elapsedMs);
+      bool isMoving();
+      uint32_t getMoves();
+      uint32_t getMissed();
+      uint32_t getPlannedMs();
+      uint32_t getLastSkew();
+      LatencyHistogram& getSkew();
+      uint32_t getFullRate(uint8_t axis);
+   private:
+      void plan(const syncMove& move);
+      void learnRate(uint8_t axis, uint32_t elapsedMs);
+      float profile(uint32_t atMs, float& speed);
+      void finish();
+      MotorDriver* const* motors = NULL; // The DC axes.
+      AxisEncoder* const* encoders = NULL; // Their positions.
+      Servo* servo = NULL; // The servo.
+      uint16_t acceleration = 0; // Motor acceleration in duty per second.
+      uint16_t tolerance = 0; // Counts from the target that count as arrived.
+      std::atomic<uint8_t> handOver{0}; // 0 free, 1 being written, 2 waiting for update().
+      syncMove waiting = {}; // Move from request().
+      bool active = false; // A move is under way.
+      syncMove move = {}; // The move under way.
+      int32_t start[plannerAxes] = {0}; // Axis positions when it began.
+      int32_t arrivedMs[plannerAxes] = {0}; // When each axis arrived, -1 until then.
+      bool done[plannerAxes] = {false}; // Axis stopped, arrived or missed.
+      int16_t servoStart = 0; // Servo angle when it began.
+      int16_t servoAngle = 0; // Servo angle last written.
+      uint32_t servoWrittenMs = 0; // When the servo was last written.
+      uint32_t elapsedMs = 0; // Time into the move.
+      uint32_t durationMs = 0; // Planned length of the move.
+      uint32_t rampMs = 0; // Planned speed up and slow down time.
+      uint32_t fullRate[plannerAxes] = {0}; // Counts per second at full duty.
+      int16_t steadyDuty[plannerAxes] = {0}; // Duty the axis has held.
+      uint32_t steadyMs[plannerAxes] = {0}; // For how long.
+      std::atomic<bool> moving{false}; // A move is waiting or under way.
+      std::atomic<uint32_t> moves{0}; // Moves finished.
+      std::atomic<uint32_t> missed{0}; // Axes that did not arrive.
+      std::atomic<uint32_t> plannedMs{0}; // Planned length of the last move.
+      std::atomic<uint32_t> lastSkew{0}; // Skew of the last move in milli-seconds.
+      LatencyHistogram skew; // Skew per move in milli-seconds.
+}; // class MotionPlanner
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * @file motorDriver.h
+ *
+ * @brief PWM speed control with acceleration ramps for one DC motor channel.
+ *
+ * @details Each crane axis is driven by one H-bridge channel. Two bridge
+ * types are in use:
+ * 1. L298N : PWM on the enable pin, direction on the two input pins. Both
+ *    inputs are changed together with gpioUpdate() so the bridge can never
+ *    see them both high.
+ * 2. DRV8871 : No enable pin. PWM on one input with the other held low, the
+ *    input that carries the PWM selects the direction.
+ *
+ * PWM is generated by the ESP32 LEDC peripheral through the ESP32PWM class of
+ * the ESP32Servo library so motor and servo channels are allocated from the
+ * same pool. Speeds are signed duty cycles from -motorMaxDuty to
+ * motorMaxDuty. A setpoint is not applied at once. update(), called from a
+ * fixed rate control task, moves the output towards it at no more than the
+ * acceleration rate when speeding up and the deceleration rate when slowing
+ * down, giving a trapezoidal speed profile. A reversal always decelerates
+ * to zero before accelerating the other way.
+ *
+ * If the bridge pins have been cut with gpioDetach(), reconnect() zeroes
+ * the motor and routes its PWM channels back to the pins.
+ ******************************************************************************/
+#ifndef _MOTOR_DRIVER_H // Start of conditional preprocessor code that only
+                        // allows this library to be included once.
+#define _MOTOR_DRIVER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <ESP32Servo.h> // For the ESP32PWM LEDC wrapper.
+#include <gpioBank.h> // Multi-pin GPIO writes.
+
+const uint8_t motorPwmResolution = 8; // Bits of PWM resolution.
+const int16_t motorMaxDuty = (1 << motorPwmResolution) - 1; // Full speed.
+
+// The kinds of H-bridge this driver knows how to run.
+enum motorBridge
+{
+   BRIDGE_L298N,
+   BRIDGE_DRV8871
+}; // motorBridge
+
+class MotorDriver
+{
+   public:
+      MotorDriver(const char* name, motorBridge bridge, int8_t in1, int8_t in2, int8_t enable = -1);
+      void begin(uint32_t frequency);
+      void setRamp(uint16_t acceleration, uint16_t deceleration);
+      void setSpeed(int16_t speed);
+      void halt();
+      void reconnect();
+      void update(uint32_t elapsedMs);
+      int16_t getSpeed();
+      int16_t getSetpoint();
+      const char* getName();
+   private:
+      void apply(int16_t duty);
+      const char* name; // Axis name used in commands and logs.
+      motorBridge bridge; // Type of H-bridge on this channel.
+      int8_t in1, in2, enable; // Bridge pins, enable is -1 on a DRV8871.
+      gpioMask in1Mask, in2Mask; // Register masks for the L298N inputs.
+      ESP32PWM pwm1, pwm2; // pwm1 drives enable (L298N) or in1 (DRV8871).
+      uint16_t acceleration = 0, deceleration = 0; // Duty per second, 0 = step.
+      int16_t setpoint = 0; // Requested signed duty.
+      int32_t speedMilli = 0; // Current signed duty in 1/1000 units.
+      int16_t applied = 0; // Duty last written to the hardware.
+}; // class MotorDriver
+
+#endif // End of conditional preprocessor code
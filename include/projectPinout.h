@@ -5,6 +5,7 @@
 #ifndef _PROJECT_GPIO_PINS_H // Start of conditional preprocessor code that  
                              // only allows this library to be included once.
 #define _PROJECT_GPIO_PINS_H // Preprocessor variable used by above check.
+#include <gpioBank.h> // gpioMask and gpioMaskOf().
 const int8_t enA1 = PIN_10_LBL_A5; // Enable Motor A. Physical pin 10.
 const int8_t inA1 = PIN_6_LBL_A1; // Motor A In1 pin. Physical pin 6.
 const int8_t inA2 = PIN_5_LBL_A0; // Motor A In2 pin. Physical pin 5.
@@ -13,5 +14,16 @@ const int8_t inB2 = PIN_20_LBL_32; // Motor B In2 pin. Physical pin 20.
 const int8_t inC1 = PIN_21_LBL_15; // Motor C In1 pin. Physical pin 21.
 const int8_t inC2 = PIN_22_LBL_33; // Motor C In2 pin. Physical pin 22.
 const int8_t servoPin = PIN_23_LBL_27; // Servo control pin. Physical pin 23.
+const int8_t encA = PIN_7_LBL_A2; // Motor A encoder, input only. Physical pin 7.
+const int8_t encB = PIN_8_LBL_A3; // Motor B encoder, input only. Physical pin 8.
+const int8_t encC = PIN_9_LBL_A4; // Motor C encoder, input only. Physical pin 9.
+const int8_t estopPin = PIN_16_LBL_21; // E-stop button to ground, active low. Physical pin 16.
+
+// Compile-time pin masks for changing several bridge pins in one write.
+constexpr gpioMask motorAInputs = gpioMaskOf(inA1) | gpioMaskOf(inA2); // L298N inputs.
+constexpr gpioMask motorBInputs = gpioMaskOf(inB1) | gpioMaskOf(inB2); // DRV8871 inputs.
+constexpr gpioMask motorCInputs = gpioMaskOf(inC1) | gpioMaskOf(inC2); // DRV8871 inputs.
+constexpr gpioMask motorEnables = gpioMaskOf(enA1); // L298N enable.
+constexpr gpioMask allBridgePins = motorAInputs | motorBInputs | motorCInputs | motorEnables;
 
 #endif // End of conditional preprocessor code
\ No newline at end of file
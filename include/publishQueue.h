@@ -0,0 +1,103 @@
+/******************************************************************************
+ * @file publishQueue.h
+ *
+ * @brief Bounded queue of outbound MQTT messages in priority classes, sent
+ * by one network task.
+ *
+ * @details Producers copy a message into the queue and return at once, so a
+ * slow broker or a full TCP send window only ever holds up the task that
+ * calls drain(). drain() always sends the oldest message of the most urgent
+ * class first: command responses and status, then telemetry, then logs.
+ * Each pass stops once its time budget is spent, or as soon as the socket
+ * could not take the next message without blocking, see setWritable().
+ *
+ * Messages are kept back to back in one block of memory, each behind a
+ * small header, and removed from the middle by marking them sent. Marked
+ * messages are squeezed out when a new one needs the room. When a message
+ * does not fit, the oldest message of the least urgent class present is
+ * dropped, but never one more urgent than the new message, in which case the
+ * new message is dropped instead. Drops are counted per class, along with
+ * the time from push to publish.
+ *
+ * With a size of 0 there is no queue. Every call goes straight to the
+ * client as before, which is how the two are compared in the native
+ * simulation. All calls must come from the network side.
+ ******************************************************************************/
+#ifndef _PUBLISH_QUEUE_H // Start of conditional preprocessor code that only
+                         // allows this library to be included once.
+#define _PUBLISH_QUEUE_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <PubSubClient.h> // MQTT client the queue feeds.
+#include <latencyHistogram.h> // Push to publish time per class.
+
+// Priority classes, most urgent first.
+enum publishClass : uint8_t
+{
+   PUB_CONTROL,
+   PUB_TELEMETRY,
+   PUB_LOG,
+   PUB_CLASSES
+}; // publishClass
+
+// Header in front of every queued message.
+struct publishEntry
+{
+   uint16_t length; // Payload bytes.
+   uint8_t flags; // Class in bits 0-1, see publishFlag.
+   uint32_t queued; // micros() when pushed.
+   const char* topic; // Must outlive the message.
+}; // publishEntry
+
+// Bits of publishEntry.flags above the class.
+enum publishFlag : uint8_t
+{
+   PUB_CLASS_MASK = 0x03,
+   PUB_RETAINED = 0x20,
+   PUB_OPEN = 0x40,
+   PUB_SENT = 0x80
+}; // publishFlag
+
+class PublishQueue : public Print
+{
+   public:
+      PublishQueue(PubSubClient& client);
+      bool begin(uint16_t size);
+      bool publish(uint8_t priority, const char* topic, const uint8_t* payload, uint16_t length, bool retained = false);
+      bool publish(uint8_t priority, const char* topic, const char* payload, bool retained = false);
+      bool beginPublish(uint8_t priority, const char* topic, uint16_t length, bool retained = false);
+      size_t write(uint8_t data) override;
+      size_t write(const uint8_t* data, size_t size) override;
+      using Print::write;
+      bool endPublish();
+      void setWritable(bool (*writable)(uint16_t bytes));
+      void drain(uint32_t budgetMicros);
+      uint16_t getFree();
+      uint16_t getDepth();
+      uint16_t getQueuedBytes();
+      uint16_t getHighWaterMark();
+      uint32_t getDrops(uint8_t priority);
+      LatencyHistogram& getLatency(uint8_t priority);
+   private:
+      bool makeRoom(uint8_t priority, uint16_t needed);
+      void compact();
+      void markSent(uint16_t offset);
+      publishEntry entryAt(uint16_t offset);
+      PubSubClient& client; // Where messages go.
+      uint8_t* data = NULL; // Headers and payloads.
+      uint16_t size = 0; // Bytes in data, 0 for no queue.
+      uint16_t start = 0; // First message not yet sent.
+      uint16_t end = 0; // Where the next message goes.
+      uint16_t sentBytes = 0; // Bytes of sent messages between start and end.
+      uint16_t depth = 0; // Messages waiting.
+      uint16_t highWaterMark = 0; // Most bytes waiting at once.
+      uint16_t open = 0; // Offset of the message being written, see beginPublish().
+      uint16_t openWritten = 0; // Payload bytes written to it so far.
+      bool writing = false; // Between beginPublish() and endPublish().
+      bool direct = false; // Streaming straight to the client.
+      bool (*writable)(uint16_t bytes) = NULL; // Socket has room, NULL to not check.
+      uint32_t drops[PUB_CLASSES] = {0}; // Messages dropped per class.
+      LatencyHistogram latency[PUB_CLASSES]; // Push to publish in micro-seconds.
+}; // class PublishQueue
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,102 @@
+/******************************************************************************
+ * @file safetyStop.h
+ *
+ * @brief Emergency stop input and command deadman that cut the H-bridges
+ * from an interrupt, whatever the tasks are doing.
+ *
+ * @details Stopping through the motor task is only as quick as the task. On
+ * a single core build a blocked socket call or a long flash write holds the
+ * motor task up too, and a motor left running on a lost link keeps running.
+ * So two things here act from interrupts instead:
+ * 1. E-stop : A normally open button from estopPin to ground, the pin held
+ *    high by its pull up. The falling edge raises a GPIO interrupt that cuts
+ *    the bridges at once, and the timer below also polls the pin in case an
+ *    edge is missed. An unwired pin reads released, so the button is
+ *    optional, but a broken wire to it cannot be told from released.
+ * 2. Deadman : A hardware timer interrupt every safetyCheckUs. While any
+ *    motor runs open ended, at a speed that no counted move, coordinated
+ *    move or replay will end by itself, a valid command or heartbeat must be
+ *    fed within the deadman window or the bridges are cut.
+ *
+ * Cutting the bridges is gpioDetach() of every bridge pin, which drives
+ * them low and takes them away from their LEDC channels, so the motors
+ * coast whatever PWM duty the channels still hold. The interrupt code runs
+ * from IRAM, only touches DRAM and reads the pin and the clock without
+ * going through Arduino calls, which are not in IRAM unless the core is
+ * built with CONFIG_ARDUINO_ISR_IRAM. Both interrupts are allocated with
+ * ESP_INTR_FLAG_IRAM, so they also act while flash is written.
+ *
+ * The motor task calls update() every tick. While the bridges are cut it
+ * halts every motor and drops every command. A deadman stop is released by
+ * the next valid command, an e-stop by releasing the button, and the motor
+ * task then reconnects the motors at zero speed.
+ *
+ * The worst case from a stop request to bridge pins low is:
+ * 1. E-stop : Interrupt entry and gpioDetach(), a few micro-seconds, or
+ *    safetyCheckUs if the edge was missed.
+ * 2. Deadman : The deadman window plus safetyCheckUs after the last valid
+ *    command, however long the network or the tasks are stalled.
+ * 3. Stop command : Delivery, up to one motor period, then the deceleration
+ *    ramp from full duty. Only while the network is up, otherwise 2 applies.
+ ******************************************************************************/
+#ifndef _SAFETY_STOP_H // Start of conditional preprocessor code that only
+                       // allows this library to be included once.
+#define _SAFETY_STOP_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <gpioBank.h> // Cutting the bridge pins.
+#include <atomic> // State shared between the interrupts and the tasks.
+
+const uint32_t safetyCheckUs = 10000; // Deadman and e-stop poll period.
+const uint8_t safetyTimer = 0; // Hardware timer used for the poll.
+
+// Why the bridges are cut.
+enum safetyCause : uint8_t
+{
+   SAFETY_CLEAR,
+   SAFETY_DEADMAN,
+   SAFETY_ESTOP,
+   SAFETY_CAUSES
+}; // safetyCause
+
+// What update() tells the motor task to do.
+enum safetyAction : uint8_t
+{
+   SAFETY_RUN,
+   SAFETY_CUT,
+   SAFETY_RESTORED
+}; // safetyAction
+
+class SafetyStop
+{
+   public:
+      void begin(const gpioMask& outputs, int8_t estopPin, uint32_t deadmanMs);
+      void feed();
+      void setOpenEnded(bool openEnded);
+      safetyAction update();
+      uint8_t getCause();
+      uint32_t getTrips(uint8_t cause);
+      uint32_t getDeadmanMs();
+      uint32_t getLateMaxUs();
+      uint32_t getCutMaxUs();
+   private:
+      static bool IRAM_ATTR onTimer(void* safety);
+      static void IRAM_ATTR onEstop(void* safety);
+      void IRAM_ATTR check();
+      void IRAM_ATTR trip(uint8_t cause, uint32_t lateUs);
+      static SafetyStop* instance; // The one the host timer stand-in checks.
+      gpioMask outputs = {0, 0}; // Bridge pins to cut.
+      int8_t estopPin = -1; // E-stop input, -1 for none.
+      uint32_t deadmanMs = 0; // Deadman window, 0 for no deadman.
+      bool openEndedSeen = false; // Motor task side copy of openEnded.
+      std::atomic<bool> openEnded{false}; // A motor runs with nothing to end it.
+      std::atomic<uint32_t> lastFeedUs{0}; // When the window last started.
+      std::atomic<uint32_t> feeds{0}; // Valid commands since start up.
+      std::atomic<uint32_t> feedsAtTrip{0}; // feeds when the deadman tripped.
+      std::atomic<uint32_t> cause{SAFETY_CLEAR}; // Why the bridges are cut, 32 bits for the interrupts.
+      std::atomic<uint32_t> trips[SAFETY_CAUSES]; // Cuts per cause.
+      std::atomic<uint32_t> lateMaxUs{0}; // Most the deadman tripped past its window.
+      std::atomic<uint32_t> cutMaxUs{0}; // Longest gpioDetach().
+}; // class SafetyStop
+
+#endif // End of conditional preprocessor code
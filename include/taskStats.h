@@ -0,0 +1,101 @@
+/******************************************************************************
+ * @file taskStats.h
+ *
+ * @brief Lightweight timing of scheduler tasks and command handlers.
+ *
+ * @details Each measured piece of code owns a TaskStat. A StatScope placed
+ * at the top of the code reads a free running counter on entry and exit and
+ * adds the difference to the TaskStat's histogram. If the task has an
+ * interval, a run longer than that interval counts as an overrun since the
+ * task has then missed its next slot. The counter is the CPU cycle counter
+ * (ESP.getCycleCount()) on the ESP32 and a nano-second steady clock on
+ * other builds. Times are kept in counter ticks and only converted to
+ * micro-seconds when a snapshot is formatted.
+ *
+ * Each TaskStat must be written from one task only. A reset requested from
+ * another core is handed over through an atomic flag and carried out by the
+ * writer on its next record().
+ *
+ * Overhead: one scope costs two counter reads plus a histogram update, a few
+ * shifts and adds with no allocation. statsCalibrate() times a batch of
+ * empty scopes at start up and every snapshot reports the result in cycles,
+ * so the figure published is the one measured on the running device.
+ ******************************************************************************/
+#ifndef _TASK_STATS_H // Start of conditional preprocessor code that only
+                      // allows this library to be included once.
+#define _TASK_STATS_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <latencyHistogram.h> // Duration histogram.
+#include <atomic> // Cross-core reset flag.
+#ifndef ARDUINO_ARCH_ESP32
+#include <chrono> // Steady clock for host builds.
+#endif
+
+/**
+ * @brief Read the free running timing counter.
+ *
+ * @param NA No parameters.
+ *
+ * @return Counter ticks, wraps around.
+ */
+inline uint32_t statsNow()
+{
+#ifdef ARDUINO_ARCH_ESP32
+   return ESP.getCycleCount();
+#else
+   return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+} // statsNow()
+
+uint32_t statsTicksPerMicro();
+
+class TaskStat
+{
+   public:
+      TaskStat(const char* name, uint32_t intervalMs = 0);
+      void record(uint32_t ticks);
+      void requestReset();
+      const char* getName();
+      uint32_t getOverruns();
+      LatencyHistogram& getHistogram();
+   private:
+      const char* name; // Label used in the snapshot.
+      uint32_t intervalTicks = 0; // Longest run that is not an overrun, 0 = none.
+      uint32_t overruns = 0; // Runs longer than the interval.
+      LatencyHistogram histogram; // Run times in counter ticks.
+      std::atomic<bool> resetPending; // Set by requestReset(), cleared by record().
+}; // class TaskStat
+
+class StatScope
+{
+   public:
+      /**
+       * @brief Start timing.
+       *
+       * @param stat Where the run time is recorded.
+       */
+      StatScope(TaskStat& stat) : stat(&stat), start(statsNow()) {}
+
+      /**
+       * @brief Stop timing and record the run.
+       */
+      ~StatScope() { this->stat->record(statsNow() - this->start); }
+
+      /**
+       * @brief Record this run against another TaskStat. Used once a
+       * command has been parsed and its handler is known.
+       *
+       * @param other TaskStat to record into instead.
+       */
+      void attribute(TaskStat& other) { this->stat = &other; }
+   private:
+      TaskStat* stat; // Where the run time is recorded.
+      uint32_t start; // Counter on entry.
+}; // class StatScope
+
+uint32_t statsCalibrate();
+size_t statsFormat(TaskStat* const stats[], uint8_t count, uint32_t overhead, char* out, size_t size);
+
+#endif // End of conditional preprocessor code
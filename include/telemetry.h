@@ -0,0 +1,72 @@
+/******************************************************************************
+ * @file telemetry.h
+ *
+ * @brief Fixed layout binary state frame, sent when the state changes or a
+ * maximum interval has passed.
+ *
+ * @details Frames are published to <clientID>/tel. All fields are little
+ * endian:
+ *
+ * | Offset | Size | Content                                              |
+ * |:------:|:----:|:-----------------------------------------------------|
+ * | 0      | 1    | Frame layout version (telemetryVersion).             |
+ * | 1      | 1    | Why it was sent, see telemetryReason.                |
+ * | 2      | 2    | Sequence number, a gap means a lost frame.           |
+ * | 4      | 4    | Uptime in milli-seconds.                             |
+ * | 8      | 6    | Applied duty of slew, hoist and luff (int16).        |
+ * | 14     | 6    | Setpoint of slew, hoist and luff (int16).            |
+ * | 20     | 1    | Servo position in degrees.                           |
+ * | 21     | 1    | WiFi RSSI in dBm (int8).                             |
+ * | 22     | 4    | Free heap in bytes.                                  |
+ *
+ * Uptime and free heap never trigger a frame on their own, RSSI only when
+ * it moves by more than a dead band. Liveness is left to the MQTT keep-alive
+ * and the retained online/offline message on <clientID>/status, so an idle
+ * crane sends one frame per maximum interval. tools/telemetry.py decodes the
+ * frames and compares the traffic with the old text keep-alive.
+ ******************************************************************************/
+#ifndef _TELEMETRY_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _TELEMETRY_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+
+const uint8_t telemetryVersion = 1; // Bump when the layout changes.
+const uint8_t telemetryAxes = 3; // Slew, hoist and luff.
+const uint8_t telemetryFrameSize = 26; // Bytes in one frame.
+
+// Why a frame was sent.
+enum telemetryReason : uint8_t
+{
+   TEL_FIRST, // First frame since start up.
+   TEL_CHANGE, // Motor, servo or RSSI state changed.
+   TEL_INTERVAL // Nothing changed for the maximum interval.
+}; // telemetryReason
+
+// Device state carried by one frame.
+struct telemetryState
+{
+   uint32_t uptime; // Milli-seconds since start up.
+   int16_t speed[telemetryAxes]; // Applied duty per axis.
+   int16_t setpoint[telemetryAxes]; // Requested duty per axis.
+   uint8_t servo; // Servo position in degrees.
+   int8_t rssi; // WiFi signal in dBm.
+   uint32_t freeHeap; // Bytes of free heap.
+}; // telemetryState
+
+class Telemetry
+{
+   public:
+      void setLimits(uint32_t maxInterval, uint8_t rssiDeadBand);
+      bool frame(const telemetryState& state, uint8_t out[telemetryFrameSize]);
+      uint16_t getSequence();
+   private:
+      bool changed(const telemetryState& state);
+      uint32_t maxInterval = 60000; // Longest gap between frames in milli-seconds.
+      uint8_t rssiDeadBand = 4; // RSSI change in dB that counts as a change.
+      bool first = true; // Nothing sent yet.
+      uint16_t sequence = 0; // Sequence number of the next frame.
+      telemetryState last; // State in the last frame sent.
+}; // class Telemetry
+
+#endif // End of conditional preprocessor code
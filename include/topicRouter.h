@@ -0,0 +1,63 @@
+/******************************************************************************
+ * @file topicRouter.h
+ *
+ * @brief Map MQTT topic names and command words to their handlers through a
+ * hash table built from a constant route list.
+ *
+ * @details Each route carries the FNV-1a hash of its name, worked out at
+ * compile time by ROUTE(). begin() places the routes in a small open
+ * addressed table indexed by the low bits of the hash. find() hashes the
+ * name once, walks at most the longest probe sequence seen while building
+ * the table, and compares the name only when the hash matches. A lookup
+ * therefore costs the same however many routes there are and never touches
+ * the heap. Names do not have to be zero terminated, so a command word can
+ * be looked up where it sits in the MQTT receive buffer.
+ *
+ * The route list itself is const and stays in flash, the table is
+ * routerSlots bytes of RAM per router.
+ ******************************************************************************/
+#ifndef _TOPIC_ROUTER_H // Start of conditional preprocessor code that only
+                        // allows this library to be included once.
+#define _TOPIC_ROUTER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <fnvHash.h> // Compile time name hashes.
+#include <taskStats.h> // Handler timing per route.
+
+const uint8_t routerSlots = 64; // Table size, must be a power of two.
+const uint8_t routerMaxRoutes = routerSlots / 2; // Keeps the probes short.
+
+// Handler of one route. value is the rest of the message, zero terminated.
+typedef void (*routeHandler)(uint8_t arg, const char* value, uint16_t length);
+
+// One entry of a route list.
+struct topicRoute
+{
+   uint32_t hash; // fnv1a() of name.
+   const char* name; // Topic below the client ID, or command word.
+   routeHandler handler; // NULL for a route the caller treats specially.
+   uint8_t arg; // Handed to the handler, such as an actuator.
+   TaskStat* stat; // Where the time spent handling it is recorded.
+}; // topicRoute
+
+// Route list entry with the hash of its name worked out at compile time.
+#define ROUTE(name, handler, arg, stat) {fnv1a(name), name, handler, arg, stat}
+
+class TopicRouter
+{
+   public:
+      bool begin(const topicRoute* routes, uint8_t count);
+      const topicRoute* find(const char* name, uint16_t length);
+      uint8_t getCount();
+      uint8_t getLongestProbe();
+   private:
+      const topicRoute* routes = NULL; // Route list given to begin().
+      uint8_t count = 0; // Routes in the list.
+      uint8_t slots[routerSlots] = {0}; // Route index plus one, 0 for empty.
+      uint8_t longestProbe = 0; // Most slots any route is past its home slot.
+}; // class TopicRouter
+
+uint16_t routeField(const char* text, uint16_t length);
+bool routeNumber(const char* text, uint16_t length, int32_t& value);
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * @file udpControl.h
+ *
+ * @brief Commands in UDP datagrams straight from the operator, for remote
+ * control that cannot wait for the MQTT broker.
+ *
+ * @details An MQTT command goes from the operator to the broker and from
+ * the broker to the crane, two trips across the network and a TCP stream
+ * that holds everything behind a lost segment. A datagram goes straight to
+ * the crane and a lost one is simply replaced by the next. The commands are
+ * the MQTT ones, handed to the same dispatcher, and MQTT stays in use for
+ * configuration, logs and telemetry. Nothing checks who sent a datagram,
+ * any sender on the network can drive the crane, so the port is closed
+ * unless UDP_PORT is set. The native build opens 4210 for the simulator.
+ *
+ * A datagram is a 7 byte header then the topic and payload of the MQTT
+ * message it stands for:
+ *
+ *    0      udpMagic.
+ *    1-2    Session, little endian, picked at random by the sender at start.
+ *    3-6    Sequence number, little endian, one more for every datagram.
+ *    7-     Topic below "<clientID>/" such as "cmd" or "slew/set", a zero,
+ *           then the payload up to the end of the datagram.
+ *
+ * Only one sender is listened to at a time. A datagram from another session
+ * takes over once the current one has been quiet for udpSessionMs, so a
+ * sender that restarts is back in control within that time and a second
+ * joystick cannot fight the first. A datagram whose sequence number is not
+ * newer than the last one taken from the session is stale, it arrived after
+ * a newer one or twice, and is dropped.
+ *
+ * Every datagram with a good header is answered with an 8 byte ack, the
+ * first 7 bytes of the datagram then a udpResult, so the sender can time
+ * the round trip and see what became of each command. Anything else is
+ * dropped without an answer.
+ *
+ * The socket is a non-blocking BSD socket, from lwIP on the ESP32 and from
+ * the operating system on a PC, so the native build talks over loopback.
+ * Datagrams are read straight into a buffer in the object, nothing here
+ * uses the heap.
+ ******************************************************************************/
+#ifndef _UDP_CONTROL_H // Start of conditional preprocessor code that only
+                       // allows this library to be included once.
+#define _UDP_CONTROL_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+
+const uint8_t udpMagic = 0xC5; // First byte of every datagram and ack.
+const uint8_t udpHeaderSize = 7; // Magic, session and sequence number.
+const uint16_t udpMaxDatagram = 256; // Longest datagram taken, as the MQTT buffer.
+const uint16_t udpSessionMs = 1000; // Quiet time before another sender may take over.
+
+// What became of a datagram, the last byte of its ack.
+enum udpResult : uint8_t
+{
+   UDP_ACCEPTED, // Handed to the dispatcher, which knew the command.
+   UDP_UNKNOWN, // Handed to the dispatcher, which did not.
+   UDP_STALE, // Not newer than the last one taken, dropped.
+   UDP_BUSY, // Another sender has control, dropped.
+   UDP_RESULTS
+}; // udpResult
+
+// Command dispatcher. topic is zero terminated, payload has room for a zero
+// after length. Returns false for an unknown command.
+typedef bool (*udpHandler)(const char* topic, uint8_t* payload, unsigned int length);
+
+class UdpControl
+{
+   public:
+      void begin(uint16_t port, udpHandler handler);
+      bool start();
+      uint8_t poll(uint8_t most);
+      uint16_t getPort();
+      uint32_t getCount(uint8_t result);
+      uint32_t getMalformed();
+   private:
+      uint8_t handle(uint16_t length);
+      int fd = -1; // Listening socket, -1 until start().
+      uint16_t port = 0; // Port to listen on, 0 for none.
+      udpHandler handler = NULL; // Where commands go.
+      bool haveSession = false; // A sender has been heard.
+      uint16_t session = 0; // Sender in control.
+      uint32_t sequence = 0; // Last sequence number taken from it.
+      uint32_t heardMs = 0; // When it last sent a datagram that was taken.
+      uint8_t buffer[udpMaxDatagram + 1]; // One datagram and a zero after it.
+      uint32_t counts[UDP_RESULTS] = {0}; // Datagrams per result.
+      uint32_t malformed = 0; // Datagrams dropped without an ack.
+}; // class UdpControl
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,290 @@
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <hostSim.h> // Virtual clock and pins.
+#include <stdio.h> // stdout.
+
+// One of the four hardware timers.
+struct hw_timer_s
+{
+   uint16_t divider; // APB clock divider, 80 for micro-second ticks.
+   void (*handler)(); // Alarm interrupt handler.
+   uint64_t alarm; // Ticks between alarms.
+}; // hw_timer_s
+
+HardwareSerial Serial;
+EspClass ESP;
+hw_timer_s simTimers[4]; // Hardware timers 0 to 3.
+
+/**
+ * @brief Milli-seconds since start up on the virtual clock.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds, wraps like the device.
+ */
+unsigned long millis()
+{
+   return (uint32_t)(hostSimMicros() / 1000);
+} // millis()
+
+/**
+ * @brief Micro-seconds since start up on the virtual clock.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds, wraps like the device.
+ */
+unsigned long micros()
+{
+   return (uint32_t)hostSimMicros();
+} // micros()
+
+/**
+ * @brief Let the virtual clock run on.
+ *
+ * @param ms Milli-seconds to wait.
+ *
+ * @return NA No return value.
+ */
+void delay(uint32_t ms)
+{
+   hostSimAdvance((uint64_t)ms * 1000);
+} // delay()
+
+/**
+ * @brief Let the virtual clock run on.
+ *
+ * @param us Micro-seconds to wait.
+ *
+ * @return NA No return value.
+ */
+void delayMicroseconds(uint32_t us)
+{
+   hostSimAdvance(us);
+} // delayMicroseconds()
+
+/**
+ * @brief Nothing else to run on the host.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void yield()
+{
+} // yield()
+
+/**
+ * @brief Pin modes are not simulated.
+ *
+ * @param pin GPIO number.
+ * @param mode INPUT, OUTPUT and so on.
+ *
+ * @return NA No return value.
+ */
+void pinMode(uint8_t pin, uint8_t mode)
+{
+} // pinMode()
+
+/**
+ * @brief Drive a simulated pin.
+ *
+ * @param pin GPIO number.
+ * @param level HIGH or LOW.
+ *
+ * @return NA No return value.
+ */
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+   hostSimPinWrite(pin, level);
+} // digitalWrite()
+
+/**
+ * @brief Read a simulated pin.
+ *
+ * @param pin GPIO number.
+ *
+ * @return HIGH or LOW.
+ */
+int digitalRead(uint8_t pin)
+{
+   return hostSimPinRead(pin);
+} // digitalRead()
+
+/**
+ * @brief Call a handler on every pulse of a simulated encoder.
+ *
+ * @param pin GPIO number.
+ * @param handler Interrupt handler.
+ * @param arg Passed to the handler.
+ * @param mode Ignored, each pulse is one call.
+ *
+ * @return NA No return value.
+ */
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode)
+{
+   hostSimAttachInterrupt(pin, handler, arg);
+} // attachInterruptArg()
+
+/**
+ * @brief Stop calling the handler of a pin.
+ *
+ * @param pin GPIO number.
+ *
+ * @return NA No return value.
+ */
+void detachInterrupt(uint8_t pin)
+{
+   hostSimAttachInterrupt(pin, NULL, NULL);
+} // detachInterrupt()
+
+/**
+ * @brief Claim a hardware timer.
+ *
+ * @param num Timer 0 to 3.
+ * @param divider APB clock divider.
+ * @param countUp Ignored.
+ *
+ * @return The timer, NULL for a bad number.
+ */
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp)
+{
+   if(num >= sizeof(simTimers) / sizeof(simTimers[0]))
+   {
+      return NULL;
+   } // if
+   simTimers[num] = {max(divider, (uint16_t)1), NULL, 0};
+   return &simTimers[num];
+} // timerBegin()
+
+/**
+ * @brief Set the alarm handler of a timer.
+ *
+ * @param timer From timerBegin().
+ * @param handler Interrupt handler.
+ * @param edge Ignored.
+ *
+ * @return NA No return value.
+ */
+void timerAttachInterrupt(hw_timer_t* timer, void (*handler)(), bool edge)
+{
+   if(timer != NULL)
+   {
+      timer->handler = handler;
+   } // if
+} // timerAttachInterrupt()
+
+/**
+ * @brief Set the alarm period of a timer.
+ *
+ * @param timer From timerBegin().
+ * @param alarm Timer ticks between alarms.
+ * @param autoreload Ignored, the alarm always repeats.
+ *
+ * @return NA No return value.
+ */
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarm, bool autoreload)
+{
+   if(timer != NULL)
+   {
+      timer->alarm = alarm;
+   } // if
+} // timerAlarmWrite()
+
+/**
+ * @brief Start calling the handler on the virtual clock. Only one timer is
+ * simulated, the last one enabled.
+ *
+ * @param timer From timerBegin().
+ *
+ * @return NA No return value.
+ */
+void timerAlarmEnable(hw_timer_t* timer)
+{
+   if(timer != NULL)
+   {
+      hostSimTimer(timer->alarm * timer->divider / 80, timer->handler); // 80 MHz APB clock.
+   } // if
+} // timerAlarmEnable()
+
+/**
+ * @brief Repeatable pseudo random number, see --seed.
+ *
+ * @param howBig One more than the largest value wanted.
+ *
+ * @return 0 to howBig - 1.
+ */
+long random(long howBig)
+{
+   return (howBig <= 0) ? 0 : hostSimRandom() % howBig;
+} // random()
+
+/**
+ * @brief Repeatable pseudo random number in a range, see --seed.
+ *
+ * @param howSmall Smallest value wanted.
+ * @param howBig One more than the largest value wanted.
+ *
+ * @return howSmall to howBig - 1.
+ */
+long random(long howSmall, long howBig)
+{
+   return (howSmall >= howBig) ? howSmall : howSmall + random(howBig - howSmall);
+} // random()
+
+/**
+ * @brief The seed comes from the --seed option instead.
+ *
+ * @param seed Ignored.
+ *
+ * @return NA No return value.
+ */
+void randomSeed(unsigned long seed)
+{
+} // randomSeed()
+
+/**
+ * @brief Write one character to stdout.
+ *
+ * @param c Character.
+ *
+ * @return 1.
+ */
+size_t HardwareSerial::write(uint8_t c)
+{
+   hostSimSerialWrite(1);
+   if(!hostSimQuiet())
+   {
+      putchar(c);
+   } // if
+   return 1;
+} // HardwareSerial::write()
+
+/**
+ * @brief Write a buffer to stdout.
+ *
+ * @param buffer Bytes to write.
+ * @param size Number of bytes.
+ *
+ * @return size.
+ */
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+   hostSimSerialWrite(size);
+   if(!hostSimQuiet())
+   {
+      fwrite(buffer, 1, size, stdout);
+   } // if
+   return size;
+} // HardwareSerial::write()
+
+/**
+ * @brief CPU cycles at 240 MHz on the virtual clock.
+ *
+ * @param NA No parameters.
+ *
+ * @return Cycle count, wraps like the device.
+ */
+uint32_t EspClass::getCycleCount()
+{
+   return (uint32_t)(hostSimMicros() * 240);
+} // EspClass::getCycleCount()
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * @file Arduino.h
+ *
+ * @brief Host stand-in for the parts of the Arduino core for ESP32 that the
+ * firmware uses.
+ *
+ * @details Time comes from the virtual clock in hostSim.h. Serial writes to
+ * stdout unless the simulation runs with --quiet. Pin interrupts are only
+ * raised by the simulated encoders and the e-stop button. The hardware
+ * timer interrupt is called on the virtual clock, always repeating.
+ ******************************************************************************/
+#ifndef _ARDUINO_H // Start of conditional preprocessor code that only allows
+                   // this library to be included once.
+#define _ARDUINO_H // Preprocessor variable used by above check.
+
+#include <stdint.h> // Fixed width integer types.
+#include <stdlib.h> // abs() and friends.
+#include <string.h> // memcpy(), strcmp() and friends.
+#include <math.h> // Floating point.
+#include <algorithm> // std::min and std::max.
+#include <WString.h> // Arduino String.
+#include <Print.h> // Arduino Print.
+#include <FreeRTOS.h> // Tasks of a DUAL_CORE build.
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define IRAM_ATTR
+#define DEC 10
+#define HEX 16
+
+using std::min;
+using std::max;
+using std::abs;
+
+template<typename T, typename L, typename H>
+inline T constrain(T value, L low, H high)
+{
+   return (value < low) ? low : (value > high) ? high : value;
+} // constrain()
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerAttachInterrupt(hw_timer_t* timer, void (*handler)(), bool edge);
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarm, bool autoreload);
+void timerAlarmEnable(hw_timer_t* timer);
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+class HardwareSerial : public Print
+{
+   public:
+      void begin(unsigned long baud) {}
+      size_t write(uint8_t c) override;
+      size_t write(const uint8_t* buffer, size_t size) override;
+      using Print::write;
+      int available() { return 0; }
+      int read() { return -1; }
+}; // class HardwareSerial
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+   public:
+      uint32_t getCycleCount();
+      uint32_t getCpuFreqMHz() { return 240; }
+      uint32_t getFreeHeap() { return hostSimHeapFree(); }
+      uint32_t getMinFreeHeap() { return hostSimHeapMinFree(); }
+      uint32_t getMaxAllocHeap() { return hostSimHeapLargest(); }
+}; // class EspClass
+
+extern EspClass ESP;
+
+#endif // End of conditional preprocessor code
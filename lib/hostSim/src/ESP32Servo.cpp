@@ -0,0 +1,127 @@
+#include <ESP32Servo.h> // Host stand-in for ESP32Servo.
+#include <hostSim.h> // Simulated crane.
+#include <gpioBank.h> // Pins cut by gpioDetach().
+
+/**
+ * @brief Claim a pin for PWM output. The output starts at zero duty.
+ *
+ * @param pin Output pin.
+ * @param frequency PWM frequency in Hz, not modelled.
+ * @param resolution Bits of duty resolution, not modelled.
+ *
+ * @return NA No return value.
+ */
+void ESP32PWM::attachPin(uint8_t pin, double frequency, uint8_t resolution)
+{
+   this->pin = pin;
+   this->duty = 0;
+   hostSimPwm(this->pin, 0);
+} // ESP32PWM::attachPin()
+
+/**
+ * @brief Route the channel to a pin again, as after gpioDetach(). The pin
+ * carries the duty last written from now on.
+ *
+ * @param pin Output pin.
+ *
+ * @return NA No return value.
+ */
+void ESP32PWM::attachPin(uint8_t pin)
+{
+   this->pin = pin;
+   gpioMask mask = gpioMaskOf(pin);
+   gpioFakeDetached = {gpioFakeDetached.bank0 & ~mask.bank0, gpioFakeDetached.bank1 & ~mask.bank1};
+   hostSimPwm(this->pin, this->duty);
+} // ESP32PWM::attachPin()
+
+/**
+ * @brief Set the duty cycle.
+ *
+ * @param duty Duty in units of the resolution.
+ *
+ * @return NA No return value.
+ */
+void ESP32PWM::write(uint32_t duty)
+{
+   this->duty = duty;
+   if(this->pin >= 0)
+   {
+      hostSimPwm(this->pin, duty);
+   } // if
+} // ESP32PWM::write()
+
+/**
+ * @brief Claim a pin for the servo.
+ *
+ * @param pin Output pin.
+ * @param min Pulse width in micro-seconds at 0 degrees.
+ * @param max Pulse width in micro-seconds at 180 degrees.
+ *
+ * @return Channel number, always 0.
+ */
+int Servo::attach(int pin, int min, int max)
+{
+   this->pin = pin;
+   this->minUs = min;
+   this->maxUs = max;
+   return 0;
+} // Servo::attach()
+
+/**
+ * @brief Release the pin.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void Servo::detach()
+{
+   this->pin = -1;
+} // Servo::detach()
+
+/**
+ * @brief Move to an angle. Like the library, values from the minimum pulse
+ * width up are taken as micro-seconds.
+ *
+ * @param value Angle in degrees or pulse width in micro-seconds.
+ *
+ * @return NA No return value.
+ */
+void Servo::write(int value)
+{
+   if(value >= this->minUs)
+   {
+      this->writeMicroseconds(value);
+      return;
+   } // if
+   this->angle = constrain(value, 0, 180);
+   if(this->pin >= 0)
+   {
+      hostSimServo(this->pin, this->angle);
+   } // if
+} // Servo::write()
+
+/**
+ * @brief Move to the angle given by a pulse width.
+ *
+ * @param value Pulse width in micro-seconds.
+ *
+ * @return NA No return value.
+ */
+void Servo::writeMicroseconds(int value)
+{
+   value = constrain(value, this->minUs, this->maxUs);
+   this->write((int)((long)(value - this->minUs) * 180 / (this->maxUs - this->minUs)));
+} // Servo::writeMicroseconds()
+
+/**
+ * @brief Last angle written.
+ *
+ * @param NA No parameters.
+ *
+ * @return Degrees.
+ */
+int Servo::read()
+{
+   return this->angle;
+} // Servo::read()
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * @file ESP32Servo.h
+ *
+ * @brief Host stand-in for the ESP32Servo library.
+ *
+ * @details PWM duty and servo angle writes are passed to the simulated crane
+ * instead of the LEDC peripheral.
+ ******************************************************************************/
+#ifndef _ESP32SERVO_H // Start of conditional preprocessor code that only
+                      // allows this library to be included once.
+#define _ESP32SERVO_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+
+class ESP32PWM
+{
+   public:
+      static void allocateTimer(int timer) {}
+      void attachPin(uint8_t pin, double frequency, uint8_t resolution);
+      void attachPin(uint8_t pin);
+      void write(uint32_t duty);
+      bool attached() { return this->pin >= 0; }
+   private:
+      int8_t pin = -1; // Output pin, -1 until attached.
+      uint32_t duty = 0; // Last duty written.
+}; // class ESP32PWM
+
+class Servo
+{
+   public:
+      void setPeriodHertz(int hertz) {}
+      int attach(int pin, int min = 544, int max = 2400);
+      void detach();
+      void write(int value);
+      void writeMicroseconds(int value);
+      int read();
+      bool attached() { return this->pin >= 0; }
+   private:
+      int8_t pin = -1; // Output pin, -1 until attached.
+      int minUs = 544; // Pulse width at 0 degrees.
+      int maxUs = 2400; // Pulse width at 180 degrees.
+      int angle = 0; // Last angle written.
+}; // class Servo
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,272 @@
+#include <FS.h> // Host stand-in for the file system interface.
+#include <hostSim.h> // Flash wear count.
+
+/**
+ * @brief Contents of the open file.
+ *
+ * @param NA No parameters.
+ *
+ * @return Contents, NULL if not open or removed since.
+ */
+std::string* fs::File::contents()
+{
+   if(this->fs == NULL || this->directory)
+   {
+      return NULL;
+   } // if
+   auto found = this->fs->files.find(this->path);
+   return (found == this->fs->files.end()) ? NULL : &found->second;
+} // fs::File::contents()
+
+/**
+ * @brief Write bytes at the current position, or at the end in append mode.
+ *
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ *
+ * @return Bytes written, 0 if the file is not open for writing.
+ */
+size_t fs::File::write(const uint8_t* data, size_t size)
+{
+   std::string* contents = this->contents();
+   if(contents == NULL || !this->writable)
+   {
+      return 0;
+   } // if
+   if(this->append)
+   {
+      this->pos = contents->size();
+   } // if
+   contents->replace(this->pos, min(size, contents->size() - this->pos), (const char*)data, size);
+   this->pos += size;
+   hostSimFlashWrite(size);
+   return size;
+} // fs::File::write()
+
+/**
+ * @brief Write one byte.
+ *
+ * @param data Byte to write.
+ *
+ * @return Bytes written.
+ */
+size_t fs::File::write(uint8_t data)
+{
+   return this->write(&data, 1);
+} // fs::File::write()
+
+/**
+ * @brief Read bytes from the current position.
+ *
+ * @param data Where to put them.
+ * @param size Most bytes to read.
+ *
+ * @return Bytes read.
+ */
+size_t fs::File::read(uint8_t* data, size_t size)
+{
+   std::string* contents = this->contents();
+   if(contents == NULL || this->pos >= contents->size())
+   {
+      return 0;
+   } // if
+   size_t count = min(size, contents->size() - this->pos);
+   memcpy(data, contents->data() + this->pos, count);
+   this->pos += count;
+   return count;
+} // fs::File::read()
+
+/**
+ * @brief Move the read and write position.
+ *
+ * @param pos Offset from the start.
+ *
+ * @return True if the offset is inside the file.
+ */
+bool fs::File::seek(uint32_t pos)
+{
+   std::string* contents = this->contents();
+   if(contents == NULL || pos > contents->size())
+   {
+      return false;
+   } // if
+   this->pos = pos;
+   return true;
+} // fs::File::seek()
+
+/**
+ * @brief Current read and write position.
+ *
+ * @param NA No parameters.
+ *
+ * @return Offset from the start.
+ */
+size_t fs::File::position()
+{
+   return this->pos;
+} // fs::File::position()
+
+/**
+ * @brief Size of the file.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes, 0 for a directory or a removed file.
+ */
+size_t fs::File::size()
+{
+   std::string* contents = this->contents();
+   return (contents == NULL) ? 0 : contents->size();
+} // fs::File::size()
+
+/**
+ * @brief Close the file.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void fs::File::close()
+{
+   this->fs = NULL;
+   this->children.clear();
+} // fs::File::close()
+
+/**
+ * @brief Whether the file is open.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if open.
+ */
+fs::File::operator bool() const
+{
+   return this->fs != NULL;
+} // fs::File::operator bool()
+
+/**
+ * @brief Whether a directory was opened.
+ *
+ * @param NA No parameters.
+ *
+ * @return True for a directory.
+ */
+bool fs::File::isDirectory()
+{
+   return this->fs != NULL && this->directory;
+} // fs::File::isDirectory()
+
+/**
+ * @brief Open the next entry of a directory.
+ *
+ * @param NA No parameters.
+ *
+ * @return The entry, closed when there are no more.
+ */
+fs::File fs::File::openNextFile()
+{
+   if(!this->isDirectory() || this->next >= this->children.size())
+   {
+      return File();
+   } // if
+   return this->fs->open(this->children[this->next++].c_str());
+} // fs::File::openNextFile()
+
+/**
+ * @brief Name of the file without the directory, as ESP32 core 2.x gives it.
+ *
+ * @param NA No parameters.
+ *
+ * @return Name.
+ */
+const char* fs::File::name()
+{
+   return this->base.c_str();
+} // fs::File::name()
+
+/**
+ * @brief Open a file or directory.
+ *
+ * @param path Full path.
+ * @param mode FILE_READ, FILE_WRITE or FILE_APPEND.
+ * @param create Ignored, writing always creates the file.
+ *
+ * @return The open file, closed if it does not exist.
+ */
+fs::File fs::FS::open(const char* path, const char* mode, const bool create)
+{
+   File file;
+   std::string name = path;
+   bool writable = mode[0] == 'w' || mode[0] == 'a';
+   if(this->dirs.count(name) != 0 && !writable)
+   {
+      std::string prefix = (name == "/") ? name : name + "/";
+      for(const auto& entry : this->files)
+      {
+         if(entry.first.compare(0, prefix.size(), prefix) == 0 && entry.first.find('/', prefix.size()) == std::string::npos)
+         {
+            file.children.push_back(entry.first);
+         } // if
+      } // for
+      file.directory = true;
+   } // if
+   else if(writable)
+   {
+      std::string& contents = this->files[name];
+      if(mode[0] == 'w')
+      {
+         contents.clear();
+      } // if
+      file.writable = true;
+      file.append = mode[0] == 'a';
+   } // else if
+   else if(this->files.count(name) == 0)
+   {
+      return file;
+   } // else if
+   file.fs = this;
+   file.path = name;
+   file.base = name.substr(name.rfind('/') + 1);
+   return file;
+} // fs::FS::open()
+
+/**
+ * @brief Whether a file or directory exists.
+ *
+ * @param path Full path.
+ *
+ * @return True if it exists.
+ */
+bool fs::FS::exists(const char* path)
+{
+   return this->files.count(path) != 0 || this->dirs.count(path) != 0;
+} // fs::FS::exists()
+
+/**
+ * @brief Create a directory.
+ *
+ * @param path Full path.
+ *
+ * @return True unless a file has that path.
+ */
+bool fs::FS::mkdir(const char* path)
+{
+   if(this->files.count(path) != 0)
+   {
+      return false;
+   } // if
+   this->dirs.insert(path);
+   return true;
+} // fs::FS::mkdir()
+
+/**
+ * @brief Delete a file.
+ *
+ * @param path Full path.
+ *
+ * @return True if it existed.
+ */
+bool fs::FS::remove(const char* path)
+{
+   return this->files.erase(path) != 0;
+} // fs::FS::remove()
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * @file FS.h
+ *
+ * @brief Host stand-in for the ESP32 file system interface.
+ *
+ * @details Files and directories are held in memory, so flash starts empty
+ * on every run the way a freshly formatted partition does. Only the calls
+ * the firmware makes are provided. Every write is reported to the
+ * simulation, which counts it as flash wear.
+ ******************************************************************************/
+#ifndef _FS_H // Start of conditional preprocessor code that only
+              // allows this library to be included once.
+#define _FS_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <map> // Files by path.
+#include <set> // Directories.
+#include <string> // Paths and file contents.
+#include <vector> // Directory listings.
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+class FS;
+
+class File
+{
+   public:
+      size_t write(const uint8_t* data, size_t size);
+      size_t write(uint8_t data);
+      size_t read(uint8_t* data, size_t size);
+      bool seek(uint32_t pos);
+      size_t position();
+      size_t size();
+      void close();
+      operator bool() const;
+      bool isDirectory();
+      File openNextFile();
+      const char* name();
+   private:
+      friend class FS;
+      std::string* contents(); // NULL once the file is gone.
+      FS* fs = NULL; // Owner, NULL when not open.
+      std::string path; // Full path.
+      std::string base; // Last part of the path.
+      bool directory = false; // Opened a directory.
+      bool writable = false; // Opened with "w" or "a".
+      bool append = false; // Writes always go to the end.
+      size_t pos = 0; // Read and write position.
+      std::vector<std::string> children; // Directory listing taken at open.
+      size_t next = 0; // Next child for openNextFile().
+}; // class File
+
+class FS
+{
+   public:
+      File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+      bool exists(const char* path);
+      bool mkdir(const char* path);
+      bool remove(const char* path);
+   protected:
+      friend class File;
+      std::map<std::string, std::string> files; // Contents by path.
+      std::set<std::string> dirs; // Directory paths.
+}; // class FS
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif // End of conditional preprocessor code
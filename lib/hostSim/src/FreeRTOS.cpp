@@ -0,0 +1,217 @@
+#include <FreeRTOS.h> // Host stand-in for FreeRTOS tasks.
+#include <hostSim.h> // Virtual clock.
+#include <condition_variable> // Handing the baton between threads.
+#include <mutex> // The baton.
+#include <thread> // One thread per task.
+#include <vector> // Created tasks.
+
+// One task created with xTaskCreatePinnedToCore().
+struct simTask
+{
+   TaskFunction_t code; // Task function.
+   void* parameter; // Passed to the task function.
+   UBaseType_t priority; // Higher runs first when due together.
+   uint64_t wakeUs; // When it is next due on the virtual clock.
+   bool running; // Holds the baton, or is waiting inside its own hostSimAdvance().
+   bool deleted; // Never runs again.
+   std::condition_variable turn; // Signalled when running changes.
+}; // simTask
+
+// Allocated and never freed, so nothing is destroyed under a task thread
+// still blocked when the simulation exits.
+std::mutex* simBaton = new std::mutex(); // Held while the baton changes hands.
+std::vector<simTask*>* simTasks = new std::vector<simTask*>(); // By priority, highest first.
+thread_local simTask* simSelf = NULL; // Task of this thread, NULL for the loop task.
+
+/**
+ * @brief Give a task the baton and wait until it blocks again.
+ *
+ * @param task Task to run.
+ *
+ * @return NA No return value.
+ */
+void simRunTask(simTask* task)
+{
+   std::unique_lock<std::mutex> lock(*simBaton);
+   task->running = true;
+   task->turn.notify_all();
+   task->turn.wait(lock, [task]() { return !task->running; });
+} // simRunTask()
+
+/**
+ * @brief Hand the baton back to whoever ran this task and wait to run
+ * again. Task side.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value, only once the task runs again.
+ */
+void simBlock()
+{
+   std::unique_lock<std::mutex> lock(*simBaton);
+   simSelf->running = false;
+   simSelf->turn.notify_all();
+   simSelf->turn.wait(lock, []() { return simSelf->running && !simSelf->deleted; });
+} // simBlock()
+
+/**
+ * @brief Thread of one task. Waits for the baton, then runs the task
+ * function, which should never return.
+ *
+ * @param task The task.
+ *
+ * @return NA No return value.
+ */
+void simTaskThread(simTask* task)
+{
+   simSelf = task;
+   {
+      std::unique_lock<std::mutex> lock(*simBaton);
+      task->turn.wait(lock, [task]() { return task->running; });
+   }
+   task->code(task->parameter);
+   vTaskDelete(NULL);
+} // simTaskThread()
+
+/**
+ * @brief Run every task that is due. Called by hostSimAdvance() after each
+ * substep.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void hostSimRunTasks()
+{
+   for(size_t i = 0; i < simTasks->size(); i++) // A task may create another.
+   {
+      simTask* task = (*simTasks)[i];
+      if(!task->deleted && !task->running && task->wakeUs <= hostSimMicros())
+      {
+         simRunTask(task);
+      } // if
+   } // for
+} // hostSimRunTasks()
+
+/**
+ * @brief Create a task and run it until it first blocks, as it would start
+ * at once on the other core.
+ *
+ * @param code Task function.
+ * @param name Not used.
+ * @param stackDepth Not used.
+ * @param parameter Passed to the task function.
+ * @param priority Higher runs first when due together.
+ * @param created Set to the task, may be NULL.
+ * @param core Not used.
+ *
+ * @return pdPASS.
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core)
+{
+   simTask* task = new simTask();
+   task->code = code;
+   task->parameter = parameter;
+   task->priority = priority;
+   task->wakeUs = hostSimMicros();
+   task->running = false;
+   task->deleted = false;
+   auto slot = simTasks->begin();
+   while(slot != simTasks->end() && (*slot)->priority >= priority)
+   {
+      slot++;
+   } // while
+   simTasks->insert(slot, task);
+   if(created != NULL)
+   {
+      *created = task;
+   } // if
+   std::thread(simTaskThread, task).detach();
+   simRunTask(task);
+   return pdPASS;
+} // xTaskCreatePinnedToCore()
+
+/**
+ * @brief Delete a task. Deleting the loop task does nothing, the simulation
+ * keeps calling loop() to move the clock on.
+ *
+ * @param task Task to delete, NULL for the caller.
+ *
+ * @return NA No return value, never when a task deletes itself.
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+   if(task == NULL)
+   {
+      task = simSelf;
+   } // if
+   if(task == NULL)
+   {
+      return;
+   } // if
+   task->deleted = true;
+   if(task == simSelf)
+   {
+      simBlock(); // Never wakes.
+   } // if
+} // vTaskDelete()
+
+/**
+ * @brief Block the calling task for a number of ticks. From the loop task
+ * this is delay().
+ *
+ * @param ticks Milli-seconds.
+ *
+ * @return NA No return value.
+ */
+void vTaskDelay(TickType_t ticks)
+{
+   if(simSelf == NULL)
+   {
+      hostSimAdvance((uint64_t)ticks * 1000);
+      return;
+   } // if
+   simSelf->wakeUs = hostSimMicros() + (uint64_t)ticks * 1000;
+   simBlock();
+} // vTaskDelay()
+
+/**
+ * @brief Block the calling task until a fixed period after its last wake
+ * time. Returns at once if that has already passed, still moving the wake
+ * time on by one period.
+ *
+ * @param previousWake Last wake time in ticks, moved on by increment.
+ * @param increment Period in ticks.
+ *
+ * @return NA No return value.
+ */
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment)
+{
+   *previousWake += increment;
+   uint64_t wakeUs = (uint64_t)*previousWake * 1000;
+   if(wakeUs <= hostSimMicros())
+   {
+      return;
+   } // if
+   if(simSelf == NULL)
+   {
+      hostSimAdvance(wakeUs - hostSimMicros());
+      return;
+   } // if
+   simSelf->wakeUs = wakeUs;
+   simBlock();
+} // vTaskDelayUntil()
+
+/**
+ * @brief Ticks since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds on the virtual clock.
+ */
+TickType_t xTaskGetTickCount()
+{
+   return (TickType_t)(hostSimMicros() / 1000);
+} // xTaskGetTickCount()
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * @file FreeRTOS.h
+ *
+ * @brief Host stand-in for the FreeRTOS task calls that a DUAL_CORE build of
+ * the firmware uses.
+ *
+ * @details Each task runs on its own thread, but only one thread runs at a
+ * time, so the firmware sees no more concurrency than the simulation can
+ * keep repeatable. A task runs from its wake time on the virtual clock until
+ * it blocks in vTaskDelay() or vTaskDelayUntil(). Wake times are checked
+ * every substep of hostSimAdvance(), also while another task is inside it,
+ * blocked on a socket write or a stall. That is how two cores look from
+ * here: the motor task keeps its period while the network task is held up.
+ * A task never runs inside its own hostSimAdvance(). Code takes no virtual
+ * time, so the jitter seen is that of the blocking alone, to the 1 ms
+ * substep. Of several tasks due together the higher priority runs first,
+ * cores are otherwise ignored.
+ ******************************************************************************/
+#ifndef _FREE_RTOS_H // Start of conditional preprocessor code that only
+                     // allows this library to be included once.
+#define _FREE_RTOS_H // Preprocessor variable used by above check.
+
+#include <stdint.h> // Fixed width integer types.
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t; // Milli-seconds, as configTICK_RATE_HZ is 1000.
+typedef struct simTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdPASS 1
+#define pdFAIL 0
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment);
+TickType_t xTaskGetTickCount();
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,30 @@
+#include <LittleFS.h> // Host stand-in for LittleFS.
+
+fs::LittleFSFS LittleFS; // The flash partition.
+
+/**
+ * @brief Mount the file system. The root directory always exists.
+ *
+ * @param formatOnFail Ignored, mounting never fails.
+ * @param basePath Ignored.
+ * @param maxOpenFiles Ignored.
+ * @param partitionLabel Ignored.
+ *
+ * @return True.
+ */
+bool fs::LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel)
+{
+   this->dirs.insert("/");
+   return true;
+} // fs::LittleFSFS::begin()
+
+/**
+ * @brief Unmount the file system. The files are kept for the rest of the run.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void fs::LittleFSFS::end()
+{
+} // fs::LittleFSFS::end()
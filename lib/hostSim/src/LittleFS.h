@@ -0,0 +1,27 @@
+/******************************************************************************
+ * @file LittleFS.h
+ *
+ * @brief Host stand-in for the ESP32 LittleFS library.
+ ******************************************************************************/
+#ifndef _LITTLEFS_H // Start of conditional preprocessor code that only
+                    // allows this library to be included once.
+#define _LITTLEFS_H // Preprocessor variable used by above check.
+
+#include <FS.h> // Host stand-in for the file system interface.
+
+namespace fs
+{
+
+class LittleFSFS : public FS
+{
+   public:
+      bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+                 const char* partitionLabel = "spiffs");
+      void end();
+}; // class LittleFSFS
+
+} // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif // End of conditional preprocessor code
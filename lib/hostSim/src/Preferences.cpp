@@ -0,0 +1,315 @@
+#include <Preferences.h> // Host stand-in for Preferences.
+#include <hostSim.h> // Where the NVS files live.
+#include <stdio.h> // File access.
+
+/**
+ * @brief Open a namespace and load what was stored in it.
+ *
+ * @param name Namespace.
+ * @param readOnly True if nothing will be written.
+ *
+ * @return True.
+ */
+bool Preferences::begin(const char* name, bool readOnly)
+{
+   this->name = name;
+   this->readOnly = readOnly;
+   this->dirty = false;
+   this->values.clear();
+   if(hostSimNvsDir() == NULL)
+   {
+      return true;
+   } // if
+   FILE* file = fopen(this->path().c_str(), "r");
+   if(file == NULL)
+   {
+      return true;
+   } // if
+   char line[512];
+   while(fgets(line, sizeof(line), file) != NULL)
+   {
+      char* equals = strchr(line, '=');
+      if(equals == NULL)
+      {
+         continue;
+      } // if
+      *equals = '\0';
+      std::string raw;
+      for(char* hex = equals + 1; isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1]); hex += 2)
+      {
+         char pair[3] = {hex[0], hex[1], '\0'};
+         raw += (char)strtoul(pair, NULL, 16);
+      } // for
+      this->values[line] = raw;
+   } // while
+   fclose(file);
+   return true;
+} // Preferences::begin()
+
+/**
+ * @brief Close the namespace, writing it out if anything changed.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void Preferences::end()
+{
+   if(this->dirty && hostSimNvsDir() != NULL)
+   {
+      FILE* file = fopen(this->path().c_str(), "w");
+      if(file != NULL)
+      {
+         for(const auto& entry : this->values)
+         {
+            fprintf(file, "%s=", entry.first.c_str());
+            for(unsigned char c : entry.second)
+            {
+               fprintf(file, "%02x", c);
+            } // for
+            fprintf(file, "\n");
+         } // for
+         fclose(file);
+      } // if
+   } // if
+   this->dirty = false;
+   this->name.clear();
+} // Preferences::end()
+
+/**
+ * @brief Remove every key in the namespace.
+ *
+ * @param NA No parameters.
+ *
+ * @return True unless the namespace is read only.
+ */
+bool Preferences::clear()
+{
+   if(this->readOnly)
+   {
+      return false;
+   } // if
+   this->values.clear();
+   this->dirty = true;
+   return true;
+} // Preferences::clear()
+
+/**
+ * @brief Remove one key.
+ *
+ * @param key Key.
+ *
+ * @return True if it existed.
+ */
+bool Preferences::remove(const char* key)
+{
+   if(this->readOnly || this->values.erase(key) == 0)
+   {
+      return false;
+   } // if
+   this->dirty = true;
+   return true;
+} // Preferences::remove()
+
+/**
+ * @brief Whether a key exists.
+ *
+ * @param key Key.
+ *
+ * @return True if it exists.
+ */
+bool Preferences::isKey(const char* key)
+{
+   return this->values.count(key) != 0;
+} // Preferences::isKey()
+
+/**
+ * @brief Store raw bytes.
+ *
+ * @param key Key.
+ * @param value Bytes to store.
+ * @param length Number of bytes.
+ *
+ * @return Bytes stored, 0 if the namespace is read only.
+ */
+size_t Preferences::put(const char* key, const void* value, size_t length)
+{
+   if(this->readOnly || this->name.empty())
+   {
+      return 0;
+   } // if
+   std::string raw((const char*)value, length);
+   auto found = this->values.find(key);
+   if(found == this->values.end() || found->second != raw)
+   {
+      this->values[key] = raw;
+      this->dirty = true;
+   } // if
+   return length;
+} // Preferences::put()
+
+/**
+ * @brief File that holds this namespace.
+ *
+ * @param NA No parameters.
+ *
+ * @return Path.
+ */
+std::string Preferences::path()
+{
+   return std::string(hostSimNvsDir()) + "/" + this->name + ".nvs";
+} // Preferences::path()
+
+/**
+ * @brief Store a string.
+ *
+ * @param key Key.
+ * @param value Text to store.
+ *
+ * @return Bytes stored.
+ */
+size_t Preferences::putString(const char* key, const String& value)
+{
+   return this->put(key, value.c_str(), value.length());
+} // Preferences::putString()
+
+/**
+ * @brief Store a string without making a String of it.
+ *
+ * @param key Key.
+ * @param value Text to store.
+ *
+ * @return Bytes stored.
+ */
+size_t Preferences::putString(const char* key, const char* value)
+{
+   return this->put(key, value, strlen(value));
+} // Preferences::putString()
+
+/**
+ * @brief Read a string.
+ *
+ * @param key Key.
+ * @param defaultValue Returned if the key does not exist.
+ *
+ * @return Stored text.
+ */
+String Preferences::getString(const char* key, const String& defaultValue)
+{
+   auto found = this->values.find(key);
+   return (found == this->values.end()) ? defaultValue : String(found->second.c_str());
+} // Preferences::getString()
+
+/**
+ * @brief Read a string into a buffer, as the device does without a String.
+ *
+ * @param key Key.
+ * @param value Buffer for the text and its terminator.
+ * @param maxLength Bytes in value.
+ *
+ * @return Bytes copied including the terminator, 0 if the key does not
+ * exist or the text does not fit. value is then left alone.
+ */
+size_t Preferences::getString(const char* key, char* value, size_t maxLength)
+{
+   auto found = this->values.find(key);
+   if(found == this->values.end() || found->second.size() + 1 > maxLength)
+   {
+      return 0;
+   } // if
+   memcpy(value, found->second.c_str(), found->second.size() + 1);
+   return found->second.size() + 1;
+} // Preferences::getString()
+
+/**
+ * @brief Store a block of bytes.
+ *
+ * @param key Key.
+ * @param value Bytes to store.
+ * @param length Number of bytes.
+ *
+ * @return Bytes stored.
+ */
+size_t Preferences::putBytes(const char* key, const void* value, size_t length)
+{
+   return this->put(key, value, length);
+} // Preferences::putBytes()
+
+/**
+ * @brief Read a block of bytes.
+ *
+ * @param key Key.
+ * @param buffer Where to put them.
+ * @param maxLength Size of buffer.
+ *
+ * @return Bytes read, 0 if missing or too long.
+ */
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength)
+{
+   auto found = this->values.find(key);
+   if(found == this->values.end() || found->second.size() > maxLength)
+   {
+      return 0;
+   } // if
+   memcpy(buffer, found->second.data(), found->second.size());
+   return found->second.size();
+} // Preferences::getBytes()
+
+/**
+ * @brief Store one byte.
+ *
+ * @param key Key.
+ * @param value Value to store.
+ *
+ * @return Bytes stored.
+ */
+size_t Preferences::putUChar(const char* key, uint8_t value)
+{
+   return this->put(key, &value, sizeof(value));
+} // Preferences::putUChar()
+
+/**
+ * @brief Read one byte.
+ *
+ * @param key Key.
+ * @param defaultValue Returned if the key does not exist.
+ *
+ * @return Stored value.
+ */
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue)
+{
+   uint8_t value = defaultValue;
+   this->getBytes(key, &value, sizeof(value));
+   return value;
+} // Preferences::getUChar()
+
+/**
+ * @brief Store a 32 bit value.
+ *
+ * @param key Key.
+ * @param value Value to store.
+ *
+ * @return Bytes stored.
+ */
+size_t Preferences::putUInt(const char* key, uint32_t value)
+{
+   return this->put(key, &value, sizeof(value));
+} // Preferences::putUInt()
+
+/**
+ * @brief Read a 32 bit value.
+ *
+ * @param key Key.
+ * @param defaultValue Returned if the key does not exist.
+ *
+ * @return Stored value.
+ */
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue)
+{
+   uint32_t value = defaultValue;
+   if(this->getBytes(key, &value, sizeof(value)) != sizeof(value))
+   {
+      return defaultValue;
+   } // if
+   return value;
+} // Preferences::getUInt()
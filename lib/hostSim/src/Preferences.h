@@ -0,0 +1,46 @@
+/******************************************************************************
+ * @file Preferences.h
+ *
+ * @brief Host stand-in for the ESP32 Preferences (NVS) library.
+ *
+ * @details Each namespace is a text file <nvs dir>/<namespace>.nvs with one
+ * key=hex value line per entry, so cached values survive from one simulation
+ * run to the next. Without --nvs nothing is written and every run starts
+ * with empty storage.
+ ******************************************************************************/
+#ifndef _PREFERENCES_H // Start of conditional preprocessor code that only
+                       // allows this library to be included once.
+#define _PREFERENCES_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <map> // Key value store.
+#include <string> // Keys and raw values.
+
+class Preferences
+{
+   public:
+      bool begin(const char* name, bool readOnly = false);
+      void end();
+      bool clear();
+      bool remove(const char* key);
+      bool isKey(const char* key);
+      size_t putString(const char* key, const String& value);
+      size_t putString(const char* key, const char* value);
+      String getString(const char* key, const String& defaultValue = String());
+      size_t getString(const char* key, char* value, size_t maxLength);
+      size_t putBytes(const char* key, const void* value, size_t length);
+      size_t getBytes(const char* key, void* buffer, size_t maxLength);
+      size_t putUChar(const char* key, uint8_t value);
+      uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+      size_t putUInt(const char* key, uint32_t value);
+      uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+   private:
+      size_t put(const char* key, const void* value, size_t length);
+      std::string path(); // File that holds this namespace.
+      std::string name; // Namespace, empty when not started.
+      bool readOnly = true; // Opened with readOnly set.
+      bool dirty = false; // Changed since begin().
+      std::map<std::string, std::string> values; // Raw bytes by key.
+}; // class Preferences
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,62 @@
+#include <Print.h> // Host stand-in for the Arduino Print class.
+#include <stdio.h> // snprintf().
+
+/**
+ * @brief Write a buffer one byte at a time. Derived classes may override
+ * this with something faster.
+ *
+ * @param buffer Bytes to write.
+ * @param size Number of bytes.
+ *
+ * @return Number of bytes written.
+ */
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+   size_t count = 0;
+   while(size-- > 0)
+   {
+      count += this->write(*buffer++);
+   } // while
+   return count;
+} // Print::write()
+
+/**
+ * @brief Print a signed integer in decimal.
+ *
+ * @param value Number to print.
+ *
+ * @return Number of bytes written.
+ */
+size_t Print::printSigned(long long value)
+{
+   char digits[24];
+   return this->write(digits, snprintf(digits, sizeof(digits), "%lld", value));
+} // Print::printSigned()
+
+/**
+ * @brief Print an unsigned integer in decimal.
+ *
+ * @param value Number to print.
+ *
+ * @return Number of bytes written.
+ */
+size_t Print::printUnsigned(unsigned long long value)
+{
+   char digits[24];
+   return this->write(digits, snprintf(digits, sizeof(digits), "%llu", value));
+} // Print::printUnsigned()
+
+/**
+ * @brief Print a floating point number like the Arduino core.
+ *
+ * @param value Number to print.
+ * @param decimals Digits after the decimal point.
+ *
+ * @return Number of bytes written.
+ */
+size_t Print::print(double value, int decimals)
+{
+   char digits[64];
+   int length = snprintf(digits, sizeof(digits), "%.*f", decimals, value);
+   return this->write(digits, (length < (int)sizeof(digits)) ? length : sizeof(digits) - 1);
+} // Print::print()
@@ -0,0 +1,48 @@
+/******************************************************************************
+ * @file Print.h
+ *
+ * @brief Host stand-in for the Arduino Print class.
+ *
+ * @details Derived classes supply write(uint8_t) and optionally a faster
+ * write(const uint8_t*, size_t). Numbers are printed in decimal, floating
+ * point with 2 decimals and println() ends lines with "\r\n", as on the
+ * device. Numbers are formatted on the stack, so printing one never touches
+ * the heap.
+ ******************************************************************************/
+#ifndef _PRINT_H // Start of conditional preprocessor code that only allows
+                 // this library to be included once.
+#define _PRINT_H // Preprocessor variable used by above check.
+
+#include <stdint.h> // Fixed width integer types.
+#include <string.h> // strlen().
+#include <WString.h> // Arduino String.
+
+class Print
+{
+   public:
+      virtual ~Print() {}
+      virtual size_t write(uint8_t c) = 0;
+      virtual size_t write(const uint8_t* buffer, size_t size);
+      size_t write(const char* text) { return (text == NULL) ? 0 : this->write((const uint8_t*)text, strlen(text)); }
+      size_t write(const char* buffer, size_t size) { return this->write((const uint8_t*)buffer, size); }
+      size_t print(const String& text) { return this->write(text.c_str()); }
+      size_t print(const char text[]) { return this->write(text); }
+      size_t print(char c) { return this->write((uint8_t)c); }
+      size_t print(unsigned char value) { return this->printUnsigned(value); }
+      size_t print(int value) { return this->printSigned(value); }
+      size_t print(unsigned int value) { return this->printUnsigned(value); }
+      size_t print(long value) { return this->printSigned(value); }
+      size_t print(unsigned long value) { return this->printUnsigned(value); }
+      size_t print(long long value) { return this->printSigned(value); }
+      size_t print(unsigned long long value) { return this->printUnsigned(value); }
+      size_t print(double value, int decimals = 2);
+      size_t println() { return this->write("\r\n"); }
+      template<typename T>
+      size_t println(const T& value) { size_t count = this->print(value); return count + this->println(); }
+      virtual void flush() {}
+   private:
+      size_t printSigned(long long value);
+      size_t printUnsigned(unsigned long long value);
+}; // class Print
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,485 @@
+#include <PubSubClient.h> // Host stand-in for PubSubClient.
+#include <hostSim.h> // In-process broker.
+
+/**
+ * @brief Construct a new PubSubClient object.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+PubSubClient::PubSubClient()
+{
+   this->buffer.resize(this->bufferSize + 1);
+} // PubSubClient::PubSubClient()
+
+/**
+ * @brief Construct a new PubSubClient object.
+ *
+ * @param client Network client, not used on the host.
+ *
+ * @return NA No return value.
+ */
+PubSubClient::PubSubClient(Client& client) : PubSubClient()
+{
+} // PubSubClient::PubSubClient()
+
+/**
+ * @brief The broker is in-process, the address is ignored.
+ *
+ * @param domain Broker host name.
+ * @param port Broker port.
+ *
+ * @return This client.
+ */
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port)
+{
+   return *this;
+} // PubSubClient::setServer()
+
+/**
+ * @brief Set the incoming message handler.
+ *
+ * @param callback Handler.
+ *
+ * @return This client.
+ */
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+   this->callback = callback;
+   return *this;
+} // PubSubClient::setCallback()
+
+/**
+ * @brief Keep-alive is not simulated, the link state comes from the script.
+ *
+ * @param keepAlive Seconds.
+ *
+ * @return This client.
+ */
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAlive)
+{
+   return *this;
+} // PubSubClient::setKeepAlive()
+
+/**
+ * @brief Nothing blocks on the host.
+ *
+ * @param timeout Seconds.
+ *
+ * @return This client.
+ */
+PubSubClient& PubSubClient::setSocketTimeout(uint16_t timeout)
+{
+   return *this;
+} // PubSubClient::setSocketTimeout()
+
+/**
+ * @brief Resize the packet buffer.
+ *
+ * @param size Bytes.
+ *
+ * @return False if size is 0.
+ */
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+   if(size == 0)
+   {
+      return false;
+   } // if
+   this->bufferSize = size;
+   this->buffer.resize(size + 1);
+   return true;
+} // PubSubClient::setBufferSize()
+
+/**
+ * @brief Size of the packet buffer.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint16_t PubSubClient::getBufferSize()
+{
+   return this->bufferSize;
+} // PubSubClient::getBufferSize()
+
+/**
+ * @brief Connect without credentials or a last will.
+ *
+ * @param id Client ID.
+ *
+ * @return True if connected.
+ */
+boolean PubSubClient::connect(const char* id)
+{
+   return this->connect(id, NULL, NULL, NULL, 0, false, NULL);
+} // PubSubClient::connect()
+
+/**
+ * @brief Connect without a last will.
+ *
+ * @param id Client ID.
+ * @param user Not checked.
+ * @param pass Not checked.
+ *
+ * @return True if connected.
+ */
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass)
+{
+   return this->connect(id, user, pass, NULL, 0, false, NULL);
+} // PubSubClient::connect()
+
+/**
+ * @brief Connect to the in-process broker. Fails if WiFi is not connected
+ * or the script has taken the broker down.
+ *
+ * @param id Client ID.
+ * @param user Not checked.
+ * @param pass Not checked.
+ * @param willTopic Last will topic, NULL for none.
+ * @param willQos Ignored.
+ * @param willRetain Retain flag of the last will.
+ * @param willMessage Last will payload.
+ * @param cleanSession Ignored, subscriptions never survive a reconnect.
+ *
+ * @return True if connected.
+ */
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass, 
+                              const char* willTopic, uint8_t willQos, boolean willRetain, 
+                              const char* willMessage, boolean cleanSession)
+{
+   if(WiFi.status() != WL_CONNECTED || !hostSimBrokerUp())
+   {
+      this->currentState = MQTT_CONNECTION_TIMEOUT;
+      return false;
+   } // if
+   this->willTopic = (willTopic != NULL) ? willTopic : "";
+   this->willMessage = (willMessage != NULL) ? willMessage : "";
+   this->willRetain = willRetain;
+   this->subscriptions.clear();
+   this->currentState = MQTT_CONNECTED;
+   return true;
+} // PubSubClient::connect()
+
+/**
+ * @brief Close the connection. The last will is not published.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void PubSubClient::disconnect()
+{
+   this->currentState = MQTT_DISCONNECTED;
+   this->subscriptions.clear();
+} // PubSubClient::disconnect()
+
+/**
+ * @brief True while connected. Notices a link taken down by the script,
+ * in which case the broker publishes the last will.
+ *
+ * @param NA No parameters.
+ *
+ * @return Connected.
+ */
+boolean PubSubClient::connected()
+{
+   if(this->currentState == MQTT_CONNECTED && (WiFi.status() != WL_CONNECTED || !hostSimBrokerUp()))
+   {
+      this->currentState = MQTT_CONNECTION_LOST;
+      this->subscriptions.clear();
+      if(!this->willTopic.empty())
+      {
+         hostSimPublish(this->willTopic.c_str(), (const uint8_t*)this->willMessage.data(), 
+                        this->willMessage.size(), this->willRetain);
+      } // if
+   } // if
+   return this->currentState == MQTT_CONNECTED;
+} // PubSubClient::connected()
+
+/**
+ * @brief Connection state.
+ *
+ * @param NA No parameters.
+ *
+ * @return One of the MQTT_ state codes.
+ */
+int PubSubClient::state()
+{
+   return this->currentState;
+} // PubSubClient::state()
+
+/**
+ * @brief Publish text.
+ *
+ * @param topic Topic.
+ * @param payload Text.
+ *
+ * @return True if published.
+ */
+boolean PubSubClient::publish(const char* topic, const char* payload)
+{
+   return this->publish(topic, (const uint8_t*)payload, strlen(payload), false);
+} // PubSubClient::publish()
+
+/**
+ * @brief Publish text.
+ *
+ * @param topic Topic.
+ * @param payload Text.
+ * @param retained Retain flag.
+ *
+ * @return True if published.
+ */
+boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained)
+{
+   return this->publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+} // PubSubClient::publish()
+
+/**
+ * @brief Publish bytes.
+ *
+ * @param topic Topic.
+ * @param payload Bytes.
+ * @param length Number of bytes.
+ *
+ * @return True if published.
+ */
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length)
+{
+   return this->publish(topic, payload, length, false);
+} // PubSubClient::publish()
+
+/**
+ * @brief Publish bytes. Fails, like the real client, if the packet does not
+ * fit the buffer.
+ *
+ * @param topic Topic.
+ * @param payload Bytes.
+ * @param length Number of bytes.
+ * @param retained Retain flag.
+ *
+ * @return True if published.
+ */
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, boolean retained)
+{
+   if(!this->connected() || MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length > this->bufferSize)
+   {
+      return false;
+   } // if
+   hostSimBrokerWrite(MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length);
+   hostSimPublish(topic, payload, length, retained);
+   return true;
+} // PubSubClient::publish()
+
+/**
+ * @brief Start a publish of any length, the payload follows with write().
+ *
+ * @param topic Topic.
+ * @param length Number of bytes that will be written.
+ * @param retained Retain flag.
+ *
+ * @return True if started.
+ */
+boolean PubSubClient::beginPublish(const char* topic, unsigned int length, boolean retained)
+{
+   if(!this->connected())
+   {
+      return false;
+   } // if
+   this->streaming = true;
+   this->streamTopic = topic;
+   this->streamPayload.clear();
+   this->streamPayload.reserve(length);
+   this->streamRetained = retained;
+   return true;
+} // PubSubClient::beginPublish()
+
+/**
+ * @brief Finish a streamed publish.
+ *
+ * @param NA No parameters.
+ *
+ * @return 1 if published.
+ */
+int PubSubClient::endPublish()
+{
+   if(!this->streaming)
+   {
+      return 0;
+   } // if
+   this->streaming = false;
+   hostSimBrokerWrite(MQTT_MAX_HEADER_SIZE + 2 + this->streamTopic.size() + this->streamPayload.size());
+   hostSimPublish(this->streamTopic.c_str(), (const uint8_t*)this->streamPayload.data(), 
+                  this->streamPayload.size(), this->streamRetained);
+   return 1;
+} // PubSubClient::endPublish()
+
+/**
+ * @brief Add one byte to a streamed publish.
+ *
+ * @param c Byte.
+ *
+ * @return 1, or 0 outside beginPublish() and endPublish().
+ */
+size_t PubSubClient::write(uint8_t c)
+{
+   if(!this->streaming)
+   {
+      return 0;
+   } // if
+   this->streamPayload += (char)c;
+   return 1;
+} // PubSubClient::write()
+
+/**
+ * @brief Add bytes to a streamed publish.
+ *
+ * @param buffer Bytes.
+ * @param size Number of bytes.
+ *
+ * @return size, or 0 outside beginPublish() and endPublish().
+ */
+size_t PubSubClient::write(const uint8_t* buffer, size_t size)
+{
+   if(!this->streaming)
+   {
+      return 0;
+   } // if
+   this->streamPayload.append((const char*)buffer, size);
+   return size;
+} // PubSubClient::write()
+
+/**
+ * @brief Subscribe to a topic filter. + and # wildcards are supported.
+ *
+ * @param topic Topic filter.
+ *
+ * @return True if subscribed.
+ */
+boolean PubSubClient::subscribe(const char* topic)
+{
+   return this->subscribe(topic, 0);
+} // PubSubClient::subscribe()
+
+/**
+ * @brief Subscribe to a topic filter. + and # wildcards are supported.
+ *
+ * @param topic Topic filter.
+ * @param qos Ignored.
+ *
+ * @return True if subscribed.
+ */
+boolean PubSubClient::subscribe(const char* topic, uint8_t qos)
+{
+   if(!this->connected())
+   {
+      return false;
+   } // if
+   this->subscriptions.push_back(topic);
+   hostSimOnline(topic);
+   return true;
+} // PubSubClient::subscribe()
+
+/**
+ * @brief Remove a topic filter.
+ *
+ * @param topic Topic filter.
+ *
+ * @return True if it was subscribed.
+ */
+boolean PubSubClient::unsubscribe(const char* topic)
+{
+   for(size_t i = 0; i < this->subscriptions.size(); i++)
+   {
+      if(this->subscriptions[i] == topic)
+      {
+         this->subscriptions.erase(this->subscriptions.begin() + i);
+         return true;
+      } // if
+   } // for
+   return false;
+} // PubSubClient::unsubscribe()
+
+/**
+ * @brief Check a topic against the subscriptions.
+ *
+ * @param topic Topic of an incoming message.
+ *
+ * @return True if any filter matches.
+ */
+bool PubSubClient::matches(const std::string& topic)
+{
+   for(const std::string& filter : this->subscriptions)
+   {
+      size_t f = 0, t = 0;
+      while(f < filter.size() && t <= topic.size())
+      {
+         if(filter[f] == '#')
+         {
+            return true;
+         } // if
+         if(filter[f] == '+')
+         {
+            while(t < topic.size() && topic[t] != '/')
+            {
+               t++;
+            } // while
+            f++;
+            continue;
+         } // if
+         if(t == topic.size() || filter[f] != topic[t])
+         {
+            break;
+         } // if
+         f++;
+         t++;
+      } // while
+      if(f == filter.size() && t == topic.size())
+      {
+         return true;
+      } // if
+   } // for
+   return false;
+} // PubSubClient::matches()
+
+/**
+ * @brief Deliver at most one due message from the broker to the callback,
+ * in the receive buffer as the real client does.
+ *
+ * @param NA No parameters.
+ *
+ * @return True while connected.
+ */
+boolean PubSubClient::loop()
+{
+   if(!this->connected())
+   {
+      return false;
+   } // if
+   hostSimSocketStall();
+   std::string topic, payload;
+   uint64_t due;
+   while(hostSimNextMessage(topic, payload, due))
+   {
+      if(!this->matches(topic))
+      {
+         continue; // The broker would not send it here.
+      } // if
+      size_t needed = MQTT_MAX_HEADER_SIZE + 2 + topic.size() + 1 + payload.size();
+      if(needed > this->bufferSize || !this->callback)
+      {
+         continue; // Too big for the buffer, dropped like the real client.
+      } // if
+      // Topic then payload in the buffer, each followed by room for a '\0'.
+      char* topicCopy = (char*)this->buffer.data() + MQTT_MAX_HEADER_SIZE;
+      memcpy(topicCopy, topic.c_str(), topic.size() + 1);
+      uint8_t* payloadCopy = (uint8_t*)topicCopy + topic.size() + 1;
+      memcpy(payloadCopy, payload.data(), payload.size());
+      hostSimDelivered(topic, due);
+      this->callback(topicCopy, payloadCopy, payload.size());
+      break; // One message per call.
+   } // while
+   return this->connected();
+} // PubSubClient::loop()
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * @file PubSubClient.h
+ *
+ * @brief Host stand-in for PubSubClient talking to the in-process broker.
+ *
+ * @details Keeps the limits of the real client that the firmware depends
+ * on: one incoming message per loop(), messages that do not fit the buffer
+ * are dropped, publish() fails if the packet does not fit the buffer while
+ * beginPublish() streams any length, and the last will is published when
+ * the connection is lost rather than closed.
+ ******************************************************************************/
+#ifndef _PUBSUBCLIENT_H // Start of conditional preprocessor code that only
+                        // allows this library to be included once.
+#define _PUBSUBCLIENT_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <WiFi.h> // Client.
+#include <functional> // Callback type.
+#include <string> // Subscriptions and streamed publishes.
+#include <vector> // Subscriptions and the receive buffer.
+
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_MAX_HEADER_SIZE 5
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient : public Print
+{
+   public:
+      PubSubClient();
+      PubSubClient(Client& client);
+      PubSubClient& setServer(const char* domain, uint16_t port);
+      PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+      PubSubClient& setClient(Client& client) { return *this; }
+      PubSubClient& setKeepAlive(uint16_t keepAlive);
+      PubSubClient& setSocketTimeout(uint16_t timeout);
+      bool setBufferSize(uint16_t size);
+      uint16_t getBufferSize();
+      boolean connect(const char* id);
+      boolean connect(const char* id, const char* user, const char* pass);
+      boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, 
+                      uint8_t willQos, boolean willRetain, const char* willMessage, 
+                      boolean cleanSession = true);
+      void disconnect();
+      boolean publish(const char* topic, const char* payload);
+      boolean publish(const char* topic, const char* payload, boolean retained);
+      boolean publish(const char* topic, const uint8_t* payload, unsigned int length);
+      boolean publish(const char* topic, const uint8_t* payload, unsigned int length, boolean retained);
+      boolean beginPublish(const char* topic, unsigned int length, boolean retained);
+      int endPublish();
+      size_t write(uint8_t c) override;
+      size_t write(const uint8_t* buffer, size_t size) override;
+      using Print::write;
+      boolean subscribe(const char* topic);
+      boolean subscribe(const char* topic, uint8_t qos);
+      boolean unsubscribe(const char* topic);
+      boolean loop();
+      boolean connected();
+      int state();
+   private:
+      bool matches(const std::string& topic);
+      std::function<void(char*, uint8_t*, unsigned int)> callback; // Incoming message handler.
+      std::vector<uint8_t> buffer; // Receive buffer, one byte longer for the terminator.
+      uint16_t bufferSize = MQTT_MAX_PACKET_SIZE; // Largest packet in or out.
+      int currentState = MQTT_DISCONNECTED; // As reported by state().
+      std::vector<std::string> subscriptions; // Topic filters.
+      std::string willTopic, willMessage; // Last will, empty topic for none.
+      bool willRetain = false; // Retain flag of the last will.
+      bool streaming = false; // Between beginPublish() and endPublish().
+      std::string streamTopic, streamPayload; // Publish being streamed.
+      bool streamRetained = false; // Retain flag of the streamed publish.
+}; // class PubSubClient
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,273 @@
+#include <TaskScheduler.h> // Host stand-in for TaskScheduler.
+
+/**
+ * @brief Construct a new Task object.
+ *
+ * @param interval Milli-seconds between runs, TASK_IMMEDIATE for every pass.
+ * @param iterations Number of runs, TASK_FOREVER for no limit.
+ * @param callback Work to do.
+ * @param scheduler Scheduler to add the task to, NULL to add it later.
+ * @param enable True to enable at once.
+ *
+ * @return NA No return value.
+ */
+Task::Task(unsigned long interval, long iterations, TaskCallback callback, 
+           Scheduler* scheduler, bool enable)
+{
+   this->interval = interval;
+   this->iterations = iterations;
+   this->setIterationsTo = iterations;
+   this->callback = callback;
+   if(scheduler != NULL)
+   {
+      scheduler->addTask(*this);
+   } // if
+   if(enable)
+   {
+      this->enable();
+   } // if
+} // Task::Task()
+
+/**
+ * @brief Schedule the task to run on the next pass.
+ *
+ * @param NA No parameters.
+ *
+ * @return True.
+ */
+bool Task::enable()
+{
+   this->enabled = true;
+   this->runCounter = 0;
+   this->iterations = this->setIterationsTo;
+   this->previousMillis = millis() - this->interval;
+   this->delayMillis = this->interval;
+   return true;
+} // Task::enable()
+
+/**
+ * @brief Stop running the task.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if it was enabled.
+ */
+bool Task::disable()
+{
+   bool was = this->enabled;
+   this->enabled = false;
+   return was;
+} // Task::disable()
+
+/**
+ * @brief Whether the task is scheduled.
+ *
+ * @param NA No parameters.
+ *
+ * @return Enabled.
+ */
+bool Task::isEnabled()
+{
+   return this->enabled;
+} // Task::isEnabled()
+
+/**
+ * @brief Change the interval. The next run is one new interval from now.
+ *
+ * @param interval Milli-seconds between runs.
+ *
+ * @return NA No return value.
+ */
+void Task::setInterval(unsigned long interval)
+{
+   this->interval = interval;
+   this->delay();
+} // Task::setInterval()
+
+/**
+ * @brief Current interval.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds between runs.
+ */
+unsigned long Task::getInterval()
+{
+   return this->interval;
+} // Task::getInterval()
+
+/**
+ * @brief Change the number of runs.
+ *
+ * @param iterations Number of runs, TASK_FOREVER for no limit.
+ *
+ * @return NA No return value.
+ */
+void Task::setIterations(long iterations)
+{
+   this->iterations = iterations;
+   this->setIterationsTo = iterations;
+} // Task::setIterations()
+
+/**
+ * @brief Runs since the task was enabled.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+unsigned long Task::getRunCounter()
+{
+   return this->runCounter;
+} // Task::getRunCounter()
+
+/**
+ * @brief Put off the next run.
+ *
+ * @param delay Milli-seconds from now, 0 for one interval.
+ *
+ * @return NA No return value.
+ */
+void Task::delay(unsigned long delay)
+{
+   this->delayMillis = (delay == 0) ? this->interval : delay;
+   this->previousMillis = millis();
+} // Task::delay()
+
+/**
+ * @brief Run on the next pass, then carry on at the usual interval.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void Task::forceNextIteration()
+{
+   this->previousMillis = millis() - this->interval;
+   this->delayMillis = this->interval;
+} // Task::forceNextIteration()
+
+/**
+ * @brief Enable again from the start.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void Task::restart()
+{
+   this->enable();
+} // Task::restart()
+
+/**
+ * @brief Start with no tasks.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void Scheduler::init()
+{
+   this->first = NULL;
+   this->last = NULL;
+} // Scheduler::init()
+
+/**
+ * @brief Add a task to the end of the chain.
+ *
+ * @param task Task to add.
+ *
+ * @return NA No return value.
+ */
+void Scheduler::addTask(Task& task)
+{
+   task.next = NULL;
+   if(this->first == NULL)
+   {
+      this->first = &task;
+   } // if
+   else
+   {
+      this->last->next = &task;
+   } // else
+   this->last = &task;
+} // Scheduler::addTask()
+
+/**
+ * @brief Remove a task from the chain.
+ *
+ * @param task Task to remove.
+ *
+ * @return NA No return value.
+ */
+void Scheduler::deleteTask(Task& task)
+{
+   Task* previous = NULL;
+   for(Task* current = this->first; current != NULL; current = current->next)
+   {
+      if(current == &task)
+      {
+         if(previous == NULL)
+         {
+            this->first = current->next;
+         } // if
+         else
+         {
+            previous->next = current->next;
+         } // else
+         if(this->last == current)
+         {
+            this->last = previous;
+         } // if
+         return;
+      } // if
+      previous = current;
+   } // for
+} // Scheduler::deleteTask()
+
+/**
+ * @brief One pass through the chain, running every task that is due.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if nothing ran.
+ */
+bool Scheduler::execute()
+{
+   bool idle = true;
+   for(Task* task = this->first; task != NULL; task = task->next)
+   {
+      if(!task->enabled)
+      {
+         continue;
+      } // if
+      if(task->iterations == 0)
+      {
+         task->disable();
+         continue;
+      } // if
+      unsigned long now = millis();
+      if(task->interval != TASK_IMMEDIATE && now - task->previousMillis < task->delayMillis)
+      {
+         continue;
+      } // if
+      if(task->iterations > 0)
+      {
+         task->iterations--;
+      } // if
+      task->runCounter++;
+      // Keep the cadence: the next run is due one interval after this one was.
+      task->previousMillis += task->delayMillis;
+      task->delayMillis = task->interval;
+      if(task->interval == TASK_IMMEDIATE)
+      {
+         task->previousMillis = now;
+      } // if
+      if(task->callback != NULL)
+      {
+         task->callback();
+      } // if
+      idle = false;
+   } // for
+   return idle;
+} // Scheduler::execute()
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * @file TaskScheduler.h
+ *
+ * @brief Host stand-in for the TaskScheduler library.
+ *
+ * @details Cooperative scheduling on the virtual clock with the timing rules
+ * of the real library: enable() runs a task on the next pass, a periodic task
+ * keeps its cadence by scheduling each run one interval after the previous
+ * scheduled run (so a late task catches up), setInterval() restarts the
+ * interval from now and TASK_IMMEDIATE runs on every pass.
+ ******************************************************************************/
+#ifndef _TASKSCHEDULER_H // Start of conditional preprocessor code that only
+                         // allows this library to be included once.
+#define _TASKSCHEDULER_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+
+#define TASK_FOREVER (-1)
+#define TASK_ONCE 1
+#define TASK_IMMEDIATE 0
+#define TASK_MILLISECOND 1UL
+#define TASK_SECOND 1000UL
+
+typedef void (*TaskCallback)();
+
+class Scheduler;
+
+class Task
+{
+   friend class Scheduler;
+   public:
+      Task(unsigned long interval = 0, long iterations = 0, TaskCallback callback = NULL, 
+           Scheduler* scheduler = NULL, bool enable = false);
+      bool enable();
+      bool disable();
+      bool isEnabled();
+      void setInterval(unsigned long interval);
+      unsigned long getInterval();
+      void setIterations(long iterations);
+      unsigned long getRunCounter();
+      void delay(unsigned long delay = 0);
+      void forceNextIteration();
+      void restart();
+   private:
+      unsigned long interval; // Milli-seconds between runs, TASK_IMMEDIATE for every pass.
+      long iterations; // Runs left, TASK_FOREVER for no limit.
+      long setIterationsTo; // Iterations to restore on enable().
+      TaskCallback callback; // Work to do.
+      bool enabled = false; // Scheduled to run.
+      unsigned long previousMillis = 0; // When the last run was due.
+      unsigned long delayMillis = 0; // Milli-seconds from previousMillis to the next run.
+      unsigned long runCounter = 0; // Runs since enable().
+      Task* next = NULL; // Next task in the scheduler's chain.
+}; // class Task
+
+class Scheduler
+{
+   public:
+      void init();
+      void addTask(Task& task);
+      void deleteTask(Task& task);
+      bool execute();
+   private:
+      Task* first = NULL; // Head of the chain.
+      Task* last = NULL; // Tail of the chain.
+}; // class Scheduler
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,106 @@
+#include <WString.h> // Host stand-in for the Arduino String class.
+#include <stdio.h> // snprintf().
+#include <stdlib.h> // atol() and atof().
+
+/**
+ * @brief Format a floating point number like the Arduino core.
+ *
+ * @param value Number to format.
+ * @param decimals Digits after the decimal point.
+ *
+ * @return NA No return value.
+ */
+String::String(double value, unsigned int decimals)
+{
+   char digits[64];
+   snprintf(digits, sizeof(digits), "%.*f", (int)decimals, value);
+   this->text = digits;
+} // String::String()
+
+/**
+ * @brief Position of a character.
+ *
+ * @param c Character to find.
+ * @param from Where to start looking.
+ *
+ * @return Index, or -1 if not found.
+ */
+int String::indexOf(char c, unsigned int from) const
+{
+   size_t position = this->text.find(c, from);
+   return (position == hostSimText::npos) ? -1 : (int)position;
+} // String::indexOf()
+
+/**
+ * @brief Position of a substring.
+ *
+ * @param text Text to find.
+ * @param from Where to start looking.
+ *
+ * @return Index, or -1 if not found.
+ */
+int String::indexOf(const char* text, unsigned int from) const
+{
+   size_t position = this->text.find(text, from);
+   return (position == hostSimText::npos) ? -1 : (int)position;
+} // String::indexOf()
+
+/**
+ * @brief Everything from an index to the end.
+ *
+ * @param from First character.
+ *
+ * @return The substring, empty if from is past the end.
+ */
+String String::substring(unsigned int from) const
+{
+   return (from >= this->text.size()) ? String() : String(this->text.substr(from));
+} // String::substring()
+
+/**
+ * @brief Characters from one index up to, not including, another. The
+ * indices are swapped if given the wrong way round, as on the device.
+ *
+ * @param from First character.
+ * @param to One past the last character.
+ *
+ * @return The substring.
+ */
+String String::substring(unsigned int from, unsigned int to) const
+{
+   if(from > to)
+   {
+      unsigned int swap = from;
+      from = to;
+      to = swap;
+   } // if
+   if(from >= this->text.size())
+   {
+      return String();
+   } // if
+   return String(this->text.substr(from, to - from));
+} // String::substring()
+
+/**
+ * @brief Leading integer, 0 if there is none.
+ *
+ * @param NA No parameters.
+ *
+ * @return Value.
+ */
+long String::toInt() const
+{
+   return atol(this->text.c_str());
+} // String::toInt()
+
+/**
+ * @brief Leading number, 0 if there is none.
+ *
+ * @param NA No parameters.
+ *
+ * @return Value.
+ */
+float String::toFloat() const
+{
+   return atof(this->text.c_str());
+} // String::toFloat()
@@ -0,0 +1,85 @@
+/******************************************************************************
+ * @file WString.h
+ *
+ * @brief Host stand-in for the Arduino String class.
+ *
+ * @details Only what the firmware uses, with the same formatting rules as
+ * the ESP32 core: integers in decimal and floating point with 2 decimals.
+ * The characters live in the simulated device heap, see hostSim.h. Short
+ * text fits in the object without allocating, up to 14 characters on the
+ * ESP32 and 15 here.
+ ******************************************************************************/
+#ifndef _WSTRING_H // Start of conditional preprocessor code that only allows
+                   // this library to be included once.
+#define _WSTRING_H // Preprocessor variable used by above check.
+
+#include <stddef.h> // size_t.
+#include <string> // Storage.
+#include <type_traits> // For the number overloads.
+#include <hostSim.h> // Simulated device heap.
+
+// Gets String storage from the simulated device heap.
+template<typename T>
+struct HostSimHeapAllocator
+{
+   typedef T value_type;
+   HostSimHeapAllocator() {}
+   template<typename U> HostSimHeapAllocator(const HostSimHeapAllocator<U>&) {}
+   T* allocate(size_t count) { return (T*)hostSimHeapAllocate(count * sizeof(T)); }
+   void deallocate(T* memory, size_t count) { hostSimHeapRelease(memory); }
+}; // HostSimHeapAllocator
+
+template<typename T, typename U>
+bool operator==(const HostSimHeapAllocator<T>&, const HostSimHeapAllocator<U>&) { return true; }
+template<typename T, typename U>
+bool operator!=(const HostSimHeapAllocator<T>&, const HostSimHeapAllocator<U>&) { return false; }
+
+typedef std::basic_string<char, std::char_traits<char>, HostSimHeapAllocator<char>> hostSimText;
+
+class String
+{
+   public:
+      String(const char* text = "") : text(text ? text : "") {}
+      String(const std::string& text) : text(text.data(), text.size()) {}
+      String(const hostSimText& text) : text(text) {}
+      explicit String(char c) : text(1, c) {}
+      explicit String(int value) : text(std::to_string(value).c_str()) {}
+      explicit String(unsigned int value) : text(std::to_string(value).c_str()) {}
+      explicit String(long value) : text(std::to_string(value).c_str()) {}
+      explicit String(unsigned long value) : text(std::to_string(value).c_str()) {}
+      explicit String(long long value) : text(std::to_string(value).c_str()) {}
+      explicit String(unsigned long long value) : text(std::to_string(value).c_str()) {}
+      explicit String(double value, unsigned int decimals = 2);
+      const char* c_str() const { return this->text.c_str(); }
+      unsigned int length() const { return this->text.size(); }
+      bool reserve(unsigned int size) { this->text.reserve(size); return true; }
+      String& operator+=(const String& other) { this->text += other.text; return *this; }
+      String& operator+=(const char* other) { this->text += other ? other : ""; return *this; }
+      String& operator+=(char c) { this->text += c; return *this; }
+      template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+      String& operator+=(T value) { return *this += String(value); }
+      bool operator==(const String& other) const { return this->text == other.text; }
+      bool operator==(const char* other) const { return this->text == (other ? other : ""); }
+      bool operator!=(const String& other) const { return !(*this == other); }
+      bool operator!=(const char* other) const { return !(*this == other); }
+      char operator[](unsigned int index) const { return index < this->text.size() ? this->text[index] : 0; }
+      int indexOf(char c, unsigned int from = 0) const;
+      int indexOf(const char* text, unsigned int from = 0) const;
+      bool startsWith(const char* prefix) const { return this->text.compare(0, strlen(prefix), prefix) == 0; }
+      String substring(unsigned int from) const;
+      String substring(unsigned int from, unsigned int to) const;
+      long toInt() const;
+      float toFloat() const;
+   private:
+      static size_t strlen(const char* text) { return std::char_traits<char>::length(text); }
+      hostSimText text; // The characters.
+}; // class String
+
+inline String operator+(const String& left, const String& right) { String sum(left); sum += right; return sum; }
+inline String operator+(const String& left, const char* right) { String sum(left); sum += right; return sum; }
+inline String operator+(const char* left, const String& right) { String sum(left); sum += right; return sum; }
+inline String operator+(const String& left, char right) { String sum(left); sum += right; return sum; }
+template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+inline String operator+(const String& left, T right) { String sum(left); sum += String(right); return sum; }
+
+#endif // End of conditional preprocessor code
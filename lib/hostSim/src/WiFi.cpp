@@ -0,0 +1,285 @@
+#include <WiFi.h> // Host stand-in for the ESP32 WiFi station API.
+#include <hostSim.h> // Virtual clock and access point.
+#include <stdio.h> // snprintf().
+
+WiFiClass WiFi;
+
+const uint8_t simChannel = 6; // Channel of the simulated access point.
+const uint8_t simBssid[6] = {0x02, 0x00, 0x5E, 0x10, 0x00, 0x01}; // Its BSSID.
+const uint32_t simAssociateUs = 800000; // Association plus DHCP.
+const uint32_t simScanChannelUs = 120000; // Scan of one channel.
+const uint32_t simScanAllUs = 1600000; // Scan of every channel.
+
+/**
+ * @brief Dotted decimal form of the address.
+ *
+ * @param NA No parameters.
+ *
+ * @return Text such as 192.168.2.50.
+ */
+String IPAddress::toString() const
+{
+   char text[16];
+   snprintf(text, sizeof(text), "%u.%u.%u.%u", (unsigned)(this->address & 0xFF), 
+            (unsigned)((this->address >> 8) & 0xFF), (unsigned)((this->address >> 16) & 0xFF),
+            (unsigned)(this->address >> 24));
+   return String(text);
+} // IPAddress::toString()
+
+/**
+ * @brief Start joining the simulated access point. Only its SSID is
+ * accepted and, if given, its channel and BSSID.
+ *
+ * @param ssid Network name.
+ * @param password Not checked.
+ * @param channel Channel to use, 0 for any.
+ * @param bssid Access point to use, NULL for any.
+ * @param connect Ignored.
+ *
+ * @return WL_DISCONNECTED until association completes.
+ */
+wl_status_t WiFiClass::begin(const char* ssid, const char* password, int32_t channel, 
+                             const uint8_t* bssid, bool connect)
+{
+   this->joining = strcmp(ssid, hostSimApSsid()) == 0
+                   && (channel == 0 || channel == simChannel)
+                   && (bssid == NULL || memcmp(bssid, simBssid, sizeof(simBssid)) == 0);
+   this->joinedAt = hostSimMicros() + simAssociateUs;
+   this->linkLost = false;
+   return WL_DISCONNECTED;
+} // WiFiClass::begin()
+
+/**
+ * @brief Leave the access point.
+ *
+ * @param wifiOff Ignored.
+ * @param eraseAp Ignored.
+ *
+ * @return True.
+ */
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp)
+{
+   this->joining = false;
+   this->linkLost = false;
+   return true;
+} // WiFiClass::disconnect()
+
+/**
+ * @brief True once association has completed and the link is up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Associated.
+ */
+bool WiFiClass::associated()
+{
+   if(this->joining && !hostSimWifiUp())
+   {
+      this->linkLost = true;
+   } // if
+   return this->joining && !this->linkLost && hostSimMicros() >= this->joinedAt;
+} // WiFiClass::associated()
+
+/**
+ * @brief Connection status.
+ *
+ * @param NA No parameters.
+ *
+ * @return WL_CONNECTED, WL_CONNECTION_LOST or WL_DISCONNECTED.
+ */
+wl_status_t WiFiClass::status()
+{
+   if(this->associated())
+   {
+      return WL_CONNECTED;
+   } // if
+   return this->linkLost ? WL_CONNECTION_LOST : WL_DISCONNECTED;
+} // WiFiClass::status()
+
+/**
+ * @brief Address given by the simulated DHCP server.
+ *
+ * @param NA No parameters.
+ *
+ * @return 192.168.2.50 while connected, otherwise 0.0.0.0.
+ */
+IPAddress WiFiClass::localIP()
+{
+   return this->associated() ? IPAddress(192, 168, 2, 50) : IPAddress();
+} // WiFiClass::localIP()
+
+/**
+ * @brief Station MAC address, see --mac.
+ *
+ * @param NA No parameters.
+ *
+ * @return Text such as AA:BB:CC:DD:EE:FF.
+ */
+String WiFiClass::macAddress()
+{
+   return String(hostSimMac());
+} // WiFiClass::macAddress()
+
+/**
+ * @brief Station MAC address as bytes, see --mac.
+ *
+ * @param mac Buffer for the 6 bytes.
+ *
+ * @return mac.
+ */
+uint8_t* WiFiClass::macAddress(uint8_t* mac)
+{
+   unsigned int bytes[6] = {0};
+   sscanf(hostSimMac(), "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]);
+   for(uint8_t i = 0; i < 6; i++)
+   {
+      mac[i] = bytes[i];
+   } // for
+   return mac;
+} // WiFiClass::macAddress()
+
+/**
+ * @brief Signal strength of the joined access point.
+ *
+ * @param NA No parameters.
+ *
+ * @return dBm, 0 when not connected.
+ */
+int8_t WiFiClass::RSSI()
+{
+   return this->associated() ? hostSimApRssi() : 0;
+} // WiFiClass::RSSI()
+
+/**
+ * @brief Start a scan. Only asynchronous scans are simulated.
+ *
+ * @param async Ignored, the scan is always asynchronous.
+ * @param showHidden Ignored.
+ * @param passive Ignored.
+ * @param maxMsPerChannel Ignored.
+ * @param channel Channel to scan, 0 for all.
+ *
+ * @return WIFI_SCAN_RUNNING.
+ */
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden, bool passive, 
+                                uint32_t maxMsPerChannel, uint8_t channel)
+{
+   this->scanDoneAt = hostSimMicros() + ((channel == 0) ? simScanAllUs : simScanChannelUs);
+   this->scanFoundAp = hostSimWifiUp() && (channel == 0 || channel == simChannel);
+   this->scanResult = (this->scanFoundAp ? 1 : 0) + ((channel == 0) ? hostSimNeighbours() : 0);
+   return WIFI_SCAN_RUNNING;
+} // WiFiClass::scanNetworks()
+
+/**
+ * @brief Result of the last scan.
+ *
+ * @param NA No parameters.
+ *
+ * @return Networks found, WIFI_SCAN_RUNNING or WIFI_SCAN_FAILED.
+ */
+int16_t WiFiClass::scanComplete()
+{
+   if(this->scanResult >= 0 && hostSimMicros() < this->scanDoneAt)
+   {
+      return WIFI_SCAN_RUNNING;
+   } // if
+   return this->scanResult;
+} // WiFiClass::scanComplete()
+
+/**
+ * @brief Forget the last scan.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void WiFiClass::scanDelete()
+{
+   this->scanResult = WIFI_SCAN_FAILED;
+} // WiFiClass::scanDelete()
+
+/**
+ * @brief Whether a scan result is an unknown network rather than the
+ * simulated access point.
+ *
+ * @param index Scan result index.
+ *
+ * @return True for one of the --neighbours.
+ */
+bool WiFiClass::neighbour(uint8_t index)
+{
+   return !this->scanFoundAp || index > 0;
+} // WiFiClass::neighbour()
+
+/**
+ * @brief Name of a scanned network.
+ *
+ * @param index Scan result index.
+ *
+ * @return The simulated access point's SSID, or neighbour<n>.
+ */
+String WiFiClass::SSID(uint8_t index)
+{
+   if(this->neighbour(index))
+   {
+      snprintf(this->neighbourSsid, sizeof(this->neighbourSsid), "neighbour%u", (unsigned)index);
+      return String(this->neighbourSsid);
+   } // if
+   return String(hostSimApSsid());
+} // WiFiClass::SSID()
+
+/**
+ * @brief Signal strength of a scanned network.
+ *
+ * @param index Scan result index.
+ *
+ * @return dBm, see --rssi. Neighbours are weaker.
+ */
+int32_t WiFiClass::RSSI(uint8_t index)
+{
+   if(this->neighbour(index))
+   {
+      return -70 - (index % 20);
+   } // if
+   return hostSimApRssi();
+} // WiFiClass::RSSI()
+
+/**
+ * @brief Channel of a scanned network.
+ *
+ * @param index Scan result index.
+ *
+ * @return Channel.
+ */
+int32_t WiFiClass::channel(uint8_t index)
+{
+   if(this->neighbour(index))
+   {
+      return 1 + (index % 11);
+   } // if
+   return simChannel;
+} // WiFiClass::channel()
+
+/**
+ * @brief Security of a scanned network.
+ *
+ * @param index Scan result index.
+ *
+ * @return WIFI_AUTH_WPA2_PSK.
+ */
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t index)
+{
+   return WIFI_AUTH_WPA2_PSK;
+} // WiFiClass::encryptionType()
+
+/**
+ * @brief BSSID of a scanned network.
+ *
+ * @param index Scan result index.
+ *
+ * @return Six bytes.
+ */
+uint8_t* WiFiClass::BSSID(uint8_t index)
+{
+   return (uint8_t*)simBssid;
+} // WiFiClass::BSSID()
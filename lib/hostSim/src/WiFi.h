@@ -0,0 +1,112 @@
+/******************************************************************************
+ * @file WiFi.h
+ *
+ * @brief Host stand-in for the ESP32 WiFi station API.
+ *
+ * @details There is one simulated access point, named by --ap. Scans and
+ * association take a realistic amount of virtual time so the connection
+ * manager's waits and time-outs are exercised. The link can be dropped and
+ * restored from the simulation script.
+ ******************************************************************************/
+#ifndef _WIFI_H // Start of conditional preprocessor code that only allows
+                // this library to be included once.
+#define _WIFI_H // Preprocessor variable used by above check.
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <hostSim.h> // Broker send window.
+
+typedef enum 
+{
+   WIFI_AUTH_OPEN = 0,
+   WIFI_AUTH_WEP,
+   WIFI_AUTH_WPA_PSK,
+   WIFI_AUTH_WPA2_PSK,
+   WIFI_AUTH_WPA_WPA2_PSK,
+   WIFI_AUTH_WPA2_ENTERPRISE,
+   WIFI_AUTH_WPA3_PSK,
+   WIFI_AUTH_WPA2_WPA3_PSK,
+   WIFI_AUTH_WAPI_PSK,
+   WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef enum 
+{
+   WL_IDLE_STATUS = 0,
+   WL_NO_SSID_AVAIL = 1,
+   WL_SCAN_COMPLETED = 2,
+   WL_CONNECTED = 3,
+   WL_CONNECT_FAILED = 4,
+   WL_CONNECTION_LOST = 5,
+   WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+   WIFI_OFF = 0,
+   WIFI_STA = 1
+} wifi_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+class IPAddress
+{
+   public:
+      IPAddress() {}
+      IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+      IPAddress(uint32_t address) : address(address) {}
+      operator uint32_t() const { return this->address; }
+      String toString() const;
+   private:
+      uint32_t address = 0; // First octet in the low byte, as on the device.
+}; // class IPAddress
+
+class Client
+{
+   public:
+      virtual ~Client() {}
+}; // class Client
+
+class WiFiClient : public Client
+{
+   public:
+      int availableForWrite() { return hostSimBrokerRoom(); } // Free send window.
+}; // class WiFiClient
+
+class WiFiClass
+{
+   public:
+      bool mode(wifi_mode_t mode) { return true; }
+      bool setAutoReconnect(bool autoReconnect) { return true; }
+      wl_status_t begin(const char* ssid, const char* password = NULL, int32_t channel = 0, 
+                        const uint8_t* bssid = NULL, bool connect = true);
+      bool disconnect(bool wifiOff = false, bool eraseAp = false);
+      wl_status_t status();
+      IPAddress localIP();
+      String macAddress();
+      uint8_t* macAddress(uint8_t* mac);
+      int8_t RSSI();
+      int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false, 
+                           uint32_t maxMsPerChannel = 300, uint8_t channel = 0);
+      int16_t scanComplete();
+      void scanDelete();
+      String SSID(uint8_t index);
+      int32_t RSSI(uint8_t index);
+      int32_t channel(uint8_t index);
+      wifi_auth_mode_t encryptionType(uint8_t index);
+      uint8_t* BSSID(uint8_t index);
+   private:
+      bool associated(); 
+      bool joining = false; // begin() called and not disconnected since.
+      uint64_t joinedAt = 0; // When association completes.
+      uint64_t scanDoneAt = 0; // When the running scan completes.
+      int16_t scanResult = WIFI_SCAN_FAILED; // Networks found, or a WIFI_SCAN_ code.
+      bool scanFoundAp = false; // The simulated access point is result 0.
+      bool neighbour(uint8_t index); // Result index is one of the --neighbours.
+      char neighbourSsid[16]; // Name returned by the last SSID() of a neighbour.
+      bool linkLost = false; // The access point went away while joined.
+}; // class WiFiClass
+
+extern WiFiClass WiFi;
+
+#endif // End of conditional preprocessor code
@@ -0,0 +1,27 @@
+// Access Point table for the native build when include/apSecrets.h does not
+// exist. The simulated Access Point takes the first SSID in whichever table
+// is used, so the firmware always finds it.
+#ifndef secrets_h
+#define secrets_h
+
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <fnvHash.h> // Compile-time FNV-1a hash.
+
+// Define a structure with key value pairs. The hash of the SSID is worked out
+// by the compiler.
+typedef struct apKeyAndValue_ 
+{
+   const char* ssid;
+   const char* pwd;
+   uint32_t ssidHash;
+} apKeyAndValue_t;
+
+// Build one table entry, hashing the SSID at compile time.
+#define AP_SECRET(ssid, pwd) {ssid, pwd, fnv1a(ssid)}
+
+constexpr apKeyAndValue_t apSecrets[] = 
+{
+   AP_SECRET("craneSim", "simpass")
+};
+
+#endif
@@ -0,0 +1,1848 @@
+#include <hostSim.h> // Simulated crane, network and clock.
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <apSecrets.h> // The simulated Access Point is the first one known.
+#include <gpioBank.h> // Bridge direction pins written by gpioUpdate().
+#include <huzzah32GpioPins.h> // Pin names for Adafruit Huzzah32 dev board.
+#include <projectPinout.h> // Which pins drive which axis.
+#include <latencyHistogram.h> // Command to actuation latency.
+#include <udpControl.h> // Datagram and ack layout.
+#include <arpa/inet.h> // htons().
+#include <netinet/in.h> // sockaddr_in.
+#include <sys/socket.h> // The operator's UDP socket.
+#include <algorithm> // std::stable_sort.
+#include <chrono> // Host time for the speed up figure.
+#include <deque> // Script entries in time order.
+#include <map> // Publish counts per topic.
+#include <new> // std::bad_alloc.
+#include <stdio.h> // Files and the summary.
+#include <vector> // Commands waiting for an actuator to move.
+
+void setup(); // Firmware entry points in main.cpp.
+void loop();
+
+const uint32_t simSubstepUs = 1000; // Crane model integration step.
+const uint64_t simActuationWindowUs = 1000000; // A command must move something within this.
+const uint32_t simPulseWindowUs = 100000; // Peak pulse rate is measured over this.
+const float simIsrCostUs = 2.0f; // Estimated ESP32 GPIO interrupt entry, handler and exit at 240 MHz.
+const uint32_t simHeapHeader = 8; // Bytes in front of each block in the device heap model.
+const uint16_t simHeapMaxBlocks = 4096; // Live blocks the model can hold.
+const size_t simHeapPrefix = 16; // Host bytes in front of each block for its model offset.
+const float simRestSpeed = 0.005f; // Share of full speed below which an undriven axis is at rest.
+const uint64_t simGroupWindowUs = 50000; // Axes set going this close together move as a group.
+const float simArriveShare = 0.02f; // Share of its travel from where an axis comes to rest that counts as arrived.
+
+// One simulated DC axis: first order lag from duty to speed, then position.
+struct simAxis
+{
+   const char* name; // Column name in the timeline.
+   float maxRate; // Units per second at full duty.
+   float tau; // Time constant of the speed response in seconds.
+   float low, high; // End stops, equal for none.
+   float position; // Degrees or milli-metres.
+   float speed; // Fraction of maxRate, -1 to 1.
+   int16_t duty; // Signed duty applied now.
+   bool atLimit; // Resting on an end stop.
+   uint32_t limitHits; // Times an end stop was reached.
+   uint8_t encoderPin; // Encoder input.
+   float pulsesPerUnit; // Encoder pulses per degree or milli-metre.
+   float pulseFraction; // Travel not yet worth a whole pulse.
+   bool inMotion; // Driven, or not yet at rest since it was.
+   uint64_t motionStartUs; // When it was last set going.
+}; // simAxis
+
+simAxis simAxes[] =
+{
+   {"slew_deg", 20.0f, 0.15f, 0.0f, 0.0f, 0.0f, 0.0f, 0, false, 0, encA, 10.0f, 0.0f, false, 0},
+   {"hoist_mm", 120.0f, 0.10f, 0.0f, 1500.0f, 750.0f, 0.0f, 0, false, 0, encB, 4.0f, 0.0f, false, 0},
+   {"luff_deg", 8.0f, 0.20f, 10.0f, 80.0f, 45.0f, 0.0f, 0, false, 0, encC, 50.0f, 0.0f, false, 0}
+}; // simAxes
+const uint8_t simAxisCount = sizeof(simAxes) / sizeof(simAxes[0]);
+std::vector<std::pair<uint64_t, float>> simPaths[simAxisCount]; // Time and position of each axis in motion.
+
+// One motion of one axis, from being set going to coming to rest.
+struct simMotion
+{
+   uint8_t axis; // Index into simAxes.
+   uint64_t startUs; // Set going.
+   uint64_t arriveUs; // Within simArriveShare of its travel of where it came to rest from then on.
+}; // simMotion
+
+// One line of the script.
+struct simEntry
+{
+   uint64_t atUs; // Due time, from start up or from online.
+   bool absolute; // True if atUs counts from start up.
+   std::string topic; // Topic, or the event name starting with !.
+   std::string payload; // Message payload.
+   uint64_t readyUs = 0; // When a message reaches the device.
+}; // simEntry
+
+// One live block in the device heap model.
+struct simHeapBlock
+{
+   uint32_t offset; // Start in the heap.
+   uint32_t size; // Bytes including the header, a multiple of 4.
+}; // simHeapBlock
+
+// How a command reached the device.
+enum simChannel : uint8_t
+{
+   SIM_MQTT, // Through the broker.
+   SIM_UDP, // In a datagram straight from the operator.
+   SIM_CHANNELS
+}; // simChannel
+const char* const simChannelNames[SIM_CHANNELS] = {"mqtt", "udp"};
+
+// A command delivered to the device and not yet followed by actuation.
+struct simPending
+{
+   uint64_t dueUs; // When the operator sent it.
+   uint8_t channel; // enum simChannel.
+}; // simPending
+
+// A datagram from the operator on its way to the device.
+struct simDatagram
+{
+   uint64_t readyUs; // When it reaches the device.
+   std::string bytes; // Header, topic and payload.
+}; // simDatagram
+
+// A datagram the operator waits to hear about.
+struct simSent
+{
+   uint64_t sentUs; // When the operator sent it.
+   bool command; // On the cmd topic or a /set topic.
+}; // simSent
+
+// Ways of asking the crane to stop.
+enum simStopKind : uint8_t
+{
+   SIM_STOP_ESTOP, // The e-stop button was pressed.
+   SIM_STOP_COMMAND, // A stop command was due.
+   SIM_STOP_NETWORK, // Commands stopped coming, timed from the last one delivered.
+   SIM_STOP_KINDS
+}; // simStopKind
+const char* const simStopNames[SIM_STOP_KINDS] = {"e-stop", "stop command", "network loss"};
+
+// A stop request made while an axis was driven, waiting for every bridge to be off.
+struct simStop
+{
+   uint8_t kind; // enum simStopKind.
+   uint64_t fromUs; // When the stop was asked for.
+}; // simStop
+
+uint64_t simNow = 0; // Virtual clock in micro-seconds.
+uint32_t simPwmDuty[hostSimPins] = {0}; // LEDC duty per pin.
+uint8_t simPinLevel[hostSimPins] = {0}; // digitalWrite() level per pin.
+int simServoAngle = -1; // Last servo angle written, -1 before the first.
+bool simWifi = true; // Access Point on the air.
+bool simBroker = true; // Broker accepting connections.
+int64_t simOnlineUs = -1; // When the device first subscribed, -1 before.
+std::string simClientId; // Prefix of the command topic.
+std::deque<simEntry> simScript; // Entries not yet due, in file order.
+std::deque<simEntry> simInbox; // Messages due and waiting for the client.
+std::vector<simPending> simPendingCommands; // Waiting for actuation.
+LatencyHistogram simLatency; // Command to actuation in micro-seconds.
+std::vector<simMotion> simMotions; // Finished since the axes were last all at rest.
+LatencyHistogram simSkew; // Arrival skew of axes that moved as a group, in micro-seconds.
+uint32_t simGroups = 0; // Groups of two or more axes measured.
+uint32_t simMaxSkewMs = 0; // --max-skew-ms, 0 for no limit.
+uint32_t simCommandsDelivered = 0; // Messages handed to the device.
+uint32_t simCommandsIdle = 0; // Commands that moved nothing within the window.
+std::map<std::string, std::pair<uint32_t, uint64_t>> simPublished; // Count and bytes per topic.
+uint32_t simPublishes = 0; // Messages the device published.
+FILE* simTimeline = NULL; // Actuator timeline CSV.
+FILE* simMqttLog = NULL; // Everything the device publishes.
+uint64_t simNextSampleUs = 0; // Next periodic timeline row.
+uint32_t simSampleUs = 100000; // Periodic timeline interval.
+uint32_t simRandomState = 1; // xorshift32 state.
+const char* simApSsid = apSecrets[0].ssid; // --ap.
+int8_t simRssi = -60; // --rssi.
+const char* simMac = "24:0A:C4:00:00:01"; // --mac.
+const char* simNvsDir = NULL; // --nvs.
+bool simQuiet = false; // --quiet.
+uint64_t simAllocations = 0; // Calls to operator new.
+uint64_t simFlashBytes = 0; // Bytes written to the simulated flash.
+uint32_t simFlashWrites = 0; // File write calls on the simulated flash.
+uint64_t simSerialBytes = 0; // Bytes written to Serial.
+uint8_t simNeighbours = 0; // --neighbours.
+void (*simIsr[hostSimPins])(void*) = {NULL}; // attachInterruptArg() handler per pin.
+void* simIsrArg[hostSimPins] = {NULL}; // Argument for each handler.
+float simPpuScale = 1.0f; // --ppu-scale.
+uint64_t simEncoderPulses = 0; // Pulses from every encoder.
+uint32_t simWindowPulses = 0; // Pulses in the current peak rate window.
+uint64_t simWindowEndUs = simPulseWindowUs; // End of that window.
+uint32_t simPeakPulseRate = 0; // Highest pulses per second over one window.
+uint32_t simBrokerRate = 0; // --broker-rate in bytes per second, 0 for no limit.
+uint32_t simBrokerWindow = 5744; // --broker-window, the socket send buffer.
+double simBrokerBacklog = 0; // Bytes written and not yet carried to the broker.
+uint32_t simBrokerBlocks = 0; // Writes that had to wait for room.
+uint64_t simBrokerBlockedUs = 0; // Time spent waiting.
+uint64_t simBrokerLongestUs = 0; // Longest single wait.
+simHeapBlock simHeapBlocks[simHeapMaxBlocks]; // Live blocks by offset.
+uint16_t simHeapCount = 0; // Live blocks.
+uint32_t simHeapSize = 200000; // --heap-size.
+uint32_t simHeapUsed = 0; // Bytes in live blocks.
+uint32_t simHeapPeak = 0; // Most bytes in live blocks at once.
+uint32_t simHeapFailures = 0; // Allocations that found no room.
+uint64_t simHeapAllocations = 0; // Allocations from the device heap.
+int64_t simHeapSetupAllocations = -1; // simHeapAllocations when setup() returned.
+FILE* simHeapLog = NULL; // --heap-log.
+uint64_t simHeapEveryUs = 3600000000ULL; // --heap-every.
+uint64_t simNextHeapUs = 0; // Next --heap-log row.
+uint64_t simHeapLastAllocations = 0; // simHeapAllocations at the last row.
+std::deque<simEntry> simScriptCycle; // The script as loaded, for --repeat-ms.
+uint64_t simRepeatUs = 0; // --repeat-ms in micro-seconds, 0 to run the script once.
+uint32_t simRepeats = 0; // Times the script has been started again.
+uint64_t simOutageUs = 0; // Time with the Access Point or broker down after first coming online.
+void (*simTimer)() = NULL; // Hardware timer interrupt handler.
+uint64_t simTimerPeriodUs = 0; // Between timer interrupts.
+uint64_t simTimerNextUs = 0; // Next timer interrupt.
+bool simEstopPressed = false; // The e-stop button is down.
+uint64_t simStallUs = 0; // The next client.loop() blocks this long.
+uint32_t simStalls = 0; // Stalls injected.
+uint64_t simLastCommandUs = 0; // Last message delivered on a cmd or set topic.
+std::vector<simStop> simStops; // Stop requests waiting for the bridges to go off.
+LatencyHistogram simStopLatency[SIM_STOP_KINDS]; // Stop request to every bridge off, in micro-seconds.
+uint32_t simMaxStopMs = 0; // --max-stop-ms, 0 for no limit.
+uint64_t simNetUs = 0; // --net-ms, one way time across one leg of the network.
+uint32_t simNetJitterUs = 0; // --net-jitter-ms, most extra time on a leg.
+uint64_t simBrokerUs = 0; // --broker-ms, time the broker takes to pass a message on.
+uint64_t simInboxReadyUs = 0; // When the last message reaches the device, TCP keeps them in order.
+LatencyHistogram simChannelLatency[SIM_CHANNELS]; // Command to actuation per channel, in micro-seconds.
+std::vector<uint64_t> simEchoes; // Send times of MQTT commands actuated and not yet in a state frame.
+LatencyHistogram simRoundTrip[SIM_CHANNELS]; // Command sent to the operator hearing of it, in micro-seconds.
+int simUdpSocket = -1; // The operator's socket, opened by the first !udp.
+uint16_t simUdpSession = 1; // Session of the operator's datagrams.
+uint32_t simUdpSequence = 0; // Sequence number of the last datagram.
+std::string simUdpLast; // The last datagram, for !udp-again.
+std::vector<simDatagram> simUdpOutbox; // Datagrams on their way.
+std::map<uint64_t, simSent> simUdpWaiting; // By session and sequence number.
+uint32_t simUdpDatagrams = 0; // Datagrams sent by the operator.
+uint32_t simUdpLost = 0; // Datagrams that arrived while the access point was down.
+uint32_t simUdpAcks[UDP_RESULTS] = {0}; // Acks per result.
+
+// Count every heap allocation made through new. String storage is counted by
+// hostSimHeapAllocate() instead. GCC cannot tell that these are the matching
+// new and delete.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(size_t size)
+{
+   simAllocations++;
+   void* memory = malloc(size > 0 ? size : 1);
+   if(memory == NULL)
+   {
+      throw std::bad_alloc();
+   } // if
+   return memory;
+} // operator new()
+
+void* operator new[](size_t size)
+{
+   return operator new(size);
+} // operator new[]()
+
+void operator delete(void* memory) noexcept
+{
+   free(memory);
+} // operator delete()
+
+void operator delete[](void* memory) noexcept
+{
+   free(memory);
+} // operator delete[]()
+
+void operator delete(void* memory, size_t size) noexcept
+{
+   free(memory);
+} // operator delete()
+
+void operator delete[](void* memory, size_t size) noexcept
+{
+   free(memory);
+} // operator delete[]()
+#pragma GCC diagnostic pop
+
+/**
+ * @brief Write one timeline row for the current state.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simTimelineRow()
+{
+   if(simTimeline == NULL)
+   {
+      return;
+   } // if
+   fprintf(simTimeline, "%llu,%d,%d,%d,%d,%.2f,%.1f,%.2f\n", (unsigned long long)simNow,
+           simAxes[0].duty, simAxes[1].duty, simAxes[2].duty, simServoAngle,
+           simAxes[0].position, simAxes[1].position, simAxes[2].position);
+} // simTimelineRow()
+
+/**
+ * @brief Largest free block in the device heap model.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes a single allocation could have, header included.
+ */
+uint32_t simHeapLargest()
+{
+   uint32_t largest = 0;
+   uint32_t gapStart = 0;
+   for(uint16_t i = 0; i <= simHeapCount; i++)
+   {
+      uint32_t gapEnd = (i < simHeapCount) ? simHeapBlocks[i].offset : simHeapSize;
+      largest = max(largest, gapEnd - gapStart);
+      gapStart = (i < simHeapCount) ? simHeapBlocks[i].offset + simHeapBlocks[i].size : gapStart;
+   } // for
+   return largest;
+} // simHeapLargest()
+
+/**
+ * @brief Write one --heap-log row.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simHeapRow()
+{
+   uint64_t afterSetup = (simHeapSetupAllocations >= 0) ? simHeapAllocations - simHeapSetupAllocations : 0;
+   fprintf(simHeapLog, "%.3f,%llu,%llu,%.1f,%u,%u,%u,%u,%u,%u\n", simNow / 3.6e9,
+           (unsigned long long)simHeapAllocations, (unsigned long long)afterSetup,
+           (simHeapAllocations - simHeapLastAllocations) * 3.6e9 / simHeapEveryUs, simHeapCount, simHeapUsed,
+           simHeapSize - simHeapUsed, hostSimHeapMinFree(), hostSimHeapLargest(), simHeapFailures);
+   simHeapLastAllocations = simHeapAllocations;
+} // simHeapRow()
+
+/**
+ * @brief PWM duty on a pin, 0 while gpioDetach() has cut it from its
+ * channel.
+ *
+ * @param pin Output pin.
+ *
+ * @return Duty.
+ */
+uint32_t simPwmOut(int8_t pin)
+{
+   gpioMask mask = gpioMaskOf(pin);
+   bool detached = (gpioFakeDetached.bank0 & mask.bank0) || (gpioFakeDetached.bank1 & mask.bank1);
+   return detached ? 0 : simPwmDuty[pin];
+} // simPwmOut()
+
+/**
+ * @brief Whether any axis is driven now.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if any bridge has a duty.
+ */
+bool simDriven()
+{
+   for(const simAxis& axis : simAxes)
+   {
+      if(axis.duty != 0)
+      {
+         return true;
+      } // if
+   } // for
+   return false;
+} // simDriven()
+
+/**
+ * @brief Start timing a stop request, if there is anything to stop.
+ *
+ * @param kind enum simStopKind.
+ * @param fromUs When the stop was asked for.
+ *
+ * @return NA No return value.
+ */
+void simStopRequested(uint8_t kind, uint64_t fromUs)
+{
+   if(simDriven())
+   {
+      simStops.push_back({kind, fromUs});
+   } // if
+} // simStopRequested()
+
+/**
+ * @brief Work out the signed duty of each axis from the bridge pins, the way
+ * motorDriver.cpp drives them.
+ *
+ * @details Motor A is an L298N, PWM on the enable pin and the direction from
+ * whichever input is high. Motors B and C are DRV8871s, PWM on in2 is
+ * forward and on in1 is reverse. A pin cut by gpioDetach() carries no PWM.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if any axis duty changed.
+ */
+bool simReadBridges()
+{
+   bool a1 = (gpioFakeLevels.bank0 & gpioMaskOf(inA1).bank0) || simPinLevel[inA1];
+   bool a2 = (gpioFakeLevels.bank0 & gpioMaskOf(inA2).bank0) || simPinLevel[inA2];
+   int16_t duty[simAxisCount];
+   duty[0] = (int16_t)simPwmOut(enA1) * (a2 && !a1 ? 1 : a1 && !a2 ? -1 : 0);
+   duty[1] = (int16_t)simPwmOut(inB2) - (int16_t)simPwmOut(inB1);
+   duty[2] = (int16_t)simPwmOut(inC2) - (int16_t)simPwmOut(inC1);
+   bool changed = false;
+   for(uint8_t i = 0; i < simAxisCount; i++)
+   {
+      changed |= (duty[i] != simAxes[i].duty);
+      simAxes[i].duty = duty[i];
+   } // for
+   return changed;
+} // simReadBridges()
+
+/**
+ * @brief Time across one leg of the network, operator to broker, broker to
+ * device or operator to device.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds, --net-ms plus up to --net-jitter-ms.
+ */
+uint64_t simLeg()
+{
+   return simNetUs + (simNetJitterUs > 0 ? hostSimRandom() % (simNetJitterUs + 1) : 0);
+} // simLeg()
+
+/**
+ * @brief Read the acks that have come back to the operator. A datagram the
+ * device dispatched completes a round trip, and an accepted command waits
+ * for actuation like one delivered by the broker.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simUdpReceive()
+{
+   uint8_t ack[udpHeaderSize + 1];
+   ssize_t length;
+   while(simUdpSocket >= 0 && (length = recv(simUdpSocket, ack, sizeof(ack), MSG_DONTWAIT)) >= 0)
+   {
+      uint8_t result = ack[udpHeaderSize];
+      if(length != sizeof(ack) || ack[0] != udpMagic || result >= UDP_RESULTS)
+      {
+         continue;
+      } // if
+      simUdpAcks[result]++;
+      uint64_t key = ((uint64_t)(ack[1] | (ack[2] << 8)) << 32) | ack[3] | (ack[4] << 8) | (ack[5] << 16)
+                   | ((uint32_t)ack[6] << 24);
+      std::map<uint64_t, simSent>::iterator sent = simUdpWaiting.find(key);
+      if(sent == simUdpWaiting.end() || (result != UDP_ACCEPTED && result != UDP_UNKNOWN))
+      {
+         continue; // A repeat or a datagram that was dropped.
+      } // if
+      simRoundTrip[SIM_UDP].record((uint32_t)(simNow + simLeg() - sent->second.sentUs));
+      if(result == UDP_ACCEPTED && sent->second.command)
+      {
+         simPendingCommands.push_back({sent->second.sentUs, SIM_UDP});
+         simLastCommandUs = simNow;
+      } // if
+      simUdpWaiting.erase(sent);
+   } // while
+} // simUdpReceive()
+
+/**
+ * @brief Send the datagrams that have crossed the network to the device
+ * over loopback. The ones that arrive while the access point is down are
+ * lost.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simUdpFlush()
+{
+   while(!simUdpOutbox.empty() && simUdpOutbox.front().readyUs <= simNow)
+   {
+      const std::string& bytes = simUdpOutbox.front().bytes;
+      struct sockaddr_in device;
+      memset(&device, 0, sizeof(device));
+      device.sin_family = AF_INET;
+      device.sin_port = htons(UDP_PORT); // The firmware's port.
+      device.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if(!simWifi || UDP_PORT == 0 || sendto(simUdpSocket, bytes.data(), bytes.size(), 0, 
+         (struct sockaddr*)&device, sizeof(device)) < 0)
+      {
+         simUdpLost++;
+      } // if
+      simUdpOutbox.erase(simUdpOutbox.begin());
+   } // while
+} // simUdpFlush()
+
+/**
+ * @brief Act on a !udp script event. The operator sends a datagram, sends
+ * the last one again or starts a new session as a second sender would.
+ *
+ * @param entry The event, "<topic> <payload>" in payload for !udp.
+ *
+ * @return NA No return value.
+ */
+void simUdpEvent(const simEntry& entry)
+{
+   if(entry.topic == "!udp-sender")
+   {
+      simUdpSession++;
+      simUdpSequence = 0;
+      return;
+   } // if
+   if(simUdpSocket < 0)
+   {
+      simUdpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+      struct sockaddr_in local;
+      memset(&local, 0, sizeof(local));
+      local.sin_family = AF_INET;
+      local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      bind(simUdpSocket, (struct sockaddr*)&local, sizeof(local));
+   } // if
+   std::string bytes = simUdpLast;
+   if(entry.topic == "!udp")
+   {
+      size_t split = entry.payload.find_first_of(" \t");
+      std::string topic = entry.payload.substr(0, split);
+      std::string payload = (split == std::string::npos) ? "" : entry.payload.substr(split + 1);
+      simUdpSequence++;
+      uint8_t header[udpHeaderSize] = {udpMagic, (uint8_t)simUdpSession, (uint8_t)(simUdpSession >> 8),
+         (uint8_t)simUdpSequence, (uint8_t)(simUdpSequence >> 8), (uint8_t)(simUdpSequence >> 16), 
+         (uint8_t)(simUdpSequence >> 24)};
+      bytes.assign((const char*)header, sizeof(header));
+      bytes += topic;
+      bytes += '\0';
+      bytes += payload;
+      bool command = topic == "cmd" || (topic.size() >= 4 && topic.compare(topic.size() - 4, 4, "/set") == 0);
+      simUdpWaiting[((uint64_t)simUdpSession << 32) | simUdpSequence] = {entry.atUs, command};
+      if(topic == "stop/set" || (topic == "cmd" && payload == "stop"))
+      {
+         simStopRequested(SIM_STOP_COMMAND, entry.atUs);
+      } // if
+      simUdpLast = bytes;
+   } // if
+   if(bytes.empty())
+   {
+      return;
+   } // if
+   simUdpDatagrams++;
+   simDatagram datagram = {entry.atUs + simLeg(), bytes};
+   std::vector<simDatagram>::iterator place = simUdpOutbox.begin();
+   while(place != simUdpOutbox.end() && place->readyUs <= datagram.readyUs)
+   {
+      place++;
+   } // while
+   simUdpOutbox.insert(place, datagram);
+} // simUdpEvent()
+
+/**
+ * @brief An actuator changed. Close out the commands waiting for it and log
+ * the new state.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simActuated()
+{
+   simUdpReceive(); // A command the device has just acked may be the cause.
+   for(const simPending& pending : simPendingCommands)
+   {
+      simLatency.record((uint32_t)(simNow - pending.dueUs));
+      simChannelLatency[pending.channel].record((uint32_t)(simNow - pending.dueUs));
+      if(pending.channel == SIM_MQTT)
+      {
+         simEchoes.push_back(pending.dueUs);
+      } // if
+   } // for
+   simPendingCommands.clear();
+   if(simDriven())
+   {
+      simTimelineRow();
+      return;
+   } // if
+   for(const simStop& stop : simStops)
+   {
+      simStopLatency[stop.kind].record((uint32_t)min<uint64_t>(simNow - stop.fromUs, UINT32_MAX));
+   } // for
+   simStops.clear();
+   simTimelineRow();
+} // simActuated()
+
+/**
+ * @brief Follow one axis from being set going to coming to rest. An axis
+ * has arrived from when it stays within simArriveShare of its travel of
+ * where it comes to rest, so the slow creep of a motor running down does
+ * not count and a short move is held to the same standard as a long one.
+ * Once every axis is at rest, the motions that started within
+ * simGroupWindowUs of each other are a group, and the time between the
+ * first and the last of them to arrive is the arrival skew of the group.
+ *
+ * @param index Index into simAxes.
+ *
+ * @return NA No return value.
+ */
+void simTrackMotion(uint8_t index)
+{
+   simAxis& axis = simAxes[index];
+   std::vector<std::pair<uint64_t, float>>& path = simPaths[index];
+   if(!axis.inMotion && axis.duty != 0)
+   {
+      axis.inMotion = true;
+      axis.motionStartUs = simNow;
+      path.clear();
+   } // if
+   if(axis.inMotion && (path.empty() || path.back().second != axis.position))
+   {
+      path.push_back(std::make_pair(simNow, axis.position));
+   } // if
+   if(axis.inMotion && axis.duty == 0 && fabsf(axis.speed) < simRestSpeed)
+   {
+      axis.inMotion = false;
+      size_t arrived = path.size() - 1;
+      float band = fabsf(axis.position - path[0].second) * simArriveShare;
+      while(arrived > 0 && fabsf(path[arrived - 1].second - axis.position) <= band)
+      {
+         arrived--;
+      } // while
+      simMotions.push_back({index, axis.motionStartUs, path[arrived].first});
+   } // if
+   for(const simAxis& other : simAxes)
+   {
+      if(other.inMotion)
+      {
+         return;
+      } // if
+   } // for
+   std::stable_sort(simMotions.begin(), simMotions.end(),
+                    [](const simMotion& a, const simMotion& b) { return a.startUs < b.startUs; });
+   for(size_t first = 0, last = 0; first < simMotions.size(); first = last)
+   {
+      uint64_t earliest = UINT64_MAX, latest = 0;
+      uint8_t axes = 0;
+      for(last = first; last < simMotions.size()
+          && simMotions[last].startUs - simMotions[first].startUs <= simGroupWindowUs; last++)
+      {
+         earliest = min(earliest, simMotions[last].arriveUs);
+         latest = max(latest, simMotions[last].arriveUs);
+         axes |= 1 << simMotions[last].axis;
+      } // for
+      if(axes != 0 && (axes & (axes - 1)) != 0) // Two or more different axes.
+      {
+         simSkew.record((uint32_t)min<uint64_t>(latest - earliest, UINT32_MAX));
+         simGroups++;
+      } // if
+   } // for
+   simMotions.clear();
+} // simTrackMotion()
+
+/**
+ * @brief Move the crane on by one substep.
+ *
+ * @param us Micro-seconds to integrate.
+ *
+ * @return NA No return value.
+ */
+void simIntegrate(uint32_t us)
+{
+   float dt = us / 1e6f;
+   for(uint8_t i = 0; i < simAxisCount; i++)
+   {
+      simAxis& axis = simAxes[i];
+      float target = axis.duty / 255.0f;
+      axis.speed += (target - axis.speed) * (dt / (axis.tau + dt));
+      float before = axis.position;
+      axis.position += axis.speed * axis.maxRate * dt;
+      if(axis.low != axis.high)
+      {
+         bool limited = axis.position <= axis.low || axis.position >= axis.high;
+         axis.position = constrain(axis.position, axis.low, axis.high);
+         if(limited)
+         {
+            axis.speed = 0.0f; // The gearbox stalls against the stop.
+         } // if
+         if(limited && !axis.atLimit)
+         {
+            axis.limitHits++;
+         } // if
+         axis.atLimit = limited;
+      } // if
+      simTrackMotion(i);
+      axis.pulseFraction += fabsf(axis.position - before) * axis.pulsesPerUnit * simPpuScale;
+      uint32_t pulses = (uint32_t)axis.pulseFraction;
+      axis.pulseFraction -= pulses;
+      simEncoderPulses += pulses;
+      simWindowPulses += pulses;
+      for(uint32_t p = 0; p < pulses && simIsr[axis.encoderPin] != NULL; p++)
+      {
+         simIsr[axis.encoderPin](simIsrArg[axis.encoderPin]);
+      } // for
+   } // for
+} // simIntegrate()
+
+/**
+ * @brief Put the script in time order, entries timed from start up first.
+ * Lines with equal times keep their file order so batches arrive in sequence.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simSortScript()
+{
+   std::stable_sort(simScript.begin(), simScript.end(), [](const simEntry& a, const simEntry& b)
+   {
+      return (a.absolute != b.absolute) ? a.absolute : a.atUs < b.atUs;
+   });
+} // simSortScript()
+
+/**
+ * @brief Act on a script event.
+ *
+ * @details A network outage or stall that starts while an axis is driven
+ * counts as a stop request from the last command delivered, since only the
+ * deadman can stop the crane then. Pressing the e-stop raises its pin
+ * interrupt.
+ *
+ * @param entry The event, its name in topic and any value in payload.
+ *
+ * @return NA No return value.
+ */
+void simEvent(const simEntry& entry)
+{
+   if(entry.topic.compare(0, 4, "!udp") == 0)
+   {
+      simUdpEvent(entry);
+      return;
+   } // if
+   bool wasUp = simWifi && simBroker;
+   simWifi = (entry.topic == "!wifi-down") ? false : (entry.topic == "!wifi-up") ? true : simWifi;
+   simBroker = (entry.topic == "!broker-down") ? false : (entry.topic == "!broker-up") ? true : simBroker;
+   if(entry.topic == "!stall")
+   {
+      simStallUs = (uint64_t)(max(0.0, atof(entry.payload.c_str())) * 1000);
+      simStalls++;
+   } // if
+   // A broker outage leaves the operator UDP, if it has been used.
+   if((wasUp && !(simWifi && simBroker) && (!simWifi || simUdpDatagrams == 0)) || entry.topic == "!stall")
+   {
+      simStopRequested(SIM_STOP_NETWORK, simLastCommandUs);
+   } // if
+   if(entry.topic == "!estop-press" && !simEstopPressed)
+   {
+      simEstopPressed = true;
+      simStopRequested(SIM_STOP_ESTOP, simNow);
+      if(estopPin < hostSimPins && simIsr[estopPin] != NULL)
+      {
+         simIsr[estopPin](simIsrArg[estopPin]);
+      } // if
+      if(simReadBridges())
+      {
+         simActuated();
+      } // if
+   } // if
+   simEstopPressed = (entry.topic == "!estop-release") ? false : simEstopPressed;
+} // simEvent()
+
+/**
+ * @brief Start the script entries that have come due. Events change the
+ * network at once, messages go to the inbox for the client to collect.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void simRunScript()
+{
+   if(simScript.empty() && simRepeatUs > 0 && simOnlineUs >= 0)
+   {
+      simRepeats++;
+      for(simEntry entry : simScriptCycle)
+      {
+         entry.atUs += (entry.absolute ? 0 : simOnlineUs) + simRepeats * simRepeatUs;
+         entry.absolute = true;
+         simScript.push_back(entry);
+      } // for
+      simSortScript();
+   } // if
+   if(simOnlineUs >= 0 && !simScript.empty() && !simScript.back().absolute)
+   {
+      // Online now, so the times that count from it can be placed.
+      for(simEntry& entry : simScript)
+      {
+         entry.atUs += entry.absolute ? 0 : simOnlineUs;
+         entry.absolute = true;
+      } // for
+      simSortScript();
+   } // if
+   while(!simScript.empty())
+   {
+      simEntry& entry = simScript.front();
+      if(!entry.absolute || entry.atUs > simNow)
+      {
+         return; // Not due, or waiting for the device to come online.
+      } // if
+      if(entry.topic[0] == '!')
+      {
+         simEvent(entry);
+      } // if
+      else
+      {
+         size_t id;
+         while((id = entry.topic.find("{id}")) != std::string::npos)
+         {
+            entry.topic.replace(id, 4, simClientId);
+         } // while
+         bool onCmd = entry.topic.size() >= 4 && entry.topic.compare(entry.topic.size() - 4, 4, "/cmd") == 0;
+         bool onStop = entry.topic.size() >= 9 && entry.topic.compare(entry.topic.size() - 9, 9, "/stop/set") == 0;
+         if(onStop || (onCmd && entry.payload == "stop"))
+         {
+            simStopRequested(SIM_STOP_COMMAND, entry.atUs);
+         } // if
+         entry.readyUs = max(simInboxReadyUs, entry.atUs + simLeg() + simBrokerUs + simLeg());
+         simInboxReadyUs = entry.readyUs;
+         simInbox.push_back(entry);
+      } // else
+      simScript.pop_front();
+   } // while
+} // simRunScript()
+
+/**
+ * @brief Current virtual time.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds since start up.
+ */
+uint64_t hostSimMicros()
+{
+   return simNow;
+} // hostSimMicros()
+
+/**
+ * @brief Let virtual time pass, moving the crane and running the script.
+ *
+ * @param micros Micro-seconds to advance.
+ *
+ * @return NA No return value.
+ */
+void hostSimAdvance(uint64_t micros)
+{
+   uint64_t end = simNow + micros;
+   while(simNow < end)
+   {
+      simUdpReceive();
+      uint32_t step = (uint32_t)min<uint64_t>(simSubstepUs, end - simNow);
+      simIntegrate(step);
+      simNow += step;
+      if(simOnlineUs >= 0 && !(simWifi && simBroker))
+      {
+         simOutageUs += step;
+      } // if
+      simRunScript();
+      simUdpFlush();
+      if(simTimer != NULL && simNow >= simTimerNextUs)
+      {
+         simTimerNextUs += simTimerPeriodUs;
+         simTimer();
+         if(simReadBridges())
+         {
+            simActuated();
+         } // if
+      } // if
+      hostSimRunTasks();
+      while(!simPendingCommands.empty() && simNow - simPendingCommands.front().dueUs > simActuationWindowUs)
+      {
+         simPendingCommands.erase(simPendingCommands.begin());
+         simCommandsIdle++;
+      } // while
+      simBrokerBacklog = max(0.0, simBrokerBacklog - (double)simBrokerRate * step / 1e6);
+      if(simNow >= simWindowEndUs)
+      {
+         simPeakPulseRate = max(simPeakPulseRate, (uint32_t)(simWindowPulses * (1000000ULL / simPulseWindowUs)));
+         simWindowPulses = 0;
+         simWindowEndUs += simPulseWindowUs;
+      } // if
+      if(simNow >= simNextSampleUs)
+      {
+         simTimelineRow();
+         simNextSampleUs += simSampleUs;
+      } // if
+      if(simHeapLog != NULL && simNow >= simNextHeapUs)
+      {
+         simHeapRow();
+         simNextHeapUs += simHeapEveryUs;
+      } // if
+   } // while
+} // hostSimAdvance()
+
+/**
+ * @brief Call a hardware timer interrupt handler every period on the
+ * virtual clock, also while a task is blocked.
+ *
+ * @param periodUs Micro-seconds between calls.
+ * @param handler Interrupt handler, NULL to stop.
+ *
+ * @return NA No return value.
+ */
+void hostSimTimer(uint64_t periodUs, void (*handler)())
+{
+   simTimerPeriodUs = max<uint64_t>(periodUs, simSubstepUs);
+   simTimerNextUs = simNow + simTimerPeriodUs;
+   simTimer = handler;
+} // hostSimTimer()
+
+/**
+ * @brief An LEDC channel duty was written.
+ *
+ * @param pin Output pin.
+ * @param duty New duty.
+ *
+ * @return NA No return value.
+ */
+void hostSimPwm(int8_t pin, uint32_t duty)
+{
+   if(pin < 0 || pin >= hostSimPins)
+   {
+      return;
+   } // if
+   simPwmDuty[pin] = duty;
+   if(simReadBridges())
+   {
+      simActuated();
+   } // if
+} // hostSimPwm()
+
+/**
+ * @brief The servo was moved.
+ *
+ * @param pin Servo pin.
+ * @param angle Degrees.
+ *
+ * @return NA No return value.
+ */
+void hostSimServo(int8_t pin, int angle)
+{
+   if(angle != simServoAngle)
+   {
+      simServoAngle = angle;
+      simActuated();
+   } // if
+} // hostSimServo()
+
+/**
+ * @brief A pin was driven with digitalWrite().
+ *
+ * @param pin GPIO number.
+ * @param level HIGH or LOW.
+ *
+ * @return NA No return value.
+ */
+void hostSimPinWrite(uint8_t pin, uint8_t level)
+{
+   if(pin >= hostSimPins)
+   {
+      return;
+   } // if
+   simPinLevel[pin] = level;
+   if(simReadBridges())
+   {
+      simActuated();
+   } // if
+} // hostSimPinWrite()
+
+/**
+ * @brief Level of a pin, as last driven by either digitalWrite() or
+ * gpioUpdate(). The e-stop input is low while the button is pressed and
+ * pulled high otherwise.
+ *
+ * @param pin GPIO number.
+ *
+ * @return HIGH or LOW.
+ */
+uint8_t hostSimPinRead(uint8_t pin)
+{
+   if(pin >= hostSimPins)
+   {
+      return LOW;
+   } // if
+   if(pin == estopPin)
+   {
+      return simEstopPressed ? LOW : HIGH;
+   } // if
+   gpioMask mask = gpioMaskOf(pin);
+   bool fake = (gpioFakeLevels.bank0 & mask.bank0) || (gpioFakeLevels.bank1 & mask.bank1);
+   return (fake || simPinLevel[pin]) ? HIGH : LOW;
+} // hostSimPinRead()
+
+/**
+ * @brief Set or clear the interrupt handler of a pin.
+ *
+ * @param pin GPIO number.
+ * @param handler Called once per encoder pulse, NULL for none.
+ * @param arg Passed to the handler.
+ *
+ * @return NA No return value.
+ */
+void hostSimAttachInterrupt(uint8_t pin, void (*handler)(void*), void* arg)
+{
+   if(pin >= hostSimPins)
+   {
+      return;
+   } // if
+   simIsr[pin] = handler;
+   simIsrArg[pin] = arg;
+} // hostSimAttachInterrupt()
+
+/**
+ * @brief Whether the Access Point is on the air.
+ *
+ * @param NA No parameters.
+ *
+ * @return True unless a !wifi-down event is in force.
+ */
+bool hostSimWifiUp()
+{
+   return simWifi;
+} // hostSimWifiUp()
+
+/**
+ * @brief Name of the simulated Access Point.
+ *
+ * @param NA No parameters.
+ *
+ * @return SSID, see --ap.
+ */
+const char* hostSimApSsid()
+{
+   return simApSsid;
+} // hostSimApSsid()
+
+/**
+ * @brief Signal strength of the simulated Access Point.
+ *
+ * @param NA No parameters.
+ *
+ * @return dBm, see --rssi.
+ */
+int8_t hostSimApRssi()
+{
+   return simRssi;
+} // hostSimApRssi()
+
+/**
+ * @brief MAC address of the simulated ESP32.
+ *
+ * @param NA No parameters.
+ *
+ * @return Text form, see --mac.
+ */
+const char* hostSimMac()
+{
+   return simMac;
+} // hostSimMac()
+
+/**
+ * @brief Whether the broker accepts connections.
+ *
+ * @param NA No parameters.
+ *
+ * @return True unless a !broker-down event is in force.
+ */
+bool hostSimBrokerUp()
+{
+   return simBroker;
+} // hostSimBrokerUp()
+
+/**
+ * @brief The device subscribed. The first command topic subscription starts
+ * the script clock and gives the client ID used for {id}.
+ *
+ * @param topic Topic filter subscribed to.
+ *
+ * @return NA No return value.
+ */
+void hostSimOnline(const char* topic)
+{
+   std::string filter(topic);
+   size_t slash = filter.rfind('/');
+   if(simOnlineUs >= 0 || slash == std::string::npos || filter.compare(slash, std::string::npos, "/cmd") != 0)
+   {
+      return;
+   } // if
+   simClientId = filter.substr(0, slash);
+   simOnlineUs = simNow;
+   simRunScript();
+} // hostSimOnline()
+
+/**
+ * @brief Take the next message the broker has ready for the device.
+ *
+ * @param topic Set to the message topic.
+ * @param payload Set to the message payload.
+ * @param due Set to when the message was ready.
+ *
+ * @return True if there was one.
+ */
+bool hostSimNextMessage(std::string& topic, std::string& payload, uint64_t& due)
+{
+   if(simInbox.empty() || simInbox.front().readyUs > simNow)
+   {
+      return false;
+   } // if
+   topic = simInbox.front().topic;
+   payload = simInbox.front().payload;
+   due = simInbox.front().atUs;
+   simInbox.pop_front();
+   return true;
+} // hostSimNextMessage()
+
+/**
+ * @brief A message reached the callback. Messages on the cmd topic and on
+ * the /set topics start a latency measurement that the next actuator change
+ * completes.
+ *
+ * @param topic Message topic.
+ * @param due When the message was ready.
+ *
+ * @return NA No return value.
+ */
+void hostSimDelivered(const std::string& topic, uint64_t due)
+{
+   simCommandsDelivered++;
+   if(topic.size() >= 4 && (topic.compare(topic.size() - 4, 4, "/cmd") == 0 
+      || topic.compare(topic.size() - 4, 4, "/set") == 0))
+   {
+      simPendingCommands.push_back({due, SIM_MQTT});
+      simLastCommandUs = simNow;
+   } // if
+} // hostSimDelivered()
+
+/**
+ * @brief The client services its socket. If a !stall is due the call
+ * blocks that long on the virtual clock, as a read on a half open
+ * connection or a slow broker can, holding up every task on the core.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void hostSimSocketStall()
+{
+   uint64_t stall = simStallUs;
+   simStallUs = 0;
+   if(stall > 0)
+   {
+      hostSimAdvance(stall);
+   } // if
+} // hostSimSocketStall()
+
+/**
+ * @brief The device published. Counted per topic and written to the
+ * --mqtt log, in hex if the payload is not text.
+ *
+ * @param topic Topic.
+ * @param payload Payload bytes.
+ * @param length Number of bytes.
+ * @param retained Retain flag.
+ *
+ * @return NA No return value.
+ */
+void hostSimPublish(const char* topic, const uint8_t* payload, size_t length, bool retained)
+{
+   simPublishes++;
+   size_t topicLength = strlen(topic);
+   if(!simEchoes.empty() && topicLength >= 4 && strcmp(topic + topicLength - 4, "/tel") == 0)
+   {
+      // The first state frame after actuation tells the operator.
+      uint64_t back = simLeg() + simBrokerUs + simLeg();
+      for(uint64_t sent : simEchoes)
+      {
+         simRoundTrip[SIM_MQTT].record((uint32_t)(simNow + back - sent));
+      } // for
+      simEchoes.clear();
+   } // if
+   std::pair<uint32_t, uint64_t>& totals = simPublished[topic];
+   totals.first++;
+   totals.second += length;
+   if(simMqttLog == NULL)
+   {
+      return;
+   } // if
+   bool text = true;
+   for(size_t i = 0; i < length; i++)
+   {
+      text &= (payload[i] >= 0x20 && payload[i] < 0x7F) || payload[i] == '\n' || payload[i] == '\t';
+   } // for
+   fprintf(simMqttLog, "%.3f %s%s ", simNow / 1e6, topic, retained ? " (retained)" : "");
+   for(size_t i = 0; i < length; i++)
+   {
+      if(text)
+      {
+         fputc(payload[i] == '\n' ? '|' : payload[i], simMqttLog);
+      } // if
+      else
+      {
+         fprintf(simMqttLog, "%02x", payload[i]);
+      } // else
+   } // for
+   fputc('\n', simMqttLog);
+} // hostSimPublish()
+
+/**
+ * @brief A packet is written to the broker socket. Waits on the virtual
+ * clock, as a blocking write does, until the send window has room for it.
+ *
+ * @param bytes Packet size.
+ *
+ * @return NA No return value.
+ */
+void hostSimBrokerWrite(size_t bytes)
+{
+   if(simBrokerRate == 0)
+   {
+      return;
+   } // if
+   double excess = simBrokerBacklog - max(0.0, (double)simBrokerWindow - bytes);
+   if(excess > 0)
+   {
+      uint64_t wait = (uint64_t)(excess * 1e6 / simBrokerRate) + 1;
+      simBrokerBlocks++;
+      simBrokerBlockedUs += wait;
+      simBrokerLongestUs = max(simBrokerLongestUs, wait);
+      hostSimAdvance(wait);
+   } // if
+   simBrokerBacklog += bytes;
+} // hostSimBrokerWrite()
+
+/**
+ * @brief Bytes the broker socket takes now without waiting.
+ *
+ * @param NA No parameters.
+ *
+ * @return Free send window.
+ */
+int hostSimBrokerRoom()
+{
+   if(simBrokerRate == 0)
+   {
+      return simBrokerWindow;
+   } // if
+   return (int)max(0.0, simBrokerWindow - simBrokerBacklog);
+} // hostSimBrokerRoom()
+
+/**
+ * @brief Messages the device has published since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t hostSimPublishes()
+{
+   return simPublishes;
+} // hostSimPublishes()
+
+/**
+ * @brief Where the Preferences files live.
+ *
+ * @param NA No parameters.
+ *
+ * @return Directory, NULL to keep nothing between runs.
+ */
+const char* hostSimNvsDir()
+{
+   return simNvsDir;
+} // hostSimNvsDir()
+
+/**
+ * @brief Next value from a xorshift generator seeded by --seed.
+ *
+ * @param NA No parameters.
+ *
+ * @return 32 random bits.
+ */
+uint32_t hostSimRandom()
+{
+   simRandomState ^= simRandomState << 13;
+   simRandomState ^= simRandomState >> 17;
+   simRandomState ^= simRandomState << 5;
+   return simRandomState;
+} // hostSimRandom()
+
+/**
+ * @brief Whether Serial output is thrown away.
+ *
+ * @param NA No parameters.
+ *
+ * @return True with --quiet.
+ */
+bool hostSimQuiet()
+{
+   return simQuiet;
+} // hostSimQuiet()
+
+/**
+ * @brief Turn Serial output off or back on.
+ *
+ * @param quiet True to throw Serial output away.
+ *
+ * @return NA No return value.
+ */
+void hostSimSetQuiet(bool quiet)
+{
+   simQuiet = quiet;
+} // hostSimSetQuiet()
+
+/**
+ * @brief Heap allocations made through operator new since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint64_t hostSimAllocations()
+{
+   return simAllocations;
+} // hostSimAllocations()
+
+/**
+ * @brief Allocate from the simulated device heap. The block goes in the
+ * first gap big enough for it, in address order, and also counts towards
+ * hostSimAllocations(). The memory itself comes from the host.
+ *
+ * @param bytes Bytes wanted.
+ *
+ * @return The memory.
+ */
+void* hostSimHeapAllocate(size_t bytes)
+{
+   simAllocations++;
+   simHeapAllocations++;
+   uint8_t* memory = (uint8_t*)malloc(simHeapPrefix + bytes);
+   if(memory == NULL)
+   {
+      throw std::bad_alloc();
+   } // if
+   uint32_t size = (bytes + simHeapHeader + 3) & ~3u;
+   uint32_t offset = UINT32_MAX;
+   uint32_t gapStart = 0;
+   uint16_t at = 0;
+   for(; at <= simHeapCount && simHeapCount < simHeapMaxBlocks; at++)
+   {
+      uint32_t gapEnd = (at < simHeapCount) ? simHeapBlocks[at].offset : simHeapSize;
+      if(gapEnd >= gapStart && gapEnd - gapStart >= size)
+      {
+         offset = gapStart;
+         break;
+      } // if
+      gapStart = (at < simHeapCount) ? simHeapBlocks[at].offset + simHeapBlocks[at].size : gapStart;
+   } // for
+   if(offset == UINT32_MAX)
+   {
+      simHeapFailures++; // The device would have got NULL.
+   } // if
+   else
+   {
+      memmove(&simHeapBlocks[at + 1], &simHeapBlocks[at], (simHeapCount - at) * sizeof(simHeapBlock));
+      simHeapBlocks[at] = {offset, size};
+      simHeapCount++;
+      simHeapUsed += size;
+      simHeapPeak = max(simHeapPeak, simHeapUsed);
+   } // else
+   memcpy(memory, &offset, sizeof(offset));
+   return memory + simHeapPrefix;
+} // hostSimHeapAllocate()
+
+/**
+ * @brief Give back memory from hostSimHeapAllocate().
+ *
+ * @param memory The memory, NULL does nothing.
+ *
+ * @return NA No return value.
+ */
+void hostSimHeapRelease(void* memory)
+{
+   if(memory == NULL)
+   {
+      return;
+   } // if
+   uint8_t* base = (uint8_t*)memory - simHeapPrefix;
+   uint32_t offset;
+   memcpy(&offset, base, sizeof(offset));
+   uint16_t low = 0, high = simHeapCount;
+   while(low < high)
+   {
+      uint16_t middle = (low + high) / 2;
+      if(simHeapBlocks[middle].offset < offset)
+      {
+         low = middle + 1;
+      } // if
+      else
+      {
+         high = middle;
+      } // else
+   } // while
+   if(low < simHeapCount && simHeapBlocks[low].offset == offset)
+   {
+      simHeapUsed -= simHeapBlocks[low].size;
+      memmove(&simHeapBlocks[low], &simHeapBlocks[low + 1], (simHeapCount - low - 1) * sizeof(simHeapBlock));
+      simHeapCount--;
+   } // if
+   free(base);
+} // hostSimHeapRelease()
+
+/**
+ * @brief Free bytes in the device heap model, as ESP.getFreeHeap().
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint32_t hostSimHeapFree()
+{
+   return simHeapSize - simHeapUsed;
+} // hostSimHeapFree()
+
+/**
+ * @brief Lowest free bytes since start up, as ESP.getMinFreeHeap().
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint32_t hostSimHeapMinFree()
+{
+   return simHeapSize - simHeapPeak;
+} // hostSimHeapMinFree()
+
+/**
+ * @brief Largest block that could be allocated now, as 
+ * ESP.getMaxAllocHeap().
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint32_t hostSimHeapLargest()
+{
+   uint32_t largest = simHeapLargest();
+   return (largest > simHeapHeader) ? largest - simHeapHeader : 0;
+} // hostSimHeapLargest()
+
+/**
+ * @brief A file on the simulated flash was written.
+ *
+ * @param bytes Number of bytes written.
+ *
+ * @return NA No return value.
+ */
+void hostSimFlashWrite(size_t bytes)
+{
+   simFlashBytes += bytes;
+   simFlashWrites++;
+} // hostSimFlashWrite()
+
+/**
+ * @brief Bytes were written to Serial.
+ *
+ * @param bytes Number of bytes.
+ *
+ * @return NA No return value.
+ */
+void hostSimSerialWrite(size_t bytes)
+{
+   simSerialBytes += bytes;
+} // hostSimSerialWrite()
+
+/**
+ * @brief Unknown networks a full scan finds besides the access point.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count, see --neighbours.
+ */
+uint8_t hostSimNeighbours()
+{
+   return simNeighbours;
+} // hostSimNeighbours()
+
+/**
+ * @brief Read the script file into time order.
+ *
+ * @param path Script file.
+ *
+ * @return True if it could be read.
+ */
+bool simLoadScript(const char* path)
+{
+   FILE* file = fopen(path, "r");
+   if(file == NULL)
+   {
+      return false;
+   } // if
+   char line[1024];
+   while(fgets(line, sizeof(line), file) != NULL)
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+      char* text = line + strspn(line, " \t");
+      if(*text == '\0' || *text == '#')
+      {
+         continue;
+      } // if
+      simEntry entry;
+      entry.absolute = (*text == '@');
+      text += entry.absolute ? 1 : 0;
+      entry.atUs = (uint64_t)(strtod(text, &text) * 1000);
+      text += strspn(text, " \t");
+      size_t topicLength = strcspn(text, " \t");
+      entry.topic.assign(text, topicLength);
+      text += topicLength;
+      text += (*text != '\0') ? 1 : 0;
+      entry.payload = text;
+      if(entry.topic.empty())
+      {
+         continue;
+      } // if
+      simScript.push_back(entry);
+      simScriptCycle.push_back(entry);
+   } // while
+   fclose(file);
+   simSortScript();
+   return true;
+} // simLoadScript()
+
+/**
+ * @brief Print what happened on stderr.
+ *
+ * @param hostSeconds Wall clock time the run took.
+ *
+ * @return NA No return value.
+ */
+void simSummary(double hostSeconds)
+{
+   fprintf(stderr, "\n--- hostSim: %.1f s simulated in %.2f s (x%.0f)\n", simNow / 1e6, hostSeconds,
+           hostSeconds > 0 ? simNow / 1e6 / hostSeconds : 0.0);
+   if(simOnlineUs >= 0)
+   {
+      fprintf(stderr, "online at %.3f s as %s\n", simOnlineUs / 1e6, simClientId.c_str());
+   } // if
+   else
+   {
+      fprintf(stderr, "never came online\n");
+   } // else
+   fprintf(stderr, "messages delivered %u, commands that moved nothing %u, script left %u\n",
+           simCommandsDelivered, simCommandsIdle + (uint32_t)simPendingCommands.size(),
+           (uint32_t)(simScript.size() + simInbox.size()));
+   if(simLatency.getCount() > 0)
+   {
+      fprintf(stderr, "command to actuation ms: n=%u min=%.1f p50=%.1f p99=%.1f max=%.1f\n",
+              simLatency.getCount(), simLatency.getMin() / 1e3, simLatency.getPercentile(50) / 1e3,
+              simLatency.getPercentile(99) / 1e3, simLatency.getMax() / 1e3);
+   } // if
+   for(uint8_t channel = 0; channel < SIM_CHANNELS && simUdpDatagrams > 0; channel++)
+   {
+      LatencyHistogram& latency = simChannelLatency[channel];
+      if(latency.getCount() > 0)
+      {
+         fprintf(stderr, "  over %-4s ms: n=%u min=%.1f p50=%.1f p99=%.1f max=%.1f\n", simChannelNames[channel],
+                 latency.getCount(), latency.getMin() / 1e3, latency.getPercentile(50) / 1e3,
+                 latency.getPercentile(99) / 1e3, latency.getMax() / 1e3);
+      } // if
+   } // for
+   for(uint8_t channel = 0; channel < SIM_CHANNELS; channel++)
+   {
+      LatencyHistogram& latency = simRoundTrip[channel];
+      if(latency.getCount() > 0)
+      {
+         fprintf(stderr, "round trip over %-4s to %-11s ms: n=%u min=%.1f p50=%.1f p99=%.1f max=%.1f\n",
+                 simChannelNames[channel], channel == SIM_UDP ? "ack" : "state frame", latency.getCount(),
+                 latency.getMin() / 1e3, latency.getPercentile(50) / 1e3, latency.getPercentile(99) / 1e3,
+                 latency.getMax() / 1e3);
+      } // if
+   } // for
+   if(simUdpDatagrams > 0)
+   {
+      fprintf(stderr, "udp datagrams sent %u, lost %u, acks accepted/unknown/stale/busy %u/%u/%u/%u, "
+              "not dispatched %u\n", simUdpDatagrams, simUdpLost, simUdpAcks[UDP_ACCEPTED], 
+              simUdpAcks[UDP_UNKNOWN], simUdpAcks[UDP_STALE], simUdpAcks[UDP_BUSY], (uint32_t)simUdpWaiting.size());
+   } // if
+   if(simGroups > 0)
+   {
+      fprintf(stderr, "axes arriving together: groups=%u skew ms p50=%.1f p99=%.1f max=%.1f\n", simGroups,
+              simSkew.getPercentile(50) / 1e3, simSkew.getPercentile(99) / 1e3, simSkew.getMax() / 1e3);
+   } // if
+   bool stopped = false;
+   for(uint8_t kind = 0; kind < SIM_STOP_KINDS; kind++)
+   {
+      LatencyHistogram& latency = simStopLatency[kind];
+      if(latency.getCount() > 0)
+      {
+         fprintf(stderr, "%s to bridges off ms: n=%u min=%.1f p50=%.1f max=%.1f\n", simStopNames[kind],
+                 latency.getCount(), latency.getMin() / 1e3, latency.getPercentile(50) / 1e3,
+                 latency.getMax() / 1e3);
+         stopped = true;
+      } // if
+   } // for
+   if(stopped || !simStops.empty() || simStalls > 0)
+   {
+      fprintf(stderr, "stalls injected %u, stop requests never completed %u\n", simStalls,
+              (uint32_t)simStops.size());
+   } // if
+   for(const auto& topic : simPublished)
+   {
+      fprintf(stderr, "published %-40s %6u msgs %9llu bytes\n", topic.first.c_str(), topic.second.first,
+              (unsigned long long)topic.second.second);
+   } // for
+   fprintf(stderr, "serial %llu bytes at 115200 baud is %.1f s of UART time\n",
+           (unsigned long long)simSerialBytes, simSerialBytes * 10 / 115200.0);
+   fprintf(stderr, "flash writes %u, %llu bytes", simFlashWrites, (unsigned long long)simFlashBytes);
+   if(simOutageUs > 0)
+   {
+      double hours = simOutageUs / 3.6e9;
+      fprintf(stderr, ", outage %.1f s, per hour of outage %.0f writes %.0f bytes", simOutageUs / 1e6,
+              simFlashWrites / hours, simFlashBytes / hours);
+   } // if
+   fprintf(stderr, "\n");
+   if(simHeapSetupAllocations >= 0)
+   {
+      uint64_t afterSetup = simHeapAllocations - simHeapSetupAllocations;
+      fprintf(stderr, "device heap: %llu allocations after setup, %.1f per simulated hour, %u blocks live, "
+              "free %u of %u bytes, lowest %u, largest block %u, failed %u\n", (unsigned long long)afterSetup,
+              afterSetup * 3.6e9 / max<uint64_t>(simNow, 1), simHeapCount, hostSimHeapFree(), simHeapSize,
+              hostSimHeapMinFree(), hostSimHeapLargest(), simHeapFailures);
+   } // if
+   if(simRepeats > 0)
+   {
+      fprintf(stderr, "script started %u times\n", simRepeats + 1);
+   } // if
+   if(simBrokerRate > 0)
+   {
+      fprintf(stderr, "broker link %u B/s with a %u byte window: writes blocked %u times, %.1f ms in all, "
+              "longest %.1f ms\n", simBrokerRate, simBrokerWindow, simBrokerBlocks, simBrokerBlockedUs / 1e3,
+              simBrokerLongestUs / 1e3);
+   } // if
+   if(simEncoderPulses > 0)
+   {
+      fprintf(stderr, "encoder pulses %llu, peak %u/s, as GPIO interrupts about %.1f%% of one core at the peak\n",
+              (unsigned long long)simEncoderPulses, simPeakPulseRate, simPeakPulseRate * simIsrCostUs / 1e4);
+   } // if
+   for(const simAxis& axis : simAxes)
+   {
+      fprintf(stderr, "%-9s %8.1f  duty %4d  end stop hits %u\n", axis.name, axis.position, axis.duty,
+              axis.limitHits);
+   } // for
+} // simSummary()
+
+#ifndef PIO_UNIT_TESTING // The Unity tests under test/ bring their own main().
+/**
+ * @brief Run the firmware on the virtual clock.
+ *
+ * @param argc Argument count.
+ * @param argv Options, see hostSim.h.
+ *
+ * @return 0 on success, 2 on a bad option.
+ */
+int main(int argc, char** argv)
+{
+   double seconds = 10;
+   uint32_t stepUs = 1000;
+   const char* routerBenchPath = NULL;
+   for(int i = 1; i < argc; i++)
+   {
+      std::string option = argv[i];
+      const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+      if(option == "--quiet")
+      {
+         simQuiet = true;
+         continue;
+      } // if
+      if(value == NULL)
+      {
+         fprintf(stderr, "%s needs a value\n", option.c_str());
+         return 2;
+      } // if
+      i++;
+      if(option == "--seconds")
+      {
+         seconds = atof(value);
+      } // if
+      else if(option == "--step-us")
+      {
+         stepUs = max(1, atoi(value));
+      } // else if
+      else if(option == "--sample-ms")
+      {
+         simSampleUs = max(1, atoi(value)) * 1000;
+      } // else if
+      else if(option == "--ap")
+      {
+         simApSsid = value;
+      } // else if
+      else if(option == "--rssi")
+      {
+         simRssi = atoi(value);
+      } // else if
+      else if(option == "--mac")
+      {
+         simMac = value;
+      } // else if
+      else if(option == "--neighbours")
+      {
+         simNeighbours = min(atoi(value), 255);
+      } // else if
+      else if(option == "--ppu-scale")
+      {
+         simPpuScale = max(0.0, atof(value));
+      } // else if
+      else if(option == "--broker-rate")
+      {
+         simBrokerRate = strtoul(value, NULL, 0);
+      } // else if
+      else if(option == "--broker-window")
+      {
+         simBrokerWindow = max(1UL, strtoul(value, NULL, 0));
+      } // else if
+      else if(option == "--heap-size")
+      {
+         simHeapSize = max(1024UL, strtoul(value, NULL, 0));
+      } // else if
+      else if(option == "--heap-every")
+      {
+         simHeapEveryUs = (uint64_t)(max(0.001, atof(value)) * 1e6);
+      } // else if
+      else if(option == "--heap-log")
+      {
+         simHeapLog = fopen(value, "w");
+         if(simHeapLog == NULL)
+         {
+            fprintf(stderr, "cannot write %s\n", value);
+            return 2;
+         } // if
+         fprintf(simHeapLog, "t_h,allocations,after_setup,per_hour,live_blocks,live_bytes,free,min_free,"
+                 "largest,failed\n");
+      } // else if
+      else if(option == "--max-skew-ms")
+      {
+         simMaxSkewMs = strtoul(value, NULL, 0);
+      } // else if
+      else if(option == "--max-stop-ms")
+      {
+         simMaxStopMs = strtoul(value, NULL, 0);
+      } // else if
+      else if(option == "--net-ms")
+      {
+         simNetUs = (uint64_t)(max(0.0, atof(value)) * 1000);
+      } // else if
+      else if(option == "--net-jitter-ms")
+      {
+         simNetJitterUs = (uint32_t)(max(0.0, atof(value)) * 1000);
+      } // else if
+      else if(option == "--broker-ms")
+      {
+         simBrokerUs = (uint64_t)(max(0.0, atof(value)) * 1000);
+      } // else if
+      else if(option == "--repeat-ms")
+      {
+         simRepeatUs = (uint64_t)(max(0.0, atof(value)) * 1000);
+      } // else if
+      else if(option == "--nvs")
+      {
+         simNvsDir = value;
+      } // else if
+      else if(option == "--seed")
+      {
+         simRandomState = max(1UL, strtoul(value, NULL, 0));
+      } // else if
+      else if(option == "--timeline")
+      {
+         simTimeline = fopen(value, "w");
+         if(simTimeline == NULL)
+         {
+            fprintf(stderr, "cannot write %s\n", value);
+            return 2;
+         } // if
+         fprintf(simTimeline, "t_us,slew_duty,hoist_duty,luff_duty,servo_deg,%s,%s,%s\n",
+                 simAxes[0].name, simAxes[1].name, simAxes[2].name);
+      } // else if
+      else if(option == "--mqtt")
+      {
+         simMqttLog = fopen(value, "w");
+         if(simMqttLog == NULL)
+         {
+            fprintf(stderr, "cannot write %s\n", value);
+            return 2;
+         } // if
+      } // else if
+      else if(option == "--bench-router")
+      {
+         routerBenchPath = value;
+      } // else if
+      else if(option == "--script")
+      {
+         if(!simLoadScript(value))
+         {
+            fprintf(stderr, "cannot read %s\n", value);
+            return 2;
+         } // if
+      } // else if
+      else
+      {
+         fprintf(stderr, "unknown option %s\n", option.c_str());
+         return 2;
+      } // else
+   } // for
+   if(routerBenchPath != NULL)
+   {
+      return hostSimBenchRouter(routerBenchPath);
+   } // if
+   auto started = std::chrono::steady_clock::now();
+   uint64_t end = (uint64_t)(seconds * 1e6);
+   setup();
+   simHeapSetupAllocations = simHeapAllocations;
+   while(simNow < end)
+   {
+      loop();
+      hostSimAdvance(stepUs);
+   } // while
+   fflush(stdout);
+   std::chrono::duration<double> took = std::chrono::steady_clock::now() - started;
+   simSummary(took.count());
+   if(simTimeline != NULL)
+   {
+      fclose(simTimeline);
+   } // if
+   if(simMqttLog != NULL)
+   {
+      fclose(simMqttLog);
+   } // if
+   if(simHeapLog != NULL)
+   {
+      fclose(simHeapLog);
+   } // if
+   if(simMaxSkewMs > 0 && (simGroups == 0 || simSkew.getMax() > simMaxSkewMs * 1000))
+   {
+      fprintf(stderr, "arrival skew over --max-skew-ms %u, or no axes moved together\n", simMaxSkewMs);
+      return 1;
+   } // if
+   if(simMaxStopMs > 0)
+   {
+      uint32_t measured = 0, worst = 0;
+      for(LatencyHistogram& latency : simStopLatency)
+      {
+         measured += latency.getCount();
+         worst = max(worst, latency.getCount() > 0 ? latency.getMax() : 0);
+      } // for
+      if(measured == 0 || !simStops.empty() || worst > simMaxStopMs * 1000)
+      {
+         fprintf(stderr, "stop to bridges off over --max-stop-ms %u, never completed, or no stops seen\n",
+                 simMaxStopMs);
+         return 1;
+      } // if
+   } // if
+   return 0;
+} // main()
+#endif
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * @file hostSim.h
+ *
+ * @brief Simulated crane hardware, network and clock for the native build.
+ *
+ * @details The firmware runs unchanged on a PC. The stand-ins for the
+ * Arduino core, FreeRTOS tasks, WiFi, PubSubClient, TaskScheduler,
+ * ESP32Servo, Preferences and LittleFS in this library all talk to the simulation
+ * through the functions below.
+ *
+ * Time is virtual. millis() and micros() read a clock that only moves when
+ * the simulation advances it, by a fixed step after every loop() pass and by
+ * the full amount inside delay(). Runs are therefore repeatable and much
+ * faster than real time.
+ *
+ * The crane has three DC axes and the servo. The simulation reads the PWM
+ * duty and direction pins the motor drivers write and turns them into axis
+ * speed with a first order lag, then into position with end stops on hoist
+ * and luff. Every actuator change and a periodic sample are written to a CSV
+ * timeline. Each axis turns an encoder that raises one interrupt per pulse
+ * on its pin, --ppu-scale times its pulses per unit, so the summary also
+ * gives the peak pulse rate and the CPU time it would cost as interrupts.
+ * Axes that are set going within 50 ms of each other move as a group, and
+ * the summary gives the arrival skew of the groups, the time between the
+ * first and the last axis of a group to arrive within 2% of its travel of
+ * where it comes to rest. With --max-skew-ms the run exits with 1 if any
+ * group took longer than that, or none was seen.
+ *
+ * The network is an in-process MQTT broker with one WiFi access point. A
+ * full scan also finds --neighbours unknown networks. With --broker-rate
+ * the link to the broker carries that many bytes a second and the socket
+ * holds --broker-window bytes, about the lwIP send buffer. A publish that
+ * does not fit waits for room on the virtual clock, in whichever task made
+ * it, as a blocking socket write does on the device.
+ *
+ * The operator also sends UDP datagrams to the firmware's UDP_PORT, over
+ * loopback through a real socket, and reads its acks. Each leg of the
+ * network, operator to broker, broker to device or operator to device,
+ * takes --net-ms plus up to --net-jitter-ms, and the broker takes
+ * --broker-ms to pass a message on. So a message through the broker crosses
+ * two legs and stays in order, a datagram crosses one and may overtake
+ * another. Datagrams that arrive while the access point is down are lost.
+ *
+ * Commands come from a script file, one per line:
+ *
+ *    <ms> <topic> <payload>    Publish to the device. {id} is its client ID.
+ *    <ms> !<event>             wifi-down, wifi-up, broker-down, broker-up,
+ *                              estop-press, estop-release.
+ *    <ms> !stall <ms>          The next client.loop() blocks that long.
+ *    <ms> !udp <topic> <payload>
+ *                              Send a datagram, topic below the client ID.
+ *    <ms> !udp-again           Send the last datagram again.
+ *    <ms> !udp-sender          Later datagrams come from a second sender.
+ *
+ * Times count from the moment the device first subscribes to its command
+ * topic, or from start up if prefixed with @. Lines starting with # are
+ * comments. Everything the device publishes can be written to a log file.
+ * At the end a summary on stderr gives the command to actuation latency,
+ * the publish count and bytes per topic, the bytes written to Serial, the
+ * flash writes in total and per hour of outage, and the final axis
+ * positions. Flash is held in memory and starts empty on every run.
+ *
+ * Once the operator has sent a datagram, the command to actuation latency
+ * is also given per channel, with the acks the device sent back. The round
+ * trip of a command is timed to when the operator hears of it: the ack for
+ * a datagram, and for an MQTT command the first state frame published after
+ * it moved something.
+ *
+ * A DUAL_CORE build runs its FreeRTOS tasks on the virtual clock too, see
+ * FreeRTOS.h, so the motor task keeps its period while the network task is
+ * blocked, as it does on the second core.
+ *
+ * The hardware timer interrupt runs on the virtual clock, also while a task
+ * is blocked, and the e-stop button pulls its pin low and raises its pin
+ * interrupt. A stop asked for while any axis is driven is timed until every
+ * bridge is off: an e-stop from the press, a stop command from when it was
+ * due, and a network outage or stall from the last command delivered, as
+ * only the deadman can stop the crane then. With --max-stop-ms the run exits
+ * with 1 if any stop took longer than that or never finished, or none was
+ * seen.
+ *
+ * The device heap is modelled as one --heap-size byte region that every
+ * String allocates from, first fit in address order with the 8 byte block
+ * header of the ESP32 heap, so ESP.getFreeHeap(), getMinFreeHeap() and
+ * getMaxAllocHeap() report what String use would do to the device. Only
+ * String storage is modelled, buffers the firmware mallocs once in setup()
+ * and the memory of the network stack are not. --heap-log writes a CSV row
+ * of the heap figures every --heap-every seconds and the summary counts the
+ * allocations made after setup() returned. With --repeat-ms the script
+ * starts again that long after each start, for soak runs of several days.
+ *
+ * With --bench-router the firmware is not started. Instead the MQTT command
+ * dispatch is measured and one JSON object per run is written to the file
+ * ("-" for stdout), see routerBench.cpp. tools/benchcompare.py compares two
+ * such files. The MqttLogger figures come from test/test_logger_bench.
+ *
+ * Usage: program [--seconds N] [--step-us N] [--script FILE]
+ *                [--timeline FILE] [--mqtt FILE] [--sample-ms N] [--ap SSID]
+ *                [--rssi DBM] [--mac MAC] [--nvs DIR] [--neighbours N]
+ *                [--ppu-scale X] [--broker-rate N] [--broker-window N]
+ *                [--heap-size N] [--heap-log FILE] [--heap-every S]
+ *                [--repeat-ms N] [--max-skew-ms N] [--max-stop-ms N]
+ *                [--net-ms X] [--net-jitter-ms X] [--broker-ms X]
+ *                [--seed N] [--quiet]
+ *                [--bench-router FILE]
+ ******************************************************************************/
+#ifndef _HOST_SIM_H // Start of conditional preprocessor code that only
+                    // allows this library to be included once.
+#define _HOST_SIM_H // Preprocessor variable used by above check.
+
+#include <stddef.h> // size_t.
+#include <stdint.h> // Fixed width integer types.
+#include <string> // Message topics and payloads.
+
+const uint8_t hostSimPins = 40; // GPIO numbers on the ESP32.
+
+// Virtual clock.
+uint64_t hostSimMicros();
+void hostSimAdvance(uint64_t micros);
+void hostSimTimer(uint64_t periodUs, void (*handler)());
+void hostSimRunTasks();
+
+// Actuators and pins.
+void hostSimPwm(int8_t pin, uint32_t duty);
+void hostSimServo(int8_t pin, int angle);
+void hostSimPinWrite(uint8_t pin, uint8_t level);
+uint8_t hostSimPinRead(uint8_t pin);
+void hostSimAttachInterrupt(uint8_t pin, void (*handler)(void*), void* arg);
+
+// WiFi access point.
+bool hostSimWifiUp();
+const char* hostSimApSsid();
+int8_t hostSimApRssi();
+const char* hostSimMac();
+uint8_t hostSimNeighbours();
+
+// MQTT broker.
+bool hostSimBrokerUp();
+void hostSimOnline(const char* clientId);
+bool hostSimNextMessage(std::string& topic, std::string& payload, uint64_t& due);
+void hostSimDelivered(const std::string& topic, uint64_t due);
+void hostSimSocketStall();
+void hostSimPublish(const char* topic, const uint8_t* payload, size_t length, bool retained);
+uint32_t hostSimPublishes();
+void hostSimBrokerWrite(size_t bytes);
+int hostSimBrokerRoom();
+
+// Everything else.
+const char* hostSimNvsDir();
+uint32_t hostSimRandom();
+bool hostSimQuiet();
+void hostSimSetQuiet(bool quiet);
+uint64_t hostSimAllocations();
+void* hostSimHeapAllocate(size_t bytes);
+void hostSimHeapRelease(void* memory);
+uint32_t hostSimHeapFree();
+uint32_t hostSimHeapMinFree();
+uint32_t hostSimHeapLargest();
+void hostSimFlashWrite(size_t bytes);
+void hostSimSerialWrite(size_t bytes);
+int hostSimBenchRouter(const char* path);
+
+#endif // End of conditional preprocessor code
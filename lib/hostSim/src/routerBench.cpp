@@ -0,0 +1,229 @@
+/******************************************************************************
+ * @file routerBench.cpp
+ *
+ * @brief Dispatch cost of the hashed TopicRouter against the String if/else
+ * chain that mqttIncomingCallback() used before it.
+ *
+ * @details Run with --bench-router FILE. Each run dispatches one command
+ * word over and over, with no handler work, in one of two ways:
+ * 1. chain : The old callback. The payload is copied into a String, split
+ *    at the comma with substring(), the command compared with each name in
+ *    turn and the value read with toInt().
+ * 2. table : The payload is used in place. routeField() finds the word,
+ *    TopicRouter::find() the route and routeNumber() reads the value.
+ *
+ * Both are measured with the 14 commands the firmware has and with extra
+ * commands added, placed before the axis names as new commands would be.
+ * The chain gets slower for commands further down it and as it grows, the
+ * table should not. Each run writes one JSON object per line:
+ *
+ *    bench, dispatch, command, commands, msgs, msgs_per_s, ns_per_msg,
+ *    allocs_per_msg, msg_ns_p50, msg_ns_p99, msg_ns_max
+ *
+ * Times are host CPU time and only mean something against another run on
+ * the same machine. tools/benchcompare.py compares two such files.
+ ******************************************************************************/
+#include <hostSim.h> // Allocation count.
+#include <Arduino.h> // Host stand-in for the Arduino core, String.
+#include <topicRouter.h> // The code under measurement.
+#include <latencyHistogram.h> // Per message time distribution.
+#include <chrono> // Host time.
+#include <stdio.h> // Output file.
+#include <vector> // Route list and chain names of each size.
+
+const uint32_t benchMessages = 200000; // Messages per pass.
+const uint8_t benchPasses = 5; // Passes per run, the fastest gives the rate.
+const uint8_t benchSizes[] = {14, 24, 32}; // Commands in the table or chain.
+const uint8_t benchFixed = 10; // Commands before the axis names.
+const char* const benchNames[] = {"forward", "backward", "stop", "jitter", "stats", "move", "where",
+   "record", "replay", "pos", "servo", "slew", "hoist", "luff"}; // Firmware order.
+const char* const benchPayloads[] = {"forward", "stats,reset", "hoist,-200", "crane,10"}; // Measured.
+
+TaskStat benchStat("bench"); // Routes need one.
+volatile int32_t benchSink = 0; // Keeps the work from being optimised away.
+
+/**
+ * @brief Host time in nano-seconds.
+ *
+ * @param NA No parameters.
+ *
+ * @return Nano-seconds from an arbitrary start.
+ */
+static uint64_t benchNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+} // benchNanos()
+
+/**
+ * @brief Handler that only keeps its input alive.
+ *
+ * @param arg Position in the route list.
+ * @param value Value text.
+ * @param length Characters in value.
+ *
+ * @return NA No return value.
+ */
+static void benchHandler(uint8_t arg, const char* value, uint16_t length)
+{
+   int32_t number = 0;
+   routeNumber(value, length, number);
+   benchSink += arg + number;
+} // benchHandler()
+
+/**
+ * @brief Command names of one size, extra ones before the axis names.
+ *
+ * @param size Number of commands.
+ * @param storage Holds the text of the extra names.
+ *
+ * @return Names in chain order.
+ */
+static std::vector<const char*> benchNameList(uint8_t size, std::vector<std::string>& storage)
+{
+   std::vector<const char*> names(benchNames, benchNames + benchFixed);
+   storage.clear();
+   storage.reserve(size);
+   for(uint8_t i = sizeof(benchNames) / sizeof(benchNames[0]); i < size; i++)
+   {
+      storage.push_back("extra" + std::to_string(i));
+      names.push_back(storage.back().c_str());
+   } // for
+   names.insert(names.end(), benchNames + benchFixed, benchNames + sizeof(benchNames) / sizeof(benchNames[0]));
+   return names;
+} // benchNameList()
+
+/**
+ * @brief One message through the old String chain.
+ *
+ * @param payload Message text.
+ * @param names Commands in chain order.
+ *
+ * @return NA No return value.
+ */
+static void benchChain(const char* payload, const std::vector<const char*>& names)
+{
+   String msg = payload;
+   int commaPosition = msg.indexOf(',');
+   String command = msg.substring(0, commaPosition);
+   String value = msg.substring(commaPosition + 1);
+   for(size_t i = 0; i < names.size(); i++)
+   {
+      if(command == names[i])
+      {
+         benchSink += i + value.toInt();
+         return;
+      } // if
+   } // for
+   benchSink -= 1; // Unknown command.
+} // benchChain()
+
+/**
+ * @brief One message through the table.
+ *
+ * @param payload Message text.
+ * @param length Characters in payload.
+ * @param router Router built from the names.
+ *
+ * @return NA No return value.
+ */
+static void benchTable(const char* payload, uint16_t length, TopicRouter& router)
+{
+   uint16_t wordLength = routeField(payload, length);
+   const topicRoute* route = router.find(payload, wordLength);
+   if(route == NULL)
+   {
+      benchSink -= 1; // Unknown command.
+      return;
+   } // if
+   uint16_t skip = min(wordLength + 1, (int)length);
+   route->handler(route->arg, payload + skip, length - skip);
+} // benchTable()
+
+/**
+ * @brief Measure one way of dispatching one command with one number of
+ * commands.
+ *
+ * @param out Where to write the result.
+ * @param table True for the router, False for the chain.
+ * @param payload Message text.
+ * @param names Commands in chain order.
+ * @param router Router built from the names.
+ *
+ * @return NA No return value.
+ */
+static void benchRun(FILE* out, bool table, const char* payload, const std::vector<const char*>& names,
+                     TopicRouter& router)
+{
+   uint16_t length = strlen(payload);
+   LatencyHistogram msgNs;
+   double seconds = 0;
+   uint64_t allocations = hostSimAllocations();
+   for(uint8_t pass = 0; pass < benchPasses; pass++)
+   {
+      uint64_t started = benchNanos();
+      for(uint32_t i = 0; i < benchMessages; i++)
+      {
+         uint64_t before = benchNanos();
+         if(table)
+         {
+            benchTable(payload, length, router);
+         } // if
+         else
+         {
+            benchChain(payload, names);
+         } // else
+         msgNs.record((uint32_t)min<uint64_t>(benchNanos() - before, UINT32_MAX));
+      } // for
+      double passSeconds = (benchNanos() - started) / 1e9;
+      seconds = (pass == 0) ? passSeconds : min(seconds, passSeconds); // Fastest pass, least disturbed.
+   } // for
+   allocations = (hostSimAllocations() - allocations) / benchPasses;
+   char command[16];
+   snprintf(command, sizeof(command), "%.*s", (int)routeField(payload, length), payload);
+   fprintf(out, "{\"bench\": \"router\", \"dispatch\": \"%s\", \"command\": \"%s\", \"commands\": %u, "
+           "\"msgs\": %u, \"msgs_per_s\": %.0f, \"ns_per_msg\": %.1f, \"allocs_per_msg\": %.2f, "
+           "\"msg_ns_p50\": %u, \"msg_ns_p99\": %u, \"msg_ns_max\": %u}\n",
+           table ? "table" : "chain", command, (unsigned)names.size(), benchMessages, benchMessages / seconds,
+           seconds * 1e9 / benchMessages, (double)allocations / benchMessages, msgNs.getPercentile(50),
+           msgNs.getPercentile(99), msgNs.getMax());
+} // benchRun()
+
+/**
+ * @brief Measure command dispatch instead of running the firmware.
+ *
+ * @param path File for the results, "-" for stdout.
+ *
+ * @return 0 on success, 1 if the file could not be written.
+ */
+int hostSimBenchRouter(const char* path)
+{
+   FILE* out = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+   if(out == NULL)
+   {
+      fprintf(stderr, "cannot write %s\n", path);
+      return 1;
+   } // if
+   for(uint8_t size : benchSizes)
+   {
+      std::vector<std::string> storage;
+      std::vector<const char*> names = benchNameList(size, storage);
+      std::vector<topicRoute> routes;
+      for(size_t i = 0; i < names.size(); i++)
+      {
+         routes.push_back({fnv1a(names[i]), names[i], &benchHandler, (uint8_t)i, &benchStat});
+      } // for
+      TopicRouter router;
+      router.begin(routes.data(), routes.size());
+      for(const char* payload : benchPayloads)
+      {
+         benchRun(out, false, payload, names, router);
+         benchRun(out, true, payload, names, router);
+      } // for
+   } // for
+   if(out != stdout)
+   {
+      fclose(out);
+   } // if
+   return 0;
+} // hostSimBenchRouter()
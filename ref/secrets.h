@@ -5,24 +5,31 @@
 #define secrets_h
 
 #include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <fnvHash.h> // Compile-time FNV-1a hash.
 
-// Define a structure with key value pair Strings.
+// Define a structure with key value pairs. The hash of the SSID is worked out
+// by the compiler so looking up a scanned network costs one hash of its name 
+// and an integer compare per entry.
 typedef struct apKeyAndValue_ 
 {
-   String ssid;
-   String pwd;
+   const char* ssid;
+   const char* pwd;
+   uint32_t ssidHash;
 } apKeyAndValue_t;
 
+// Build one table entry, hashing the SSID at compile time.
+#define AP_SECRET(ssid, pwd) {ssid, pwd, fnv1a(ssid)}
+
 // Declare an array of key values paris containg Access Point IDs and 
 // passwords. Change the values in this array to match your network. 
-apKeyAndValue_t apSecrets[] = 
+constexpr apKeyAndValue_t apSecrets[] = 
 {
-   {"SSID1", "PASSWORD1"},
-   {"SSID2", "PASSWORD2"},
-   {"SSID3", "PASSWORD3"},
-   {"SSID4", "PASSWORD4"},
-   {"SSID5", "PASSWORD5"},
-   {"SSID6", "PASSWORD6"}
+   AP_SECRET("SSID1", "PASSWORD1"),
+   AP_SECRET("SSID2", "PASSWORD2"),
+   AP_SECRET("SSID3", "PASSWORD3"),
+   AP_SECRET("SSID4", "PASSWORD4"),
+   AP_SECRET("SSID5", "PASSWORD5"),
+   AP_SECRET("SSID6", "PASSWORD6")
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,6 @@
 #include "MqttLogger.h" // For logging to serial and/or MQTT.
 #include "Arduino.h" // Arduino Core for ESP32. Comes with PlatformIO.
+#include "fnvHash.h" // Hash of each line to spot repeats.
 
 /**
  * @brief Construct a new Mqtt Logger:: Mqtt Logger object
@@ -42,6 +43,8 @@ MqttLogger::MqttLogger(PubSubClient& client, const char* topic, MqttLoggerMode m
  */
 MqttLogger::~MqttLogger()
 {
+    free(this->ring);
+    free(this->replayBuffer);
 } // MqttLogger::~MqttLogger()
 
 /**
@@ -153,33 +156,104 @@ boolean MqttLogger::setBufferSize(uint16_t size)
 /**
  * @brief Send & reset current buffer.
  * 
- * @param NA No parameters.
+ * @details The buffer and an optional span that did not fit in it go out as
+ * one message. A message that fits the PubSubClient packet is published in 
+ * one piece. A longer one is streamed with beginPublish()/endPublish(), the
+ * span straight from the caller's memory, so it is neither split nor 
+ * rejected by the client. While the broker is out of reach the line is kept
+ * in the spool, if there is one, as well as going to Serial as the mode says.
+ * 
+ * @param rest Bytes of the same line that follow the buffer, may be NULL.
+ * @param restLen Number of bytes in rest.
  * 
  * @return NA No return value.
  */
-void MqttLogger::sendBuffer() 
+void MqttLogger::sendBuffer(const uint8_t* rest, size_t restLen) 
 {
-    if (this->bufferCnt > 0)
+    size_t total = this->bufferCnt + restLen;
+    if (total > 0 && this->ring != NULL)
+    {
+        if (total > 0x7FFF)
+        {
+            this->droppedBytes += total; // Too long for a ring entry header.
+        } // if
+        else
+        {
+            this->enqueue(this->buffer, this->bufferCnt, false, rest, restLen);
+        } // else
+    } // if
+    else if (total > 0)
     {
         bool doSerial = this->mode==MqttLoggerMode::SerialOnly || this->mode==MqttLoggerMode::MqttAndSerial;
-        if (this->mode!=MqttLoggerMode::SerialOnly && this->client != NULL && this->client->connected()) 
+        if (this->online()) 
         {
-            this->client->publish(this->topic, (byte *)this->buffer, this->bufferCnt, retained);
+            size_t packet = MQTT_MAX_HEADER_SIZE + 2 + strlen(this->topic) + total;
+            if (this->queue == NULL && restLen == 0 && packet <= this->client->getBufferSize())
+            {
+                this->client->publish(this->topic, (byte *)this->buffer, this->bufferCnt, retained);
+            } // if
+            else if (this->beginPacket(total))
+            {
+                this->packet().write(this->buffer, this->bufferCnt);
+                if (restLen > 0)
+                {
+                    this->packet().write(rest, restLen);
+                } // if
+                this->endPacket();
+            } // else if
         } // if 
-        else if (this->mode == MqttLoggerMode::MqttAndSerialFallback)
+        else 
         {
-            doSerial = true;
-        } //  else if
+            if (this->spool != NULL && this->mode != MqttLoggerMode::SerialOnly)
+            {
+                this->spool->append(this->buffer, this->bufferCnt, false, rest, restLen);
+            } // if
+            if (this->mode == MqttLoggerMode::MqttAndSerialFallback)
+            {
+                doSerial = true;
+            } // if
+        } //  else
         if (doSerial) 
         {
             Serial.write(this->buffer, this->bufferCnt);
+            if (restLen > 0)
+            {
+                Serial.write(rest, restLen);
+            } // if
             Serial.println();
         } // if
-        this->bufferCnt=0;
-    } // if
+    } // else if
+    this->bufferCnt=0;
     this->bufferEnd=this->buffer;
 } // MqttLogger::sendBuffer()
 
+/**
+ * @brief A newline was printed. Send the line.
+ * 
+ * @details If the line was too long for the buffer its text has already 
+ * gone out in one message. All that can be left is the "\r" of println(), 
+ * which is dropped rather than sent on its own. With setCollapse() on, a 
+ * line that repeats the one before it is counted instead of sent.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::endLine()
+{
+    if (this->lineStreamed && (this->bufferCnt == 0 || (this->bufferCnt == 1 && this->buffer[0] == '\r')))
+    {
+        this->bufferCnt = 0;
+        this->bufferEnd = this->buffer;
+    } // if
+    if (this->collapse && !this->lineStreamed && this->repeatLine())
+    {
+        return;
+    } // if
+    this->sendBuffer();
+    this->lineStreamed = false;
+} // MqttLogger::endLine()
+
 /**
  * @brief implement Print::write(uint8_t c): store into a buffer until \n or 
  *        buffer full.
@@ -192,7 +266,7 @@ size_t MqttLogger::write(uint8_t character)
 {
     if (character == '\n') // when newline is printed we send the buffer
     {
-        this->sendBuffer();
+        this->endLine();
     } // if
     else
     {
@@ -209,4 +283,769 @@ size_t MqttLogger::write(uint8_t character)
         } //  else
     } // else
     return 1;
-} // MqttLogger::write()
\ No newline at end of file
+} // MqttLogger::write()
+
+/**
+ * @brief implement Print::write(const uint8_t*, size_t): copy whole spans 
+ *        into the buffer instead of one virtual call per character.
+ * 
+ * @details print() of a String or literal arrives here in one call. Each 
+ * span up to a newline is copied with memcpy(). A span that does not fit in
+ * what is left of the buffer is sent together with the buffer as one 
+ * message by sendBuffer() rather than split at the buffer boundary.
+ * 
+ * @param data Characters to log.
+ * @param size Number of characters.
+ * 
+ * @return size Always the number of characters passed in.
+ */
+size_t MqttLogger::write(const uint8_t* data, size_t size)
+{
+    const uint8_t* end = data + size;
+    while (data < end)
+    {
+        const uint8_t* newline = (const uint8_t*)memchr(data, '\n', end - data);
+        const uint8_t* spanEnd = (newline != NULL) ? newline : end;
+        size_t len = spanEnd - data;
+        if (this->bufferCnt + len <= this->bufferSize)
+        {
+            memcpy(this->bufferEnd, data, len);
+            this->bufferEnd += len;
+            this->bufferCnt += len;
+        } // if
+        else
+        {
+            this->sendBuffer(data, len);
+            this->lineStreamed = true;
+        } // else
+        if (newline != NULL)
+        {
+            this->endLine();
+            data = newline + 1;
+        } // if
+        else
+        {
+            data = end;
+        } // else
+    } // while
+    return size;
+} // MqttLogger::write()
+
+/**
+ * @brief Print a binary record to Serial as a '#' prefixed hex line.
+ * 
+ * @param data Record bytes.
+ * @param len Number of record bytes.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::printHex(const uint8_t* data, uint16_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    Serial.write('#');
+    for (uint16_t i = 0; i < len; i++)
+    {
+        Serial.write(digits[data[i] >> 4]);
+        Serial.write(digits[data[i] & 0x0F]);
+    } // for
+    Serial.println();
+} // MqttLogger::printHex()
+
+/**
+ * @brief Send one binary log record produced by the tokenized LOG macros.
+ * 
+ * @details Records bypass the newline handling of write() since they may 
+ * contain any byte value. In asynchronous mode they are queued in the ring
+ * and packed together by drain(). Otherwise each record is published on its
+ * own, or spooled while the broker is out of reach. Serial output is written
+ * as hex so it can be fed to the host decoder.
+ * 
+ * @param data Record bytes.
+ * @param len Number of record bytes.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::writeRecord(const uint8_t* data, uint16_t len)
+{
+    if (this->ring != NULL)
+    {
+        this->enqueue(data, len, true);
+        return;
+    } // if
+    bool doSerial = this->mode==MqttLoggerMode::SerialOnly || this->mode==MqttLoggerMode::MqttAndSerial;
+    if (this->online()) 
+    {
+        if (this->queue != NULL)
+        {
+            this->queue->publish(PUB_LOG, this->topic, data, len, this->retained);
+        } // if
+        else
+        {
+            this->client->publish(this->topic, data, len, this->retained);
+        } // else
+    } // if 
+    else 
+    {
+        if (this->spool != NULL && this->mode != MqttLoggerMode::SerialOnly)
+        {
+            this->spool->append(data, len, true);
+        } // if
+        if (this->mode == MqttLoggerMode::MqttAndSerialFallback)
+        {
+            doSerial = true;
+        } // if
+    } //  else
+    if (doSerial) 
+    {
+        this->printHex(data, len);
+    } // if
+} // MqttLogger::writeRecord()
+
+/**
+ * @brief Switch between synchronous and asynchronous (ring buffer) logging.
+ * 
+ * @details With a ring buffer in place a completed line is only copied into
+ * it by write(). No network or UART I/O happens until drain() is called, 
+ * which is normally done from a scheduled task. The size is rounded down to 
+ * a power of two. A size of 0 frees the ring and returns the logger to 
+ * synchronous operation. Lines still queued when the ring is changed are 
+ * discarded.
+ * 
+ * @param size Size of the ring buffer in bytes.
+ * 
+ * @return True if the requested mode is active.
+ */
+boolean MqttLogger::setAsync(uint16_t size)
+{
+    free(this->ring);
+    this->ring = NULL;
+    this->ringSize = 0;
+    this->ringMask = 0;
+    this->ringHead.store(0);
+    this->ringTail.store(0);
+    this->droppedBytes = 0;
+    this->highWaterMark = 0;
+    if (size == 0)
+    {
+        return true;
+    } // if
+    uint16_t powerOfTwo = 1;
+    while (powerOfTwo <= size / 2)
+    {
+        powerOfTwo *= 2;
+    } // while
+    this->ring = (uint8_t *)malloc(powerOfTwo);
+    if (this->ring == NULL)
+    {
+        return false;
+    } // if
+    this->ringSize = powerOfTwo;
+    this->ringMask = powerOfTwo - 1;
+    return true;
+} // MqttLogger::setAsync()
+
+/**
+ * @brief Copy bytes into the ring at a free-running position.
+ * 
+ * @param pos Free-running byte position to start writing at.
+ * @param data Bytes to copy.
+ * @param len Number of bytes to copy.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::ringPut(uint32_t pos, const uint8_t* data, uint16_t len)
+{
+    uint16_t index = pos & this->ringMask;
+    uint16_t first = min((uint16_t)(this->ringSize - index), len);
+    memcpy(this->ring + index, data, first);
+    memcpy(this->ring, data + first, len - first);
+} // MqttLogger::ringPut()
+
+/**
+ * @brief Copy bytes out of the ring from a free-running position.
+ * 
+ * @param pos Free-running byte position to start reading at.
+ * @param data Destination for the bytes.
+ * @param len Number of bytes to copy.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::ringGet(uint32_t pos, uint8_t* data, uint16_t len)
+{
+    uint16_t index = pos & this->ringMask;
+    uint16_t first = min((uint16_t)(this->ringSize - index), len);
+    memcpy(data, this->ring + index, first);
+    memcpy(data + first, this->ring, len - first);
+} // MqttLogger::ringGet()
+
+/**
+ * @brief Read the header of the ring entry at a position.
+ * 
+ * @param pos Free-running byte position of the entry.
+ * 
+ * @return Length of the entry body in the low 15 bits, bit 15 set when the 
+ *         entry is a binary record rather than a line of text.
+ */
+uint16_t MqttLogger::ringEntryHeader(uint32_t pos)
+{
+    uint8_t header[2];
+    this->ringGet(pos, header, sizeof(header));
+    return header[0] | (header[1] << 8);
+} // MqttLogger::ringEntryHeader()
+
+/**
+ * @brief Write the body of a ring entry to an output without copying it.
+ * 
+ * @param out Where to write the entry (the MQTT client or Serial).
+ * @param pos Free-running byte position of the entry body.
+ * @param len Length of the entry body.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::ringEmit(Print& out, uint32_t pos, uint16_t len)
+{
+    uint16_t index = pos & this->ringMask;
+    uint16_t first = min((uint16_t)(this->ringSize - index), len);
+    out.write(this->ring + index, first);
+    if (first < len)
+    {
+        out.write(this->ring, len - first);
+    } // if
+} // MqttLogger::ringEmit()
+
+/**
+ * @brief Write the body of a binary ring entry to an output as a hex line.
+ * 
+ * @param out Where to write the entry (normally Serial).
+ * @param pos Free-running byte position of the entry body.
+ * @param len Length of the entry body.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::ringEmitHex(Print& out, uint32_t pos, uint16_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    out.write('#');
+    for (uint16_t i = 0; i < len; i++)
+    {
+        uint8_t octet = this->ring[(pos + i) & this->ringMask];
+        out.write(digits[octet >> 4]);
+        out.write(digits[octet & 0x0F]);
+    } // for
+    out.println();
+} // MqttLogger::ringEmitHex()
+
+/**
+ * @brief Append one completed line to the ring. Producer side only.
+ * 
+ * @details Each entry is a two byte little endian header followed by the 
+ * line. The header holds the length, with bit 15 marking binary records. If
+ * the whole entry does not fit it is dropped and counted.
+ * 
+ * @param data The line or record to queue.
+ * @param len Length of the line or record.
+ * @param binary True for a tokenized log record, False for a line of text.
+ * @param rest More of the same line to append, may be NULL.
+ * @param restLen Number of bytes in rest.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::enqueue(const uint8_t* data, uint16_t len, bool binary, const uint8_t* rest, uint16_t restLen)
+{
+    uint32_t head = this->ringHead.load(std::memory_order_relaxed);
+    uint32_t tail = this->ringTail.load(std::memory_order_acquire);
+    uint32_t used = head - tail;
+    uint32_t total = (uint32_t)len + restLen;
+    if (total + 2 > this->ringSize - used)
+    {
+        this->droppedBytes += total;
+        return;
+    } // if
+    uint8_t header[2] = {(uint8_t)(total & 0xFF), (uint8_t)((total >> 8) | (binary ? 0x80 : 0))};
+    this->ringPut(head, header, sizeof(header));
+    this->ringPut(head + 2, data, len);
+    if (restLen > 0)
+    {
+        this->ringPut(head + 2 + len, rest, restLen);
+    } // if
+    this->ringHead.store(head + 2 + total, std::memory_order_release);
+    used += 2 + total;
+    if (used > this->highWaterMark)
+    {
+        this->highWaterMark = used;
+    } // if
+} // MqttLogger::enqueue()
+
+/**
+ * @brief True when lines can be published now.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return True if the mode publishes and the client is connected.
+ */
+boolean MqttLogger::online()
+{
+    return this->mode!=MqttLoggerMode::SerialOnly && this->client != NULL && this->client->connected();
+} // MqttLogger::online()
+
+/**
+ * @brief Send queued lines and replay spooled ones. Consumer side only.
+ * 
+ * @details Lines in the ring always go first. Only once the ring is empty is
+ * one batch of spooled lines replayed, so a backlog from an outage never 
+ * delays new lines. While offline the spool gets its staged page written out
+ * once it is old enough.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::drain()
+{
+    bool toMqtt = this->online();
+    if (this->ring != NULL)
+    {
+        this->drainRing(toMqtt);
+    } // if
+    if (this->spool == NULL)
+    {
+        return;
+    } // if
+    if (!toMqtt)
+    {
+        this->spool->flush(false);
+    } // if
+    else if (this->getQueuedBytes() == 0)
+    {
+        this->replay();
+    } // else if
+} // MqttLogger::drain()
+
+/**
+ * @brief Send queued lines from the ring.
+ * 
+ * @details As many whole lines as fit in one PubSubClient packet are joined 
+ * with newlines and published as a single message. Binary records are packed
+ * back to back since each one carries its own length. The message is streamed 
+ * straight out of the ring with beginPublish()/endPublish() so no staging 
+ * copy is needed. While the broker is unreachable the lines are moved to the
+ * spool if there is one. Without a spool, MqttOnly mode holds them in the 
+ * ring. The ring also holds them, echoing nothing to serial, when the message
+ * cannot be started so they are sent whole on a later pass.
+ * 
+ * @param toMqtt True if the broker can be reached.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::drainRing(bool toMqtt)
+{
+    uint32_t tail = this->ringTail.load(std::memory_order_relaxed);
+    uint32_t head = this->ringHead.load(std::memory_order_acquire);
+    if (tail == head)
+    {
+        return;
+    } // if
+    bool toSerial = this->mode==MqttLoggerMode::SerialOnly || this->mode==MqttLoggerMode::MqttAndSerial
+                    || (!toMqtt && this->mode==MqttLoggerMode::MqttAndSerialFallback);
+    bool toSpool = !toMqtt && this->spool != NULL && this->mode!=MqttLoggerMode::SerialOnly;
+    if (!toMqtt && !toSerial && !toSpool)
+    {
+        return;
+    } // if
+    uint32_t budget = this->bufferSize;
+    if (toMqtt)
+    {
+        uint32_t overhead = MQTT_MAX_HEADER_SIZE + 2 + strlen(this->topic);
+        uint32_t packetSize = this->client->getBufferSize();
+        budget = (packetSize > overhead) ? packetSize - overhead : 1;
+    } // if
+    if (toMqtt && this->queue != NULL)
+    {
+        uint16_t room = this->queue->getFree();
+        if (room < (this->ringEntryHeader(tail) & 0x7FFF) && this->queue->getDepth() > 0)
+        {
+            return; // Held in the ring until the publish queue has room.
+        } // if
+        budget = min(budget, (uint32_t)room);
+    } // if
+    uint32_t pos = tail, payload = 0;
+    while (pos != head)
+    {
+        uint16_t header = this->ringEntryHeader(pos);
+        uint16_t len = header & 0x7FFF;
+        uint32_t needed = (pos == tail || (header & 0x8000)) ? payload + len : payload + 1 + len;
+        if (pos != tail && needed > budget)
+        {
+            break;
+        } // if
+        payload = needed;
+        pos += 2 + len;
+    } // while
+    uint32_t end = pos;
+    if (toMqtt)
+    {
+        if (!this->beginPacket(payload))
+        {
+            return; // Held in the ring until the message can be started.
+        } // if
+        for (pos = tail; pos != end; )
+        {
+            uint16_t header = this->ringEntryHeader(pos);
+            uint16_t len = header & 0x7FFF;
+            if (pos != tail && !(header & 0x8000))
+            {
+                this->packet().write('\n');
+            } // if
+            this->ringEmit(this->packet(), pos + 2, len);
+            pos += 2 + len;
+        } // for
+        this->endPacket();
+    } // if
+    if (toSpool)
+    {
+        for (pos = tail; pos != end; )
+        {
+            uint16_t header = this->ringEntryHeader(pos);
+            this->spoolEntry(pos + 2, header);
+            pos += 2 + (header & 0x7FFF);
+        } // for
+    } // if
+    if (toSerial)
+    {
+        for (pos = tail; pos != end; )
+        {
+            uint16_t header = this->ringEntryHeader(pos);
+            uint16_t len = header & 0x7FFF;
+            if (header & 0x8000)
+            {
+                this->ringEmitHex(Serial, pos + 2, len);
+            } // if
+            else
+            {
+                this->ringEmit(Serial, pos + 2, len);
+                Serial.println();
+            } // else
+            pos += 2 + len;
+        } // for
+    } // if
+    this->ringTail.store(end, std::memory_order_release);
+} // MqttLogger::drainRing()
+
+
+/**
+ * @brief Copy one ring entry to the spool.
+ * 
+ * @details An entry that wraps past the end of the ring is handed over as two
+ * spans so it needs no staging copy.
+ * 
+ * @param pos Free-running byte position of the entry body.
+ * @param header Header of the entry.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::spoolEntry(uint32_t pos, uint16_t header)
+{
+    uint16_t len = header & 0x7FFF;
+    uint16_t index = pos & this->ringMask;
+    uint16_t first = min((uint16_t)(this->ringSize - index), len);
+    this->spool->append(this->ring + index, first, (header & 0x8000) != 0, this->ring, len - first);
+} // MqttLogger::spoolEntry()
+
+/**
+ * @brief Publish one batch of spooled lines, no faster than the replay rate.
+ * 
+ * @details Lines are joined the same way drain() joins ring entries, up to
+ * one PubSubClient packet. A token bucket filled at the replay rate paces 
+ * the batches. It holds at most one page so a long outage cannot bank a 
+ * burst. A spooled line longer than a packet goes out on its own, streamed.
+ * Lines only leave the spool once the message carrying them has started.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::replay()
+{
+    uint32_t now = millis();
+    uint32_t refill = (uint32_t)((uint64_t)(now - this->replayLast) * this->replayRate / 1000);
+    if (refill > 0)
+    {
+        this->replayTokens = min(this->replayTokens + refill, (uint32_t)logSpoolPage);
+        this->replayLast = now;
+    } // if
+    if (this->spool->getPending() == 0 || (this->queue != NULL && this->queue->getFree() < logSpoolPage))
+    {
+        return;
+    } // if
+    uint32_t overhead = MQTT_MAX_HEADER_SIZE + 2 + strlen(this->topic);
+    uint32_t packetSize = this->client->getBufferSize();
+    uint32_t budget = (packetSize > overhead) ? packetSize - overhead : 1;
+    budget = min(budget, this->replayTokens);
+    uint16_t payload = 0;
+    while (true)
+    {
+        uint16_t sep = (payload > 0) ? 1 : 0;
+        bool binary = false;
+        uint16_t len = this->spool->peek(this->replayBuffer + payload + sep, logSpoolPage - payload - sep, binary);
+        if (len == 0 || payload + sep + len > logSpoolPage)
+        {
+            break;
+        } // if
+        if (binary && sep > 0)
+        {
+            memmove(this->replayBuffer + payload, this->replayBuffer + payload + 1, len);
+            sep = 0;
+        } // if
+        uint32_t needed = payload + sep + len;
+        if (payload > 0 && needed > budget)
+        {
+            break;
+        } // if
+        if (payload == 0 && len > this->replayTokens)
+        {
+            return; // Wait for the bucket to fill.
+        } // if
+        if (sep > 0)
+        {
+            this->replayBuffer[payload] = '\n';
+        } // if
+        this->spool->take();
+        payload = needed;
+    } // while
+    if (payload == 0)
+    {
+        return;
+    } // if
+    if (!this->beginPacket(payload))
+    {
+        this->spool->rewind(); // Left in the spool for a later batch.
+        return;
+    } // if
+    this->packet().write(this->replayBuffer, payload);
+    this->endPacket();
+    this->spool->consume();
+    this->replayTokens -= min((uint32_t)payload, this->replayTokens);
+} // MqttLogger::replay()
+
+/**
+ * @brief Number of bytes currently waiting in the ring.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return Queued bytes including entry headers.
+ */
+uint16_t MqttLogger::getQueuedBytes()
+{
+    return this->ringHead.load() - this->ringTail.load();
+} // MqttLogger::getQueuedBytes()
+
+/**
+ * @brief Highest ring occupancy seen since the ring was allocated.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return High-water mark in bytes including entry headers.
+ */
+uint16_t MqttLogger::getHighWaterMark()
+{
+    return this->highWaterMark;
+} // MqttLogger::getHighWaterMark()
+
+/**
+ * @brief Number of log bytes discarded because the ring was full.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return Dropped bytes since the ring was allocated.
+ */
+uint32_t MqttLogger::getDroppedBytes()
+{
+    return this->droppedBytes;
+} // MqttLogger::getDroppedBytes()
+
+/**
+ * @brief Keep lines on flash while the broker is out of reach.
+ * 
+ * @details The spool must already have had begin() called. Lines that would
+ * have gone to MQTT are appended to it while offline and replayed by drain()
+ * after the connection is back, at no more than bytesPerSecond so the backlog
+ * does not crowd out new lines. Pass NULL to stop spooling.
+ * 
+ * @param spool Spool to use, may be NULL.
+ * @param bytesPerSecond Replay rate cap.
+ * 
+ * @return True if the spool is in use.
+ */
+boolean MqttLogger::setSpool(LogSpool* spool, uint32_t bytesPerSecond)
+{
+    this->spool = NULL;
+    if (spool == NULL)
+    {
+        return true;
+    } // if
+    if (this->replayBuffer == NULL)
+    {
+        this->replayBuffer = (uint8_t *)malloc(logSpoolPage);
+        if (this->replayBuffer == NULL)
+        {
+            return false;
+        } // if
+    } // if
+    this->spool = spool;
+    this->replayRate = bytesPerSecond;
+    this->replayTokens = 0;
+    this->replayLast = millis();
+    return true;
+} // MqttLogger::setSpool()
+
+/**
+ * @brief Collapse runs of identical lines into one line and a count.
+ * 
+ * @details The first line of a run is sent as usual. The repeats are only 
+ * counted, and "last message repeated N times" goes out just before the 
+ * next different line. Lines longer than the buffer and binary records are
+ * never collapsed.
+ * 
+ * @param collapse True to collapse repeats.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::setCollapse(bool collapse)
+{
+    this->collapse = collapse;
+    this->lastLineHash = 0;
+    this->flushRepeats();
+} // MqttLogger::setCollapse()
+
+/**
+ * @brief Number of lines collapsed into a repeat count since start up.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return Lines not sent.
+ */
+uint32_t MqttLogger::getCollapsed()
+{
+    return this->collapsedLines;
+} // MqttLogger::getCollapsed()
+
+/**
+ * @brief Check whether the line in the buffer repeats the last one sent.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return True if it was a repeat, counted and cleared from the buffer.
+ */
+bool MqttLogger::repeatLine()
+{
+    uint32_t hash = 2166136261u;
+    for (uint16_t i = 0; i < this->bufferCnt; i++)
+    {
+        hash = fnv1aByte(hash, this->buffer[i]);
+    } // for
+    if (this->bufferCnt > 0 && hash == this->lastLineHash)
+    {
+        this->repeats++;
+        this->collapsedLines++;
+        this->bufferCnt = 0;
+        this->bufferEnd = this->buffer;
+        return true;
+    } // if
+    this->lastLineHash = hash;
+    this->flushRepeats();
+    return false;
+} // MqttLogger::repeatLine()
+
+/**
+ * @brief Send the count of a run of repeats, if there is one.
+ * 
+ * @details The note goes out as a line of its own ahead of whatever is in 
+ * the buffer, which is left in place.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::flushRepeats()
+{
+    if (this->repeats == 0)
+    {
+        return;
+    } // if
+    char note[48];
+    int len = snprintf(note, sizeof(note), "last message repeated %lu times", (unsigned long)this->repeats);
+    this->repeats = 0;
+    uint16_t held = this->bufferCnt;
+    this->bufferCnt = 0;
+    this->sendBuffer((const uint8_t*)note, len);
+    this->bufferCnt = held;
+    this->bufferEnd = this->buffer + held;
+} // MqttLogger::flushRepeats()
+
+/**
+ * @brief Hand MQTT messages to a publish queue instead of the client.
+ * 
+ * @details Messages go in the log class, the least urgent, and are sent by
+ * whichever task drains the queue. While the queue is short of room the
+ * async ring and the spool replay hold their lines back rather than have
+ * the queue drop them. Pass NULL to publish directly again.
+ * 
+ * @param queue Queue to use, may be NULL.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::setQueue(PublishQueue* queue)
+{
+    this->queue = queue;
+} // MqttLogger::setQueue()
+
+/**
+ * @brief Start one MQTT message on the queue or the client.
+ * 
+ * @param length Payload bytes that will follow.
+ * 
+ * @return True if the payload can be written to packet().
+ */
+bool MqttLogger::beginPacket(size_t length)
+{
+    if (this->queue != NULL)
+    {
+        return this->queue->beginPublish(PUB_LOG, this->topic, length, this->retained);
+    } // if
+    return this->client->beginPublish(this->topic, length, this->retained);
+} // MqttLogger::beginPacket()
+
+/**
+ * @brief Where the payload of the message started by beginPacket() goes.
+ * 
+ * @param NA No parameters.
+ * 
+ * @return The queue or the client.
+ */
+Print& MqttLogger::packet()
+{
+    if (this->queue != NULL)
+    {
+        return *this->queue;
+    } // if
+    return *this->client;
+} // MqttLogger::packet()
+
+/**
+ * @brief Finish the message started by beginPacket().
+ * 
+ * @param NA No parameters.
+ * 
+ * @return NA No return value.
+ */
+void MqttLogger::endPacket()
+{
+    if (this->queue != NULL)
+    {
+        this->queue->endPublish();
+    } // if
+    else
+    {
+        this->client->endPublish();
+    } // else
+} // MqttLogger::endPacket()
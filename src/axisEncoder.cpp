@@ -0,0 +1,293 @@
+#include <axisEncoder.h> // Pulse counting position feedback for one axis.
+#include <gpioBank.h> // IRAM safe edge interrupt.
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/pcnt.h> // ESP32 pulse counter peripheral.
+#endif
+
+/**
+ * @brief Construct a new Axis Encoder object.
+ *
+ * @param pin Encoder input pin.
+ *
+ * @return NA No return value.
+ */
+AxisEncoder::AxisEncoder(int8_t pin)
+{
+   this->pin = pin;
+} // AxisEncoder::AxisEncoder()
+
+/**
+ * @brief Start counting, on a PCNT unit if one can be had.
+ *
+ * @details Pins 34 to 39 have no internal pull up, so the encoder must
+ * drive the line both ways or have its own pull up. Rising edges are
+ * counted. The PCNT glitch filter ignores pulses shorter than 1.25
+ * micro-seconds.
+ *
+ * @param unit PCNT unit to use, -1 to count with a GPIO interrupt.
+ *
+ * @return NA No return value.
+ */
+void AxisEncoder::begin(int8_t unit)
+{
+   pinMode(this->pin, INPUT);
+#if defined(ARDUINO_ARCH_ESP32)
+   if(unit >= 0)
+   {
+      pcnt_config_t config = {};
+      config.pulse_gpio_num = this->pin;
+      config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+      config.lctrl_mode = PCNT_MODE_KEEP;
+      config.hctrl_mode = PCNT_MODE_KEEP;
+      config.pos_mode = PCNT_COUNT_INC;
+      config.neg_mode = PCNT_COUNT_DIS;
+      config.counter_h_lim = encoderPcntLimit;
+      config.counter_l_lim = -encoderPcntLimit;
+      config.unit = (pcnt_unit_t)unit;
+      config.channel = PCNT_CHANNEL_0;
+      if(pcnt_unit_config(&config) == ESP_OK)
+      {
+         pcnt_set_filter_value(config.unit, encoderGlitchFilter);
+         pcnt_filter_enable(config.unit);
+         pcnt_counter_pause(config.unit);
+         pcnt_counter_clear(config.unit);
+         pcnt_counter_resume(config.unit);
+         this->unit = unit;
+         this->lastRaw = 0;
+         return;
+      } // if
+   } // if
+#endif
+   this->unit = -1;
+   this->lastRaw = this->isrPulses.load();
+   gpioAttachEdge(this->pin, true, AxisEncoder::countPulse, this);
+} // AxisEncoder::begin()
+
+/**
+ * @brief GPIO interrupt handler, one call per pulse.
+ *
+ * @param encoder The AxisEncoder the pin belongs to.
+ *
+ * @return NA No return value.
+ */
+void IRAM_ATTR AxisEncoder::countPulse(void* encoder)
+{
+   ((AxisEncoder*)encoder)->isrPulses.fetch_add(1, std::memory_order_relaxed);
+} // AxisEncoder::countPulse()
+
+/**
+ * @brief Pulses since the last call.
+ *
+ * @details The PCNT counter starts again at 0 when it reaches its limit, so
+ * the difference is taken modulo the limit. That is exact as long as fewer
+ * than 32767 pulses arrive between two calls, 1.6 MHz at a 20 ms tick.
+ *
+ * @param NA No parameters.
+ *
+ * @return Pulse count.
+ */
+uint32_t AxisEncoder::readPulses()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+   if(this->unit >= 0)
+   {
+      int16_t value = 0;
+      pcnt_get_counter_value((pcnt_unit_t)this->unit, &value);
+      uint32_t now = (uint16_t)value;
+      uint32_t pulses = (now + encoderPcntLimit - this->lastRaw) % encoderPcntLimit;
+      this->lastRaw = now;
+      return pulses;
+   } // if
+#endif
+   uint32_t now = this->isrPulses.load(std::memory_order_relaxed);
+   uint32_t pulses = now - this->lastRaw;
+   this->lastRaw = now;
+   return pulses;
+} // AxisEncoder::readPulses()
+
+/**
+ * @brief Ask for a move relative to where the axis is when it starts.
+ * Network side.
+ *
+ * @details A request not yet started by update() is replaced.
+ *
+ * @param counts Signed distance in encoder counts.
+ * @param duty Speed to move at, 1 to motorMaxDuty.
+ *
+ * @return True if the request was accepted.
+ */
+bool AxisEncoder::requestMove(int32_t counts, uint8_t duty)
+{
+   if(counts == 0 || counts > encoderMaxMove || counts < -encoderMaxMove || duty == 0)
+   {
+      return false;
+   } // if
+   this->request.store(((uint32_t)counts << 8) | duty, std::memory_order_release);
+   return true;
+} // AxisEncoder::requestMove()
+
+/**
+ * @brief Abandon the move under way and any that has not started. Control 
+ * side. The motor is left as it is.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void AxisEncoder::cancel()
+{
+   this->request.store(0, std::memory_order_relaxed);
+   this->moveDirection = 0;
+   this->settling = false;
+   this->moving = false;
+} // AxisEncoder::cancel()
+
+/**
+ * @brief Count the pulses since the last tick and run any move. Control
+ * side, called every tick before the motor ramps are updated.
+ *
+ * @param motor The motor of this axis.
+ * @param elapsedMs Milli-seconds since the last call.
+ * @param deceleration The motor's deceleration in duty per second.
+ *
+ * @return NA No return value.
+ */
+void AxisEncoder::update(MotorDriver& motor, uint32_t elapsedMs, uint16_t deceleration)
+{
+   uint32_t pulses = this->readPulses();
+   int16_t speed = motor.getSpeed();
+   if(speed != 0)
+   {
+      this->direction = (speed > 0) ? 1 : -1;
+   } // if
+   int32_t position = this->position.load(std::memory_order_relaxed) + this->direction * (int32_t)pulses;
+   this->position.store(position, std::memory_order_relaxed);
+   if(elapsedMs > 0)
+   {
+      this->rate = (this->rate * 3 + pulses * 1000 / elapsedMs) / 4;
+   } // if
+   uint32_t request = this->request.exchange(0, std::memory_order_acquire);
+   if(request != 0)
+   {
+      int32_t counts = (int32_t)request >> 8;
+      int16_t duty = request & 0xFF;
+      this->moveDirection = (counts > 0) ? 1 : -1;
+      this->settling = false;
+      this->target = position + counts;
+      this->moving = true;
+      motor.setSpeed(this->moveDirection * duty);
+   } // if
+   if(this->moveDirection != 0)
+   {
+      int32_t ahead = (this->target - position) * this->moveDirection;
+      uint32_t expectMs = this->stopMs;
+      if(expectMs == 0)
+      {
+         expectMs = elapsedMs + ((deceleration > 0) ? abs(speed) * 1000 / (2 * deceleration) : 0);
+      } // if
+      if(ahead <= (int32_t)(this->rate * expectMs / 1000))
+      {
+         motor.setSpeed(0);
+         this->moveDirection = 0;
+         this->settling = true;
+         this->brakePosition = position;
+         this->brakeRate = this->rate;
+      } // if
+   } // if
+   else if(this->settling && this->rate == 0 && speed == 0)
+   {
+      if(this->brakeRate > 0)
+      {
+         uint32_t measured = abs(position - this->brakePosition) * 1000 / this->brakeRate;
+         this->stopMs = (this->stopMs == 0) ? measured : (this->stopMs + measured) / 2;
+      } // if
+      this->lastError = position - this->target;
+      this->settling = false;
+      this->moving = false;
+      this->moves++;
+   } // else if
+} // AxisEncoder::update()
+
+/**
+ * @brief Signed counts since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Position in counts.
+ */
+int32_t AxisEncoder::getPosition()
+{
+   return this->position.load(std::memory_order_relaxed);
+} // AxisEncoder::getPosition()
+
+/**
+ * @brief Where the last move was to end.
+ *
+ * @param NA No parameters.
+ *
+ * @return Position in counts.
+ */
+int32_t AxisEncoder::getTarget()
+{
+   return this->target;
+} // AxisEncoder::getTarget()
+
+/**
+ * @brief Rest position minus target of the last finished move.
+ *
+ * @param NA No parameters.
+ *
+ * @return Error in counts, positive past the target in the forward direction.
+ */
+int32_t AxisEncoder::getLastError()
+{
+   return this->lastError;
+} // AxisEncoder::getLastError()
+
+/**
+ * @brief Pulse rate, smoothed over a few ticks.
+ *
+ * @param NA No parameters.
+ *
+ * @return Pulses per second.
+ */
+uint32_t AxisEncoder::getRate()
+{
+   return this->rate;
+} // AxisEncoder::getRate()
+
+/**
+ * @brief Moves finished since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t AxisEncoder::getMoves()
+{
+   return this->moves;
+} // AxisEncoder::getMoves()
+
+/**
+ * @brief Whether a move is under way or still settling.
+ *
+ * @param NA No parameters.
+ *
+ * @return True while moving.
+ */
+bool AxisEncoder::isMoving()
+{
+   return this->moving;
+} // AxisEncoder::isMoving()
+
+/**
+ * @brief Whether pulses are counted by a PCNT unit rather than an interrupt.
+ *
+ * @param NA No parameters.
+ *
+ * @return True for PCNT.
+ */
+bool AxisEncoder::usesPcnt()
+{
+   return this->unit >= 0;
+} // AxisEncoder::usesPcnt()
@@ -0,0 +1,228 @@
+#include <commandQueue.h> // Lock-free setpoint queue.
+
+/**
+ * @brief Stage one setpoint. It stays invisible to the consumer until 
+ * commit(). Producer side only.
+ *
+ * @param actuator Which actuator, see enum actuator.
+ * @param value Setpoint for that actuator.
+ *
+ * @return True if staged, False if the queue is full (counted as a drop).
+ */
+bool CommandQueue::stage(uint8_t actuator, int16_t value)
+{
+   uint32_t committed = this->head.load(std::memory_order_relaxed);
+   if((int32_t)(this->staged - committed) < 0)
+   {
+      this->staged = committed; // Nothing staged yet.
+   } // if
+   if(this->staged - this->tail.load(std::memory_order_acquire) >= commandQueueSize)
+   {
+      this->drops++;
+      return false;
+   } // if
+   motorCommand& slot = this->slots[this->staged & (commandQueueSize - 1)];
+   slot.actuator = actuator;
+   slot.value = value;
+   this->staged++;
+   return true;
+} // CommandQueue::stage()
+
+/**
+ * @brief Publish everything staged since the last commit in one step.
+ * Producer side only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandQueue::commit()
+{
+   uint32_t committed = this->head.load(std::memory_order_relaxed);
+   if((int32_t)(this->staged - committed) > 0)
+   {
+      for(uint32_t i = committed; this->recorder != NULL && i != this->staged; i++)
+      {
+         const motorCommand& slot = this->slots[i & (commandQueueSize - 1)];
+         this->recorder->add(REC_SETPOINT, slot.actuator, slot.value);
+      } // for
+      this->head.store(this->staged, std::memory_order_release);
+   } // if
+} // CommandQueue::commit()
+
+/**
+ * @brief Throw away everything staged since the last commit. Producer side
+ * only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandQueue::abandon()
+{
+   this->staged = this->head.load(std::memory_order_relaxed);
+} // CommandQueue::abandon()
+
+/**
+ * @brief Stage and commit a single setpoint. Producer side only.
+ *
+ * @param actuator Which actuator, see enum actuator.
+ * @param value Setpoint for that actuator.
+ *
+ * @return True if queued, False if the queue is full.
+ */
+bool CommandQueue::push(uint8_t actuator, int16_t value)
+{
+   bool queued = this->stage(actuator, value);
+   this->commit();
+   return queued;
+} // CommandQueue::push()
+
+/**
+ * @brief Ask the consumer to stop ahead of anything already queued. Needs
+ * no slot so it works even when the queue is full. Producer side only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandQueue::requestStop()
+{
+   this->stopMark.store(this->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+   this->stopPending.store(true, std::memory_order_release);
+   if(this->recorder != NULL)
+   {
+      this->recorder->add(REC_STOP, 0, 0);
+   } // if
+} // CommandQueue::requestStop()
+
+/**
+ * @brief Check for a pending stop. If there is one, discard the setpoints
+ * that were queued before it. Consumer side only.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if a stop was requested since the last call.
+ */
+bool CommandQueue::takeStop()
+{
+   if(!this->stopPending.exchange(false, std::memory_order_acquire))
+   {
+      return false;
+   } // if
+   uint32_t mark = this->stopMark.load(std::memory_order_relaxed);
+   uint32_t current = this->tail.load(std::memory_order_relaxed);
+   if((int32_t)(mark - current) > 0)
+   {
+      this->coalesced += mark - current;
+      this->tail.store(mark, std::memory_order_release);
+   } // if
+   this->stops++;
+   return true;
+} // CommandQueue::takeStop()
+
+/**
+ * @brief Take every committed setpoint, keeping only the newest for each
+ * actuator. Consumer side only.
+ *
+ * @details A stop requested since the last takeStop() is checked after
+ * head is read, so it is seen if any setpoint queued after it is. Only the
+ * setpoints queued before such a stop are taken. The rest wait until the
+ * next takeStop() has cut the motors, so the stop never zeroes a setpoint
+ * that was sent after it.
+ *
+ * @param latest Receives the newest setpoint of each actuator that changed.
+ *
+ * @return Bit mask of the actuators with a new setpoint in latest.
+ */
+uint8_t CommandQueue::collect(int16_t latest[ACT_COUNT])
+{
+   uint8_t changed = 0;
+   uint32_t current = this->tail.load(std::memory_order_relaxed);
+   uint32_t end = this->head.load(std::memory_order_acquire);
+   if(this->stopPending.load(std::memory_order_acquire))
+   {
+      uint32_t mark = this->stopMark.load(std::memory_order_relaxed);
+      if((int32_t)(end - mark) > 0 && (int32_t)(mark - current) >= 0)
+      {
+         end = mark;
+      } // if
+   } // if
+   while(current != end)
+   {
+      const motorCommand& slot = this->slots[current & (commandQueueSize - 1)];
+      if(slot.actuator < ACT_COUNT)
+      {
+         if(changed & (1 << slot.actuator))
+         {
+            this->coalesced++;
+         } // if
+         latest[slot.actuator] = slot.value;
+         changed |= 1 << slot.actuator;
+      } // if
+      current++;
+   } // while
+   this->tail.store(current, std::memory_order_release);
+   return changed;
+} // CommandQueue::collect()
+
+/**
+ * @brief Number of committed setpoints waiting for the consumer.
+ *
+ * @param NA No parameters.
+ *
+ * @return Queue depth.
+ */
+uint16_t CommandQueue::getDepth()
+{
+   return this->head.load() - this->tail.load();
+} // CommandQueue::getDepth()
+
+/**
+ * @brief Setpoints refused because the queue was full.
+ *
+ * @param NA No parameters.
+ *
+ * @return Drop count.
+ */
+uint32_t CommandQueue::getDrops()
+{
+   return this->drops;
+} // CommandQueue::getDrops()
+
+/**
+ * @brief Setpoints superseded by a newer one or flushed by a stop.
+ *
+ * @param NA No parameters.
+ *
+ * @return Coalesce count.
+ */
+uint32_t CommandQueue::getCoalesced()
+{
+   return this->coalesced;
+} // CommandQueue::getCoalesced()
+
+/**
+ * @brief Stops taken by the consumer.
+ *
+ * @param NA No parameters.
+ *
+ * @return Stop count.
+ */
+uint32_t CommandQueue::getStops()
+{
+   return this->stops;
+} // CommandQueue::getStops()
+
+/**
+ * @brief Hand every committed setpoint and stop to a recorder as well.
+ * Producer side only.
+ *
+ * @param recorder Recorder, NULL for none.
+ *
+ * @return NA No return value.
+ */
+void CommandQueue::setRecorder(CommandRecorder* recorder)
+{
+   this->recorder = recorder;
+} // CommandQueue::setRecorder()
@@ -0,0 +1,494 @@
+#include <commandRecorder.h> // Record and replay of dispatched commands.
+
+/**
+ * @brief Set aside the recording buffer.
+ *
+ * @param size Bytes for entries, 0 for no recorder.
+ *
+ * @return True if the buffer could be allocated.
+ */
+bool CommandRecorder::begin(uint16_t size)
+{
+   if(size == 0 || this->data != NULL)
+   {
+      return this->data != NULL;
+   } // if
+   this->data = (uint8_t*)malloc(size);
+   this->size = (this->data != NULL) ? size : 0;
+   return this->data != NULL;
+} // CommandRecorder::begin()
+
+/**
+ * @brief Throw away the current recording and start a new one. Network side
+ * only.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if recording, False if there is no buffer or a replay is
+ * running.
+ */
+bool CommandRecorder::startRecording()
+{
+   if(this->data == NULL || this->state.load(std::memory_order_acquire) != RECORDER_IDLE)
+   {
+      return false;
+   } // if
+   this->length = 0;
+   this->entries = 0;
+   this->duration = 0;
+   this->full = false;
+   this->recordStart = micros();
+   this->recordLast = 0;
+   this->state.store(RECORDER_RECORDING, std::memory_order_release);
+   return true;
+} // CommandRecorder::startRecording()
+
+/**
+ * @brief End the recording. The time since the last entry is kept as the
+ * pause at the end of each replay cycle. Network side only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandRecorder::stopRecording()
+{
+   if(this->state.load(std::memory_order_relaxed) != RECORDER_RECORDING)
+   {
+      return;
+   } // if
+   this->duration = max((uint32_t)(micros() - this->recordStart), max(this->recordLast, recordMinDuration));
+   this->state.store(RECORDER_IDLE, std::memory_order_release);
+} // CommandRecorder::stopRecording()
+
+/**
+ * @brief Append one dispatched command while recording. A command that does
+ * not fit ends the recording. Network side only.
+ *
+ * @param kind See enum recordKind.
+ * @param actuator See enum actuator, ignored for a stop.
+ * @param value Setpoint, or counts for a move.
+ * @param duty Duty of a move.
+ *
+ * @return NA No return value.
+ */
+void CommandRecorder::add(uint8_t kind, uint8_t actuator, int32_t value, uint8_t duty)
+{
+   if(this->state.load(std::memory_order_relaxed) != RECORDER_RECORDING)
+   {
+      return;
+   } // if
+   uint32_t time = micros() - this->recordStart;
+   if(this->length + recordMaxEntry > this->size)
+   {
+      this->full = true;
+      this->stopRecording();
+      return;
+   } // if
+   uint8_t* out = this->data + this->length;
+   uint8_t used = putVarint(out, time - this->recordLast);
+   out[used++] = (kind << 4) | (actuator & 0x0F);
+   if(kind != REC_STOP)
+   {
+      used += putVarint(out + used, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+   } // if
+   if(kind == REC_MOVE || kind == REC_SYNC)
+   {
+      out[used++] = duty;
+   } // if
+   this->length += used;
+   this->entries++;
+   this->recordLast = time;
+} // CommandRecorder::add()
+
+/**
+ * @brief Hand the recording to the motor task. Network side only.
+ *
+ * @param cycles Times to play it, 0 to repeat until stopped.
+ *
+ * @return True if a replay started, False if there is nothing to replay or
+ * the recorder is busy.
+ */
+bool CommandRecorder::startReplay(uint16_t cycles)
+{
+   if(this->entries == 0 || this->state.load(std::memory_order_acquire) != RECORDER_IDLE)
+   {
+      return false;
+   } // if
+   this->replayCycles = cycles;
+   this->replayStarted = false;
+   this->cancel.store(false, std::memory_order_relaxed);
+   this->state.store(RECORDER_REPLAYING, std::memory_order_release);
+   return true;
+} // CommandRecorder::startReplay()
+
+/**
+ * @brief Ask the motor task to end the replay on its next tick. Either side.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandRecorder::stopReplay()
+{
+   if(this->state.load(std::memory_order_acquire) == RECORDER_REPLAYING)
+   {
+      this->cancel.store(true, std::memory_order_release);
+   } // if
+} // CommandRecorder::stopReplay()
+
+/**
+ * @brief Take the next entry that is due. Motor task only, called until it
+ * returns False on every tick.
+ *
+ * @details The first call of a replay starts its clock. The recorder goes
+ * back to idle after the last cycle or once stopReplay() was called.
+ *
+ * @param nowMicros micros() at the start of this tick.
+ * @param command Receives the entry.
+ *
+ * @return True if command holds an entry to apply now.
+ */
+bool CommandRecorder::replayNext(uint32_t nowMicros, recordedCommand& command)
+{
+   if(this->state.load(std::memory_order_acquire) != RECORDER_REPLAYING)
+   {
+      return false;
+   } // if
+   if(this->cancel.exchange(false, std::memory_order_acquire))
+   {
+      this->finishReplay();
+      return false;
+   } // if
+   if(!this->replayStarted)
+   {
+      this->replayStarted = true;
+      this->replayStart = nowMicros;
+      this->replayPos = 0;
+      this->replayTime = 0;
+   } // if
+   uint32_t elapsed = nowMicros - this->replayStart;
+   if(this->replayPos >= this->length)
+   {
+      if(elapsed < this->duration)
+      {
+         return false; // Pause at the end of the cycle.
+      } // if
+      this->cycles++;
+      if(this->replayCycles == 1)
+      {
+         this->finishReplay();
+         return false;
+      } // if
+      if(this->replayCycles > 1)
+      {
+         this->replayCycles--;
+      } // if
+      this->replayStart += this->duration; // Keeps the cycles on the original grid.
+      this->replayPos = 0;
+      this->replayTime = 0;
+      elapsed = nowMicros - this->replayStart;
+   } // if
+   uint16_t pos = this->replayPos;
+   uint32_t delta = 0;
+   this->getVarint(pos, delta);
+   uint32_t time = this->replayTime + delta;
+   if(elapsed < time)
+   {
+      return false;
+   } // if
+   uint8_t type = this->data[pos++];
+   command.kind = type >> 4;
+   command.actuator = type & 0x0F;
+   command.value = 0;
+   command.duty = 0;
+   if(command.kind != REC_STOP)
+   {
+      uint32_t zigzag = 0;
+      this->getVarint(pos, zigzag);
+      command.value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+   } // if
+   if((command.kind == REC_MOVE || command.kind == REC_SYNC) && pos < this->length)
+   {
+      command.duty = this->data[pos++];
+   } // if
+   this->replayPos = pos;
+   this->replayTime = time;
+   this->lateness.record(elapsed - time);
+   return true;
+} // CommandRecorder::replayNext()
+
+/**
+ * @brief Write the recording to a file with its header. Network side only.
+ *
+ * @param fs Mounted file system.
+ * @param path File to write, replaced if it exists.
+ *
+ * @return True if the whole recording was written.
+ */
+bool CommandRecorder::save(fs::FS& fs, const char* path)
+{
+   if(this->state.load(std::memory_order_acquire) != RECORDER_IDLE || this->entries == 0)
+   {
+      return false;
+   } // if
+   fs::File file = fs.open(path, FILE_WRITE);
+   if(!file)
+   {
+      return false;
+   } // if
+   uint8_t head[recordHeaderSize];
+   this->header(head);
+   bool written = file.write(head, sizeof(head)) == sizeof(head)
+      && file.write(this->data, this->length) == this->length;
+   file.close();
+   return written;
+} // CommandRecorder::save()
+
+/**
+ * @brief Replace the recording with one from a file. Network side only.
+ *
+ * @param fs Mounted file system.
+ * @param path File written by save() or by tools/recording.py.
+ *
+ * @return True if the file held a recording that fits the buffer.
+ */
+bool CommandRecorder::load(fs::FS& fs, const char* path)
+{
+   if(this->data == NULL || this->state.load(std::memory_order_acquire) != RECORDER_IDLE
+      || !fs.exists(path))
+   {
+      return false;
+   } // if
+   fs::File file = fs.open(path, FILE_READ);
+   if(!file)
+   {
+      return false;
+   } // if
+   uint8_t head[recordHeaderSize];
+   bool valid = file.read(head, sizeof(head)) == sizeof(head)
+      && head[0] == 'C' && head[1] == 'R' && head[2] == recordVersion;
+   uint16_t bytes = valid ? head[10] | (head[11] << 8) : 0;
+   valid = valid && bytes <= this->size && file.read(this->data, bytes) == bytes;
+   file.close();
+   this->length = valid ? bytes : 0;
+   this->entries = valid ? head[8] | (head[9] << 8) : 0;
+   this->duration = valid ? head[4] | (head[5] << 8) | (head[6] << 16) | ((uint32_t)head[7] << 24) : 0;
+   this->full = false;
+   if(!valid || !this->check())
+   {
+      this->length = 0;
+      this->entries = 0;
+      return false;
+   } // if
+   return true;
+} // CommandRecorder::load()
+
+/**
+ * @brief Header that goes in front of the entries in a saved recording.
+ *
+ * @param out Receives recordHeaderSize bytes.
+ *
+ * @return NA No return value.
+ */
+void CommandRecorder::header(uint8_t out[recordHeaderSize])
+{
+   out[0] = 'C';
+   out[1] = 'R';
+   out[2] = recordVersion;
+   out[3] = 0;
+   for(uint8_t i = 0; i < 4; i++)
+   {
+      out[4 + i] = (this->duration >> (8 * i)) & 0xFF;
+   } // for
+   out[8] = this->entries & 0xFF;
+   out[9] = this->entries >> 8;
+   out[10] = this->length & 0xFF;
+   out[11] = this->length >> 8;
+} // CommandRecorder::header()
+
+/**
+ * @brief The encoded entries. Only stable while the recorder is idle.
+ *
+ * @param NA No parameters.
+ *
+ * @return Pointer to getLength() bytes.
+ */
+const uint8_t* CommandRecorder::getData()
+{
+   return this->data;
+} // CommandRecorder::getData()
+
+/**
+ * @brief Bytes of entries recorded.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint16_t CommandRecorder::getLength()
+{
+   return this->length;
+} // CommandRecorder::getLength()
+
+/**
+ * @brief Entries recorded.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint16_t CommandRecorder::getEntries()
+{
+   return this->entries;
+} // CommandRecorder::getEntries()
+
+/**
+ * @brief Length of one replay cycle.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds.
+ */
+uint32_t CommandRecorder::getDuration()
+{
+   return this->duration;
+} // CommandRecorder::getDuration()
+
+/**
+ * @brief What the recorder is doing.
+ *
+ * @param NA No parameters.
+ *
+ * @return See enum recorderState.
+ */
+uint8_t CommandRecorder::getState()
+{
+   return this->state.load(std::memory_order_acquire);
+} // CommandRecorder::getState()
+
+/**
+ * @brief Whether the last recording ended because the buffer filled up.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if commands after the end were not recorded.
+ */
+bool CommandRecorder::isFull()
+{
+   return this->full;
+} // CommandRecorder::isFull()
+
+/**
+ * @brief Replay cycles finished since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t CommandRecorder::getCycles()
+{
+   return this->cycles;
+} // CommandRecorder::getCycles()
+
+/**
+ * @brief How late each replayed entry was applied, written by the motor
+ * task.
+ *
+ * @param NA No parameters.
+ *
+ * @return Histogram in micro-seconds.
+ */
+LatencyHistogram& CommandRecorder::getLateness()
+{
+   return this->lateness;
+} // CommandRecorder::getLateness()
+
+/**
+ * @brief Encode a LEB128 varint.
+ *
+ * @param out Receives up to 5 bytes.
+ * @param value Value to encode.
+ *
+ * @return Bytes written.
+ */
+uint8_t CommandRecorder::putVarint(uint8_t* out, uint32_t value)
+{
+   uint8_t used = 0;
+   while(value >= 0x80)
+   {
+      out[used++] = (value & 0x7F) | 0x80;
+      value >>= 7;
+   } // while
+   out[used++] = value;
+   return used;
+} // CommandRecorder::putVarint()
+
+/**
+ * @brief Decode a LEB128 varint, never reading past the entries.
+ *
+ * @param pos Where to start, moved past the varint.
+ * @param value Receives the value.
+ *
+ * @return Bytes read, 0 if the entries ended first.
+ */
+uint8_t CommandRecorder::getVarint(uint16_t& pos, uint32_t& value)
+{
+   value = 0;
+   for(uint8_t used = 0; used < 5 && pos < this->length; used++)
+   {
+      uint8_t byte = this->data[pos++];
+      value |= (uint32_t)(byte & 0x7F) << (7 * used);
+      if((byte & 0x80) == 0)
+      {
+         return used + 1;
+      } // if
+   } // for
+   return 0;
+} // CommandRecorder::getVarint()
+
+/**
+ * @brief Walk a loaded recording to make sure every entry is whole and the
+ * header agrees with it.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if the recording can be replayed.
+ */
+bool CommandRecorder::check()
+{
+   uint16_t pos = 0;
+   uint16_t count = 0;
+   uint32_t time = 0;
+   while(pos < this->length)
+   {
+      uint32_t value = 0;
+      if(this->getVarint(pos, value) == 0 || pos >= this->length)
+      {
+         return false;
+      } // if
+      time += value;
+      uint8_t kind = this->data[pos++] >> 4;
+      if(kind > REC_SYNC || (kind != REC_STOP && this->getVarint(pos, value) == 0)
+         || ((kind == REC_MOVE || kind == REC_SYNC) && pos++ >= this->length))
+      {
+         return false;
+      } // if
+      count++;
+   } // while
+   this->duration = max(this->duration, max(time, recordMinDuration));
+   return count == this->entries;
+} // CommandRecorder::check()
+
+/**
+ * @brief Go back to idle at the end of a replay. Motor task only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void CommandRecorder::finishReplay()
+{
+   this->replayStarted = false;
+   this->state.store(RECORDER_IDLE, std::memory_order_release);
+} // CommandRecorder::finishReplay()
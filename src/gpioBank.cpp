@@ -0,0 +1,135 @@
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <gpioBank.h> // Multi-pin GPIO writes.
+
+#if defined(ARDUINO_ARCH_ESP32) // gpioUpdate() is inline in the header.
+#include <esp32/rom/gpio.h> // gpio_matrix_out(), in ROM so safe from an interrupt.
+#include <soc/gpio_sig_map.h> // SIG_GPIO_OUT_IDX.
+#include <driver/gpio.h> // GPIO interrupt service.
+
+/**
+ * @brief Drive pins low and route them back to their GPIO output register,
+ * away from any peripheral such as an LEDC channel.
+ *
+ * @details The pins are cleared first, in one write per bank, so a pin
+ * driven by its register is low before the matrix is changed and a pin
+ * driven by a peripheral goes low the moment it is detached. Runs from
+ * IRAM and only calls ROM code, so it works from an interrupt and while
+ * the flash cache is off.
+ *
+ * @param pins Pins to cut. They must already be outputs.
+ *
+ * @return NA No return value.
+ */
+void IRAM_ATTR gpioDetach(const gpioMask& pins)
+{
+   gpioUpdate(pins, gpioNone);
+   uint32_t bank0 = pins.bank0;
+   while(bank0 != 0)
+   {
+      uint8_t pin = __builtin_ctz(bank0);
+      gpio_matrix_out(pin, SIG_GPIO_OUT_IDX, false, false);
+      bank0 &= bank0 - 1;
+   } // while
+   uint32_t bank1 = pins.bank1;
+   while(bank1 != 0)
+   {
+      uint8_t pin = 32 + __builtin_ctz(bank1);
+      gpio_matrix_out(pin, SIG_GPIO_OUT_IDX, false, false);
+      bank1 &= bank1 - 1;
+   } // while
+} // gpioDetach()
+
+/**
+ * @brief Call a handler on one edge of an input.
+ *
+ * @details Arduino's attachInterrupt() installs the shared GPIO interrupt
+ * service without ESP_INTR_FLAG_IRAM, so its handlers wait while the flash
+ * cache is off. This installs the service with the flag instead. Whichever
+ * installs it first decides for every pin, so all GPIO interrupts in this
+ * firmware come through here, and every handler must be IRAM_ATTR and only
+ * touch DRAM.
+ *
+ * @param pin GPIO number.
+ * @param rising True for the rising edge, false for the falling edge.
+ * @param handler IRAM_ATTR function to call.
+ * @param arg Passed to the handler.
+ *
+ * @return NA No return value.
+ */
+void gpioAttachEdge(uint8_t pin, bool rising, void (*handler)(void*), void* arg)
+{
+   gpio_install_isr_service(ESP_INTR_FLAG_IRAM); // ESP_ERR_INVALID_STATE once installed.
+   gpio_set_intr_type((gpio_num_t)pin, rising ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE);
+   gpio_isr_handler_add((gpio_num_t)pin, handler, arg);
+   gpio_intr_enable((gpio_num_t)pin);
+} // gpioAttachEdge()
+
+#else // Recording fake for host builds.
+
+gpioMask gpioFakeLevels = {0, 0};
+gpioFakeWrite gpioFakeLog[gpioFakeLogSize];
+uint32_t gpioFakeWrites = 0;
+gpioMask gpioFakeDetached = {0, 0};
+
+/**
+ * @brief Host stand-in for the register writes. Applies the clear and set
+ * masks to gpioFakeLevels and records the write with a timestamp.
+ *
+ * @param clear Pins to drive low.
+ * @param set Pins to drive high.
+ *
+ * @return NA No return value.
+ */
+void gpioUpdate(const gpioMask& clear, const gpioMask& set)
+{
+   gpioFakeLevels.bank0 = (gpioFakeLevels.bank0 & ~clear.bank0) | set.bank0;
+   gpioFakeLevels.bank1 = (gpioFakeLevels.bank1 & ~clear.bank1) | set.bank1;
+   gpioFakeWrite& entry = gpioFakeLog[gpioFakeWrites % gpioFakeLogSize];
+   entry.micros = micros();
+   entry.clear = clear;
+   entry.set = set;
+   gpioFakeWrites++;
+} // gpioUpdate()
+
+/**
+ * @brief Host stand-in for detaching pins. Clears them like gpioUpdate()
+ * and marks them in gpioFakeDetached until a PWM channel attaches again.
+ *
+ * @param pins Pins to cut.
+ *
+ * @return NA No return value.
+ */
+void gpioDetach(const gpioMask& pins)
+{
+   gpioUpdate(pins, gpioNone);
+   gpioFakeDetached = gpioFakeDetached | pins;
+} // gpioDetach()
+
+/**
+ * @brief Host stand-in for reading the input register.
+ *
+ * @param pin GPIO number.
+ *
+ * @return True if digitalRead() says the pin is high.
+ */
+bool gpioRead(uint8_t pin)
+{
+   return digitalRead(pin) == HIGH;
+} // gpioRead()
+
+/**
+ * @brief Host stand-in for hooking an edge interrupt.
+ *
+ * @param pin GPIO number.
+ * @param rising True for the rising edge, false for the falling edge.
+ * @param handler Function to call.
+ * @param arg Passed to the handler.
+ *
+ * @return NA No return value.
+ */
+void gpioAttachEdge(uint8_t pin, bool rising, void (*handler)(void*), void* arg)
+{
+   attachInterruptArg(pin, handler, arg, rising ? RISING : FALLING);
+} // gpioAttachEdge()
+
+#endif
@@ -0,0 +1,147 @@
+#include <jsonPool.h> // Fixed size memory pool for ArduinoJson.
+
+const size_t jsonPoolAlign = 8; // Enough for any type ArduinoJson stores.
+const size_t jsonPoolHeader = jsonPoolAlign; // Block size, padded to alignment.
+
+/**
+ * @brief Construct a new JsonPool object.
+ *
+ * @param memory Static array to allocate from, 8 byte aligned.
+ * @param size Bytes in memory.
+ *
+ * @return NA No return value.
+ */
+JsonPool::JsonPool(uint8_t* memory, size_t size)
+{
+   this->memory = memory;
+   this->size = size;
+} // JsonPool::JsonPool()
+
+/**
+ * @brief Round a size up to the pool alignment.
+ *
+ * @param size Bytes requested.
+ *
+ * @return Bytes actually reserved.
+ */
+size_t JsonPool::roundUp(size_t size)
+{
+   return (size + jsonPoolAlign - 1) & ~(jsonPoolAlign - 1);
+} // JsonPool::roundUp()
+
+/**
+ * @brief Hand out a block from the pool.
+ *
+ * @param size Bytes wanted.
+ *
+ * @return The block, or NULL if the pool is full.
+ */
+void* JsonPool::allocate(size_t size)
+{
+   size_t needed = jsonPoolHeader + roundUp(size);
+   if(needed > this->size - this->used)
+   {
+      this->failures++;
+      return NULL;
+   } // if
+   uint8_t* block = this->memory + this->used;
+   *(size_t*)block = size;
+   this->last = this->used;
+   this->used += needed;
+   this->highWaterMark = max(this->highWaterMark, this->used);
+   return block + jsonPoolHeader;
+} // JsonPool::allocate()
+
+/**
+ * @brief Give a block back. Only the most recent block is actually 
+ * returned to the pool, everything else waits for reset().
+ *
+ * @param pointer Block from allocate() or reallocate().
+ *
+ * @return NA No return value.
+ */
+void JsonPool::deallocate(void* pointer)
+{
+   if(pointer != NULL && this->last != SIZE_MAX 
+      && (uint8_t*)pointer == this->memory + this->last + jsonPoolHeader)
+   {
+      this->used = this->last;
+      this->last = SIZE_MAX;
+   } // if
+} // JsonPool::deallocate()
+
+/**
+ * @brief Resize a block. The most recent block changes size in place, any
+ * other block is copied to a new one.
+ *
+ * @param pointer Block from allocate() or reallocate(), NULL to allocate.
+ * @param size New size in bytes.
+ *
+ * @return The resized block, or NULL if the pool is full.
+ */
+void* JsonPool::reallocate(void* pointer, size_t size)
+{
+   if(pointer == NULL)
+   {
+      return this->allocate(size);
+   } // if
+   uint8_t* header = (uint8_t*)pointer - jsonPoolHeader;
+   size_t oldSize = *(size_t*)header;
+   if(this->last != SIZE_MAX && header == this->memory + this->last)
+   {
+      size_t needed = jsonPoolHeader + roundUp(size);
+      if(needed > this->size - this->last)
+      {
+         this->failures++;
+         return NULL;
+      } // if
+      *(size_t*)header = size;
+      this->used = this->last + needed;
+      this->highWaterMark = max(this->highWaterMark, this->used);
+      return pointer;
+   } // if
+   void* moved = this->allocate(size);
+   if(moved != NULL)
+   {
+      memcpy(moved, pointer, min(oldSize, size));
+   } // if
+   return moved;
+} // JsonPool::reallocate()
+
+/**
+ * @brief Recycle the whole pool. The document using it must have been 
+ * cleared first.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void JsonPool::reset()
+{
+   this->used = 0;
+   this->last = SIZE_MAX;
+} // JsonPool::reset()
+
+/**
+ * @brief Most bytes the pool has ever had in use, for sizing JSON_POOL_SIZE.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+size_t JsonPool::getHighWaterMark()
+{
+   return this->highWaterMark;
+} // JsonPool::getHighWaterMark()
+
+/**
+ * @brief Allocations refused because the pool was full.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t JsonPool::getFailures()
+{
+   return this->failures;
+} // JsonPool::getFailures()
@@ -0,0 +1,146 @@
+#include <latencyHistogram.h> // Duration histogram.
+
+/**
+ * @brief Bucket for a value. Values below 4 get a bucket each, above that
+ * the top three significant bits select the bucket.
+ *
+ * @param value Value to place.
+ *
+ * @return Bucket index.
+ */
+uint8_t LatencyHistogram::bucketOf(uint32_t value)
+{
+   if(value < 4)
+   {
+      return value;
+   } // if
+   uint8_t msb = 31 - __builtin_clz(value);
+   return (msb - 1) * 4 + ((value >> (msb - 2)) & 3);
+} // LatencyHistogram::bucketOf()
+
+/**
+ * @brief Largest value that falls in a bucket.
+ *
+ * @param bucket Bucket index.
+ *
+ * @return Upper bound of the bucket.
+ */
+uint32_t LatencyHistogram::bucketTop(uint8_t bucket)
+{
+   if(bucket < 4)
+   {
+      return bucket;
+   } // if
+   uint8_t msb = bucket / 4 + 1;
+   uint32_t base = ((uint32_t)(4 + (bucket & 3))) << (msb - 2);
+   return base + ((uint32_t)1 << (msb - 2)) - 1;
+} // LatencyHistogram::bucketTop()
+
+/**
+ * @brief Add one value.
+ *
+ * @param value Duration to record.
+ *
+ * @return NA No return value.
+ */
+void LatencyHistogram::record(uint32_t value)
+{
+   this->buckets[bucketOf(value)]++;
+   this->count++;
+   this->sum += value;
+   if(value < this->minimum)
+   {
+      this->minimum = value;
+   } // if
+   if(value > this->maximum)
+   {
+      this->maximum = value;
+   } // if
+} // LatencyHistogram::record()
+
+/**
+ * @brief Forget everything recorded so far.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LatencyHistogram::reset()
+{
+   memset(this->buckets, 0, sizeof(this->buckets));
+   this->count = 0;
+   this->minimum = UINT32_MAX;
+   this->maximum = 0;
+   this->sum = 0;
+} // LatencyHistogram::reset()
+
+/**
+ * @brief Number of values recorded.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t LatencyHistogram::getCount()
+{
+   return this->count;
+} // LatencyHistogram::getCount()
+
+/**
+ * @brief Smallest value recorded, 0 if none.
+ *
+ * @param NA No parameters.
+ *
+ * @return Minimum.
+ */
+uint32_t LatencyHistogram::getMin()
+{
+   return (this->count == 0) ? 0 : this->minimum;
+} // LatencyHistogram::getMin()
+
+/**
+ * @brief Largest value recorded.
+ *
+ * @param NA No parameters.
+ *
+ * @return Maximum.
+ */
+uint32_t LatencyHistogram::getMax()
+{
+   return this->maximum;
+} // LatencyHistogram::getMax()
+
+/**
+ * @brief Mean of the values recorded, 0 if none.
+ *
+ * @param NA No parameters.
+ *
+ * @return Average.
+ */
+uint32_t LatencyHistogram::getAverage()
+{
+   return (this->count == 0) ? 0 : this->sum / this->count;
+} // LatencyHistogram::getAverage()
+
+/**
+ * @brief Value below which the given percentage of recordings fall. Never 
+ * reported above the true maximum.
+ *
+ * @param percent Percentile wanted, 1 to 100.
+ *
+ * @return Upper bound of the bucket holding that percentile.
+ */
+uint32_t LatencyHistogram::getPercentile(uint8_t percent)
+{
+   uint64_t wanted = ((uint64_t)this->count * percent + 99) / 100;
+   uint64_t seen = 0;
+   for(uint8_t bucket = 0; bucket < latencyBuckets; bucket++)
+   {
+      seen += this->buckets[bucket];
+      if(seen >= wanted && seen > 0)
+      {
+         return min(bucketTop(bucket), this->maximum);
+      } // if
+   } // for
+   return this->maximum;
+} // LatencyHistogram::getPercentile()
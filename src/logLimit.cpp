@@ -0,0 +1,106 @@
+#include <logLimit.h> // Per call site rate limit for the LOG macros.
+
+/**
+ * @brief Construct a new Log Limiter object.
+ *
+ * @param out Where to write the dropped line notes, NULL for no notes.
+ * @param burst Lines a call site may send back to back.
+ * @param period Milli-seconds for a call site to earn one more line.
+ *
+ * @return NA No return value.
+ */
+LogLimiter::LogLimiter(Print* out, uint8_t burst, uint32_t period)
+{
+   this->out = out;
+   this->burst = burst;
+   this->period = period;
+} // LogLimiter::LogLimiter()
+
+/**
+ * @brief A call site starts a line. Decide whether it is sent.
+ *
+ * @details A dropped line that begins part way through a line that was sent
+ * ends that line first, so the text that follows does not run into it.
+ *
+ * @param site Bucket of the call site.
+ * @param function Function the call site is in, for the note.
+ *
+ * @return True if the line is sent.
+ */
+bool LogLimiter::start(LogSite& site, const char* function)
+{
+   uint32_t now = millis();
+   uint32_t earned = (this->period > 0) ? (now - site.refilled) / this->period : this->burst;
+   if(earned > 0)
+   {
+      site.spent -= min((uint32_t)site.spent, earned);
+      site.refilled = (site.spent == 0) ? now : site.refilled + earned * this->period;
+   } // if
+   if(site.spent >= this->burst)
+   {
+      site.dropped++;
+      this->dropped++;
+      if(this->started && this->out != NULL)
+      {
+         this->out->println();
+      } // if
+      this->open = false;
+      this->started = false;
+      return false;
+   } // if
+   site.spent++;
+   if(site.dropped > 0 && this->out != NULL)
+   {
+      if(this->started)
+      {
+         this->out->println();
+      } // if
+      this->out->print('<');
+      this->out->print(function);
+      this->out->print("> ");
+      this->out->print(site.dropped);
+      this->out->println(" lines from here were dropped by the rate limit.");
+   } // if
+   site.dropped = 0;
+   this->open = true;
+   this->started = true;
+   return true;
+} // LogLimiter::start()
+
+/**
+ * @brief More text for the current line. Decide whether it is sent.
+ *
+ * @param NA No parameters.
+ *
+ * @return True unless the line was dropped by start().
+ */
+bool LogLimiter::pass()
+{
+   this->started = this->started || this->open;
+   return this->open;
+} // LogLimiter::pass()
+
+/**
+ * @brief The current line is finished.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LogLimiter::endLine()
+{
+   this->open = true;
+   this->started = false;
+} // LogLimiter::endLine()
+
+/**
+ * @brief Lines dropped at every call site since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t LogLimiter::getDropped()
+{
+   return this->dropped;
+} // LogLimiter::getDropped()
@@ -0,0 +1,379 @@
+#include <logSpool.h> // Flash backed store for log lines written while offline.
+
+/**
+ * @brief Construct a new Log Spool object.
+ *
+ * @param fs File system to keep the segments on.
+ * @param dir Directory for the segments, created by begin() if missing.
+ * @param capacity Most bytes kept on flash.
+ * @param segmentSize A new segment file is started past this size.
+ *
+ * @return NA No return value.
+ */
+LogSpool::LogSpool(fs::FS& fs, const char* dir, uint32_t capacity, uint32_t segmentSize) : fs(fs)
+{
+   this->dir = dir;
+   this->capacity = capacity;
+   this->segmentSize = segmentSize;
+} // LogSpool::LogSpool()
+
+/**
+ * @brief Find the segments left from before a restart so they are replayed.
+ *
+ * @details The file system must already be mounted. New lines always start
+ * a new segment so nothing is appended to a segment that may be part read.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if the spool directory can be used.
+ */
+bool LogSpool::begin()
+{
+   if(!this->fs.exists(this->dir) && !this->fs.mkdir(this->dir))
+   {
+      return false;
+   } // if
+   fs::File root = this->fs.open(this->dir);
+   if(!root || !root.isDirectory())
+   {
+      return false;
+   } // if
+   bool found = false;
+   uint32_t first = 0, last = 0;
+   for(fs::File file = root.openNextFile(); file; file = root.openNextFile())
+   {
+      const char* name = strrchr(file.name(), '/');
+      name = (name != NULL) ? name + 1 : file.name();
+      char* end;
+      uint32_t segment = strtoul(name, &end, 16);
+      if(end == name || *end != '\0')
+      {
+         continue; // Not a segment.
+      } // if
+      first = found ? min(first, segment) : segment;
+      last = found ? max(last, segment) : segment;
+      found = true;
+      this->flashBytes += file.size();
+   } // for
+   root.close();
+   this->readSegment = first;
+   this->writeSegment = found ? last + 1 : 0;
+   this->writeSegmentBytes = 0;
+   this->unreadBytes = this->flashBytes;
+   this->ready = true;
+   return true;
+} // LogSpool::begin()
+
+/**
+ * @brief Stage one entry for flash. A full page is written out first.
+ *
+ * @param data Entry bytes.
+ * @param len Number of bytes in data.
+ * @param binary True for a tokenized log record, False for a line of text.
+ * @param rest More of the same entry to append, may be NULL.
+ * @param restLen Number of bytes in rest.
+ *
+ * @return True if the entry was kept, False if it was too long to spool.
+ */
+bool LogSpool::append(const uint8_t* data, uint16_t len, bool binary, const uint8_t* rest, uint16_t restLen)
+{
+   uint32_t total = (uint32_t)len + restLen;
+   if(!this->ready || total == 0 || total + 2 > logSpoolPage)
+   {
+      this->droppedBytes += total;
+      return false;
+   } // if
+   if(this->pageUsed + 2 + total > logSpoolPage)
+   {
+      this->flush(true);
+   } // if
+   if(this->pageUsed == 0)
+   {
+      this->pageSince = millis();
+   } // if
+   this->page[this->pageUsed++] = total & 0xFF;
+   this->page[this->pageUsed++] = (total >> 8) | (binary ? 0x80 : 0);
+   memcpy(this->page + this->pageUsed, data, len);
+   this->pageUsed += len;
+   if(restLen > 0)
+   {
+      memcpy(this->page + this->pageUsed, rest, restLen);
+      this->pageUsed += restLen;
+   } // if
+   return true;
+} // LogSpool::append()
+
+/**
+ * @brief Write the staged page to the newest segment.
+ *
+ * @details Without force the page is only written once its oldest entry has
+ * waited logSpoolFlushAge, which bounds what a reset can lose without a
+ * flash write for every line. Rotates to a new segment and deletes the
+ * oldest ones as the limits are passed.
+ *
+ * @param force True to write whatever is staged now.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::flush(bool force)
+{
+   if(this->pageUsed == 0 || (!force && millis() - this->pageSince < logSpoolFlushAge))
+   {
+      return;
+   } // if
+   char path[32];
+   this->segmentPath(this->writeSegment, path, sizeof(path));
+   fs::File file = this->fs.open(path, FILE_APPEND);
+   if(!file)
+   {
+      this->droppedBytes += this->pageUsed;
+      this->pageUsed = 0;
+      return;
+   } // if
+   size_t written = file.write(this->page, this->pageUsed);
+   file.close();
+   this->flushes++;
+   this->bytesWritten += written;
+   this->flashBytes += written;
+   this->unreadBytes += written;
+   this->writeSegmentBytes += written;
+   this->droppedBytes += this->pageUsed - written; // Flash full.
+   this->pageUsed = 0;
+   if(this->writeSegmentBytes >= this->segmentSize)
+   {
+      this->writeSegment++;
+      this->writeSegmentBytes = 0;
+   } // if
+   while(this->flashBytes > this->capacity && this->readSegment < this->writeSegment)
+   {
+      this->deleteOldest();
+   } // while
+} // LogSpool::flush()
+
+/**
+ * @brief Read the oldest entry not yet passed with take(), without removing
+ * it.
+ *
+ * @details Segments consumed to the end are deleted on the way. Taken 
+ * entries are never read past the end of their segment. A truncated
+ * entry at the end of a segment, left by a full flash, ends that segment.
+ * Entries are never longer than logSpoolPage - 2 so a buffer of
+ * logSpoolPage bytes always has room.
+ *
+ * @param out Where to put the entry.
+ * @param size Size of out. A longer entry is not copied.
+ * @param binary Set True for a tokenized log record.
+ *
+ * @return Length of the entry, 0 if the spool is empty.
+ */
+uint16_t LogSpool::peek(uint8_t* out, uint16_t size, bool& binary)
+{
+   while(this->ready && this->getPending() > 0)
+   {
+      if(!this->openReader())
+      {
+         return 0;
+      } // if
+      uint8_t header[2];
+      this->reader.seek(this->takePos);
+      uint16_t len = 0;
+      bool whole = this->reader.read(header, sizeof(header)) == sizeof(header);
+      if(whole)
+      {
+         len = (header[0] | (header[1] << 8)) & logSpoolMaxEntry;
+         whole = this->takePos + 2 + len <= this->reader.size();
+      } // if
+      if(!whole && this->takePos != this->readPos)
+      {
+         return 0; // Taken entries end the segment, it goes once they are consumed.
+      } // if
+      if(!whole)
+      {
+         this->deleteOldest(); // End of this segment.
+         continue;
+      } // if
+      this->peekLength = len;
+      if(len > size)
+      {
+         return len; // Left for a call with more room.
+      } // if
+      this->reader.read(out, len);
+      binary = (header[1] & 0x80) != 0;
+      return len;
+   } // while
+   return 0;
+} // LogSpool::peek()
+
+/**
+ * @brief Move past the entry peek() returned so the next peek() reads the one
+ * after it. The entry stays in the spool until consume().
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::take()
+{
+   this->takePos += 2 + this->peekLength;
+   this->peekLength = 0;
+} // LogSpool::take()
+
+/**
+ * @brief Remove every entry passed with take().
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::consume()
+{
+   uint32_t taken = this->takePos - this->readPos;
+   this->readPos = this->takePos;
+   this->unreadBytes -= min(taken, this->unreadBytes);
+   this->peekLength = 0;
+} // LogSpool::consume()
+
+/**
+ * @brief Put back every entry passed with take(), so the next peek() reads
+ * the oldest entry again.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::rewind()
+{
+   this->takePos = this->readPos;
+   this->peekLength = 0;
+} // LogSpool::rewind()
+
+/**
+ * @brief Bytes waiting to be replayed, on flash and staged.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes including entry headers.
+ */
+uint32_t LogSpool::getPending()
+{
+   return this->unreadBytes + this->pageUsed;
+} // LogSpool::getPending()
+
+/**
+ * @brief Bytes written to flash since start up, the measure of wear.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint32_t LogSpool::getBytesWritten()
+{
+   return this->bytesWritten;
+} // LogSpool::getBytesWritten()
+
+/**
+ * @brief Flash writes since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t LogSpool::getFlushes()
+{
+   return this->flushes;
+} // LogSpool::getFlushes()
+
+/**
+ * @brief Bytes lost to the capacity limit, a full flash or over long entries.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes.
+ */
+uint32_t LogSpool::getDroppedBytes()
+{
+   return this->droppedBytes;
+} // LogSpool::getDroppedBytes()
+
+/**
+ * @brief File name of a segment.
+ *
+ * @param segment Segment number.
+ * @param path Where to put the name.
+ * @param size Size of path.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::segmentPath(uint32_t segment, char* path, size_t size)
+{
+   snprintf(path, size, "%s/%08lx", this->dir, (unsigned long)segment);
+} // LogSpool::segmentPath()
+
+/**
+ * @brief Delete the oldest segment. What was not read from it is dropped.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void LogSpool::deleteOldest()
+{
+   char path[32];
+   this->segmentPath(this->readSegment, path, sizeof(path));
+   if(this->reader)
+   {
+      this->reader.close();
+   } // if
+   fs::File file = this->fs.open(path, FILE_READ);
+   uint32_t size = file ? file.size() : 0;
+   file.close();
+   this->fs.remove(path);
+   uint32_t unread = (size > this->readPos) ? size - this->readPos : 0;
+   this->flashBytes -= min(size, this->flashBytes);
+   this->unreadBytes -= min(unread, this->unreadBytes);
+   this->droppedBytes += unread;
+   this->readSegment++;
+   this->readPos = 0;
+   this->takePos = 0;
+   this->peekLength = 0;
+} // LogSpool::deleteOldest()
+
+/**
+ * @brief Open the oldest segment for replay.
+ *
+ * @details Replay never reads the segment that appends go to. If that is
+ * the only one it is written out and closed off, and the next append starts
+ * a new segment.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if there is a segment to read.
+ */
+bool LogSpool::openReader()
+{
+   if(this->reader)
+   {
+      return true;
+   } // if
+   if(this->readSegment == this->writeSegment)
+   {
+      this->flush(true);
+      if(this->writeSegmentBytes == 0)
+      {
+         return false; // Nothing on flash.
+      } // if
+      this->writeSegment++;
+      this->writeSegmentBytes = 0;
+   } // if
+   char path[32];
+   this->segmentPath(this->readSegment, path, sizeof(path));
+   this->reader = this->fs.open(path, FILE_READ);
+   if(!this->reader)
+   {
+      this->readSegment++; // Missing, carry on with the next one.
+      this->readPos = 0;
+      this->takePos = 0;
+      return false;
+   } // if
+   return true;
+} // LogSpool::openReader()
@@ -19,14 +19,13 @@
  * 
  * @section libraries Libraries
  * 1. PubSubClient by Nick O'Leary (knolleary/PubSubClient@^2.8) for MQTT support.
- * 2. ArduinoJson by Benoit Blanchon (bblanchon/ArduinoJson@^7.2.1) for JSON support.
+ * 2. ArduinoJson by Benoit Blanchon (bblanchon/ArduinoJson@^7.2.1) for JSON command batches.
  * 3. TaskScheduler by Richard Lowe (arkhipenko/TaskScheduler@^3.3.0) for task scheduling.
  * 
  * @section notes Notes
  * - 
  * 
  * @section todo TODO
- * - Add JSON support.
  * - Get OTA working. Code is in but have not got  it working yet
  * - Add unit tests.
  *  
@@ -45,35 +44,95 @@
 #include <WiFi.h> // For WiFi connection (use for ESP32/ESP8266).
 #include <PubSubClient.h> // For MQTT handling.
 #include <MqttLogger.h> // For logging to serial and/or MQTT.
+#include <logToken.h> // Compile-time tokens for LOG_TOKENIZED builds.
+#include <logLimit.h> // Per call site rate limit for the LOG macros.
 #include <apSecrets.h> // Known Access Point SSID and password pairs.
 #include <TaskScheduler.h> // Manage scheduding task executin out of loop().
+#include <Preferences.h> // NVS storage for the last good Access Point.
 //#include <ArduinoOTA.h> // For OTA update support. Comes with PlatformIO. 
 #include <huzzah32GpioPins.h> // Pin names for Adafruit Huzzah32 dev board.
 #include <projectPinout.h> // Map application pins development board pins. 
 #include <ESP32Servo.h> // Servo control library.
+#include <motorDriver.h> // PWM speed control with acceleration ramps.
+#include <axisEncoder.h> // Pulse counting position feedback.
+#include <motionPlanner.h> // Coordinated moves of every axis.
+#include <safetyStop.h> // E-stop input and command deadman.
+#include <commandQueue.h> // Setpoints from the MQTT callback to the motor task.
+#include <commandRecorder.h> // Record and replay of dispatched commands.
+#include <latencyHistogram.h> // Control loop period statistics.
+#include <taskStats.h> // Timing of scheduler tasks and command handlers.
+#include <telemetry.h> // Binary state frames.
+#include <jsonPool.h> // Heap free memory for ArduinoJson.
+#include <LittleFS.h> // Flash file system for the log spool.
+#include <logSpool.h> // Log lines kept on flash while offline.
+#include <publishQueue.h> // Outbound MQTT messages in priority classes.
+#include <topicRouter.h> // Hashed routing of topics and commands.
+#include <udpControl.h> // Commands in UDP datagrams.
+#include <atomic> // Lock-free flags shared between cores.
+#if defined(ARDUINO_ARCH_ESP32)
+#include <lwip/sockets.h> // select() on the broker socket.
+#endif
 
 // Define global objects.
 WiFiClient espClient; // WiFi client object.
 PubSubClient client(espClient); // MQTT client.
+PublishQueue publishQueue(client); // Everything the firmware publishes, sent by t7.
 Scheduler runner; // Task scheduler.
 Servo servoMotor; // Servo motor object.
+MotorDriver slewMotor("slew", BRIDGE_L298N, inA1, inA2, enA1); // Motor A.
+MotorDriver hoistMotor("hoist", BRIDGE_DRV8871, inB1, inB2); // Motor B.
+MotorDriver luffMotor("luff", BRIDGE_DRV8871, inC1, inC2); // Motor C.
+MotorDriver* motors[] = {&slewMotor, &hoistMotor, &luffMotor}; // In actuator order.
+AxisEncoder slewEncoder(encA); // Motor A pulses.
+AxisEncoder hoistEncoder(encB); // Motor B pulses.
+AxisEncoder luffEncoder(encC); // Motor C pulses.
+AxisEncoder* encoders[] = {&slewEncoder, &hoistEncoder, &luffEncoder}; // In actuator order.
+MotionPlanner motionPlanner; // Coordinated moves, run by the motor task.
+SafetyStop safetyStop; // Cuts the bridges from interrupts.
+UdpControl udpControl; // Commands straight from the operator, dispatched by t9.
+CommandQueue commandQueue; // MQTT callback to motor task.
+CommandRecorder commandRecorder; // Dispatched commands for replay by the motor task.
+Telemetry telemetry; // Decides when to send a state frame.
+alignas(8) uint8_t jsonMemory[JSON_POOL_SIZE]; // Backing store for jsonPool.
+JsonPool jsonPool(jsonMemory, sizeof(jsonMemory)); // Static allocator for jsonBatch.
+JsonDocument jsonBatch(&jsonPool); // Parsed JSON command batch.
+Preferences apCache; // Last Access Point we got an IP address from.
 
 // Structure for storing Wifi Access Point information.
 struct accessPoint 
 {
    int32_t rssi;
-   String ssid;
+   char ssid[33]; // Up to 32 characters and the terminator.
    int32_t channel;
    wifi_auth_mode_t encryptionType;
-   String password;
+   const char* password; // Points into apSecrets.
    bool status;
+   uint8_t bssid[6];
 }; // accessPoint
-accessPoint ap =  {0,"",0,WIFI_AUTH_OPEN,"",false};
+accessPoint ap =  {0,"",0,WIFI_AUTH_OPEN,NULL,false,{0}};
+
+// States of the WiFi and MQTT connection manager.
+enum netState 
+{
+   NET_FAST_CONNECT,
+   NET_SCAN_START,
+   NET_SCANNING,
+   NET_ASSOCIATING,
+   NET_DHCP,
+   NET_BROKER_CONNECT,
+   NET_SUBSCRIBE,
+   NET_ONLINE,
+   NET_BACKOFF
+}; // netState
 
 // Define global variables.
-String clientID = ""; // Unique client ID.
-String mqttResponseTopic = ""; // Topic to publish responses to.
-String mqttCommandTopic = ""; // Topic to subscribe to for commands.
+char clientID[32] = ""; // Unique client ID, set once by getUniqueID().
+char mqttResponseTopic[64] = ""; // Topic to publish responses to.
+char mqttCommandTopic[64] = ""; // Topic to subscribe to for commands.
+char mqttTelemetryTopic[64] = ""; // Topic to publish state frames to.
+char mqttStatusTopic[64] = ""; // Retained online/offline, also the last will.
+char mqttSetTopic[64] = ""; // Wildcard filter for the per actuator topics.
+size_t mqttTopicPrefix = 0; // Length of "<clientID>/" at the start of every topic.
 
 // Build_flags defined in platformio.ini
 unsigned long serialBaudRate = UART_SPEED; // Baud rate for serial port.
@@ -82,8 +141,55 @@ const int mqttPort = MQTT_PORT; // MQTT port (default: 1883)
 const char* mqttUser = MQTT_USER; // MQTT username. Not used at present.
 const char* mqttPassword = MQTT_PASSWORD; // MQTT password. Not used at present.
 const char* deviceType = DEVICE_TYPE; // What this device is.
-const int keepAlive = KEEP_ALIVE; // Keep alive time in milli-seconds.
+const uint16_t mqttKeepAlive = MQTT_KEEP_ALIVE; // MQTT keep-alive in seconds.
+const unsigned long telemetryCheck = TELEMETRY_CHECK; // How often to look for a state change in milli-seconds.
+const unsigned long telemetryMaxInterval = TELEMETRY_MAX_INTERVAL; // Longest gap between state frames in milli-seconds.
+const uint8_t telemetryRssiDeadBand = TELEMETRY_RSSI_DEADBAND; // RSSI change in dB that sends a frame.
+const unsigned long motorControlPeriod = MOTOR_CONTROL_PERIOD; // Ramp update period in milli-seconds.
+const uint32_t motorPwmFrequency = MOTOR_PWM_FREQ; // DC motor PWM frequency in Hz.
+const uint16_t motorAcceleration = MOTOR_ACCEL; // Duty units per second when speeding up.
+const uint16_t motorDeceleration = MOTOR_DECEL; // Duty units per second when slowing down.
+const unsigned long mqttPollMax = MQTT_POLL_MAX; // Longest idle MQTT poll interval in milli-seconds.
+const bool mqttPollBackOff = MQTT_POLL_BACKOFF; // True to poll every pass while busy, false to poll every MQTT_POLL_MAX.
+const uint16_t udpPort = UDP_PORT; // UDP command port. 0 = commands over MQTT only.
+const unsigned long udpPollMax = UDP_POLL_MAX; // Longest idle UDP poll interval in milli-seconds.
+const uint8_t udpBurst = 8; // Most datagrams taken in one UDP poll.
 const char* buildVersion = BUILD_VERSION; // Version of the software.
+const unsigned long netBackOffMin = NET_BACKOFF_MIN; // First retry delay in milli-seconds.
+const unsigned long netBackOffMax = NET_BACKOFF_MAX; // Longest retry delay in milli-seconds.
+const unsigned long netStepTimeout = 15000; // Give up on association or DHCP after this.
+const unsigned long netFastTimeout = 4000; // Give up on the cached AP after this.
+const uint16_t logRingSize = LOG_RING_SIZE; // Async log ring size in bytes. 0 = synchronous.
+const unsigned long logDrainInterval = LOG_DRAIN_INTERVAL; // Log drain period in milli-seconds.
+const uint32_t logSpoolSize = LOG_SPOOL_SIZE; // Flash kept for offline log lines in bytes. 0 = none.
+const uint32_t logSpoolSegment = LOG_SPOOL_SEGMENT; // Log spool file size in bytes.
+const uint32_t logSpoolRate = LOG_SPOOL_RATE; // Spooled log replay cap in bytes per second.
+const uint8_t logLimitBurst = LOG_LIMIT_BURST; // Lines a LOG call site may send back to back. 0 = no limit.
+const uint32_t logLimitPeriod = LOG_LIMIT_PERIOD; // Milli-seconds for a call site to earn one more line.
+const bool logCollapse = LOG_COLLAPSE; // True to send runs of identical lines as one line and a count.
+#define dualCore DUAL_CORE // 1 = networking on core 0, motor control on core 1.
+#define taskStats TASK_STATS // 1 = time tasks and command handlers.
+#define positionFeedback POSITION_FEEDBACK // 1 = encoders on the DC axes.
+const uint8_t moveDuty = MOVE_DUTY; // Duty of a counted move unless the command gives one.
+const uint32_t syncRate = SYNC_RATE; // Guess of encoder counts per second at full duty until measured.
+const uint16_t syncTolerance = SYNC_TOLERANCE; // Counts from its target at which a coordinated axis has arrived.
+const uint32_t deadmanMs = DEADMAN_MS; // Longest gap between commands while a motor runs open ended. 0 = no deadman.
+#define estopInput ESTOP_INPUT // 1 = e-stop button on estopPin.
+const uint16_t recordSize = RECORD_SIZE; // Bytes of recorded commands kept in RAM. 0 = no recorder.
+const char* recordPath = "/recording.bin"; // Where record,save keeps the recording.
+const uint16_t recordDumpChunk = 128; // Recording bytes per record,dump message.
+const uint16_t publishQueueSize = PUBLISH_QUEUE_SIZE; // Outbound queue in bytes. 0 = publish directly.
+const unsigned long publishDrainInterval = PUBLISH_DRAIN_INTERVAL; // Queue drain period in milli-seconds.
+const uint32_t publishDrainBudget = PUBLISH_DRAIN_BUDGET; // Longest drain pass in micro-seconds.
+
+#if dualCore == 1
+const BaseType_t networkCore = 0; // Protocol core, where the WiFi stack runs.
+const BaseType_t motorCore = 1; // Application core.
+const UBaseType_t networkTaskPriority = 1; // Below the WiFi and lwIP tasks.
+const UBaseType_t motorTaskPriority = 10; // Above loopTask and the network task.
+TaskHandle_t networkTaskHandle = NULL; // Runs the scheduler on core 0.
+TaskHandle_t motorTaskHandle = NULL; // Runs motorControl() on core 1.
+#endif
 
 // Configure logging object target based on the value of LOG_TARGET in 
 // platformio.ini. 
@@ -99,40 +205,135 @@ const char* buildVersion = BUILD_VERSION; // Version of the software.
 #else // For all other logging value settings, log messages to terminal only.
    MqttLogger mqttLogger(client,"mqttlogger/log",MqttLoggerMode::SerialOnly);
 #endif
+LogSpool logSpool(LittleFS, "/spool", logSpoolSize, logSpoolSegment); // Log lines written while offline.
+#if LOG_TOKENIZED == 1
+   LogLimiter logLimit(NULL, logLimitBurst, logLimitPeriod); // No text notes among binary records.
+#else
+   LogLimiter logLimit(&mqttLogger, logLimitBurst, logLimitPeriod);
+#endif
 
 // Log themed compiler macros mapped to different MqttLogger functions or if 
 // the targhet is set to 0 map the logging macros to do nothing. This makes it
 // easy to control logging behaviour at compile time by simply setting 1 
-// varibale in PlatformIO.   
+// varibale in PlatformIO. With LOG_TOKENIZED set to 1 the macros send compact
+// binary records instead of text (see logToken.h). With LOG_LIMIT_BURST above
+// 0 every LOG and LOGLN call site is rate limited on its own (see logLimit.h)
+// and the LOGNF and LOGLNF calls that finish a dropped line are dropped too.
 #if logTarget == 0
    #define LOG(msg) // Map to nothing, effectively suppressing all logging.
    #define LOGNF(msg) // Map to nothing, effectively suppressing all logging.
    #define LOGLN(msg) // Map to nothing, effectively suppressing all logging.
    #define LOGLNF(msg) // Map to nothing, effectively suppressing all logging.
 #else
-   #define LOG(msg) mqttLogger.print(String("<") + __FUNCTION__ + "> " + msg)
-   #define LOGNF(msg) mqttLogger.print(msg)
-   #define LOGLN(msg) mqttLogger.println(String("<") + __FUNCTION__ + "> " + msg)
-   #define LOGLNF(msg) mqttLogger.println(msg)
+   #if LOG_TOKENIZED == 1
+      #define LOGTOKEN(msg, text, eol) do { constexpr uint32_t token = logToken(text, __LINE__); logTokenized(mqttLogger, token, eol, msg); } while(0)
+      #define LOGSTART(msg, text) LOGTOKEN(msg, text, 0)
+      #define LOGMORE(msg, text) LOGTOKEN(msg, text, 0)
+      #define LOGSTARTLN(msg, text) LOGTOKEN(msg, text, logEndOfLine)
+      #define LOGMORELN(msg, text) LOGTOKEN(msg, text, logEndOfLine)
+   #else
+      #define LOGSTART(msg, text) do { mqttLogger.print('<'); mqttLogger.print(__FUNCTION__); mqttLogger.print("> "); mqttLogger.print(msg); } while(0)
+      #define LOGMORE(msg, text) mqttLogger.print(msg)
+      #define LOGSTARTLN(msg, text) do { LOGSTART(msg, text); mqttLogger.println(); } while(0)
+      #define LOGMORELN(msg, text) mqttLogger.println(msg)
+   #endif
+   // The argument is stringized here, before it is passed on and any macro
+   // in it such as NULL is expanded, so the token matches the source text
+   // that tools/logtokens.py reads.
+   #if LOG_LIMIT_BURST > 0
+      #define LOG(msg) do { static LogSite logSite; if(logLimit.start(logSite, __FUNCTION__)) LOGSTART(msg, #msg); } while(0)
+      #define LOGNF(msg) do { if(logLimit.pass()) LOGMORE(msg, #msg); } while(0)
+      #define LOGLN(msg) do { static LogSite logSite; if(logLimit.start(logSite, __FUNCTION__)) LOGSTARTLN(msg, #msg); logLimit.endLine(); } while(0)
+      #define LOGLNF(msg) do { if(logLimit.pass()) LOGMORELN(msg, #msg); logLimit.endLine(); } while(0)
+   #else
+      #define LOG(msg) LOGSTART(msg, #msg)
+      #define LOGNF(msg) LOGMORE(msg, #msg)
+      #define LOGLN(msg) LOGSTARTLN(msg, #msg)
+      #define LOGLNF(msg) LOGMORELN(msg, #msg)
+   #endif
+#endif
+
+// Timing of tasks and command handlers. Compiled out when TASK_STATS is 0.
+#if taskStats == 1
+   #define STAT_SCOPE(stat) StatScope statScope(stat)
+   #define STAT_ATTRIBUTE(stat) statScope.attribute(stat)
+#else
+   #define STAT_SCOPE(stat)
+   #define STAT_ATTRIBUTE(stat)
 #endif
 
 // Forward function declarations.
-void mqttSendKeepAlive();
+void telemetrySend();
 void mqttCheckIncoming();
+void udpCheckIncoming();
+void logDrain();
+void networkManager();
+void publishDrain();
+void publishRecording();
+void safetyReport();
 //void otaCheck();
 void mqttIncomingCallback(char* topic, byte* payload, unsigned int length); 
+bool dispatchCommand(const char* name, byte* payload, unsigned int length);
 void stop();
 void goForward();
 void goBackward();
 void motorControl();
-String getPassword(String lAP);
-Task t1(keepAlive, TASK_FOREVER, &mqttSendKeepAlive);
-Task t2(keepAlive, TASK_FOREVER, &mqttCheckIncoming);
-//Task t3(keepAlive, TASK_FOREVER, &otaCheck);
-Task t4(keepAlive, TASK_FOREVER, &motorControl);
+int8_t findActuator(const char* name, size_t length);
+bool setpointInRange(uint8_t actuator, int32_t value);
+uint8_t queueBatch(byte* payload, unsigned int length);
+void queueAll(int16_t duty, int16_t servoPosition);
+const char* getPassword(const char* lAP);
+Task t1(telemetryCheck, TASK_FOREVER, &telemetrySend);
+Task t2(mqttPollBackOff ? TASK_IMMEDIATE : mqttPollMax, TASK_FOREVER, &mqttCheckIncoming);
+//Task t3(1000, TASK_FOREVER, &otaCheck);
+Task t4(motorControlPeriod, TASK_FOREVER, &motorControl);
+Task t5(logDrainInterval, TASK_FOREVER, &logDrain);
+Task t6(100, TASK_FOREVER, &networkManager);
+Task t7(publishDrainInterval, TASK_FOREVER, &publishDrain);
+Task t8(100, TASK_FOREVER, &safetyReport);
+Task t9(TASK_IMMEDIATE, TASK_FOREVER, &udpCheckIncoming);
 int servoForward = 115;
 int servoBackward = 55;
 int servoStop = 90;
+unsigned long motorLastUpdate = 0; // When t4 last advanced the motor ramps.
+unsigned long mqttPollInterval = mqttPollBackOff ? TASK_IMMEDIATE : mqttPollMax; // Current MQTT poll interval.
+bool mqttMessageSeen = false; // Set by the callback when a message arrives.
+unsigned long udpPollInterval = TASK_IMMEDIATE; // Current UDP poll interval.
+netState net = NET_FAST_CONNECT; // Current connection manager state.
+netState netRetryState = NET_FAST_CONNECT; // State to resume after back-off.
+uint8_t netScanChannel = 0; // Channel to scan, 0 for all channels.
+const char* netAttempt = "full scan"; // How the current AP was found.
+unsigned long netConnectStart = 0; // When the current connection attempt began.
+unsigned long netBackOffDelay = NET_BACKOFF_MIN; // Current back-off delay.
+unsigned long netRetryAt = 0; // When the back-off expires.
+unsigned long netStepStart = 0; // When the current wait state began.
+unsigned long loopLastMicros = 0; // Start of the previous loop() pass.
+unsigned long loopStallMax = 0; // Longest gap between loop() passes in micro-seconds.
+LatencyHistogram controlPeriod; // Start to start time of motorControl() in micro-seconds.
+unsigned long controlLastMicros = 0; // Start of the previous motorControl() pass.
+uint16_t recordDumpNext = 0; // Next byte of a record,dump still to queue.
+uint16_t recordDumpEnd = 0; // Bytes in the dump, header included.
+std::atomic<bool> controlPeriodReset(false); // Set by the jitter command, cleared by the motor task.
+TaskStat telemetryStat("telemetry", telemetryCheck); // Task t1.
+TaskStat mqttPollStat("mqttPoll", mqttPollMax); // Task t2, includes the callback.
+TaskStat motorStat("motor", motorControlPeriod); // Task t4 or the motor task.
+TaskStat logDrainStat("logDrain", logDrainInterval); // Task t5.
+TaskStat networkStat("network", 100); // Task t6.
+TaskStat publishStat("publish", publishDrainInterval); // Task t7.
+TaskStat udpPollStat("udpPoll", udpPollMax); // Task t9, includes the dispatch.
+TaskStat loopStat("loop"); // One pass of runner.execute(), max is the longest loop.
+TaskStat cmdMoveStat("cmd.move"); // forward and backward.
+TaskStat cmdStopStat("cmd.stop"); // stop.
+TaskStat cmdAxisStat("cmd.axis"); // pos, move and the axis names.
+TaskStat cmdReportStat("cmd.report"); // jitter, stats, where and alive.
+TaskStat cmdRecordStat("cmd.record"); // record and replay.
+TaskStat cmdBatchStat("cmd.batch"); // A whole JSON batch.
+TaskStat cmdBatchItemStat("cmd.batch/item"); // A JSON batch divided by its length.
+TaskStat cmdUnknownStat("cmd.unknown"); // Anything else.
+TaskStat* const allStats[] = {&telemetryStat, &mqttPollStat, &motorStat, &logDrainStat, 
+   &networkStat, &publishStat, &udpPollStat, &loopStat, &cmdMoveStat, &cmdStopStat, &cmdAxisStat, &cmdReportStat, 
+   &cmdRecordStat, &cmdBatchStat, &cmdBatchItemStat, &cmdUnknownStat}; // Reported by the stats command in this order.
+uint32_t statsOverhead = 0; // Ticks added by one StatScope, see statsCalibrate().
 
 
 /**
@@ -154,477 +355,1953 @@ int servoStop = 90;
 //   ArduinoOTA.handle();  
 //} // otaCheck()
 
+/** 
+ * @brief Set the next interval of a task that polls for incoming messages.
+ * 
+ * @details While messages are arriving the task runs on every pass of
+ * runner.execute(). Each idle poll doubles the interval until it reaches 
+ * the longest allowed.
+ * 
+ * @param task The polling task.
+ * @param interval Its current interval, updated.
+ * @param busy True if the poll found a message.
+ * @param most Longest idle interval in milli-seconds.
+ * 
+ * @return NA No return value.
+ */
+void pollBackOff(Task& task, unsigned long& interval, bool busy, unsigned long most) 
+{
+   unsigned long nextInterval = interval;
+   if(busy)
+   {
+      nextInterval = TASK_IMMEDIATE; // Stay on every pass while busy.
+   } // if
+   else if(nextInterval < most)
+   {
+      nextInterval = (nextInterval == TASK_IMMEDIATE) ? 1 : nextInterval * 2;
+      nextInterval = min(nextInterval, most);
+   } // else if
+   if(nextInterval != interval)
+   {
+      interval = nextInterval;
+      task.setInterval(interval);
+   } // if
+} // pollBackOff()
+
 /** 
  * @brief Check for incoming MQTT messages.
  * 
+ * @details Polling is decoupled from the keep-alive cadence. While messages
+ * are arriving the socket is serviced on every pass of runner.execute(). Each
+ * idle poll doubles the interval until it reaches MQTT_POLL_MAX, so a command
+ * that arrives after a quiet spell waits at most MQTT_POLL_MAX milli-seconds.
+ * With MQTT_POLL_BACKOFF 0 the socket is polled every MQTT_POLL_MAX instead,
+ * one message a poll, as it was on the keep-alive cadence. That is kept to
+ * compare the two, see lib/hostSim/scripts/latency.txt.
+ * 
  * @param NA No parameters are passed in.
  * 
+ * @return NA No return value.
  */
 void mqttCheckIncoming() 
 {
-   client.loop();  
-} // mqttSendKeepAlive()
+   STAT_SCOPE(mqttPollStat);
+   mqttMessageSeen = false;
+   client.loop();
+   if(mqttPollBackOff)
+   {
+      pollBackOff(t2, mqttPollInterval, mqttMessageSeen, mqttPollMax);
+   } // if
+} // mqttCheckIncoming()
 
 /** 
- * @brief Issue MQTT keepalive messages.
+ * @brief Check for incoming UDP commands.
+ * 
+ * @details Runs as task t9 and backs off while idle in the same way as the
+ * MQTT poll, to at most UDP_POLL_MAX milli-seconds. Up to udpBurst waiting
+ * datagrams are taken each time. Nothing arrives before the first IP
+ * address, when the socket is opened.
  * 
  * @param NA No parameters are passed in.
  * 
  * @return NA No return value.
  */
-void mqttSendKeepAlive() 
+void udpCheckIncoming() 
 {
-   LOGLN(millis());
-   LOGLNF(WiFi.localIP().toString());
-   String msg = "Build version = ";
-   msg += buildVersion;
-   client.publish(mqttResponseTopic.c_str(), msg.c_str());  
-} // mqttSendKeepAlive()
+   STAT_SCOPE(udpPollStat);
+   pollBackOff(t9, udpPollInterval, udpControl.poll(udpBurst) > 0, udpPollMax);
+} // udpCheckIncoming()
 
-/**
- * @brief Call back function to process incoming MQTT messages.
+/** 
+ * @brief Send log lines queued in the MqttLogger ring buffer and replay 
+ * lines spooled to flash during an outage.
  * 
- * @param topic The MQTT topic that the incomming message was sent to.
- * @param payload The content of the incoming MQTT message.
- * @param length The length of the incoming message.
+ * @param NA No parameters are passed in.
  * 
  * @return NA No return value.
  */
-void mqttIncomingCallback(char* topic, byte* payload, unsigned int length) 
+void logDrain() 
 {
-   payload[length] = '\0';
-   String strTopic = String((char*)topic);
-   String msg = (char*)payload;
-   LOG("Received message: ");
-   LOGLNF(msg);
-   int commaPosition = msg.indexOf(',');
-   String command = msg.substring(0,commaPosition);
-   String value = msg.substring(commaPosition+1);
-   if(command == "forward")
+   STAT_SCOPE(logDrainStat);
+   mqttLogger.drain();
+} // logDrain()
+
+/** 
+ * @brief Send queued MQTT messages, most urgent first, and carry on with a
+ * record,dump that did not fit the queue in one go.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void publishDrain() 
+{
+   STAT_SCOPE(publishStat);
+   publishQueue.drain(publishDrainBudget);
+   publishRecording();
+} // publishDrain()
+
+/** 
+ * @brief Check that the broker socket can take a packet without blocking.
+ * 
+ * @details lwIP only reports a socket writable once a low water mark of
+ * about half its send buffer is free, more than any message this firmware
+ * sends, so the size is not checked on the device. A socket that is not
+ * open is reported writable and the publish then fails as before.
+ * 
+ * @param bytes Packet size.
+ * 
+ * @return True if the packet can be written now.
+ */
+bool brokerWritable(uint16_t bytes) 
+{
+#if defined(ARDUINO_ARCH_ESP32)
+   int socket = espClient.fd();
+   if(socket < 0)
    {
-      goForward();
+      return true;
    } // if
-   else if(command == "backward")
+   fd_set ready;
+   FD_ZERO(&ready);
+   FD_SET(socket, &ready);
+   struct timeval now = {0, 0};
+   return select(socket + 1, NULL, &ready, NULL, &now) > 0;
+#else
+   return espClient.availableForWrite() >= bytes;
+#endif
+} // brokerWritable()
+
+/** 
+ * @brief Publish a binary state frame if the state has changed or the 
+ * maximum interval has passed.
+ * 
+ * @details Replaces the 1 Hz text keep-alive. Liveness comes from the MQTT
+ * keep-alive and the last will on the status topic. The motor figures are
+ * read without a lock, each is a single 16 bit value. Frame layout is in 
+ * telemetry.h.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void telemetrySend() 
+{
+   STAT_SCOPE(telemetryStat);
+   if(net != NET_ONLINE)
    {
-      goBackward();
-   }  // if
-   else if(command == "stop")
+      return;
+   } // if
+   telemetryState state;
+   state.uptime = millis();
+   for(uint8_t i = 0; i < telemetryAxes; i++)
    {
-      stop();
-   }  // if
-   else if(command == "pos")
+      state.speed[i] = motors[i]->getSpeed();
+      state.setpoint[i] = motors[i]->getSetpoint();
+   } // for
+   state.servo = servoMotor.read();
+   state.rssi = WiFi.RSSI();
+   state.freeHeap = ESP.getFreeHeap();
+   uint8_t frame[telemetryFrameSize];
+   if(telemetry.frame(state, frame))
    {
-      int servoValue = value.toInt();
-      servoMotor.write(servoValue);
+      publishQueue.publish(PUB_TELEMETRY, mqttTelemetryTopic, frame, sizeof(frame));
    } // if
-   else
-   {
-      LOGLN("Unknown command.");
-   } // else
-} // mqttIncomingCallback()
+} // telemetrySend()
 
 /**
- * @brief Returns a string contaning the password for an Access Point.
+ * @brief Log each time the e-stop or the deadman cuts the bridges, and when
+ * the cut is released.
  * 
- * @param lAP SSID to use to look up the password.
+ * @details Runs as scheduled task t8. The cut happens in an interrupt, which
+ * must not log, so the trip counts are compared with the ones seen last 
+ * time instead.
+ * 
+ * @param NA No parameters are passed in.
  * 
- * @return Access Point password. If the AP is nt known return "unknown".
+ * @return NA No return value.
  */
-String getPassword(String lAP)
+void safetyReport()
 {
-   String password = "unknown";
-   String msg = "Check to see if ";
-   msg += lAP;
-   msg += " is a known network name.";
-   LOGLN(msg);
-   int apArraySize = sizeof(apSecrets)/sizeof(apSecrets[0]);
-   for (int x = 0; x < apArraySize; x++) 
+   static uint32_t seen[SAFETY_CAUSES] = {0}; // Trip counts already logged.
+   static uint8_t lastCause = SAFETY_CLEAR; // Cause at the last pass.
+   bool tripped = false;
+   if(safetyStop.getTrips(SAFETY_DEADMAN) != seen[SAFETY_DEADMAN])
    {
-      if(lAP == apSecrets[x].ssid)
-      {
-         password = apSecrets[x].pwd;
-         msg = lAP;
-         msg += " is a known Access Point. Setting password.";
-      } // if
-   } // for
-   if(password == "unknown")
+      seen[SAFETY_DEADMAN] = safetyStop.getTrips(SAFETY_DEADMAN);
+      tripped = true;
+      LOG("Deadman stop, no command for ");
+      LOGNF(deadmanMs);
+      LOGLNF(" milliseconds with a motor running.");
+   } // if
+   if(safetyStop.getTrips(SAFETY_ESTOP) != seen[SAFETY_ESTOP])
    {
-         msg = lAP;
-         msg += " is NOT a known Access Point.";
-   } //if
-   LOGLN(msg);
-   return password;
-} // aaWifi::getPassword()
+      seen[SAFETY_ESTOP] = safetyStop.getTrips(SAFETY_ESTOP);
+      tripped = true;
+      LOGLN("Emergency stop.");
+   } // if
+   uint8_t cause = safetyStop.getCause();
+   if(cause == SAFETY_CLEAR && (tripped || lastCause != SAFETY_CLEAR))
+   {
+      LOGLN("Safety stop released, motors stopped.");
+   } // if
+   lastCause = cause;
+} // safetyReport()
 
 /**
- * @brief Returns a string contaning a unique ID for this device.
+ * @brief Publish the control loop period statistics to the response topic and
+ * start a new measurement.
+ * 
+ * @details The histogram is only written by the motor task. It is read here
+ * without a lock, so on a dual core build one figure may be a pass behind the
+ * others. The reset is handed to the motor task through an atomic flag.
  * 
  * @param NA No parameters are passed in.
  * 
- * @return uniqueID A String contianing a unique ID for ths device.
+ * @return NA No return value.
  */
-String getUniqueID()
+void publishControlJitter()
 {
-   String uniqueID = String(deviceType);
-   uniqueID += WiFi.macAddress().c_str();
-   return uniqueID;
-} // getUniqueID()
+   char msg[128];
+   snprintf(msg, sizeof(msg), 
+      "jitter mode=%s target=%lu n=%lu min=%lu avg=%lu p99=%lu max=%lu us",
+      (dualCore == 1) ? "dual-core" : "single-core", motorControlPeriod * 1000,
+      (unsigned long)controlPeriod.getCount(), (unsigned long)controlPeriod.getMin(),
+      (unsigned long)controlPeriod.getAverage(), (unsigned long)controlPeriod.getPercentile(99),
+      (unsigned long)controlPeriod.getMax());
+   publishQueue.publish(PUB_CONTROL, mqttResponseTopic, msg);
+   controlPeriodReset = true;
+} // publishControlJitter()
 
 /**
- * @brief Look for Wifi Access Points, put the best in a global structure.
+ * @brief Publish the encoder position of each DC axis to the response topic.
+ * 
+ * @details One line per axis: position, target of the last move, error of 
+ * the last finished move, all in counts, then the pulse rate, the number of
+ * moves and whether a PCNT unit or an interrupt counts the pulses. A last 
+ * line gives the coordinated moves finished, the axes that missed their 
+ * target, the planned length and arrival skew of the moves and the 
+ * measured rate of each axis at full duty.
  * 
  * @param NA No parameters are passed in.
  * 
- * @return True if a known AP is found and False if not.
+ * @return NA No return value.
  */
-bool scanForAp()
+void publishPosition()
 {
-   bool validAP = false;
-   LOGLN("Scan for nearby Access Points.");
-   ap.rssi = -99; // Initialize RSSI to indicating no AP found.
-   ap.ssid = "null"; // Initilize SSID to indicate no AP found.
-   int n = WiFi.scanNetworks(); // Look for access points.
-   LOGLN("Scan complete.");
-   if(n == 0) 
-   {
-      LOGLN("No networks found.");
-   } // if
-   else 
-   {
-      String cnt = String(n);
-      cnt += " networks found."; 
-      LOGLN(cnt);
-      for (int i = 0; i < n; ++i) 
-      {
-         // Print SSID and RSSI for each network found
-         String op = "Count = ";
-         op += String(i + 1);
-         LOGLN(op);
-         String ssid = "   SSID  = ";
-         ssid += String(WiFi.SSID(i).c_str());
-         LOGLN(ssid);
-         String rssi = "   RSSI = ";
-         rssi += String(WiFi.RSSI(i));
-         LOGLN(rssi);
-         int32_t slvl = WiFi.RSSI(i);
-         if(slvl >= -30)
-         {
-            LOGLN("   RSSI rating = Amazing.");
-         } // if
-         if((slvl >= -54) && (slvl <= -29))
-         {
-            LOGLN("   RSSI rating = Amazing.");
-         } // if
-         else if((slvl >= -66) && (slvl <= -55))
-         {
-            LOGLN("   RSSI rating = Very good.");
-         } // else if
-         else if((slvl >= -70) && (slvl <= -67))
-         {
-            LOGLN("   RSSI rating = Fairly Good.");
-         } // else if
-         else if((slvl >= -79) && (slvl <= -70))
-         {
-            LOGLN("   RSSI rating = Okay.");
-         } // else if
-         else if((slvl >= -89) && (slvl <= -80))
-         {
-            LOGLN("   RSSI rating = Not good.");
-         } // else if
-         else if(slvl <= -90)
-         {
-            LOGLN("   RSSI rating = Extremely weak signal (unusable).");
-         } // else if
-         String chan = "   Channel = ";
-         chan += String(WiFi.channel(i));
-         LOGLN(chan);
-         ap.channel = WiFi.channel(i);
-         ap.encryptionType = WiFi.encryptionType(i);
-         switch (WiFi.encryptionType(i))
-         {
-            case WIFI_AUTH_OPEN:
-               LOGLN("   Auth = open");
-               break;
-            case WIFI_AUTH_WEP:
-               LOGLN("   Auth = WEP");
-               break;
-            case WIFI_AUTH_WPA_PSK:
-               LOGLN("   Auth = WPA");
-               break;
-            case WIFI_AUTH_WPA2_PSK:
-               LOGLN("   Auth = WPA2");
-               break;
-            case WIFI_AUTH_WPA_WPA2_PSK:
-               LOGLN("   Auth = WPA+WPA2");
-               break;
-            case WIFI_AUTH_WPA2_ENTERPRISE:
-               LOGLN("   Auth = WPA2-EAP");
-               break;
-            case WIFI_AUTH_WPA3_PSK:
-               LOGLN("   Auth = WPA3");
-               break;
-            case WIFI_AUTH_WPA2_WPA3_PSK:
-               LOGLN("   Auth = WPA2+WPA3");
-               break;
-            case WIFI_AUTH_WAPI_PSK:
-               LOGLN("   Auth = WAPI");
-               break;
-            default:
-               LOGLN("   Auth = unknown");
-         } // switch()
-         if(slvl > ap.rssi) // Save AP with best RSSI.
-         {
-            validAP = true;
-            ap.rssi = slvl;
-            ap.ssid = String(WiFi.SSID(i).c_str());
-            ap.password = getPassword(WiFi.SSID(i).c_str());
-            LOGLN("   NOTE: This is now the best access point.");
-         } // if
-         delay(10);
-      } // for
-   } // else
-   WiFi.scanDelete(); // Delete the scan result to free memory.
-   return validAP;
-} // aaWifi::scanForAP()
+   char msg[384];
+   size_t length = 0;
+   for(uint8_t i = 0; i < sizeof(encoders) / sizeof(encoders[0]) && length < sizeof(msg); i++)
+   {
+      AxisEncoder* encoder = encoders[i];
+      int added = snprintf(msg + length, sizeof(msg) - length, 
+         "%s%s pos=%ld target=%ld error=%ld rate=%lu/s moves=%lu%s%s",
+         (i > 0) ? "\n" : "", motors[i]->getName(), (long)encoder->getPosition(), 
+         (long)encoder->getTarget(), (long)encoder->getLastError(), 
+         (unsigned long)encoder->getRate(), (unsigned long)encoder->getMoves(), 
+         encoder->usesPcnt() ? " pcnt" : " isr", encoder->isMoving() ? " moving" : "");
+      length += (added > 0) ? added : 0;
+   } // for
+   if(length < sizeof(msg))
+   {
+      snprintf(msg + length, sizeof(msg) - length, 
+         "\nsync moves=%lu missed=%lu planned=%lu ms skew last/p99/max %lu/%lu/%lu ms rate %lu/%lu/%lu/s%s",
+         (unsigned long)motionPlanner.getMoves(), (unsigned long)motionPlanner.getMissed(),
+         (unsigned long)motionPlanner.getPlannedMs(), (unsigned long)motionPlanner.getLastSkew(),
+         (unsigned long)motionPlanner.getSkew().getPercentile(99), (unsigned long)motionPlanner.getSkew().getMax(),
+         (unsigned long)motionPlanner.getFullRate(ACT_SLEW), (unsigned long)motionPlanner.getFullRate(ACT_HOIST),
+         (unsigned long)motionPlanner.getFullRate(ACT_LUFF), motionPlanner.isMoving() ? " moving" : "");
+   } // if
+   publishQueue.publish(PUB_CONTROL, mqttResponseTopic, msg);
+} // publishPosition()
 
 /**
- * @brief Connect to the Access Point stored in the gobal AP structure.
+ * @brief Start a counted move of one DC axis.
  * 
- * @param NA No parameters are passed in.
+ * @details The value is "<axis>,<counts>[,<duty>]" where counts is signed 
+ * and duty defaults to MOVE_DUTY. The motor task starts the move and stops
+ * the axis when the count is reached.
  * 
- * @return NA No return value.
+ * @param value Command value.
+ * @param length Characters in value.
+ * 
+ * @return True if the move was handed to the motor task.
  */
-void wifiConnect()
+bool queueMove(const char* value, uint16_t length)
 {
-   if(scanForAp())
+   uint16_t nameLength = routeField(value, length);
+   if(nameLength == length)
    {
-      LOG("Connecting to WiFi. SSID: ");
-      LOGNF(ap.ssid);
-      WiFi.begin(ap.ssid, ap.password);
-      while(WiFi.status() != WL_CONNECTED)
-      {
-         delay(500);
-         LOGNF(".");
-      } // while()
-      LOGLNF("");
-      LOG("WiFi connected. Assigned IP address: ");
-      LOGLNF(WiFi.localIP().toString());
+      return false;
    } // if
-   else
+   const char* rest = value + nameLength + 1;
+   uint16_t restLength = length - nameLength - 1;
+   uint16_t countsLength = routeField(rest, restLength);
+   int8_t axis = findActuator(value, nameLength);
+   int32_t counts = 0;
+   int32_t duty = moveDuty;
+   if(!routeNumber(rest, countsLength, counts) || (countsLength < restLength 
+      && !routeNumber(rest + countsLength + 1, restLength - countsLength - 1, duty)))
    {
-      LOGLN("No network Access Point found.");
-   } // else
-} //  wifiConnect()
+      return false;
+   } // if
+   if(axis < 0 || duty < 1 || duty > motorMaxDuty)
+   {
+      return false;
+   } // if
+   if(!encoders[axis]->requestMove(counts, duty))
+   {
+      return false;
+   } // if
+   commandRecorder.add(REC_MOVE, axis, counts, duty);
+   return true;
+} // queueMove()
 
-/** 
- * @brief (Re)establish an MQTT client connection to a broker.
+/**
+ * @brief Start a coordinated move of several axes.
  * 
- * @param NA No parameters are passed in.
+ * @details The value is a list of <name>=<number> fields in any order, for 
+ * example "slew=300,hoist=-400,servo=120,ms=4000". An axis name gives the 
+ * signed counts to move that DC axis, servo the angle to end at, ms the 
+ * shortest time for the move and duty the highest duty any axis may need. 
+ * With neither ms nor duty the duty is MOVE_DUTY. The motor task plans the 
+ * move so that every axis arrives at the same time, see motionPlanner.h.
  * 
- * @return NA No return value.
+ * @param value Command value.
+ * @param length Characters in value.
+ * 
+ * @return True if the move was handed to the motor task.
  */
-void reconnect()
+bool queueSync(const char* value, uint16_t length)
 {
-   while (!client.connected())
+   syncMove move = {{0, 0, 0}, -1, 0, 0};
+   while(length > 0)
    {
-      clientID = getUniqueID();
-      LOG("Attempting MQTT connection as ");
-      LOGNF(clientID);
-      LOGNF("...");
-      // Attempt to connect
-      if (client.connect(clientID.c_str()))
+      uint16_t fieldLength = routeField(value, length);
+      const char* equals = (const char*)memchr(value, '=', fieldLength);
+      int32_t number = 0;
+      if(equals == NULL || !routeNumber(equals + 1, value + fieldLength - equals - 1, number))
       {
-         // as we have a connection here, this will be the first message published to the mqtt server
-         LOGLNF("connected."); 
-         mqttCommandTopic = clientID + "/cmd";
-         mqttResponseTopic = clientID + "/rsp";
-         client.setCallback(mqttIncomingCallback);
-         client.subscribe(mqttCommandTopic.c_str());
+         return false;
+      } // if
+      uint16_t nameLength = equals - value;
+      int8_t axis = findActuator(value, nameLength);
+      if(axis >= 0)
+      {
+         move.counts[axis] = number;
       } // if
+      else if(nameLength == 5 && strncmp(value, "servo", 5) == 0 && number >= 0 && number <= 180)
+      {
+         move.servo = number;
+      } // else if
+      else if(nameLength == 2 && strncmp(value, "ms", 2) == 0 && number >= 0)
+      {
+         move.durationMs = number;
+      } // else if
+      else if(nameLength == 4 && strncmp(value, "duty", 4) == 0 && number >= 1 && number <= motorMaxDuty)
+      {
+         move.duty = number;
+      } // else if
       else
       {
-         LOG("failed, rc=");
-         LOGNF(client.state());
-         LOGLNF(" try again in 5 seconds");
-         delay(5000);
+         return false;
       } // else
-   } // while()
-} // reconnect()
+      uint16_t skip = min(fieldLength + 1, (int)length);
+      value += skip;
+      length -= skip;
+   } // while
+   if(move.durationMs == 0 && move.duty == 0)
+   {
+      move.duty = moveDuty;
+   } // if
+   if(!motionPlanner.request(move))
+   {
+      return false;
+   } // if
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      if(move.counts[i] != 0)
+      {
+         commandRecorder.add(REC_SYNC, i, move.counts[i]);
+      } // if
+   } // for
+   if(move.servo >= 0)
+   {
+      commandRecorder.add(REC_SYNC, ACT_SERVO, move.servo);
+   } // if
+   commandRecorder.add(REC_SYNC, ACT_COUNT, move.durationMs, move.duty);
+   return true;
+} // queueSync()
 
 /**
- * @brief Spins motor clockwise (from motor's perspecive).
+ * @brief Queue as much of a record,dump as the publish queue has room for.
+ * 
+ * @details The dump is the header then the entries in hex, in messages of
+ * up to recordDumpChunk bytes. tools/recording.py joins them back together
+ * and turns them into CSV. t7 calls this again until the whole dump is 
+ * queued, so a dump bigger than the queue never pushes out other messages.
+ * A dump is abandoned if a new recording or a replay starts.
+ * 
+ * @param NA No parameters are passed in.
  * 
+ * @return NA No return value.
  */
-void stop() 
+void publishRecording()
 {
-   // LM298N Motor Controller.
-   digitalWrite(enA1, LOW);
-   digitalWrite(inA1, LOW);
-   digitalWrite(inA2, LOW);
-   // DRV8871 Motor Controller.
-   digitalWrite(inB1, LOW);
-   digitalWrite(inB2, LOW);
-   digitalWrite(inC1, LOW);
-   digitalWrite(inC2, LOW);
-   // Servo motor
-   servoMotor.write(servoStop); // Put Servo motor in stop position.
-} // stop()
+   static const char hex[] = "0123456789abcdef";
+   if(recordDumpNext < recordDumpEnd && commandRecorder.getState() != RECORDER_IDLE)
+   {
+      recordDumpNext = recordDumpEnd;
+      LOGLN("Recording dump abandoned, recorder busy.");
+   } // if
+   uint8_t header[recordHeaderSize];
+   commandRecorder.header(header);
+   const uint8_t* data = commandRecorder.getData();
+   while(recordDumpNext < recordDumpEnd && publishQueue.getFree() >= 2 * recordDumpChunk)
+   {
+      char chunk[2 * recordDumpChunk];
+      uint16_t length = 0;
+      for(; recordDumpNext < recordDumpEnd && length < sizeof(chunk); recordDumpNext++)
+      {
+         uint8_t value = (recordDumpNext < sizeof(header)) ? header[recordDumpNext] : data[recordDumpNext - sizeof(header)];
+         chunk[length++] = hex[value >> 4];
+         chunk[length++] = hex[value & 0x0F];
+      } // for
+      publishQueue.publish(PUB_CONTROL, mqttResponseTopic, (const uint8_t*)chunk, length);
+   } // while
+} // publishRecording()
 
 /**
- * @brief Spins motor clockwise (from motor's perspecive).
+ * @brief Act on a record command.
+ * 
+ * @details The value is start (the default), stop, save, load or dump. 
+ * Recording ends by itself once the buffer is full.
  * 
+ * @param value Command value.
+ * 
+ * @return NA No return value.
  */
-void goForward() 
+void recordControl(const char* value)
 {
-   // LM298N Motor Controller.
-   digitalWrite(enA1, HIGH);
-   digitalWrite(inA1, LOW);
-   digitalWrite(inA2, HIGH);
-   // DRV8871 Motor Controller.
-   digitalWrite(inB1, LOW);
-   digitalWrite(inB2, HIGH);
-   digitalWrite(inC1, LOW);
-   digitalWrite(inC2, HIGH);
-   // Servo motor
-   servoMotor.write(servoForward); // Put Servo motor in forward position.
-} // goForward()
+   if(strcmp(value, "stop") == 0)
+   {
+      commandRecorder.stopRecording();
+      LOG("Recorded ");
+      LOGNF(commandRecorder.getEntries());
+      LOGNF(" commands in ");
+      LOGNF(commandRecorder.getLength());
+      LOGNF(" bytes over ");
+      LOGNF(commandRecorder.getDuration() / 1000);
+      LOGLNF(" milli-seconds.");
+   } // if
+   else if(strcmp(value, "save") == 0)
+   {
+      if(!commandRecorder.save(LittleFS, recordPath))
+      {
+         LOGLN("Recording not saved, nothing recorded or recorder busy.");
+      } // if
+   } // else if
+   else if(strcmp(value, "load") == 0)
+   {
+      if(!commandRecorder.load(LittleFS, recordPath))
+      {
+         LOGLN("No recording loaded, missing, too big or recorder busy.");
+      } // if
+   } // else if
+   else if(strcmp(value, "dump") == 0)
+   {
+      recordDumpNext = 0;
+      recordDumpEnd = recordHeaderSize + commandRecorder.getLength();
+      publishRecording();
+   } // else if
+   else if(!commandRecorder.startRecording())
+   {
+      LOGLN("Cannot record, recorder busy or RECORD_SIZE is 0.");
+   } // else if
+} // recordControl()
 
 /**
- * @brief Spins motor counter-clockwise (from motor's perspecive).
+ * @brief Publish the task and command handler timing snapshot to the 
+ * response topic.
+ * 
+ * @details The snapshot can be longer than the PubSubClient buffer so it is
+ * streamed with beginPublish().
  * 
+ * @param reset True to start new measurements once published.
+ * 
+ * @return NA No return value.
  */
-void goBackward() 
+void publishTaskStats(bool reset)
 {
-   digitalWrite(enA1, HIGH);
-   digitalWrite(inA1, HIGH);
-   digitalWrite(inA2, LOW);
-   // DRV8871 Motor Controller.
-   digitalWrite(inB1, HIGH);
-   digitalWrite(inB2, LOW);
-   digitalWrite(inC1, HIGH);
-   digitalWrite(inC2, LOW);
-   // Servo motor
-   servoMotor.write(servoBackward); // put Servo motor in backward position.
-} // goBackward()
+   static char msg[1024];
+#if taskStats == 1
+   size_t length = statsFormat(allStats, sizeof(allStats) / sizeof(allStats[0]), 
+                               statsOverhead, msg, sizeof(msg));
+#else
+   size_t length = snprintf(msg, sizeof(msg), "stats off, build with TASK_STATS=1");
+#endif
+   int added = snprintf(msg + length, sizeof(msg) - length, 
+      "\nqueue depth/drops/coalesced %u/%lu/%lu\nloop stall max %lu us"
+      "\nlog spool pending/written/flushes/dropped %lu/%lu/%lu/%lu"
+      "\nlog lines rate limited/collapsed %lu/%lu"
+      "\nrecorder state/entries/bytes/cycles %u/%u/%u/%lu, replay late p50/p99/max %lu/%lu/%lu us"
+      "\npublish queue depth/bytes/high %u/%u/%u, drops control/telemetry/log %lu/%lu/%lu"
+      "\npublish latency p99/max control %lu/%lu telemetry %lu/%lu log %lu/%lu us"
+      "\nsafety state/deadman %u/%lu ms, trips deadman/estop %lu/%lu, late max %lu us, cut max %lu us"
+      "\nudp port %u accepted/unknown/stale/busy/malformed %lu/%lu/%lu/%lu/%lu"
+      "\nheap free/min/largest %lu/%lu/%lu bytes",
+      commandQueue.getDepth(), (unsigned long)commandQueue.getDrops(), 
+      (unsigned long)commandQueue.getCoalesced(), loopStallMax,
+      (unsigned long)logSpool.getPending(), (unsigned long)logSpool.getBytesWritten(),
+      (unsigned long)logSpool.getFlushes(), (unsigned long)logSpool.getDroppedBytes(),
+      (unsigned long)logLimit.getDropped(), (unsigned long)mqttLogger.getCollapsed(),
+      commandRecorder.getState(), commandRecorder.getEntries(), commandRecorder.getLength(),
+      (unsigned long)commandRecorder.getCycles(), 
+      (unsigned long)commandRecorder.getLateness().getPercentile(50),
+      (unsigned long)commandRecorder.getLateness().getPercentile(99),
+      (unsigned long)commandRecorder.getLateness().getMax(),
+      publishQueue.getDepth(), publishQueue.getQueuedBytes(), publishQueue.getHighWaterMark(),
+      (unsigned long)publishQueue.getDrops(PUB_CONTROL), (unsigned long)publishQueue.getDrops(PUB_TELEMETRY),
+      (unsigned long)publishQueue.getDrops(PUB_LOG),
+      (unsigned long)publishQueue.getLatency(PUB_CONTROL).getPercentile(99), 
+      (unsigned long)publishQueue.getLatency(PUB_CONTROL).getMax(),
+      (unsigned long)publishQueue.getLatency(PUB_TELEMETRY).getPercentile(99), 
+      (unsigned long)publishQueue.getLatency(PUB_TELEMETRY).getMax(),
+      (unsigned long)publishQueue.getLatency(PUB_LOG).getPercentile(99), 
+      (unsigned long)publishQueue.getLatency(PUB_LOG).getMax(),
+      safetyStop.getCause(), (unsigned long)safetyStop.getDeadmanMs(), 
+      (unsigned long)safetyStop.getTrips(SAFETY_DEADMAN), (unsigned long)safetyStop.getTrips(SAFETY_ESTOP),
+      (unsigned long)safetyStop.getLateMaxUs(), (unsigned long)safetyStop.getCutMaxUs(),
+      udpControl.getPort(), (unsigned long)udpControl.getCount(UDP_ACCEPTED), 
+      (unsigned long)udpControl.getCount(UDP_UNKNOWN), (unsigned long)udpControl.getCount(UDP_STALE),
+      (unsigned long)udpControl.getCount(UDP_BUSY), (unsigned long)udpControl.getMalformed(),
+      (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), 
+      (unsigned long)ESP.getMaxAllocHeap());
+   if(added > 0 && length + added < sizeof(msg))
+   {
+      length += added;
+   } // if
+   else
+   {
+      msg[length] = '\0'; // Drop the partial lines.
+   } // else
+   publishQueue.publish(PUB_CONTROL, mqttResponseTopic, (const uint8_t*)msg, length);
+   if(reset)
+   {
+      for(TaskStat* stat : allStats)
+      {
+         stat->requestReset();
+      } // for
+   } // if
+} // publishTaskStats()
 
 /**
- * @brief Simple little routine to spin DC motors forward and backward for 
- * testing. Not used, just here to show all the commands in one spot.
+ * @brief Handle forward, every motor and the servo one way.
+ * 
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
  */
-void motorControl()
+void handleForward(uint8_t arg, const char* value, uint16_t length)
 {
-//   stop();
-//   delay(1000);
-//   goForward();
-//   delay(1000);
-//   stop();
-//   delay(1000);
-//   goBackward();
-//   delay(1000);
-} // motorControl()
+   goForward();
+} // handleForward()
 
 /**
- * @brief Standard Arduino start up function.
+ * @brief Handle backward, every motor and the servo the other way.
  * 
- * @param NA No parameters are passed in.
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
  * 
  * @return NA No return value.
  */
-void setup()
+void handleBackward(uint8_t arg, const char* value, uint16_t length)
 {
-   Serial.begin(serialBaudRate);
-   LOGLN("Start of setup.");
-   LOGLN("Initialized Wifi interface.");   
-   wifiConnect();
-   LOGLN("Connect to MQTT broker.");   
-   client.setServer(mqttServer, mqttPort);
-   LOGLN("Initialized scheduler");
-   runner.init();
-   // Add tasks to scheduler.
-   LOG("Add t1 task to send keep-alive messages every ");
-   LOGNF(keepAlive);
-   LOGLNF(" milliseconds.");
-   runner.addTask(t1); 
-   
-   LOG("Add task t2 to check for incoming MQTT messages every ");
-   LOGNF(keepAlive);
-   LOGLNF(" milliseconds.");
-   runner.addTask(t2);
-   
-//   LOG("Add task t3 to check for OTA messages every ");
-//   LOGNF(keepAlive);
-//   LOGLNF(" milliseconds.");
-//   runner.addTask(t3); 
+   goBackward();
+} // handleBackward()
 
-   LOG("Add task t4 to manage motors every ");
-   LOGNF(keepAlive);
-   LOGLNF(" milliseconds.");
-   runner.addTask(t4); 
+/**
+ * @brief Handle stop, on the command topic or the stop/set topic.
+ * 
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleStop(uint8_t arg, const char* value, uint16_t length)
+{
+   commandQueue.requestStop(); // Jumps ahead of anything queued.
+} // handleStop()
 
-   LOGLN("Wait 5 seconds for task setup to complete.");
-   delay(5000);
+/**
+ * @brief Handle jitter.
+ * 
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleJitter(uint8_t arg, const char* value, uint16_t length)
+{
+   publishControlJitter();
+} // handleJitter()
 
-   // Enabe tasks in scheduler.
-   LOG("Enable t1 task to send keep-alive messages every ");
-   LOGNF(keepAlive);
-   LOGLNF(" milliseconds.");   
-   t1.enable();
+/**
+ * @brief Handle alive, the heartbeat an operator sends to keep open ended
+ * motion going without sending commands.
+ * 
+ * @details Every valid command feeds the deadman in mqttIncomingCallback(),
+ * so there is nothing more to do.
+ * 
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleAlive(uint8_t arg, const char* value, uint16_t length)
+{
+} // handleAlive()
 
-   LOGLN("Enabled t2 to check for incoming MQTT messages every ");
-   LOGNF(keepAlive);
-   LOGLNF(" milliseconds.");   
-   t2.enable();
+/**
+ * @brief Handle stats and stats,reset.
+ * 
+ * @param arg Not used.
+ * @param value reset to start new measurements.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleStats(uint8_t arg, const char* value, uint16_t length)
+{
+   publishTaskStats(strcmp(value, "reset") == 0);
+} // handleStats()
 
-//   LOGLN("Enabling OTA Feature.");
+#if positionFeedback == 1
+/**
+ * @brief Handle move,<axis>,<counts>[,<duty>] and the coordinated 
+ * move,<name>=<number>,... form.
+ * 
+ * @details A first field with an = in it makes the move coordinated, see 
+ * queueSync().
+ * 
+ * @param arg Not used.
+ * @param value Everything after move.
+ * @param length Characters in value.
+ * 
+ * @return NA No return value.
+ */
+void handleMove(uint8_t arg, const char* value, uint16_t length)
+{
+   if(memchr(value, '=', routeField(value, length)) != NULL)
+   {
+      if(!queueSync(value, length))
+      {
+         LOGLN("Bad move, expected move,<axis>=<counts>,...[,servo=<angle>][,ms=<ms>][,duty=<duty>] or a move under way.");
+      } // if
+   } // if
+   else if(!queueMove(value, length))
+   {
+      LOGLN("Bad move, expected move,<axis>,<counts>[,<duty>].");
+   } // else if
+} // handleMove()
+
+/**
+ * @brief Handle where.
+ * 
+ * @param arg Not used.
+ * @param value Not used.
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleWhere(uint8_t arg, const char* value, uint16_t length)
+{
+   publishPosition();
+} // handleWhere()
+#endif
+
+/**
+ * @brief Handle record[,stop|save|load|dump].
+ * 
+ * @param arg Not used.
+ * @param value Empty to start recording, otherwise see recordControl().
+ * @param length Not used.
+ * 
+ * @return NA No return value.
+ */
+void handleRecord(uint8_t arg, const char* value, uint16_t length)
+{
+   recordControl(value);
+} // handleRecord()
+
+/**
+ * @brief Handle replay[,<cycles>|stop]. Cycles defaults to 1, 0 repeats
+ * until stopped.
+ * 
+ * @param arg Not used.
+ * @param value Cycles or stop.
+ * @param length Characters in value.
+ * 
+ * @return NA No return value.
+ */
+void handleReplay(uint8_t arg, const char* value, uint16_t length)
+{
+   int32_t cycles = 1;
+   if(strcmp(value, "stop") == 0)
+   {
+      commandRecorder.stopReplay();
+   } // if
+   else if(length > 0 && (!routeNumber(value, length, cycles) || cycles < 0 || cycles > UINT16_MAX))
+   {
+      LOGLN("Bad replay, expected replay[,<cycles>|stop].");
+   } // else if
+   else if(!commandRecorder.startReplay(cycles))
+   {
+      LOGLN("Cannot replay, nothing recorded or recorder busy.");
+   } // else if
+} // handleReplay()
+
+/**
+ * @brief Handle a setpoint for one actuator, from <axis>,<value> or pos,<angle>
+ * on the command topic or from a plain number on <axis>/set. A value out of
+ * range for the actuator is rejected, see setpointInRange().
+ * 
+ * @param arg Actuator, see enum actuator.
+ * @param value Signed duty for a DC axis, angle for the servo.
+ * @param length Characters in value.
+ * 
+ * @return NA No return value.
+ */
+void handleSetpoint(uint8_t arg, const char* value, uint16_t length)
+{
+   int32_t setpoint;
+   if(!routeNumber(value, length, setpoint))
+   {
+      LOGLN("Bad setpoint, expected a number.");
+      return;
+   } // if
+   if(!setpointInRange(arg, setpoint))
+   {
+      LOGLN("Setpoint out of range.");
+      return;
+   } // if
+   commandQueue.push(arg, setpoint); // Ramped by t4.
+} // handleSetpoint()
+
+/**
+ * @brief Handle the axes/set group topic, one signed duty for every DC axis
+ * applied in the same control tick. A duty out of range is rejected.
+ * 
+ * @param arg Not used.
+ * @param value Signed duty.
+ * @param length Characters in value.
+ * 
+ * @return NA No return value.
+ */
+void handleAxes(uint8_t arg, const char* value, uint16_t length)
+{
+   int32_t duty;
+   if(!routeNumber(value, length, duty))
+   {
+      LOGLN("Bad setpoint, expected a number.");
+      return;
+   } // if
+   if(!setpointInRange(ACT_SLEW, duty))
+   {
+      LOGLN("Setpoint out of range.");
+      return;
+   } // if
+   bool queued = true;
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      queued = queued && commandQueue.stage(i, duty);
+   } // for
+   if(queued)
+   {
+      commandQueue.commit();
+   } // if
+   else
+   {
+      commandQueue.abandon(); // Never apply half a group.
+      LOGLN("Command queue full.");
+   } // else
+} // handleAxes()
+
+// Topics below "<clientID>/". The cmd route has no handler, its payload is
+// "<command>[,<value>]" and the command word is looked up in commandRoutes.
+// Every <name>/set topic arrives through one <clientID>/+/set subscription.
+const topicRoute topicRoutes[] = 
+{
+   ROUTE("cmd", NULL, 0, &cmdUnknownStat),
+   ROUTE("slew/set", &handleSetpoint, ACT_SLEW, &cmdAxisStat),
+   ROUTE("hoist/set", &handleSetpoint, ACT_HOIST, &cmdAxisStat),
+   ROUTE("luff/set", &handleSetpoint, ACT_LUFF, &cmdAxisStat),
+   ROUTE("servo/set", &handleSetpoint, ACT_SERVO, &cmdAxisStat),
+   ROUTE("axes/set", &handleAxes, 0, &cmdAxisStat),
+   ROUTE("stop/set", &handleStop, 0, &cmdStopStat)
+}; // topicRoutes
+
+// Command words on the cmd topic. The axis names match the MotorDriver names.
+const topicRoute commandRoutes[] = 
+{
+   ROUTE("forward", &handleForward, 0, &cmdMoveStat),
+   ROUTE("backward", &handleBackward, 0, &cmdMoveStat),
+   ROUTE("stop", &handleStop, 0, &cmdStopStat),
+   ROUTE("jitter", &handleJitter, 0, &cmdReportStat),
+   ROUTE("stats", &handleStats, 0, &cmdReportStat),
+   ROUTE("alive", &handleAlive, 0, &cmdReportStat),
+#if positionFeedback == 1
+   ROUTE("move", &handleMove, 0, &cmdAxisStat),
+   ROUTE("where", &handleWhere, 0, &cmdReportStat),
+#endif
+   ROUTE("record", &handleRecord, 0, &cmdRecordStat),
+   ROUTE("replay", &handleReplay, 0, &cmdRecordStat),
+   ROUTE("pos", &handleSetpoint, ACT_SERVO, &cmdAxisStat),
+   ROUTE("servo", &handleSetpoint, ACT_SERVO, &cmdAxisStat),
+   ROUTE("slew", &handleSetpoint, ACT_SLEW, &cmdAxisStat),
+   ROUTE("hoist", &handleSetpoint, ACT_HOIST, &cmdAxisStat),
+   ROUTE("luff", &handleSetpoint, ACT_LUFF, &cmdAxisStat)
+}; // commandRoutes
+
+TopicRouter topicRouter; // Looks up topicRoutes.
+TopicRouter commandRouter; // Looks up commandRoutes.
+
+/**
+ * @brief Call back function to process incoming MQTT messages.
+ * 
+ * @param topic The MQTT topic that the incomming message was sent to.
+ * @param payload The content of the incoming MQTT message.
+ * @param length The length of the incoming message.
+ * 
+ * @return NA No return value.
+ */
+void mqttIncomingCallback(char* topic, byte* payload, unsigned int length) 
+{
+   mqttMessageSeen = true;
+   dispatchCommand(topic + min(strlen(topic), mqttTopicPrefix), payload, length);
+} // mqttIncomingCallback()
+
+/**
+ * @brief Process a command, from MQTT or from a UDP datagram.
+ * 
+ * @details The topic below the client ID picks a route, and on the command
+ * topic the first comma separated word of the payload picks a second one.
+ * Both lookups are hashed, so every command costs the same to find. A JSON
+ * batch is only taken on the command topic. The payload is used where it 
+ * lies in the receive buffer and numbers are read with routeNumber(), so 
+ * nothing here uses the heap apart from logging.
+ * Every message that finds a route, and every accepted batch, feeds the 
+ * deadman.
+ * 
+ * @param name Topic below "<clientID>/", zero terminated.
+ * @param payload The content of the message, with room for a zero after it.
+ * @param length The length of the message.
+ * 
+ * @return False if the command is not known or the batch was rejected.
+ */
+bool dispatchCommand(const char* name, byte* payload, unsigned int length) 
+{
+   STAT_SCOPE(cmdUnknownStat);
+   const topicRoute* route = topicRouter.find(name, strlen(name));
+   if(route != NULL && route->handler == NULL && length > 0 && payload[0] == '[')
+   {
+      STAT_ATTRIBUTE(cmdBatchStat);
+#if taskStats == 1
+      uint32_t start = statsNow();
+      uint8_t count = queueBatch(payload, length);
+      cmdBatchItemStat.record((statsNow() - start) / max(count, (uint8_t)1));
+#else
+      uint8_t count = queueBatch(payload, length);
+#endif
+      if(count > 0)
+      {
+         safetyStop.feed();
+      } // if
+      return count > 0;
+   } // if
+   payload[length] = '\0';
+   const char* value = (const char*)payload;
+   LOG("Received message: ");
+   LOGNF(name);
+   LOGNF(" ");
+   LOGLNF(value);
+   if(route != NULL && route->handler == NULL)
+   {
+      uint16_t wordLength = routeField(value, length);
+      route = commandRouter.find(value, wordLength);
+      uint16_t skip = min((unsigned int)wordLength + 1, length);
+      value += skip;
+      length -= skip;
+   } // if
+   if(route == NULL)
+   {
+      LOGLN("Unknown command.");
+      return false;
+   } // if
+   safetyStop.feed(); // A valid command, the operator is still there.
+   // Commands are only parsed and queued here. Task t4 acts on them.
+   STAT_ATTRIBUTE(*route->stat);
+   route->handler(route->arg, value, length);
+   return true;
+} // dispatchCommand()
+
+/**
+ * @brief Returns the password for an Access Point.
+ * 
+ * @details The SSID hashes in apSecrets are worked out at compile time so 
+ * this hashes the name once and compares integers, only falling back to a 
+ * string compare to rule out a hash collision.
+ * 
+ * @param lAP SSID to use to look up the password.
+ * 
+ * @return Access Point password. If the AP is not known return NULL.
+ */
+const char* getPassword(const char* lAP)
+{
+   uint32_t hash = fnv1a(lAP);
+   for(const apKeyAndValue_t& secret : apSecrets)
+   {
+      if(secret.ssidHash == hash && strcmp(secret.ssid, lAP) == 0)
+      {
+         return secret.pwd;
+      } // if
+   } // for
+   return NULL;
+} // getPassword()
+
+/**
+ * @brief Returns a string contaning a unique ID for this device.
+ * 
+ * @details The ID is the device type followed by the station MAC address. 
+ * It is built into clientID on the first call and the same text returned 
+ * after that, so reconnecting to the broker never touches the heap.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return uniqueID Text contianing a unique ID for ths device.
+ */
+const char* getUniqueID()
+{
+   if(clientID[0] == '\0')
+   {
+      uint8_t mac[6];
+      WiFi.macAddress(mac);
+      snprintf(clientID, sizeof(clientID), "%s%02X:%02X:%02X:%02X:%02X:%02X", deviceType, 
+               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+   } // if
+   return clientID;
+} // getUniqueID()
+
+/**
+ * @brief Name of a WiFi authentication mode for the logs.
+ * 
+ * @param mode Authentication mode reported by the scan.
+ * 
+ * @return Short printable name.
+ */
+const char* authName(wifi_auth_mode_t mode)
+{
+   switch(mode)
+   {
+      case WIFI_AUTH_OPEN: return "open";
+      case WIFI_AUTH_WEP: return "WEP";
+      case WIFI_AUTH_WPA_PSK: return "WPA";
+      case WIFI_AUTH_WPA2_PSK: return "WPA2";
+      case WIFI_AUTH_WPA_WPA2_PSK: return "WPA+WPA2";
+      case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2-EAP";
+      case WIFI_AUTH_WPA3_PSK: return "WPA3";
+      case WIFI_AUTH_WPA2_WPA3_PSK: return "WPA2+WPA3";
+      case WIFI_AUTH_WAPI_PSK: return "WAPI";
+      default: return "unknown";
+   } // switch()
+} // authName()
+
+/**
+ * @brief Pick the best known Wifi Access Point from a completed scan, put it
+ * in a global structure.
+ * 
+ * @details One log line is written per network. Networks that are not in 
+ * apSecrets are reported but never chosen.
+ * 
+ * @param n The number of networks found by the scan.
+ * 
+ * @return True if a known AP is found and False if not.
+ */
+bool scanForAp(int n)
+{
+   bool validAP = false;
+   ap.rssi = -99; // Initialize RSSI to indicating no AP found.
+   snprintf(ap.ssid, sizeof(ap.ssid), "null"); // Initilize SSID to indicate no AP found.
+   LOG("Scan complete. Networks found: ");
+   LOGLNF(n);
+   for (int i = 0; i < n; ++i) 
+   {
+      String ssid = WiFi.SSID(i); // Only while scanning, the core has no other way.
+      int32_t slvl = WiFi.RSSI(i);
+      const char* password = getPassword(ssid.c_str());
+      LOG("   ");
+      LOGNF(ssid);
+      LOGNF(" RSSI ");
+      LOGNF(slvl);
+      LOGNF(" channel ");
+      LOGNF(WiFi.channel(i));
+      LOGNF(" auth ");
+      LOGNF(authName(WiFi.encryptionType(i)));
+      LOGLNF(password != NULL ? " known" : " unknown");
+      if(password != NULL && slvl > ap.rssi) // Save known AP with best RSSI.
+      {
+         validAP = true;
+         ap.rssi = slvl;
+         snprintf(ap.ssid, sizeof(ap.ssid), "%s", ssid.c_str());
+         ap.password = password;
+         ap.channel = WiFi.channel(i);
+         ap.encryptionType = WiFi.encryptionType(i);
+         memcpy(ap.bssid, WiFi.BSSID(i), sizeof(ap.bssid));
+      } // if
+   } // for
+   return validAP;
+} // scanForAp()
+
+/**
+ * @brief Load the last Access Point we got an IP address from.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return True if a cached AP that is still in apSecrets was loaded.
+ */
+bool loadApCache()
+{
+   apCache.begin("apCache", true);
+   char ssid[sizeof(ap.ssid)] = "";
+   apCache.getString("ssid", ssid, sizeof(ssid));
+   size_t bssidLen = apCache.getBytes("bssid", ap.bssid, sizeof(ap.bssid));
+   ap.channel = apCache.getUChar("channel", 0);
+   ap.encryptionType = (wifi_auth_mode_t)apCache.getUChar("auth", WIFI_AUTH_OPEN);
+   apCache.end();
+   const char* password = getPassword(ssid);
+   if(password == NULL || bssidLen != sizeof(ap.bssid) || ap.channel == 0)
+   {
+      return false;
+   } // if
+   snprintf(ap.ssid, sizeof(ap.ssid), "%s", ssid);
+   ap.password = password;
+   return true;
+} // loadApCache()
+
+/**
+ * @brief Remember the Access Point we just got an IP address from.
+ * 
+ * @details Flash is only written when something changed, so a normal boot 
+ * through the cached AP costs no NVS wear.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void saveApCache()
+{
+   uint8_t cachedBssid[6] = {0};
+   char cachedSsid[sizeof(ap.ssid)] = "";
+   apCache.begin("apCache", false);
+   apCache.getBytes("bssid", cachedBssid, sizeof(cachedBssid));
+   apCache.getString("ssid", cachedSsid, sizeof(cachedSsid));
+   if(strcmp(cachedSsid, ap.ssid) != 0
+      || memcmp(cachedBssid, ap.bssid, sizeof(cachedBssid)) != 0
+      || apCache.getUChar("channel", 0) != ap.channel
+      || apCache.getUChar("auth", WIFI_AUTH_OPEN) != ap.encryptionType)
+   {
+      apCache.putString("ssid", ap.ssid);
+      apCache.putBytes("bssid", ap.bssid, sizeof(ap.bssid));
+      apCache.putUChar("channel", ap.channel);
+      apCache.putUChar("auth", ap.encryptionType);
+      LOGLN("Saved Access Point to the fast connect cache.");
+   } // if
+   apCache.end();
+} // saveApCache()
+
+/**
+ * @brief Schedule the next connection attempt after an exponential back-off.
+ * 
+ * @details The delay doubles on every consecutive failure from 
+ * NET_BACKOFF_MIN up to NET_BACKOFF_MAX milli-seconds. Up to a quarter of the
+ * delay is added as random jitter so a fleet of cranes does not retry in 
+ * lock step after a broker restart.
+ * 
+ * @param retryState The state to resume in once the back-off expires.
+ * 
+ * @return NA No return value.
+ */
+void netBackOff(netState retryState)
+{
+   unsigned long wait = netBackOffDelay + random(netBackOffDelay / 4 + 1);
+   LOG("Retry in ");
+   LOGNF(wait);
+   LOGLNF(" milliseconds.");
+   netRetryAt = millis() + wait;
+   netRetryState = retryState;
+   netBackOffDelay = min(netBackOffDelay * 2, netBackOffMax);
+   net = NET_BACKOFF;
+} // netBackOff()
+
+/**
+ * @brief Bring up and supervise the WiFi and MQTT broker connection.
+ * 
+ * @details Runs as scheduled task t6. Each call does at most one short step
+ * and returns, so the other tasks keep their cadence while the network is 
+ * down. The states advance as follows:
+ * 0. NET_FAST_CONNECT : WiFi.begin() straight to the cached SSID, BSSID and 
+ *    channel. If that fails, scan only the cached channel, then all channels.
+ * 1. NET_SCAN_START : Start an asynchronous scan for Access Points.
+ * 2. NET_SCANNING : Wait for the scan, pick the best known AP, WiFi.begin().
+ * 3. NET_ASSOCIATING : Wait for the AP to accept us.
+ * 4. NET_DHCP : Wait for an IP address.
+ * 5. NET_BROKER_CONNECT : Connect to the MQTT broker. This is the one step 
+ *    that blocks, bounded by the MQTT socket timeout.
+ * 6. NET_SUBSCRIBE : Subscribe to the command topic.
+ * 7. NET_ONLINE : Watch for loss of WiFi or broker.
+ * Any failure goes through NET_BACKOFF before it is retried.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void networkManager()
+{
+   STAT_SCOPE(networkStat);
+   switch(net)
+   {
+      case NET_FAST_CONNECT:
+         netConnectStart = millis();
+         netScanChannel = 0;
+         if(!loadApCache())
+         {
+            net = NET_SCAN_START;
+            break;
+         } // if
+         LOG("Fast connect to cached Access Point ");
+         LOGNF(ap.ssid);
+         LOGNF(" on channel ");
+         LOGLNF(ap.channel);
+         WiFi.begin(ap.ssid, ap.password, ap.channel, ap.bssid);
+         netAttempt = "fast connect";
+         netScanChannel = ap.channel; // Fallback is a single channel scan.
+         netStepStart = millis();
+         net = NET_ASSOCIATING;
+         break;
+      case NET_SCAN_START:
+         LOG("Scan for nearby Access Points on channel ");
+         LOGLNF(netScanChannel); // 0 means all channels.
+         WiFi.scanNetworks(true, false, false, 300, netScanChannel); // Asynchronous, poll scanComplete().
+         netAttempt = (netScanChannel == 0) ? "full scan" : "channel scan";
+         net = NET_SCANNING;
+         break;
+      case NET_SCANNING:
+      {
+         int n = WiFi.scanComplete();
+         if(n == WIFI_SCAN_RUNNING)
+         {
+            break;
+         } // if
+         bool found = (n > 0) && scanForAp(n);
+         WiFi.scanDelete(); // Delete the scan result to free memory.
+         if(!found && netScanChannel != 0)
+         {
+            LOGLN("No known Access Point on that channel.");
+            netScanChannel = 0; // Widen to a full scan straight away.
+            net = NET_SCAN_START;
+            break;
+         } // if
+         if(!found)
+         {
+            LOGLN("No network Access Point found.");
+            netBackOff(NET_FAST_CONNECT);
+            break;
+         } // if
+         LOG("Connecting to WiFi. SSID: ");
+         LOGLNF(ap.ssid);
+         WiFi.begin(ap.ssid, ap.password, ap.channel, ap.bssid);
+         netScanChannel = 0; // Any further fallback is a full scan.
+         netStepStart = millis();
+         net = NET_ASSOCIATING;
+         break;
+      } // case
+      case NET_ASSOCIATING:
+         if(WiFi.status() == WL_CONNECTED)
+         {
+            net = NET_DHCP;
+         } // if
+         else if(netScanChannel != 0 && millis() - netStepStart > netFastTimeout)
+         {
+            LOGLN("Fast connect failed.");
+            WiFi.disconnect();
+            net = NET_SCAN_START; // Scan the cached channel next.
+         } // else if
+         else if(millis() - netStepStart > netStepTimeout)
+         {
+            LOGLN("WiFi association timed out.");
+            WiFi.disconnect();
+            netBackOff(NET_FAST_CONNECT);
+         } // else if
+         break;
+      case NET_DHCP:
+         if((uint32_t)WiFi.localIP() != 0)
+         {
+            uint32_t ip = WiFi.localIP(); // First octet in the low byte.
+            char ipText[16];
+            snprintf(ipText, sizeof(ipText), "%u.%u.%u.%u", (unsigned)(ip & 0xFF), 
+                     (unsigned)((ip >> 8) & 0xFF), (unsigned)((ip >> 16) & 0xFF), (unsigned)(ip >> 24));
+            LOG("WiFi connected. Assigned IP address: ");
+            LOGLNF(ipText);
+            LOG("Time to IP in milli-seconds using ");
+            LOGNF(netAttempt);
+            LOGNF(" = ");
+            LOGLNF(millis() - netConnectStart);
+            saveApCache();
+            if(udpControl.start())
+            {
+               LOG("Listening for UDP commands on port ");
+               LOGLNF(udpControl.getPort());
+            } // if
+            net = NET_BROKER_CONNECT;
+         } // if
+         else if(millis() - netStepStart > netStepTimeout)
+         {
+            LOGLN("DHCP timed out.");
+            WiFi.disconnect();
+            netBackOff(NET_FAST_CONNECT);
+         } // else if
+         break;
+      case NET_BROKER_CONNECT:
+         if(WiFi.status() != WL_CONNECTED)
+         {
+            netBackOff(NET_FAST_CONNECT);
+            break;
+         } // if
+         getUniqueID();
+         LOG("Attempting MQTT connection as ");
+         LOGNF(clientID);
+         LOGNF("...");
+         snprintf(mqttStatusTopic, sizeof(mqttStatusTopic), "%s/status", clientID);
+         if(client.connect(clientID, NULL, NULL, mqttStatusTopic, 1, true, "offline"))
+         {
+            // as we have a connection here, this will be the first message published to the mqtt server
+            LOGLNF("connected."); 
+            net = NET_SUBSCRIBE;
+         } // if
+         else
+         {
+            LOG("failed, rc=");
+            LOGLNF(client.state());
+            netBackOff(NET_BROKER_CONNECT);
+         } // else
+         break;
+      case NET_SUBSCRIBE:
+         snprintf(mqttCommandTopic, sizeof(mqttCommandTopic), "%s/cmd", clientID);
+         snprintf(mqttResponseTopic, sizeof(mqttResponseTopic), "%s/rsp", clientID);
+         snprintf(mqttTelemetryTopic, sizeof(mqttTelemetryTopic), "%s/tel", clientID);
+         snprintf(mqttSetTopic, sizeof(mqttSetTopic), "%s/+/set", clientID);
+         mqttTopicPrefix = strlen(clientID) + 1;
+         client.setCallback(mqttIncomingCallback);
+         if(client.subscribe(mqttCommandTopic) && client.subscribe(mqttSetTopic))
+         {
+            char status[32];
+            snprintf(status, sizeof(status), "online %s", buildVersion);
+            publishQueue.publish(PUB_CONTROL, mqttStatusTopic, status, true); // Replaces the last will.
+            netBackOffDelay = netBackOffMin; // Healthy again.
+            net = NET_ONLINE;
+         } // if
+         else
+         {
+            LOGLN("Subscribe failed.");
+            client.disconnect();
+            netBackOff(NET_BROKER_CONNECT);
+         } // else
+         break;
+      case NET_ONLINE:
+         if(WiFi.status() != WL_CONNECTED)
+         {
+            LOGLN("WiFi connection lost.");
+            client.disconnect();
+            netBackOff(NET_FAST_CONNECT);
+         } // if
+         else if(!client.connected())
+         {
+            LOG("MQTT connection lost, rc=");
+            LOGLNF(client.state());
+            netBackOff(NET_BROKER_CONNECT);
+         } // else if
+         break;
+      case NET_BACKOFF:
+         if((long)(millis() - netRetryAt) >= 0)
+         {
+            netStepStart = millis();
+            net = netRetryState;
+         } // if
+         break;
+   } // switch()
+} // networkManager()
+
+/**
+ * @brief Find the actuator for an axis name.
+ * 
+ * @param name Axis name as used in commands ("slew", "hoist" or "luff"),
+ *        need not be zero terminated.
+ * @param length Characters in name.
+ * 
+ * @return Actuator index (also the index into motors[]), or -1 if there is 
+ *         no such axis.
+ */
+int8_t findActuator(const char* name, size_t length)
+{
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      if(strncmp(motors[i]->getName(), name, length) == 0 && motors[i]->getName()[length] == '\0')
+      {
+         return i;
+      } // if
+   } // for
+   return -1;
+} // findActuator()
+
+/**
+ * @brief Check a setpoint against what its actuator can take. Every command
+ * path checks with this before queueing a setpoint.
+ * 
+ * @param actuator Actuator, see enum actuator.
+ * @param value Signed duty for a DC axis, angle for the servo.
+ * 
+ * @return True if the value is from -motorMaxDuty to motorMaxDuty for a DC 
+ *         axis or from 0 to 180 for the servo.
+ */
+bool setpointInRange(uint8_t actuator, int32_t value)
+{
+   if(actuator == ACT_SERVO)
+   {
+      return value >= 0 && value <= 180;
+   } // if
+   return actuator < ACT_SERVO && value >= -motorMaxDuty && value <= motorMaxDuty;
+} // setpointInRange()
+
+/**
+ * @brief Parse a JSON command batch and queue it so the motor task applies 
+ * every command in the same control tick.
+ * 
+ * @details A batch is an array of {"m":name,"v":value} objects, for example
+ * [{"m":"hoist","v":40},{"m":"servo","v":120}]. Names are the axis names,
+ * "servo" (or "pos") and "stop", which needs no value. The message is read 
+ * straight out of the PubSubClient receive buffer and the document lives in
+ * jsonPool, so nothing is copied to the heap. ArduinoJson 7 interns the 
+ * names in the pool and they are compared there without building Strings.
+ * The batch is staged and committed in one step. If any entry is unknown, 
+ * has a value that is not a whole number in range for its actuator, a signed
+ * duty for a DC axis or 0 to 180 for the servo, or the queue fills, none of
+ * it is applied. A stop in the batch takes effect 
+ * first and the rest of the batch lands after it.
+ * 
+ * @param payload The MQTT message.
+ * @param length Bytes in payload.
+ * 
+ * @return Number of commands in the batch, 0 if it was rejected.
+ */
+uint8_t queueBatch(byte* payload, unsigned int length)
+{
+   jsonBatch.clear();
+   jsonPool.reset(); // Safe now that the document holds nothing.
+   DeserializationError error = deserializeJson(jsonBatch, payload, length);
+   if(error)
+   {
+      LOG("Bad command batch: ");
+      LOGLNF(error.c_str());
+      return 0;
+   } // if
+   if(!jsonBatch.is<JsonArray>())
+   {
+      LOGLN("Command batch is not an array.");
+      return 0;
+   } // if
+   uint8_t count = 0;
+   bool stopFirst = false;
+   for(JsonVariant item : jsonBatch.as<JsonArray>())
+   {
+      const char* name = item["m"] | "";
+      int32_t value = item["v"].as<int32_t>();
+      int8_t axis = -1;
+      if(strcmp(name, "stop") == 0)
+      {
+         stopFirst = true;
+         count++;
+         continue;
+      } // if
+      else if(strcmp(name, "servo") == 0 || strcmp(name, "pos") == 0)
+      {
+         axis = ACT_SERVO;
+      } // else if
+      else
+      {
+         axis = findActuator(name, strlen(name));
+      } // else
+      if(axis < 0)
+      {
+         commandQueue.abandon();
+         LOG("Unknown command in batch: ");
+         LOGLNF(name);
+         return 0;
+      } // if
+      if(!item["v"].is<int32_t>() || !setpointInRange(axis, value))
+      {
+         commandQueue.abandon();
+         LOG("Bad value in batch for ");
+         LOGLNF(name);
+         return 0;
+      } // if
+      if(!commandQueue.stage(axis, value))
+      {
+         commandQueue.abandon(); // Never apply half a batch.
+         LOGLN("Command queue full.");
+         return 0;
+      } // if
+      count++;
+   } // for
+   if(stopFirst)
+   {
+      commandQueue.requestStop(); // Marks the queue before the batch is committed.
+   } // if
+   commandQueue.commit();
+   return count;
+} // queueBatch()
+
+/**
+ * @brief Queue the same duty for every DC motor plus a servo position as one
+ * batch so the motor task applies them together.
+ * 
+ * @param duty Signed duty for every DC motor.
+ * @param servoPosition Servo angle.
+ * 
+ * @return NA No return value.
+ */
+void queueAll(int16_t duty, int16_t servoPosition)
+{
+   bool queued = true;
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      queued = queued && commandQueue.stage(i, duty);
+   } // for
+   queued = queued && commandQueue.stage(ACT_SERVO, servoPosition);
+   if(queued)
+   {
+      commandQueue.commit();
+   } // if
+   else
+   {
+      commandQueue.abandon(); // Never apply half a batch.
+      LOGLN("Command queue full.");
+   } // else
+} // queueAll()
+
+/**
+ * @brief Ramp all DC motors down to a stop, abandon any counted or 
+ * coordinated move and centre the servo. Called from the motor task.
+ * 
+ */
+void stop() 
+{
+   for(MotorDriver* motor : motors)
+   {
+      motor->setSpeed(0);
+   } // for
+   for(AxisEncoder* encoder : encoders)
+   {
+      encoder->cancel();
+   } // for
+   motionPlanner.cancel();
+   // Servo motor
+   servoMotor.write(servoStop); // Put Servo motor in stop position.
+} // stop()
+
+/**
+ * @brief Queue all motors to spin clockwise (from motor's perspecive).
+ * 
+ */
+void goForward() 
+{
+   queueAll(motorMaxDuty, servoForward);
+} // goForward()
+
+/**
+ * @brief Queue all motors to spin counter-clockwise (from motor's perspecive).
+ * 
+ */
+void goBackward() 
+{
+   queueAll(-motorMaxDuty, servoBackward);
+} // goBackward()
+
+/**
+ * @brief Fixed rate motor control task. Acts on a pending stop first, then
+ * on the newest queued setpoint of each actuator and on whatever a replay
+ * has due, then counts the encoder pulses and runs any counted move, then 
+ * any coordinated move, then moves every DC motor one step along its 
+ * acceleration or deceleration ramp. A plain setpoint for any actuator ends
+ * a coordinated move.
+ * 
+ * @details Runs from task t4 on a single core build and from motorTask() on
+ * a dual core build. It only talks to the network side through commandQueue,
+ * commandRecorder, the encoders, motionPlanner, safetyStop and 
+ * controlPeriodReset, and must never log since the log ring has a single 
+ * producer.
+ * 
+ * While safetyStop has the bridges cut every motor is halted, any counted
+ * or coordinated move or replay is abandoned and every command is dropped.
+ * The servo stays where it is. When the cut is released the motors are 
+ * reconnected at zero speed.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void motorControl()
+{
+   unsigned long startMicros = micros();
+   if(controlPeriodReset)
+   {
+      controlPeriod.reset();
+      controlPeriodReset = false;
+   } // if
+   else if(controlLastMicros != 0)
+   {
+      controlPeriod.record(startMicros - controlLastMicros);
+   } // else if
+   controlLastMicros = startMicros;
+   STAT_SCOPE(motorStat);
+   safetyAction safety = safetyStop.update();
+   if(safety == SAFETY_RESTORED)
+   {
+      for(MotorDriver* motor : motors)
+      {
+         motor->reconnect();
+      } // for
+   } // if
+   bool stopped = commandQueue.takeStop();
+   if(stopped || safety == SAFETY_CUT)
+   {
+      commandRecorder.stopReplay(); // A live stop also ends a replay.
+   } // if
+   if(stopped && safety != SAFETY_CUT)
+   {
+      stop();
+   } // if
+   static syncMove replaySync = {{0, 0, 0}, -1, 0, 0}; // Sync entries replayed so far.
+   int16_t latest[ACT_COUNT];
+   uint8_t changed = commandQueue.collect(latest);
+   if(safety == SAFETY_CUT)
+   {
+      for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+      {
+         encoders[i]->cancel();
+         motors[i]->halt();
+      } // for
+      motionPlanner.cancel();
+      changed = 0; // Nothing moves until the cut is released.
+   } // if
+   recordedCommand replayed;
+   while(commandRecorder.replayNext(startMicros, replayed))
+   {
+      if(replayed.kind == REC_STOP)
+      {
+         stop();
+         changed = 0; // As a live stop, drops the setpoints before it.
+      } // if
+      else if(replayed.kind == REC_MOVE && replayed.actuator < ACT_SERVO)
+      {
+         encoders[replayed.actuator]->requestMove(replayed.value, replayed.duty);
+      } // else if
+      else if(replayed.kind == REC_SETPOINT && replayed.actuator < ACT_COUNT)
+      {
+         latest[replayed.actuator] = replayed.value;
+         changed |= 1 << replayed.actuator;
+      } // else if
+      else if(replayed.kind == REC_SYNC && replayed.actuator < ACT_SERVO)
+      {
+         replaySync.counts[replayed.actuator] = replayed.value;
+      } // else if
+      else if(replayed.kind == REC_SYNC && replayed.actuator == ACT_SERVO)
+      {
+         replaySync.servo = replayed.value;
+      } // else if
+      else if(replayed.kind == REC_SYNC)
+      {
+         replaySync.durationMs = replayed.value;
+         replaySync.duty = replayed.duty;
+         motionPlanner.request(replaySync);
+         replaySync = {{0, 0, 0}, -1, 0, 0};
+      } // else if
+   } // while
+   if(changed != 0)
+   {
+      motionPlanner.cancel();
+   } // if
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      if(changed & (1 << i))
+      {
+         encoders[i]->cancel(); // A plain setpoint ends a counted move.
+         motors[i]->setSpeed(latest[i]);
+      } // if
+   } // for
+   if(changed & (1 << ACT_SERVO))
+   {
+      servoMotor.write(latest[ACT_SERVO]);
+   } // if
+   unsigned long now = millis();
+   unsigned long elapsed = (motorLastUpdate == 0) ? motorControlPeriod : now - motorLastUpdate;
+   motorLastUpdate = now;
+#if positionFeedback == 1
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      encoders[i]->update(*motors[i], elapsed, motorDeceleration);
+   } // for
+   motionPlanner.update(elapsed);
+#endif
+   bool openEnded = false;
+   for(uint8_t i = 0; i < sizeof(motors) / sizeof(motors[0]); i++)
+   {
+      motors[i]->update(elapsed);
+      openEnded |= motors[i]->getSpeed() != 0 && !encoders[i]->isMoving();
+   } // for
+   safetyStop.setOpenEnded(openEnded && !motionPlanner.isMoving() 
+                           && commandRecorder.getState() != RECORDER_REPLAYING);
+} // motorControl()
+
+/**
+ * @brief Run one pass of the scheduler, tracking the longest gap between 
+ * passes.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void runScheduler()
+{
+   unsigned long now = micros();
+   if(loopLastMicros != 0 && now - loopLastMicros > loopStallMax)
+   {
+      loopStallMax = now - loopLastMicros; // Track the worst stall seen.
+   } // if
+   loopLastMicros = now;
+   STAT_SCOPE(loopStat);
+   runner.execute(); // Run the scheduled tasks, including task t6 which 
+                     // keeps the WiFi and MQTT broker connection up.
+} // runScheduler()
+
+#if dualCore == 1
+/**
+ * @brief FreeRTOS task on the protocol core that runs the scheduler, and 
+ * with it WiFi, MQTT and logging.
+ * 
+ * @param parameter Not used.
+ * 
+ * @return NA Never returns.
+ */
+void networkTask(void* parameter)
+{
+   for(;;)
+   {
+      runScheduler();
+      vTaskDelay(1); // Let the idle task on this core feed the watchdog.
+   } // for
+} // networkTask()
+
+/**
+ * @brief FreeRTOS task on the application core that calls motorControl() 
+ * every MOTOR_CONTROL_PERIOD milli-seconds, measured from the previous wake 
+ * time so that a late pass does not push the next one back.
+ * 
+ * @param parameter Not used.
+ * 
+ * @return NA Never returns.
+ */
+void motorTask(void* parameter)
+{
+   TickType_t lastWake = xTaskGetTickCount();
+   for(;;)
+   {
+      vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(motorControlPeriod));
+      motorControl();
+   } // for
+} // motorTask()
+#endif
+
+/**
+ * @brief Standard Arduino start up function.
+ * 
+ * @param NA No parameters are passed in.
+ * 
+ * @return NA No return value.
+ */
+void setup()
+{
+   Serial.begin(serialBaudRate);
+   mqttLogger.setCollapse(logCollapse);
+   LOGLN("Start of setup.");
+   LOGLN("Connect to MQTT broker.");   
+   client.setServer(mqttServer, mqttPort);
+   client.setSocketTimeout(2); // Bound the one blocking connection step.
+   client.setKeepAlive(mqttKeepAlive); // Broker publishes the last will after 1.5x this.
+   telemetry.setLimits(telemetryMaxInterval, telemetryRssiDeadBand);
+#if taskStats == 1
+   statsOverhead = statsCalibrate();
+   LOG("Task timing on, each measurement costs ");
+   LOGNF(statsOverhead);
+   LOGLNF(" counter ticks.");
+#endif
+   LOGLN("Initialized scheduler");
+   runner.init();
+   // Add tasks to scheduler.
+   LOG("Add t1 task to check for telemetry to send every ");
+   LOGNF(telemetryCheck);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t1); 
+   
+   LOG("Add task t2 to check for incoming MQTT messages at most every ");
+   LOGNF(mqttPollMax);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t2);
+   
+//   LOG("Add task t3 to check for OTA messages every ");
+//   LOGNF(1000);
+//   LOGLNF(" milliseconds.");
+//   runner.addTask(t3); 
+
+#if dualCore == 0
+   LOG("Add task t4 to manage motors every ");
+   LOGNF(motorControlPeriod);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t4); 
+#endif
+
+   LOG("Add task t5 to drain the log ring buffer every ");
+   LOGNF(logDrainInterval);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t5); 
+
+   LOGLN("Add task t6 to manage the WiFi and MQTT broker connection.");
+   runner.addTask(t6); 
+
+   LOG("Add task t7 to send queued MQTT messages every ");
+   LOGNF(publishDrainInterval);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t7); 
+
+   LOG("Add task t8 to report safety stops every ");
+   LOGNF(100);
+   LOGLNF(" milliseconds.");
+   runner.addTask(t8); 
+
+   LOGLN("Add task t9 to check for incoming UDP commands.");
+   runner.addTask(t9); 
+
+   LOGLN("Wait 5 seconds for task setup to complete.");
+   delay(5000);
+
+   // Enabe tasks in scheduler.
+   LOG("Enable t1 task to check for telemetry to send every ");
+   LOGNF(telemetryCheck);
+   LOGLNF(" milliseconds.");   
+   t1.enable();
+
+   LOG("Enabled t2 to check for incoming MQTT messages at most every ");
+   LOGNF(mqttPollMax);
+   LOGLNF(" milliseconds.");   
+   t2.enable();
+
+   if(udpPort != 0)
+   {
+      LOG("Enabled t9 to check for UDP commands on port ");
+      LOGNF(udpPort);
+      LOGNF(" at most every ");
+      LOGNF(udpPollMax);
+      LOGLNF(" milliseconds.");   
+      udpControl.begin(udpPort, &dispatchCommand);
+      t9.enable();
+   } // if
+
+//   LOGLN("Enabling OTA Feature.");
 //   ArduinoOTA.setPassword("lonelybinary");
 //   ArduinoOTA.begin();
 
 //   LOGLN("Enabled t3 to check for incoming OTA messages every ");
-//   LOGNF(keepAlive);
+//   LOGNF(1000);
 //   LOGLNF(" milliseconds.");   
 //   t3.enable();
 
-   LOGLN("Set up DC motor control pins.");
-   pinMode(enA1, OUTPUT);
-   pinMode(inA1, OUTPUT);
-   pinMode(inA2, OUTPUT);
-   pinMode(inB1, OUTPUT);
-   pinMode(inB2, OUTPUT);
-   pinMode(inC1, OUTPUT);
-   pinMode(inC2, OUTPUT);
-
-   LOGLN("Set up Servo motor control pin.");
+   LOGLN("Allocate PWM timers for the DC motors and the servo.");
 	// Allow allocation of all timers
 	ESP32PWM::allocateTimer(0);
 	ESP32PWM::allocateTimer(1);
 	ESP32PWM::allocateTimer(2);
 	ESP32PWM::allocateTimer(3);
+
+   LOG("Set up DC motor PWM channels at ");
+   LOGNF(motorPwmFrequency);
+   LOGLNF(" Hz.");
+   for(MotorDriver* motor : motors)
+   {
+      motor->begin(motorPwmFrequency);
+      motor->setRamp(motorAcceleration, motorDeceleration);
+   } // for
+
+#if positionFeedback == 1
+   LOGLN("Count encoder pulses on the DC axes with PCNT units 0 to 2.");
+   for(uint8_t i = 0; i < sizeof(encoders) / sizeof(encoders[0]); i++)
+   {
+      encoders[i]->begin(i);
+      if(!encoders[i]->usesPcnt())
+      {
+         LOG("No PCNT unit, counting with an interrupt for ");
+         LOGLNF(motors[i]->getName());
+      } // if
+   } // for
+   LOG("Plan coordinated moves from a first guess of ");
+   LOGNF(syncRate);
+   LOGLNF(" counts per second at full duty.");
+   motionPlanner.begin(motors, encoders, &servoMotor, motorAcceleration, syncRate, syncTolerance);
+#endif
+
+   LOGLN("Set up Servo motor control pin.");
 	servoMotor.setPeriodHertz(50);    // standard 50 hz servo
 	servoMotor.attach(servoPin, 500, 2400); // attaches the servo on pin 18 to the servo object
    servoMotor.write(servoStop); // Put Servo motor in stop position.
 	// using default min/max of 1000us and 2000us
 	// different servos may require different min/max settings
 	// for an accurate 0 to 180 sweep
-   LOGLN("Enabled t4 to manage motors every ");
-   LOGNF(keepAlive);
+
+   LOG("Cut the bridges on the e-stop input or after ");
+   LOGNF(deadmanMs);
+   LOGLNF(" milliseconds without a command while a motor runs, 0 = never.");
+   safetyStop.begin(allBridgePins, (estopInput == 1) ? estopPin : -1, deadmanMs);
+   t8.enable();
+
+   LOG("Switch to asynchronous logging with a ring buffer of ");
+   LOGNF(logRingSize);
+   LOGLNF(" bytes.");
+   if(logRingSize > 0 && mqttLogger.setAsync(logRingSize))
+   {
+      t5.enable();
+   } // if
+
+   LOG("Keep up to ");
+   LOGNF(logSpoolSize);
+   LOGLNF(" bytes of log lines on flash while offline.");
+   if(logSpoolSize > 0 && LittleFS.begin(true) && logSpool.begin() 
+      && mqttLogger.setSpool(&logSpool, logSpoolRate))
+   {
+      t5.enable(); // Replays the spool, also when logging is synchronous.
+   } // if
+   else if(logSpoolSize > 0)
+   {
+      LOGLN("Log spool unavailable, lines logged while offline are lost.");
+   } // else if
+
+   LOG("Queue up to ");
+   LOGNF(publishQueueSize);
+   LOGLNF(" bytes of outbound MQTT messages.");
+   if(publishQueue.begin(publishQueueSize))
+   {
+      mqttLogger.setQueue(&publishQueue);
+      publishQueue.setWritable(&brokerWritable);
+   } // if
+   t7.enable(); // Also finishes record,dump without a queue.
+
+   LOG("Keep up to ");
+   LOGNF(recordSize);
+   LOGLNF(" bytes of recorded commands for replay.");
+   if(commandRecorder.begin(recordSize))
+   {
+      commandQueue.setRecorder(&commandRecorder);
+      if(LittleFS.begin(true) && commandRecorder.load(LittleFS, recordPath))
+      {
+         LOG("Loaded a recording of ");
+         LOGNF(commandRecorder.getEntries());
+         LOGLNF(" commands from flash.");
+      } // if
+   } // if
+
+   if(!topicRouter.begin(topicRoutes, sizeof(topicRoutes) / sizeof(topicRoutes[0]))
+      || !commandRouter.begin(commandRoutes, sizeof(commandRoutes) / sizeof(commandRoutes[0])))
+   {
+      LOGLN("Too many MQTT routes, raise routerSlots.");
+   } // if
+   LOG("Routing ");
+   LOGNF(commandRouter.getCount());
+   LOGNF(" commands, longest probe ");
+   LOGLNF(commandRouter.getLongestProbe());
+
+   LOGLN("Enable t6 to connect to WiFi and the MQTT broker.");
+   t6.enable();
+
+   // Last, as the motor task uses the command queue and the recorder set up
+   // above from the moment it starts.
+#if dualCore == 1
+   LOG("Start motor task on core ");
+   LOGNF(motorCore);
+   LOGNF(" to manage motors every ");
+   LOGNF(motorControlPeriod);
+   LOGLNF(" milliseconds.");   
+   xTaskCreatePinnedToCore(motorTask, "motor", 4096, NULL, motorTaskPriority, &motorTaskHandle, motorCore);
+   LOG("Start network task on core ");
+   LOGNF(networkCore);
+   LOGLNF(". End of setup.");
+   // Nothing on this core may log once the network task owns the logger.
+   xTaskCreatePinnedToCore(networkTask, "network", 8192, NULL, networkTaskPriority, &networkTaskHandle, networkCore);
+#else
+   LOG("Enabled t4 to manage motors every ");
+   LOGNF(motorControlPeriod);
    LOGLNF(" milliseconds.");   
    t4.enable();
-
    LOGLN("End of setup.");
+#endif
 } // setup()
 
 /** 
  * @brief Standard Arduino main logic loop for this program.
  * 
+ * @details On a dual core build the work has moved to networkTask() and 
+ * motorTask(), so the Arduino loop task removes itself.
+ * 
  * @param NA No parameters are passed in.
  * 
  * @return NA No return value.
  */
 void loop()
 {
-   if (!client.connected()) // Make sure there is an MQTT broker connection.
-   {
-      reconnect(); // If there is no active MQTT broker connection set one up.
-   } // if
-   runner.execute(); // Run the scheduled tasks.
-} // loop()
\ No newline at end of file
+#if dualCore == 1
+   vTaskDelete(NULL);
+#else
+   runScheduler();
+#endif
+} // loop()
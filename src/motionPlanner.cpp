@@ -0,0 +1,393 @@
+#include <motionPlanner.h> // Coordinated moves with synchronised arrival.
+
+/**
+ * @brief Set up the planner. Call before the motor task starts.
+ *
+ * @param motors The DC axes, plannerAxes of them.
+ * @param encoders Their encoders, in the same order.
+ * @param servo The servo.
+ * @param acceleration Motor acceleration in duty per second, 0 for none.
+ * @param fullRate First guess of counts per second at full duty, used for
+ * every axis until it has been measured.
+ * @param tolerance Counts from the target that count as arrived.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::begin(MotorDriver* const* motors, AxisEncoder* const* encoders, Servo* servo,
+                          uint16_t acceleration, uint32_t fullRate, uint16_t tolerance)
+{
+   this->motors = motors;
+   this->encoders = encoders;
+   this->servo = servo;
+   this->acceleration = acceleration;
+   this->tolerance = tolerance;
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      this->fullRate[i] = max(fullRate, (uint32_t)1);
+   } // for
+} // MotionPlanner::begin()
+
+/**
+ * @brief Ask for a coordinated move. Network side.
+ *
+ * @details The motor task takes the move on its next tick. Until then no
+ * other move is accepted.
+ *
+ * @param move Distances, servo angle, duration and highest duty.
+ *
+ * @return False if the move is empty or out of range, or the previous
+ * request has not been taken yet.
+ */
+bool MotionPlanner::request(const syncMove& move)
+{
+   bool any = move.servo >= 0;
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      if(move.counts[i] > encoderMaxMove || move.counts[i] < -encoderMaxMove)
+      {
+         return false;
+      } // if
+      any = any || move.counts[i] != 0;
+   } // for
+   if(!any || move.servo > 180 || move.duty > motorMaxDuty)
+   {
+      return false;
+   } // if
+   uint8_t expected = 0;
+   if(!this->handOver.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+   {
+      return false;
+   } // if
+   this->waiting = move;
+   this->moving = true;
+   this->handOver.store(2, std::memory_order_release);
+   return true;
+} // MotionPlanner::request()
+
+/**
+ * @brief Abandon the move under way and one not yet started. Control side.
+ *
+ * @details Axes of the move that have not arrived are told to stop, unless
+ * a counted move of their own has taken them over.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::cancel()
+{
+   uint8_t expected = 2;
+   this->handOver.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+   if(this->active)
+   {
+      for(uint8_t i = 0; i < plannerAxes; i++)
+      {
+         if(!this->done[i] && !this->encoders[i]->isMoving())
+         {
+            this->motors[i]->setSpeed(0);
+         } // if
+      } // for
+      this->active = false;
+   } // if
+   this->moving = this->handOver.load(std::memory_order_relaxed) != 0;
+} // MotionPlanner::cancel()
+
+/**
+ * @brief Take a waiting move and drive the one under way. Control side,
+ * called every tick after the encoders are updated and before the motor
+ * ramps are.
+ *
+ * @param elapsedMs Milli-seconds since the last call.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::update(uint32_t elapsedMs)
+{
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      this->learnRate(i, elapsedMs);
+   } // for
+   if(this->handOver.load(std::memory_order_acquire) == 2)
+   {
+      syncMove next = this->waiting;
+      this->handOver.store(0, std::memory_order_release);
+      this->plan(next);
+   } // if
+   if(!this->active)
+   {
+      return;
+   } // if
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      if(!this->done[i] && this->encoders[i]->isMoving())
+      {
+         this->cancel(); // A counted move has taken the axis over.
+         return;
+      } // if
+   } // for
+   this->elapsedMs += elapsedMs;
+   float speed = 0;
+   float share = this->profile(this->elapsedMs, speed);
+   this->profile(this->elapsedMs + elapsedMs + plannerLeadMs, speed); // Ahead of the ramp and the motor lag.
+   bool finished = true;
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      if(this->done[i])
+      {
+         continue;
+      } // if
+      int32_t position = this->encoders[i]->getPosition();
+      int32_t target = this->start[i] + this->move.counts[i];
+      int32_t left = (this->move.counts[i] > 0) ? target - position : position - target;
+      int32_t coast = this->encoders[i]->getRate() * plannerLeadMs / 1000; // Still to come once stopped.
+      if(this->elapsedMs >= this->durationMs && left - coast <= (int32_t)this->tolerance)
+      {
+         this->motors[i]->setSpeed(0);
+         this->arrivedMs[i] = this->elapsedMs;
+         this->done[i] = true;
+         continue;
+      } // if
+      if(this->elapsedMs >= this->durationMs + plannerSettleMs)
+      {
+         this->motors[i]->setSpeed(0);
+         this->done[i] = true;
+         this->missed++;
+         continue;
+      } // if
+      float error = this->start[i] + this->move.counts[i] * share - position;
+      float duty = (this->move.counts[i] * speed * 1000.0f + error * 1000.0f / plannerCorrectionMs)
+                   * motorMaxDuty / this->fullRate[i];
+      duty = constrain(duty, (float)-motorMaxDuty, (float)motorMaxDuty);
+      this->motors[i]->setSpeed((int16_t)lroundf(duty));
+      finished = false;
+   } // for
+   if(this->move.servo >= 0 && this->servoAngle != this->move.servo)
+   {
+      if(this->elapsedMs >= this->servoWrittenMs + plannerServoFrameMs || share >= 1.0f)
+      {
+         int16_t angle = this->servoStart + lroundf((this->move.servo - this->servoStart) * share);
+         if(angle != this->servoAngle)
+         {
+            this->servo->write(angle);
+            this->servoAngle = angle;
+         } // if
+         this->servoWrittenMs = this->elapsedMs - this->elapsedMs % plannerServoFrameMs;
+      } // if
+      finished = false;
+   } // if
+   if(finished)
+   {
+      this->finish();
+   } // if
+} // MotionPlanner::update()
+
+/**
+ * @brief Work out the length and ramp time of a move and start it.
+ *
+ * @param move The move.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::plan(const syncMove& move)
+{
+   this->move = move;
+   uint32_t duty = (move.duty > 0) ? move.duty : motorMaxDuty;
+   this->rampMs = (this->acceleration > 0) ? duty * 1000 / this->acceleration : 0;
+   uint32_t cruiseMs = 0;
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      uint64_t distance = abs(move.counts[i]);
+      cruiseMs = max(cruiseMs, (uint32_t)(distance * 1000 * motorMaxDuty / ((uint64_t)this->fullRate[i] * duty)));
+      this->start[i] = this->encoders[i]->getPosition();
+      this->arrivedMs[i] = -1;
+      this->done[i] = move.counts[i] == 0;
+      if(!this->done[i])
+      {
+         this->encoders[i]->cancel(); // The planner drives the axis now.
+      } // if
+   } // for
+   this->durationMs = max(max(move.durationMs, cruiseMs + this->rampMs), (uint32_t)plannerServoFrameMs);
+   this->rampMs = min(this->rampMs, this->durationMs / 2);
+   this->servoStart = this->servo->read();
+   this->servoAngle = this->servoStart;
+   this->servoWrittenMs = 0;
+   this->elapsedMs = 0;
+   this->active = true;
+   this->plannedMs = this->durationMs;
+} // MotionPlanner::plan()
+
+/**
+ * @brief Measure the rate of an axis at full duty once it has held one
+ * duty for plannerSteadyMs.
+ *
+ * @param axis Axis number.
+ * @param elapsedMs Milli-seconds since the last call.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::learnRate(uint8_t axis, uint32_t elapsedMs)
+{
+   int16_t duty = this->motors[axis]->getSpeed();
+   if(duty != this->steadyDuty[axis] || duty != this->motors[axis]->getSetpoint()
+      || abs(duty) < plannerMeasureDuty)
+   {
+      this->steadyDuty[axis] = duty;
+      this->steadyMs[axis] = 0;
+      return;
+   } // if
+   this->steadyMs[axis] += elapsedMs;
+   uint32_t measured = this->encoders[axis]->getRate() * motorMaxDuty / abs(duty);
+   if(this->steadyMs[axis] >= plannerSteadyMs && measured > 0)
+   {
+      this->fullRate[axis] = (this->fullRate[axis] * 7 + measured) / 8;
+   } // if
+} // MotionPlanner::learnRate()
+
+/**
+ * @brief Where the profile is at a time into the move.
+ *
+ * @param atMs Milli-seconds into the move.
+ * @param speed Set to the share of the distance covered per milli-second.
+ *
+ * @return Share of the distance covered, 0 to 1.
+ */
+float MotionPlanner::profile(uint32_t atMs, float& speed)
+{
+   float t = atMs;
+   float total = this->durationMs;
+   float ramp = this->rampMs;
+   if(t >= total)
+   {
+      speed = 0;
+      return 1.0f;
+   } // if
+   float cruise = 1.0f / (total - ramp);
+   if(t < ramp)
+   {
+      speed = cruise * t / ramp;
+      return 0.5f * cruise * t * t / ramp;
+   } // if
+   if(t < total - ramp)
+   {
+      speed = cruise;
+      return cruise * (t - ramp / 2);
+   } // if
+   float left = total - t;
+   speed = cruise * left / ramp;
+   return 1.0f - 0.5f * cruise * left * left / ramp;
+} // MotionPlanner::profile()
+
+/**
+ * @brief Record the skew of the move just finished.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void MotionPlanner::finish()
+{
+   int32_t first = INT32_MAX;
+   int32_t last = -1;
+   for(uint8_t i = 0; i < plannerAxes; i++)
+   {
+      if(this->move.counts[i] != 0 && this->arrivedMs[i] >= 0)
+      {
+         first = min(first, this->arrivedMs[i]);
+         last = max(last, this->arrivedMs[i]);
+      } // if
+   } // for
+   if(last >= 0)
+   {
+      this->lastSkew = last - first;
+      this->skew.record(last - first);
+   } // if
+   this->active = false;
+   this->moves++;
+   this->moving = this->handOver.load(std::memory_order_relaxed) != 0;
+} // MotionPlanner::finish()
+
+/**
+ * @brief Whether a move is waiting or under way.
+ *
+ * @param NA No parameters.
+ *
+ * @return True while moving.
+ */
+bool MotionPlanner::isMoving()
+{
+   return this->moving;
+} // MotionPlanner::isMoving()
+
+/**
+ * @brief Moves finished since start up, cancelled ones not included.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t MotionPlanner::getMoves()
+{
+   return this->moves;
+} // MotionPlanner::getMoves()
+
+/**
+ * @brief Axes that were not at their target plannerSettleMs after the end
+ * of their move.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t MotionPlanner::getMissed()
+{
+   return this->missed;
+} // MotionPlanner::getMissed()
+
+/**
+ * @brief Planned length of the last move, after any stretching.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds.
+ */
+uint32_t MotionPlanner::getPlannedMs()
+{
+   return this->plannedMs;
+} // MotionPlanner::getPlannedMs()
+
+/**
+ * @brief Time between the first and the last axis to arrive in the last
+ * finished move.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds.
+ */
+uint32_t MotionPlanner::getLastSkew()
+{
+   return this->lastSkew;
+} // MotionPlanner::getLastSkew()
+
+/**
+ * @brief Skew of every finished move.
+ *
+ * @param NA No parameters.
+ *
+ * @return Histogram in milli-seconds.
+ */
+LatencyHistogram& MotionPlanner::getSkew()
+{
+   return this->skew;
+} // MotionPlanner::getSkew()
+
+/**
+ * @brief Measured rate of an axis at full duty, or the first guess.
+ *
+ * @param axis Axis number.
+ *
+ * @return Counts per second.
+ */
+uint32_t MotionPlanner::getFullRate(uint8_t axis)
+{
+   return (axis < plannerAxes) ? this->fullRate[axis] : 0;
+} // MotionPlanner::getFullRate()
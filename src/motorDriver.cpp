@@ -0,0 +1,231 @@
+#include <motorDriver.h> // PWM speed control with acceleration ramps.
+
+/**
+ * @brief Construct a new Motor Driver object.
+ *
+ * @param name Axis name used in commands and logs.
+ * @param bridge Type of H-bridge on this channel.
+ * @param in1 Bridge input 1 pin.
+ * @param in2 Bridge input 2 pin.
+ * @param enable Bridge enable pin, -1 if the bridge has none.
+ *
+ * @return NA No return value.
+ */
+MotorDriver::MotorDriver(const char* name, motorBridge bridge, int8_t in1, int8_t in2, int8_t enable)
+{
+   this->name = name;
+   this->bridge = bridge;
+   this->in1 = in1;
+   this->in2 = in2;
+   this->enable = enable;
+   this->in1Mask = gpioMaskOf(in1);
+   this->in2Mask = gpioMaskOf(in2);
+} // MotorDriver::MotorDriver()
+
+/**
+ * @brief Set up the pins and PWM channels and leave the motor stopped.
+ *
+ * @details ESP32PWM::allocateTimer() must have been called before this so
+ * that the LEDC timers are shared with the servo.
+ *
+ * @param frequency PWM frequency in Hz.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::begin(uint32_t frequency)
+{
+   if(this->bridge == BRIDGE_L298N)
+   {
+      pinMode(this->in1, OUTPUT);
+      pinMode(this->in2, OUTPUT);
+      gpioUpdate(this->in1Mask | this->in2Mask, gpioNone);
+      this->pwm1.attachPin(this->enable, frequency, motorPwmResolution);
+   } // if
+   else
+   {
+      this->pwm1.attachPin(this->in1, frequency, motorPwmResolution);
+      this->pwm2.attachPin(this->in2, frequency, motorPwmResolution);
+   } // else
+   this->setpoint = 0;
+   this->speedMilli = 0;
+   this->applied = 1; // Force the first write.
+   this->apply(0);
+} // MotorDriver::begin()
+
+/**
+ * @brief Set the acceleration and deceleration limits.
+ *
+ * @param acceleration Duty units per second when speeding up, 0 = no limit.
+ * @param deceleration Duty units per second when slowing down, 0 = no limit.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::setRamp(uint16_t acceleration, uint16_t deceleration)
+{
+   this->acceleration = acceleration;
+   this->deceleration = deceleration;
+} // MotorDriver::setRamp()
+
+/**
+ * @brief Request a new speed. The output ramps towards it in update().
+ *
+ * @param speed Signed duty, positive is forward. Clamped to motorMaxDuty.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::setSpeed(int16_t speed)
+{
+   this->setpoint = constrain(speed, -motorMaxDuty, motorMaxDuty);
+} // MotorDriver::setSpeed()
+
+/**
+ * @brief Stop at once, bypassing the deceleration ramp.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::halt()
+{
+   this->setpoint = 0;
+   this->speedMilli = 0;
+   this->apply(0);
+} // MotorDriver::halt()
+
+/**
+ * @brief Route the PWM channels back to the bridge pins after gpioDetach()
+ * has cut them, with the motor stopped.
+ *
+ * @details The channels are set to zero duty and the L298N inputs cleared
+ * before the pins are handed back, so the bridge stays off until the next
+ * setSpeed().
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::reconnect()
+{
+   this->setpoint = 0;
+   this->speedMilli = 0;
+   this->applied = 1; // Force the write.
+   this->apply(0);
+   if(this->bridge == BRIDGE_L298N)
+   {
+      this->pwm1.attachPin(this->enable);
+   } // if
+   else
+   {
+      this->pwm1.attachPin(this->in1);
+      this->pwm2.attachPin(this->in2);
+   } // else
+} // MotorDriver::reconnect()
+
+/**
+ * @brief Advance the ramp by one control period and update the outputs.
+ *
+ * @param elapsedMs Milli-seconds since the previous call.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::update(uint32_t elapsedMs)
+{
+   int32_t target = (int32_t)this->setpoint * 1000;
+   if(this->speedMilli != target)
+   {
+      // Slowing down if the target is nearer zero or on the other side of it.
+      bool slowing = (this->speedMilli > 0 && target < this->speedMilli)
+                     || (this->speedMilli < 0 && target > this->speedMilli);
+      // Never cross zero in one step, a reversal stops first.
+      if((this->speedMilli > 0 && target < 0) || (this->speedMilli < 0 && target > 0))
+      {
+         target = 0;
+      } // if
+      uint16_t rate = slowing ? this->deceleration : this->acceleration;
+      int32_t step = (int32_t)rate * elapsedMs; // Duty per second * ms = milli-duty.
+      int32_t error = target - this->speedMilli;
+      if(rate == 0 || abs(error) <= step)
+      {
+         this->speedMilli = target;
+      } // if
+      else
+      {
+         this->speedMilli += (error > 0) ? step : -step;
+      } // else
+   } // if
+   this->apply(this->speedMilli / 1000);
+} // MotorDriver::update()
+
+/**
+ * @brief Write a signed duty cycle to the bridge.
+ *
+ * @details On the L298N the direction pins are only touched when the
+ * direction changes, and then both in one clear-then-set register update.
+ * Zero duty leaves both bridges coasting.
+ *
+ * @param duty Signed duty, positive is forward.
+ *
+ * @return NA No return value.
+ */
+void MotorDriver::apply(int16_t duty)
+{
+   if(duty == this->applied)
+   {
+      return;
+   } // if
+   uint32_t magnitude = abs(duty);
+   if(this->bridge == BRIDGE_L298N)
+   {
+      bool directionChange = (duty > 0) != (this->applied > 0) || (duty < 0) != (this->applied < 0);
+      if(directionChange)
+      {
+         this->pwm1.write(0); // Off while the inputs change over.
+         gpioMask both = this->in1Mask | this->in2Mask;
+         gpioMask high = (duty > 0) ? this->in2Mask : (duty < 0) ? this->in1Mask : gpioNone;
+         gpioUpdate(both, high);
+      } // if
+      this->pwm1.write(magnitude);
+   } // if
+   else
+   {
+      this->pwm1.write(duty < 0 ? magnitude : 0);
+      this->pwm2.write(duty > 0 ? magnitude : 0);
+   } // else
+   this->applied = duty;
+} // MotorDriver::apply()
+
+/**
+ * @brief Speed currently applied to the motor.
+ *
+ * @param NA No parameters.
+ *
+ * @return Signed duty.
+ */
+int16_t MotorDriver::getSpeed()
+{
+   return this->applied;
+} // MotorDriver::getSpeed()
+
+/**
+ * @brief Speed the motor is ramping towards.
+ *
+ * @param NA No parameters.
+ *
+ * @return Signed duty.
+ */
+int16_t MotorDriver::getSetpoint()
+{
+   return this->setpoint;
+} // MotorDriver::getSetpoint()
+
+/**
+ * @brief Axis name of this motor.
+ *
+ * @param NA No parameters.
+ *
+ * @return Name used in commands and logs.
+ */
+const char* MotorDriver::getName()
+{
+   return this->name;
+} // MotorDriver::getName()
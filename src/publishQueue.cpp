@@ -0,0 +1,467 @@
+#include <publishQueue.h> // Outbound MQTT messages in priority classes.
+
+/**
+ * @brief Construct a new Publish Queue object.
+ *
+ * @param client MQTT client that drain() publishes with.
+ *
+ * @return NA No return value.
+ */
+PublishQueue::PublishQueue(PubSubClient& client) : client(client)
+{
+} // PublishQueue::PublishQueue()
+
+/**
+ * @brief Set aside the queue memory.
+ *
+ * @param size Bytes for messages and their headers, 0 to publish directly.
+ *
+ * @return True if the queue is in use.
+ */
+bool PublishQueue::begin(uint16_t size)
+{
+   if(size == 0 || this->data != NULL)
+   {
+      return this->data != NULL;
+   } // if
+   this->data = (uint8_t*)malloc(size);
+   this->size = (this->data != NULL) ? size : 0;
+   return this->data != NULL;
+} // PublishQueue::begin()
+
+/**
+ * @brief Queue one whole message.
+ *
+ * @param priority Class, see enum publishClass.
+ * @param topic Topic, must outlive the message.
+ * @param payload Bytes.
+ * @param length Number of bytes.
+ * @param retained Retain flag.
+ *
+ * @return True if queued, or published when there is no queue.
+ */
+bool PublishQueue::publish(uint8_t priority, const char* topic, const uint8_t* payload, uint16_t length, bool retained)
+{
+   if(this->size == 0 && MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length <= this->client.getBufferSize())
+   {
+      return this->client.publish(topic, payload, length, retained);
+   } // if
+   if(!this->beginPublish(priority, topic, length, retained))
+   {
+      return false;
+   } // if
+   this->write(payload, length);
+   return this->endPublish();
+} // PublishQueue::publish()
+
+/**
+ * @brief Queue one text message.
+ *
+ * @param priority Class, see enum publishClass.
+ * @param topic Topic, must outlive the message.
+ * @param payload Nul terminated text.
+ * @param retained Retain flag.
+ *
+ * @return True if queued, or published when there is no queue.
+ */
+bool PublishQueue::publish(uint8_t priority, const char* topic, const char* payload, bool retained)
+{
+   return this->publish(priority, topic, (const uint8_t*)payload, strlen(payload), retained);
+} // PublishQueue::publish()
+
+/**
+ * @brief Start a message whose payload follows with write(), as
+ * PubSubClient::beginPublish(). The room for all of it is taken now.
+ *
+ * @param priority Class, see enum publishClass.
+ * @param topic Topic, must outlive the message.
+ * @param length Number of bytes that will be written.
+ * @param retained Retain flag.
+ *
+ * @return True if started, False if the message was dropped.
+ */
+bool PublishQueue::beginPublish(uint8_t priority, const char* topic, uint16_t length, bool retained)
+{
+   priority = min(priority, (uint8_t)PUB_LOG);
+   if(this->size == 0)
+   {
+      this->direct = this->client.beginPublish(topic, length, retained);
+      this->writing = this->direct;
+      return this->direct;
+   } // if
+   uint16_t needed = sizeof(publishEntry) + length;
+   if(sizeof(publishEntry) + (uint32_t)length > this->size || !this->makeRoom(priority, needed))
+   {
+      this->drops[priority]++;
+      this->writing = false;
+      return false;
+   } // if
+   publishEntry entry;
+   entry.length = length;
+   entry.flags = priority | (retained ? PUB_RETAINED : 0) | PUB_OPEN;
+   entry.queued = micros();
+   entry.topic = topic;
+   memcpy(this->data + this->end, &entry, sizeof(entry));
+   this->open = this->end;
+   this->openWritten = 0;
+   this->end += needed;
+   this->depth++;
+   this->writing = true;
+   this->highWaterMark = max(this->highWaterMark, this->getQueuedBytes());
+   return true;
+} // PublishQueue::beginPublish()
+
+/**
+ * @brief Add one byte to the message started by beginPublish().
+ *
+ * @param data Byte.
+ *
+ * @return 1, or 0 if there is no message or it is already full.
+ */
+size_t PublishQueue::write(uint8_t data)
+{
+   return this->write(&data, 1);
+} // PublishQueue::write()
+
+/**
+ * @brief Add bytes to the message started by beginPublish(). Bytes past the
+ * length it was given are dropped.
+ *
+ * @param data Bytes.
+ * @param size Number of bytes.
+ *
+ * @return Number of bytes taken.
+ */
+size_t PublishQueue::write(const uint8_t* data, size_t size)
+{
+   if(!this->writing)
+   {
+      return 0;
+   } // if
+   if(this->direct)
+   {
+      return this->client.write(data, size);
+   } // if
+   publishEntry entry = this->entryAt(this->open);
+   size = min(size, (size_t)(entry.length - this->openWritten));
+   memcpy(this->data + this->open + sizeof(publishEntry) + this->openWritten, data, size);
+   this->openWritten += size;
+   return size;
+} // PublishQueue::write()
+
+/**
+ * @brief Finish the message started by beginPublish() and let drain() have
+ * it. A message that was given fewer bytes than promised is cut short.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if the message was queued, or published when there is no
+ * queue.
+ */
+bool PublishQueue::endPublish()
+{
+   if(!this->writing)
+   {
+      return false;
+   } // if
+   this->writing = false;
+   if(this->direct)
+   {
+      this->direct = false;
+      return this->client.endPublish() > 0;
+   } // if
+   publishEntry entry = this->entryAt(this->open);
+   entry.flags &= ~PUB_OPEN;
+   entry.length = this->openWritten;
+   memcpy(this->data + this->open, &entry, sizeof(entry));
+   this->end = this->open + sizeof(publishEntry) + entry.length; // It is always the newest.
+   return true;
+} // PublishQueue::endPublish()
+
+/**
+ * @brief Ask before each publish whether the socket can take a packet
+ * without blocking.
+ *
+ * @details A full TCP send window makes the client wait, in the calling
+ * task, until the broker acknowledges enough to make room. With a check set
+ * drain() leaves the rest of the queue for a later pass instead, so a slow
+ * broker fills the queue rather than stalling the scheduler.
+ *
+ * @param writable Returns true if a packet of that many bytes can be
+ * written now, NULL to always publish.
+ *
+ * @return NA No return value.
+ */
+void PublishQueue::setWritable(bool (*writable)(uint16_t bytes))
+{
+   this->writable = writable;
+} // PublishQueue::setWritable()
+
+/**
+ * @brief Publish queued messages, most urgent class first, until the queue
+ * is empty, the time budget is spent or the socket is full. At least one
+ * message is sent per call if the socket has room, so the queue always
+ * moves.
+ *
+ * @details A message the client refuses while still connected is dropped
+ * and counted. If the connection is gone the messages are kept for when it
+ * is back.
+ *
+ * @param budgetMicros Time this call may take in micro-seconds.
+ *
+ * @return NA No return value.
+ */
+void PublishQueue::drain(uint32_t budgetMicros)
+{
+   if(this->size == 0 || this->depth == 0 || !this->client.connected())
+   {
+      return;
+   } // if
+   uint32_t started = micros();
+   do
+   {
+      int32_t best = -1;
+      uint8_t bestClass = PUB_CLASSES;
+      uint16_t offset = this->start;
+      while(offset < this->end && bestClass != PUB_CONTROL)
+      {
+         publishEntry entry = this->entryAt(offset);
+         uint8_t priority = entry.flags & PUB_CLASS_MASK;
+         if(!(entry.flags & (PUB_SENT | PUB_OPEN)) && priority < bestClass)
+         {
+            best = offset;
+            bestClass = priority;
+         } // if
+         offset += sizeof(publishEntry) + entry.length;
+      } // while
+      if(best < 0)
+      {
+         return;
+      } // if
+      publishEntry entry = this->entryAt(best);
+      const uint8_t* payload = this->data + best + sizeof(publishEntry);
+      bool retained = (entry.flags & PUB_RETAINED) != 0;
+      uint32_t packet = MQTT_MAX_HEADER_SIZE + 2 + strlen(entry.topic) + entry.length;
+      if(this->writable != NULL && !this->writable(min(packet, (uint32_t)0xFFFF)))
+      {
+         return; // Sent when the broker has caught up.
+      } // if
+      bool sent;
+      if(packet <= this->client.getBufferSize())
+      {
+         sent = this->client.publish(entry.topic, payload, entry.length, retained);
+      } // if
+      else
+      {
+         sent = this->client.beginPublish(entry.topic, entry.length, retained)
+            && this->client.write(payload, entry.length) == entry.length
+            && this->client.endPublish() > 0;
+      } // else
+      if(!sent && !this->client.connected())
+      {
+         return; // Kept for after the reconnect.
+      } // if
+      if(sent)
+      {
+         this->latency[bestClass].record(micros() - entry.queued);
+      } // if
+      else
+      {
+         this->drops[bestClass]++;
+      } // else
+      this->markSent(best);
+   } while(this->depth > 0 && micros() - started < budgetMicros);
+} // PublishQueue::drain()
+
+/**
+ * @brief Largest message that can be queued now without dropping another.
+ *
+ * @param NA No parameters.
+ *
+ * @return Payload bytes, 0xFFFF when there is no queue.
+ */
+uint16_t PublishQueue::getFree()
+{
+   if(this->size == 0)
+   {
+      return 0xFFFF;
+   } // if
+   uint16_t used = this->getQueuedBytes() + sizeof(publishEntry);
+   return (this->size > used) ? this->size - used : 0;
+} // PublishQueue::getFree()
+
+/**
+ * @brief Messages waiting to be sent.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint16_t PublishQueue::getDepth()
+{
+   return this->depth;
+} // PublishQueue::getDepth()
+
+/**
+ * @brief Bytes waiting to be sent.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes including message headers.
+ */
+uint16_t PublishQueue::getQueuedBytes()
+{
+   return this->end - this->start - this->sentBytes;
+} // PublishQueue::getQueuedBytes()
+
+/**
+ * @brief Most bytes waiting at once since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Bytes including message headers.
+ */
+uint16_t PublishQueue::getHighWaterMark()
+{
+   return this->highWaterMark;
+} // PublishQueue::getHighWaterMark()
+
+/**
+ * @brief Messages of one class dropped to make room, because they did not
+ * fit or because the client refused them.
+ *
+ * @param priority Class, see enum publishClass.
+ *
+ * @return Count.
+ */
+uint32_t PublishQueue::getDrops(uint8_t priority)
+{
+   return this->drops[min(priority, (uint8_t)PUB_LOG)];
+} // PublishQueue::getDrops()
+
+/**
+ * @brief Time from push to publish for one class.
+ *
+ * @param priority Class, see enum publishClass.
+ *
+ * @return Histogram in micro-seconds.
+ */
+LatencyHistogram& PublishQueue::getLatency(uint8_t priority)
+{
+   return this->latency[min(priority, (uint8_t)PUB_LOG)];
+} // PublishQueue::getLatency()
+
+/**
+ * @brief Make the space after end big enough for a new message, squeezing
+ * out sent messages and then dropping less urgent ones.
+ *
+ * @param priority Class of the new message.
+ * @param needed Bytes including its header.
+ *
+ * @return True if there is room.
+ */
+bool PublishQueue::makeRoom(uint8_t priority, uint16_t needed)
+{
+   while(this->size - this->end < needed)
+   {
+      if(this->start > 0 || this->sentBytes > 0)
+      {
+         this->compact();
+         continue;
+      } // if
+      int32_t victim = -1;
+      uint8_t victimClass = priority;
+      for(uint16_t offset = this->start; offset < this->end; )
+      {
+         publishEntry entry = this->entryAt(offset);
+         uint8_t entryClass = entry.flags & PUB_CLASS_MASK;
+         if(!(entry.flags & PUB_OPEN) && entryClass >= priority && (victim < 0 || entryClass > victimClass))
+         {
+            victim = offset; // Oldest of the least urgent class so far.
+            victimClass = entryClass;
+         } // if
+         offset += sizeof(publishEntry) + entry.length;
+      } // for
+      if(victim < 0)
+      {
+         return false;
+      } // if
+      this->drops[victimClass]++;
+      this->markSent(victim);
+   } // while
+   return true;
+} // PublishQueue::makeRoom()
+
+/**
+ * @brief Move the waiting messages to the front, in order, over the ones
+ * already sent.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void PublishQueue::compact()
+{
+   uint16_t to = 0;
+   for(uint16_t offset = this->start; offset < this->end; )
+   {
+      publishEntry entry = this->entryAt(offset);
+      uint16_t bytes = sizeof(publishEntry) + entry.length;
+      if(!(entry.flags & PUB_SENT))
+      {
+         memmove(this->data + to, this->data + offset, bytes);
+         to += bytes;
+      } // if
+      offset += bytes;
+   } // for
+   this->start = 0;
+   this->end = to;
+   this->sentBytes = 0;
+} // PublishQueue::compact()
+
+/**
+ * @brief Take a message out of the queue. Sent messages at the front are
+ * skipped over straight away, the rest wait for compact().
+ *
+ * @param offset Where the message starts.
+ *
+ * @return NA No return value.
+ */
+void PublishQueue::markSent(uint16_t offset)
+{
+   publishEntry entry = this->entryAt(offset);
+   entry.flags |= PUB_SENT;
+   memcpy(this->data + offset, &entry, sizeof(entry));
+   this->sentBytes += sizeof(publishEntry) + entry.length;
+   this->depth--;
+   while(this->start < this->end)
+   {
+      publishEntry first = this->entryAt(this->start);
+      if(!(first.flags & PUB_SENT))
+      {
+         break;
+      } // if
+      uint16_t bytes = sizeof(publishEntry) + first.length;
+      this->start += bytes;
+      this->sentBytes -= bytes;
+   } // while
+   if(this->start == this->end)
+   {
+      this->start = 0;
+      this->end = 0;
+   } // if
+} // PublishQueue::markSent()
+
+/**
+ * @brief Copy out a message header, which may not be aligned.
+ *
+ * @param offset Where the message starts.
+ *
+ * @return Its header.
+ */
+publishEntry PublishQueue::entryAt(uint16_t offset)
+{
+   publishEntry entry;
+   memcpy(&entry, this->data + offset, sizeof(entry));
+   return entry;
+} // PublishQueue::entryAt()
@@ -0,0 +1,285 @@
+#include <safetyStop.h> // E-stop input and command deadman.
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/timer.h> // Hardware timer with an IRAM interrupt.
+#include <esp_timer.h> // esp_timer_get_time(), in IRAM.
+#endif
+
+/**
+ * @brief Micro-seconds since start up, the same clock as micros() but safe
+ * from an interrupt while the flash cache is off.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds, wrapping like micros().
+ */
+static inline __attribute__((always_inline)) uint32_t isrMicros()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+   return (uint32_t)esp_timer_get_time();
+#else
+   return micros();
+#endif
+} // isrMicros()
+
+SafetyStop* SafetyStop::instance = NULL;
+
+/**
+ * @brief Start watching. Call once the motors are set up and before the
+ * motor task starts.
+ *
+ * @param outputs Every bridge pin, all of them already outputs.
+ * @param estopPin E-stop input, -1 for none.
+ * @param deadmanMs Longest gap between valid commands while a motor runs
+ * open ended, 0 for no deadman.
+ *
+ * @return NA No return value.
+ */
+void SafetyStop::begin(const gpioMask& outputs, int8_t estopPin, uint32_t deadmanMs)
+{
+   this->outputs = outputs;
+   this->estopPin = estopPin;
+   this->deadmanMs = deadmanMs;
+   this->lastFeedUs = micros();
+   for(std::atomic<uint32_t>& count : this->trips)
+   {
+      count = 0;
+   } // for
+   instance = this;
+   if(estopPin >= 0)
+   {
+      pinMode(estopPin, INPUT_PULLUP);
+      gpioAttachEdge(estopPin, false, &SafetyStop::onEstop, this);
+   } // if
+#if defined(ARDUINO_ARCH_ESP32)
+   // Through the IDF rather than timerAttachInterrupt(), which cannot ask
+   // for ESP_INTR_FLAG_IRAM.
+   timer_config_t config = {};
+   config.divider = 80; // 1 MHz from the 80 MHz APB clock.
+   config.counter_dir = TIMER_COUNT_UP;
+   config.counter_en = TIMER_PAUSE;
+   config.alarm_en = TIMER_ALARM_EN;
+   config.auto_reload = TIMER_AUTORELOAD_EN;
+   config.intr_type = TIMER_INTR_LEVEL;
+   timer_idx_t timer = (timer_idx_t)safetyTimer;
+   timer_init(TIMER_GROUP_0, timer, &config);
+   timer_set_counter_value(TIMER_GROUP_0, timer, 0);
+   timer_set_alarm_value(TIMER_GROUP_0, timer, safetyCheckUs);
+   timer_enable_intr(TIMER_GROUP_0, timer);
+   timer_isr_callback_add(TIMER_GROUP_0, timer, &SafetyStop::onTimer, this, ESP_INTR_FLAG_IRAM);
+   timer_start(TIMER_GROUP_0, timer);
+#else
+   hw_timer_t* timer = timerBegin(safetyTimer, 80, true);
+   timerAttachInterrupt(timer, []() { onTimer(instance); }, true);
+   timerAlarmWrite(timer, safetyCheckUs, true);
+   timerAlarmEnable(timer);
+#endif
+} // SafetyStop::begin()
+
+/**
+ * @brief A valid command or heartbeat arrived. Network side.
+ *
+ * @details Starts the deadman window again, and releases a deadman stop on
+ * the next update().
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void SafetyStop::feed()
+{
+   this->lastFeedUs.store(micros(), std::memory_order_relaxed);
+   this->feeds.store(this->feeds.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+} // SafetyStop::feed()
+
+/**
+ * @brief Say whether any motor runs open ended. Control side, called every
+ * tick after the motors are updated.
+ *
+ * @details If the last valid command is older than the deadman window
+ * when a motor starts to run open ended, the window starts then instead, so
+ * a counted move or replay that leaves a motor running is given the whole
+ * window too.
+ *
+ * @param openEnded True if a motor runs at a speed nothing will end.
+ *
+ * @return NA No return value.
+ */
+void SafetyStop::setOpenEnded(bool openEnded)
+{
+   uint32_t now = micros();
+   if(openEnded && !this->openEndedSeen 
+      && now - this->lastFeedUs.load(std::memory_order_relaxed) > this->deadmanMs * 1000)
+   {
+      this->lastFeedUs.store(now, std::memory_order_relaxed);
+   } // if
+   this->openEndedSeen = openEnded;
+   this->openEnded.store(openEnded, std::memory_order_release);
+} // SafetyStop::setOpenEnded()
+
+/**
+ * @brief See whether the bridges are cut, and release them once the cause
+ * has gone. Control side, called first thing every tick.
+ *
+ * @param NA No parameters.
+ *
+ * @return SAFETY_CUT while cut, SAFETY_RESTORED on the tick the cut ends,
+ * when the motors must be reconnected, otherwise SAFETY_RUN.
+ */
+safetyAction SafetyStop::update()
+{
+   uint32_t now = this->cause.load(std::memory_order_acquire);
+   if(now == SAFETY_CLEAR)
+   {
+      return SAFETY_RUN;
+   } // if
+   bool released = (now == SAFETY_ESTOP) ? gpioRead(this->estopPin)
+                 : this->feeds.load(std::memory_order_acquire) != this->feedsAtTrip.load(std::memory_order_relaxed);
+   // An interrupt may cut again meanwhile, that cut stands.
+   if(!released || !this->cause.compare_exchange_strong(now, SAFETY_CLEAR, std::memory_order_acq_rel))
+   {
+      return SAFETY_CUT;
+   } // if
+   return SAFETY_RESTORED;
+} // SafetyStop::update()
+
+/**
+ * @brief Why the bridges are cut.
+ *
+ * @param NA No parameters.
+ *
+ * @return enum safetyCause, SAFETY_CLEAR when they are not.
+ */
+uint8_t SafetyStop::getCause()
+{
+   return this->cause.load(std::memory_order_relaxed);
+} // SafetyStop::getCause()
+
+/**
+ * @brief Times the bridges were cut for one cause since start up.
+ *
+ * @param cause SAFETY_DEADMAN or SAFETY_ESTOP.
+ *
+ * @return Count.
+ */
+uint32_t SafetyStop::getTrips(uint8_t cause)
+{
+   return (cause < SAFETY_CAUSES) ? this->trips[cause].load(std::memory_order_relaxed) : 0;
+} // SafetyStop::getTrips()
+
+/**
+ * @brief The deadman window.
+ *
+ * @param NA No parameters.
+ *
+ * @return Milli-seconds, 0 for no deadman.
+ */
+uint32_t SafetyStop::getDeadmanMs()
+{
+   return this->deadmanMs;
+} // SafetyStop::getDeadmanMs()
+
+/**
+ * @brief Most time past the end of its window that the deadman has cut the
+ * bridges, at most safetyCheckUs unless the timer interrupt was held off.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds.
+ */
+uint32_t SafetyStop::getLateMaxUs()
+{
+   return this->lateMaxUs.load(std::memory_order_relaxed);
+} // SafetyStop::getLateMaxUs()
+
+/**
+ * @brief Longest time gpioDetach() took to cut the bridges.
+ *
+ * @param NA No parameters.
+ *
+ * @return Micro-seconds.
+ */
+uint32_t SafetyStop::getCutMaxUs()
+{
+   return this->cutMaxUs.load(std::memory_order_relaxed);
+} // SafetyStop::getCutMaxUs()
+
+/**
+ * @brief Hardware timer interrupt, every safetyCheckUs.
+ *
+ * @param safety The SafetyStop that started the timer.
+ *
+ * @return False, no task needs to be woken.
+ */
+bool IRAM_ATTR SafetyStop::onTimer(void* safety)
+{
+   ((SafetyStop*)safety)->check();
+   return false;
+} // SafetyStop::onTimer()
+
+/**
+ * @brief Falling edge on the e-stop input.
+ *
+ * @param safety The SafetyStop that attached it.
+ *
+ * @return NA No return value.
+ */
+void IRAM_ATTR SafetyStop::onEstop(void* safety)
+{
+   SafetyStop* self = (SafetyStop*)safety;
+   if(self->cause.load(std::memory_order_relaxed) != SAFETY_ESTOP)
+   {
+      self->trip(SAFETY_ESTOP, 0);
+   } // if
+} // SafetyStop::onEstop()
+
+/**
+ * @brief Poll the e-stop input and the deadman window.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void IRAM_ATTR SafetyStop::check()
+{
+   uint32_t now = this->cause.load(std::memory_order_relaxed);
+   if(this->estopPin >= 0 && now != SAFETY_ESTOP && !gpioRead(this->estopPin))
+   {
+      this->trip(SAFETY_ESTOP, 0);
+      return;
+   } // if
+   if(this->deadmanMs == 0 || now != SAFETY_CLEAR || !this->openEnded.load(std::memory_order_acquire))
+   {
+      return;
+   } // if
+   uint32_t quietUs = isrMicros() - this->lastFeedUs.load(std::memory_order_relaxed);
+   if(quietUs > this->deadmanMs * 1000)
+   {
+      this->feedsAtTrip.store(this->feeds.load(std::memory_order_acquire), std::memory_order_relaxed);
+      this->trip(SAFETY_DEADMAN, quietUs - this->deadmanMs * 1000);
+   } // if
+} // SafetyStop::check()
+
+/**
+ * @brief Cut the bridges and count why.
+ *
+ * @param cause SAFETY_DEADMAN or SAFETY_ESTOP.
+ * @param lateUs How long past the end of the deadman window.
+ *
+ * @return NA No return value.
+ */
+void IRAM_ATTR SafetyStop::trip(uint8_t cause, uint32_t lateUs)
+{
+   uint32_t start = isrMicros();
+   gpioDetach(this->outputs);
+   uint32_t took = isrMicros() - start;
+   this->cause.store(cause, std::memory_order_release);
+   this->trips[cause].store(this->trips[cause].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   if(took > this->cutMaxUs.load(std::memory_order_relaxed))
+   {
+      this->cutMaxUs.store(took, std::memory_order_relaxed);
+   } // if
+   if(lateUs > this->lateMaxUs.load(std::memory_order_relaxed))
+   {
+      this->lateMaxUs.store(lateUs, std::memory_order_relaxed);
+   } // if
+} // SafetyStop::trip()
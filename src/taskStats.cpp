@@ -0,0 +1,169 @@
+#include <taskStats.h> // Timing of scheduler tasks and command handlers.
+
+/**
+ * @brief Counter ticks per micro-second.
+ *
+ * @param NA No parameters.
+ *
+ * @return CPU clock in MHz on the ESP32, 1000 for the nano-second clock.
+ */
+uint32_t statsTicksPerMicro()
+{
+#ifdef ARDUINO_ARCH_ESP32
+   return ESP.getCpuFreqMHz();
+#else
+   return 1000;
+#endif
+} // statsTicksPerMicro()
+
+/**
+ * @brief Construct a new TaskStat object.
+ *
+ * @param name Label used in the snapshot.
+ * @param intervalMs Task interval in milli-seconds, 0 if overruns do not
+ * apply.
+ *
+ * @return NA No return value.
+ */
+TaskStat::TaskStat(const char* name, uint32_t intervalMs) : resetPending(false)
+{
+   this->name = name;
+   this->intervalTicks = intervalMs * 1000 * statsTicksPerMicro();
+} // TaskStat::TaskStat()
+
+/**
+ * @brief Add one run. Only the task being measured may call this.
+ *
+ * @param ticks Run time in counter ticks.
+ *
+ * @return NA No return value.
+ */
+void TaskStat::record(uint32_t ticks)
+{
+   if(this->resetPending)
+   {
+      this->histogram.reset();
+      this->overruns = 0;
+      this->resetPending = false;
+   } // if
+   this->histogram.record(ticks);
+   if(this->intervalTicks != 0 && ticks > this->intervalTicks)
+   {
+      this->overruns++;
+   } // if
+} // TaskStat::record()
+
+/**
+ * @brief Ask the writer to clear the figures on its next run. Safe to call
+ * from any task.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void TaskStat::requestReset()
+{
+   this->resetPending = true;
+} // TaskStat::requestReset()
+
+/**
+ * @brief Label used in the snapshot.
+ *
+ * @param NA No parameters.
+ *
+ * @return Name.
+ */
+const char* TaskStat::getName()
+{
+   return this->name;
+} // TaskStat::getName()
+
+/**
+ * @brief Runs that took longer than the task interval.
+ *
+ * @param NA No parameters.
+ *
+ * @return Overrun count.
+ */
+uint32_t TaskStat::getOverruns()
+{
+   return this->overruns;
+} // TaskStat::getOverruns()
+
+/**
+ * @brief Run time histogram in counter ticks.
+ *
+ * @param NA No parameters.
+ *
+ * @return Histogram.
+ */
+LatencyHistogram& TaskStat::getHistogram()
+{
+   return this->histogram;
+} // TaskStat::getHistogram()
+
+/**
+ * @brief Measure the cost of one empty StatScope.
+ *
+ * @details Times a batch of scopes into a scratch TaskStat. The two
+ * counter reads around the batch are shared by all of its runs.
+ *
+ * @param NA No parameters.
+ *
+ * @return Average counter ticks added by one scope.
+ */
+uint32_t statsCalibrate()
+{
+   const uint16_t runs = 256;
+   TaskStat scratch("calibrate");
+   uint32_t start = statsNow();
+   for(uint16_t i = 0; i < runs; i++)
+   {
+      StatScope scope(scratch);
+   } // for
+   uint32_t batch = statsNow() - start;
+   return batch / runs;
+} // statsCalibrate()
+
+/**
+ * @brief Write a compact snapshot, one line per TaskStat.
+ *
+ * @details The first line gives the measurement overhead. Every other line
+ * is "name n p50 p99 max overruns" with times in micro-seconds. Lines that
+ * do not fit are left out whole.
+ *
+ * @param stats TaskStats to report.
+ * @param count Number of entries in stats.
+ * @param overhead Cost of one scope in counter ticks from statsCalibrate().
+ * @param out Buffer for the text.
+ * @param size Size of out.
+ *
+ * @return Number of characters written, not counting the terminator.
+ */
+size_t statsFormat(TaskStat* const stats[], uint8_t count, uint32_t overhead, char* out, size_t size)
+{
+   uint32_t perMicro = statsTicksPerMicro();
+   int used = snprintf(out, size, "stats us n/p50/p99/max/over, overhead %lu ticks at %lu/us",
+                       (unsigned long)overhead, (unsigned long)perMicro);
+   if(used < 0 || (size_t)used >= size)
+   {
+      return (size == 0) ? 0 : strlen(out);
+   } // if
+   for(uint8_t i = 0; i < count; i++)
+   {
+      LatencyHistogram& histogram = stats[i]->getHistogram();
+      int added = snprintf(out + used, size - used, "\n%s %lu/%lu/%lu/%lu/%lu",
+                           stats[i]->getName(), (unsigned long)histogram.getCount(),
+                           (unsigned long)(histogram.getPercentile(50) / perMicro),
+                           (unsigned long)(histogram.getPercentile(99) / perMicro),
+                           (unsigned long)(histogram.getMax() / perMicro),
+                           (unsigned long)stats[i]->getOverruns());
+      if(added < 0 || (size_t)(used + added) >= size)
+      {
+         out[used] = '\0'; // Drop the partial line.
+         break;
+      } // if
+      used += added;
+   } // for
+   return used;
+} // statsFormat()
@@ -0,0 +1,113 @@
+#include <telemetry.h> // Binary state frames.
+
+/**
+ * @brief Store a value in little endian order.
+ *
+ * @param out Where to write.
+ * @param value Value to store.
+ * @param bytes Number of bytes to write.
+ *
+ * @return Pointer just past what was written.
+ */
+static uint8_t* putLittleEndian(uint8_t* out, uint32_t value, uint8_t bytes)
+{
+   for(uint8_t i = 0; i < bytes; i++)
+   {
+      *out++ = (value >> (8 * i)) & 0xFF;
+   } // for
+   return out;
+} // putLittleEndian()
+
+/**
+ * @brief Set when a frame is due even without a change.
+ *
+ * @param maxInterval Longest gap between frames in milli-seconds.
+ * @param rssiDeadBand RSSI change in dB that counts as a change.
+ *
+ * @return NA No return value.
+ */
+void Telemetry::setLimits(uint32_t maxInterval, uint8_t rssiDeadBand)
+{
+   this->maxInterval = maxInterval;
+   this->rssiDeadBand = rssiDeadBand;
+} // Telemetry::setLimits()
+
+/**
+ * @brief Compare a state with the one last sent.
+ *
+ * @param state Current state.
+ *
+ * @return True if a motor, the servo or the RSSI has changed.
+ */
+bool Telemetry::changed(const telemetryState& state)
+{
+   for(uint8_t i = 0; i < telemetryAxes; i++)
+   {
+      if(state.speed[i] != this->last.speed[i] || state.setpoint[i] != this->last.setpoint[i])
+      {
+         return true;
+      } // if
+   } // for
+   return state.servo != this->last.servo
+          || abs(state.rssi - this->last.rssi) >= this->rssiDeadBand;
+} // Telemetry::changed()
+
+/**
+ * @brief Build the next frame if one is due.
+ *
+ * @param state Current state.
+ * @param out Buffer for the frame.
+ *
+ * @return True if out holds a frame to send, false if nothing is due.
+ */
+bool Telemetry::frame(const telemetryState& state, uint8_t out[telemetryFrameSize])
+{
+   telemetryReason reason;
+   if(this->first)
+   {
+      reason = TEL_FIRST;
+   } // if
+   else if(this->changed(state))
+   {
+      reason = TEL_CHANGE;
+   } // else if
+   else if(state.uptime - this->last.uptime >= this->maxInterval)
+   {
+      reason = TEL_INTERVAL;
+   } // else if
+   else
+   {
+      return false;
+   } // else
+   uint8_t* p = out;
+   *p++ = telemetryVersion;
+   *p++ = reason;
+   p = putLittleEndian(p, this->sequence++, 2);
+   p = putLittleEndian(p, state.uptime, 4);
+   for(uint8_t i = 0; i < telemetryAxes; i++)
+   {
+      p = putLittleEndian(p, (uint16_t)state.speed[i], 2);
+   } // for
+   for(uint8_t i = 0; i < telemetryAxes; i++)
+   {
+      p = putLittleEndian(p, (uint16_t)state.setpoint[i], 2);
+   } // for
+   *p++ = state.servo;
+   *p++ = (uint8_t)state.rssi;
+   putLittleEndian(p, state.freeHeap, 4);
+   this->last = state;
+   this->first = false;
+   return true;
+} // Telemetry::frame()
+
+/**
+ * @brief Sequence number the next frame will carry.
+ *
+ * @param NA No parameters.
+ *
+ * @return Sequence number.
+ */
+uint16_t Telemetry::getSequence()
+{
+   return this->sequence;
+} // Telemetry::getSequence()
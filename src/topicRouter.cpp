@@ -0,0 +1,135 @@
+#include <topicRouter.h> // Hashed routing of topics and commands.
+
+/**
+ * @brief Build the hash table for a route list.
+ *
+ * @details Routes go in list order, each into the first free slot at or
+ * after the one its hash picks. A name listed twice keeps its first route.
+ *
+ * @param routes Route list, must outlive the router.
+ * @param count Routes in the list, at most routerMaxRoutes.
+ *
+ * @return False if there are too many routes.
+ */
+bool TopicRouter::begin(const topicRoute* routes, uint8_t count)
+{
+   if(count > routerMaxRoutes)
+   {
+      return false;
+   } // if
+   memset(this->slots, 0, sizeof(this->slots));
+   this->routes = routes;
+   this->count = count;
+   this->longestProbe = 0;
+   for(uint8_t i = 0; i < count; i++)
+   {
+      uint8_t slot = routes[i].hash & (routerSlots - 1);
+      uint8_t probe = 0;
+      while(this->slots[slot] != 0)
+      {
+         slot = (slot + 1) & (routerSlots - 1);
+         probe++;
+      } // while
+      this->slots[slot] = i + 1;
+      this->longestProbe = max(this->longestProbe, probe);
+   } // for
+   return true;
+} // TopicRouter::begin()
+
+/**
+ * @brief Look up a name.
+ *
+ * @param name Topic or command word, need not be zero terminated.
+ * @param length Characters in name.
+ *
+ * @return The route, or NULL if there is none by that name.
+ */
+const topicRoute* TopicRouter::find(const char* name, uint16_t length)
+{
+   uint32_t hash = fnv1aSpan(name, length);
+   uint8_t slot = hash & (routerSlots - 1);
+   for(uint8_t probe = 0; probe <= this->longestProbe && this->slots[slot] != 0; probe++)
+   {
+      const topicRoute* route = &this->routes[this->slots[slot] - 1];
+      if(route->hash == hash && strncmp(route->name, name, length) == 0 && route->name[length] == '\0')
+      {
+         return route;
+      } // if
+      slot = (slot + 1) & (routerSlots - 1);
+   } // for
+   return NULL;
+} // TopicRouter::find()
+
+/**
+ * @brief Routes in the table.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint8_t TopicRouter::getCount()
+{
+   return this->count;
+} // TopicRouter::getCount()
+
+/**
+ * @brief Longest walk past the home slot a lookup can take.
+ *
+ * @param NA No parameters.
+ *
+ * @return Slots.
+ */
+uint8_t TopicRouter::getLongestProbe()
+{
+   return this->longestProbe;
+} // TopicRouter::getLongestProbe()
+
+/**
+ * @brief Length of the first comma separated field.
+ *
+ * @param text Message text.
+ * @param length Characters in text.
+ *
+ * @return Characters before the first comma, or length if there is none.
+ */
+uint16_t routeField(const char* text, uint16_t length)
+{
+   const char* comma = (const char*)memchr(text, ',', length);
+   return (comma != NULL) ? comma - text : length;
+} // routeField()
+
+/**
+ * @brief Read a whole field as a signed decimal number, without a String
+ * or strtol() and its locale.
+ *
+ * @param text Field text.
+ * @param length Characters in the field.
+ *
+ * @return False if the field is empty, is not all digits after an optional
+ * sign or does not fit an int32_t. value is then left alone.
+ */
+bool routeNumber(const char* text, uint16_t length, int32_t& value)
+{
+   uint16_t i = (length > 0 && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+   if(i == length)
+   {
+      return false;
+   } // if
+   uint32_t magnitude = 0;
+   for(; i < length; i++)
+   {
+      uint8_t digit = text[i] - '0';
+      if(digit > 9 || magnitude > (UINT32_MAX - digit) / 10)
+      {
+         return false;
+      } // if
+      magnitude = magnitude * 10 + digit;
+   } // for
+   bool negative = (text[0] == '-');
+   if(magnitude > (negative ? 2147483648u : 2147483647u))
+   {
+      return false;
+   } // if
+   value = negative ? (int32_t)(0u - magnitude) : (int32_t)magnitude;
+   return true;
+} // routeNumber()
@@ -0,0 +1,168 @@
+#include <udpControl.h> // Commands in UDP datagrams.
+#if defined(ARDUINO_ARCH_ESP32)
+#include <lwip/sockets.h> // BSD sockets on lwIP.
+#else
+#include <arpa/inet.h> // htons().
+#include <netinet/in.h> // sockaddr_in.
+#include <sys/socket.h> // BSD sockets.
+#endif
+#include <unistd.h> // close().
+
+/**
+ * @brief Say where commands go. Nothing is received until start().
+ *
+ * @param port UDP port to listen on, 0 for none.
+ * @param handler Command dispatcher.
+ *
+ * @return NA No return value.
+ */
+void UdpControl::begin(uint16_t port, udpHandler handler)
+{
+   this->port = port;
+   this->handler = handler;
+} // UdpControl::begin()
+
+/**
+ * @brief Open the socket. Call once the network stack is up, such as when
+ * the first IP address is assigned. The socket then lasts through any
+ * reconnection.
+ *
+ * @param NA No parameters.
+ *
+ * @return True if the socket was opened now, false if it already was, there
+ * is no port or it could not be bound.
+ */
+bool UdpControl::start()
+{
+   if(this->port == 0 || this->handler == NULL || this->fd >= 0)
+   {
+      return false;
+   } // if
+   int fd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+   if(fd < 0)
+   {
+      return false;
+   } // if
+   struct sockaddr_in address;
+   memset(&address, 0, sizeof(address));
+   address.sin_family = AF_INET;
+   address.sin_port = htons(this->port);
+   address.sin_addr.s_addr = htonl(INADDR_ANY);
+   if(::bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+   {
+      ::close(fd);
+      return false;
+   } // if
+   this->fd = fd;
+   return true;
+} // UdpControl::start()
+
+/**
+ * @brief Take the datagrams that have arrived, without waiting for more.
+ * Each is checked, dispatched if it is in order and answered.
+ *
+ * @param most Datagrams to take at most, so a flood cannot hold up the
+ * other tasks.
+ *
+ * @return Datagrams taken, good or bad.
+ */
+uint8_t UdpControl::poll(uint8_t most)
+{
+   uint8_t taken = 0;
+   while(this->fd >= 0 && taken < most)
+   {
+      struct sockaddr_in from;
+      socklen_t fromLength = sizeof(from);
+      int length = recvfrom(this->fd, this->buffer, sizeof(this->buffer), MSG_DONTWAIT,
+                            (struct sockaddr*)&from, &fromLength);
+      if(length < 0)
+      {
+         break; // Nothing more waiting.
+      } // if
+      taken++;
+      if(length <= udpHeaderSize || length > udpMaxDatagram || this->buffer[0] != udpMagic
+         || memchr(this->buffer + udpHeaderSize, '\0', length - udpHeaderSize) == NULL)
+      {
+         this->malformed++; // Too short, too long, not ours or no topic.
+         continue;
+      } // if
+      uint8_t result = this->handle(length);
+      this->counts[result]++;
+      this->buffer[udpHeaderSize] = result; // The ack is the header and the result.
+      sendto(this->fd, this->buffer, udpHeaderSize + 1, MSG_DONTWAIT, (struct sockaddr*)&from, fromLength);
+   } // while
+   return taken;
+} // UdpControl::poll()
+
+/**
+ * @brief Port listened on.
+ *
+ * @param NA No parameters.
+ *
+ * @return Port, 0 for none.
+ */
+uint16_t UdpControl::getPort()
+{
+   return this->port;
+} // UdpControl::getPort()
+
+/**
+ * @brief Datagrams answered with one result since start up.
+ *
+ * @param result enum udpResult.
+ *
+ * @return Count.
+ */
+uint32_t UdpControl::getCount(uint8_t result)
+{
+   return (result < UDP_RESULTS) ? this->counts[result] : 0;
+} // UdpControl::getCount()
+
+/**
+ * @brief Datagrams dropped without an answer since start up.
+ *
+ * @param NA No parameters.
+ *
+ * @return Count.
+ */
+uint32_t UdpControl::getMalformed()
+{
+   return this->malformed;
+} // UdpControl::getMalformed()
+
+/**
+ * @brief Check the session and sequence number of a datagram in the buffer
+ * and dispatch it if it is newer than the last one taken.
+ *
+ * @param length Bytes in the datagram, already checked for a topic.
+ *
+ * @return enum udpResult.
+ */
+uint8_t UdpControl::handle(uint16_t length)
+{
+   uint16_t session = this->buffer[1] | (this->buffer[2] << 8);
+   uint32_t sequence = this->buffer[3] | (this->buffer[4] << 8) | ((uint32_t)this->buffer[5] << 16)
+                     | ((uint32_t)this->buffer[6] << 24);
+   uint32_t now = millis();
+   if(!this->haveSession || (session != this->session && now - this->heardMs > udpSessionMs))
+   {
+      this->haveSession = true;
+      this->session = session;
+      this->sequence = sequence - 1; // Whatever the new sender starts from is newer.
+   } // if
+   if(session != this->session)
+   {
+      return UDP_BUSY;
+   } // if
+   if((int32_t)(sequence - this->sequence) <= 0) // Newer, allowing for wrap around.
+   {
+      return UDP_STALE;
+   } // if
+   this->sequence = sequence;
+   this->heardMs = now;
+   const char* topic = (const char*)this->buffer + udpHeaderSize;
+   uint16_t topicLength = strlen(topic);
+   uint8_t* payload = this->buffer + udpHeaderSize + topicLength + 1;
+   unsigned int payloadLength = length - udpHeaderSize - topicLength - 1;
+   return this->handler(topic, payload, payloadLength) ? UDP_ACCEPTED : UDP_UNKNOWN;
+} // UdpControl::handle()
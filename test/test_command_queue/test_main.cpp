@@ -0,0 +1,312 @@
+/******************************************************************************
+ * @file test_main.cpp
+ *
+ * @brief Unity tests of the setpoint queue between the MQTT callback and the
+ * motor task, see commandQueue.h.
+ *
+ * @details The first tests walk one thread through coalescing, stops, drops
+ * and batches, including a stop that arrives between takeStop() and
+ * collect(). The stress test then runs a producer and a consumer thread
+ * against each other, as the two cores do in DUAL_CORE mode, and checks that
+ * every setpoint is either applied or counted and that each actuator only
+ * ever moves forward through the values it was sent. Run with
+ * pio test -e native.
+ ******************************************************************************/
+#include <unity.h> // Unity test framework. Comes with PlatformIO.
+#include <commandQueue.h> // Lock-free setpoint queue.
+#include <thread> // Producer and consumer threads for the stress test.
+
+const uint32_t stressPushes = 200000; // Setpoints the stress producer sends.
+const uint32_t stressStopEvery = 997; // Pushes between stops in the stress test.
+
+/**
+ * @brief Called by Unity before each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void setUp()
+{
+} // setUp()
+
+/**
+ * @brief Called by Unity after each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void tearDown()
+{
+} // tearDown()
+
+/**
+ * @brief Only the newest setpoint of each actuator survives a collect() and
+ * the ones it replaced are counted as coalesced.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_coalesce_keeps_newest()
+{
+   CommandQueue queue;
+   int16_t latest[ACT_COUNT] = {0};
+   TEST_ASSERT_TRUE(queue.push(ACT_HOIST, 10));
+   TEST_ASSERT_TRUE(queue.push(ACT_SLEW, 5));
+   TEST_ASSERT_TRUE(queue.push(ACT_HOIST, 20));
+   TEST_ASSERT_TRUE(queue.push(ACT_HOIST, -30));
+   TEST_ASSERT_EQUAL_UINT16(4, queue.getDepth());
+   TEST_ASSERT_EQUAL_UINT8((1 << ACT_HOIST) | (1 << ACT_SLEW), queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(-30, latest[ACT_HOIST]);
+   TEST_ASSERT_EQUAL_INT16(5, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_UINT32(2, queue.getCoalesced());
+   TEST_ASSERT_EQUAL_UINT16(0, queue.getDepth());
+   TEST_ASSERT_EQUAL_UINT8(0, queue.collect(latest));
+} // test_coalesce_keeps_newest()
+
+/**
+ * @brief A stop discards what was queued before it and keeps what was queued
+ * after it.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_stop_discards_only_earlier()
+{
+   CommandQueue queue;
+   int16_t latest[ACT_COUNT] = {0};
+   queue.push(ACT_SLEW, 100);
+   queue.push(ACT_LUFF, 50);
+   queue.requestStop();
+   queue.push(ACT_SLEW, -100);
+   TEST_ASSERT_TRUE(queue.takeStop());
+   TEST_ASSERT_FALSE(queue.takeStop());
+   TEST_ASSERT_EQUAL_UINT32(2, queue.getCoalesced());
+   TEST_ASSERT_EQUAL_UINT32(1, queue.getStops());
+   TEST_ASSERT_EQUAL_UINT8(1 << ACT_SLEW, queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(-100, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_INT16(0, latest[ACT_LUFF]);
+} // test_stop_discards_only_earlier()
+
+/**
+ * @brief A stop that arrives between takeStop() and collect() keeps
+ * collect() from taking the setpoints queued after it, so the consumer
+ * applies them after the stop rather than zeroing them with it.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_stop_between_take_and_collect()
+{
+   CommandQueue queue;
+   int16_t latest[ACT_COUNT] = {0};
+   queue.push(ACT_SLEW, 10);
+   TEST_ASSERT_FALSE(queue.takeStop());
+   queue.requestStop();
+   queue.push(ACT_SLEW, 20);
+   queue.push(ACT_HOIST, 5);
+   TEST_ASSERT_EQUAL_UINT8(1 << ACT_SLEW, queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(10, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_UINT16(2, queue.getDepth());
+   TEST_ASSERT_TRUE(queue.takeStop());
+   TEST_ASSERT_EQUAL_UINT32(0, queue.getCoalesced());
+   TEST_ASSERT_EQUAL_UINT8((1 << ACT_SLEW) | (1 << ACT_HOIST), queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(20, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_INT16(5, latest[ACT_HOIST]);
+} // test_stop_between_take_and_collect()
+
+/**
+ * @brief A full queue refuses and counts setpoints but still takes a stop,
+ * which makes room again.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_full_queue_counts_drops()
+{
+   CommandQueue queue;
+   int16_t latest[ACT_COUNT] = {0};
+   for(uint16_t i = 0; i < commandQueueSize; i++)
+   {
+      TEST_ASSERT_TRUE(queue.push(i % ACT_COUNT, i));
+   } // for
+   TEST_ASSERT_FALSE(queue.push(ACT_SERVO, 90));
+   TEST_ASSERT_FALSE(queue.push(ACT_SERVO, 91));
+   TEST_ASSERT_EQUAL_UINT32(2, queue.getDrops());
+   TEST_ASSERT_EQUAL_UINT16(commandQueueSize, queue.getDepth());
+   queue.requestStop();
+   TEST_ASSERT_TRUE(queue.takeStop());
+   TEST_ASSERT_EQUAL_UINT32(commandQueueSize, queue.getCoalesced());
+   TEST_ASSERT_TRUE(queue.push(ACT_SERVO, 92));
+   TEST_ASSERT_EQUAL_UINT8(1 << ACT_SERVO, queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(92, latest[ACT_SERVO]);
+   TEST_ASSERT_EQUAL_UINT32(2, queue.getDrops());
+} // test_full_queue_counts_drops()
+
+/**
+ * @brief A staged batch is seen whole once committed and not at all if it is
+ * abandoned, including when it ran out of room part way.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_batch_is_all_or_nothing()
+{
+   CommandQueue queue;
+   int16_t latest[ACT_COUNT] = {0};
+   TEST_ASSERT_TRUE(queue.stage(ACT_SLEW, 1));
+   TEST_ASSERT_TRUE(queue.stage(ACT_HOIST, 2));
+   TEST_ASSERT_TRUE(queue.stage(ACT_SERVO, 3));
+   TEST_ASSERT_EQUAL_UINT8(0, queue.collect(latest));
+   queue.commit();
+   TEST_ASSERT_EQUAL_UINT8((1 << ACT_SLEW) | (1 << ACT_HOIST) | (1 << ACT_SERVO), queue.collect(latest));
+   queue.stage(ACT_LUFF, 4);
+   queue.abandon();
+   queue.commit();
+   TEST_ASSERT_EQUAL_UINT8(0, queue.collect(latest));
+   bool staged = true;
+   for(uint16_t i = 0; i <= commandQueueSize && staged; i++)
+   {
+      staged = queue.stage(ACT_LUFF, i);
+   } // for
+   TEST_ASSERT_FALSE(staged);
+   queue.abandon();
+   queue.commit();
+   TEST_ASSERT_EQUAL_UINT16(0, queue.getDepth());
+   TEST_ASSERT_EQUAL_UINT8(0, queue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(0, latest[ACT_LUFF]);
+} // test_batch_is_all_or_nothing()
+
+/**
+ * @brief One producer and one consumer thread hammer the queue. The producer
+ * sends each actuator the values 1, 2, 3 and so on, retrying when the queue
+ * is full, with a stop every stressStopEvery pushes. The consumer takes
+ * stops and collects as the motor task does, zeroing every actuator on a
+ * stop.
+ *
+ * @details Checked: each actuator only steps forward, by no more than two
+ * queues worth, so nothing is torn or replayed. Every setpoint is either
+ * applied or counted as coalesced. Every refused push is counted as a drop.
+ * No stop zeroes a setpoint sent after it: before each stop the producer
+ * notes the last value it sent each actuator, and no value the consumer
+ * holds when it takes the stop may be newer. The last value sent to each
+ * actuator is the one it ends on, so the setpoints sent after the last stop
+ * survive it.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_stress_producer_consumer()
+{
+   CommandQueue queue;
+   std::atomic<bool> done{false};
+   std::atomic<uint16_t> sentAtStop[ACT_COUNT];
+   for(std::atomic<uint16_t>& sentBefore : sentAtStop)
+   {
+      sentBefore = 0;
+   } // for
+   uint16_t sent[ACT_COUNT] = {0};
+   uint32_t refused = 0;
+   uint32_t stopsRequested = 0;
+   std::thread producer([&]()
+   {
+      for(uint32_t i = 0; i < stressPushes; i++)
+      {
+         uint8_t actuator = i % ACT_COUNT;
+         if(i % stressStopEvery == stressStopEvery - 1)
+         {
+            for(uint8_t a = 0; a < ACT_COUNT; a++)
+            {
+               sentAtStop[a].store(sent[a], std::memory_order_relaxed);
+            } // for
+            queue.requestStop(); // Publishes sentAtStop with the stop.
+            stopsRequested++;
+         } // if
+         while(!queue.push(actuator, (int16_t)(sent[actuator] + 1)))
+         {
+            refused++;
+            std::this_thread::yield();
+         } // while
+         sent[actuator]++;
+      } // for
+      done.store(true, std::memory_order_release);
+   });
+   int16_t latest[ACT_COUNT] = {0};
+   uint16_t seen[ACT_COUNT] = {0};
+   uint16_t applied[ACT_COUNT] = {0};
+   uint32_t collected = 0;
+   uint32_t badSteps = 0;
+   uint32_t zeroedLater = 0;
+   bool finished = false;
+   while(!finished)
+   {
+      finished = done.load(std::memory_order_acquire); // Then one last pass.
+      if(queue.takeStop())
+      {
+         for(uint8_t a = 0; a < ACT_COUNT; a++)
+         {
+            if(applied[a] > sentAtStop[a].load(std::memory_order_relaxed))
+            {
+               zeroedLater++;
+            } // if
+            applied[a] = 0;
+         } // for
+      } // if
+      std::this_thread::yield(); // Room for a stop between the two.
+      uint8_t changed = queue.collect(latest);
+      for(uint8_t a = 0; a < ACT_COUNT; a++)
+      {
+         if(changed & (1 << a))
+         {
+            uint16_t step = (uint16_t)latest[a] - seen[a];
+            if(step == 0 || step > 2 * commandQueueSize)
+            {
+               badSteps++;
+            } // if
+            seen[a] = latest[a];
+            applied[a] = latest[a];
+            collected++;
+         } // if
+      } // for
+   } // while
+   producer.join();
+   TEST_ASSERT_EQUAL_UINT32(0, badSteps);
+   TEST_ASSERT_EQUAL_UINT32(0, zeroedLater);
+   TEST_ASSERT_EQUAL_UINT32(stressPushes, collected + queue.getCoalesced());
+   TEST_ASSERT_EQUAL_UINT32(refused, queue.getDrops());
+   TEST_ASSERT_TRUE(queue.getStops() >= 1);
+   TEST_ASSERT_TRUE(queue.getStops() <= stopsRequested);
+   TEST_ASSERT_EQUAL_UINT16(0, queue.getDepth());
+   for(uint8_t a = 0; a < ACT_COUNT; a++)
+   {
+      TEST_ASSERT_EQUAL_UINT16(sent[a], seen[a]);
+      TEST_ASSERT_EQUAL_UINT16(sent[a], applied[a]);
+   } // for
+} // test_stress_producer_consumer()
+
+/**
+ * @brief Run the tests.
+ *
+ * @param argc Not used.
+ * @param argv Not used.
+ *
+ * @return Number of failed tests.
+ */
+int main(int argc, char** argv)
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_coalesce_keeps_newest);
+   RUN_TEST(test_stop_discards_only_earlier);
+   RUN_TEST(test_stop_between_take_and_collect);
+   RUN_TEST(test_full_queue_counts_drops);
+   RUN_TEST(test_batch_is_all_or_nothing);
+   RUN_TEST(test_stress_producer_consumer);
+   return UNITY_END();
+} // main()
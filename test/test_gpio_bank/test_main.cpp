@@ -0,0 +1,251 @@
+/******************************************************************************
+ * @file test_main.cpp
+ *
+ * @brief Unity tests of the multi-pin GPIO writes in gpioBank.h, and a
+ * microbenchmark of reversing the L298N inputs with them against two
+ * digitalWrite() calls.
+ *
+ * @details The first tests check masks, the clear before set order and
+ * gpioDetach() against the recording fake of a host build. The benchmark
+ * reverses the motor A inputs benchReversals times each way, in the order
+ * the firmware used before gpioUpdate(), set then clear, and prints one
+ * line per path:
+ *
+ *    gpio reverse <path>: ns_avg, ns_max, writes, both_high
+ *
+ * ns_avg and ns_max are the time from the first pin starting to change to
+ * the last one done, so also the skew between the two inputs. writes is
+ * the number of separate output calls and both_high says whether a
+ * reversal passes through both inputs high, which on an L298N is a brake.
+ * That is read in one extra reversal outside the timing.
+ *
+ * Run with pio test -e native, where both paths are host stand-ins and the
+ * times only show that the harness works. For device figures run it on a
+ * Huzzah32 with pio test -e featheresp32, which times with the CPU cycle
+ * counter. The motor A enable is held low there so the motor stays off.
+ ******************************************************************************/
+#include <unity.h> // Unity test framework. Comes with PlatformIO.
+#include <Arduino.h> // Arduino Core for ESP32. Comes with PlatformIO.
+#include <huzzah32GpioPins.h> // Huzzah32 pin names.
+#include <projectPinout.h> // Bridge pins and their masks.
+#include <gpioBank.h> // The code under measurement.
+#include <stdio.h> // Benchmark lines.
+#if !defined(ARDUINO_ARCH_ESP32)
+#include <chrono> // Host time.
+#endif
+
+const uint32_t benchReversals = 10000; // Reversals per path.
+
+/**
+ * @brief A time stamp in nano-seconds, from the CPU cycle counter on the
+ * device and from the host clock otherwise.
+ *
+ * @param NA No parameters.
+ *
+ * @return Nano-seconds from an arbitrary start, wrapping.
+ */
+static uint32_t benchNanos()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+   return ESP.getCycleCount() * (1000 / ESP.getCpuFreqMHz());
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+} // benchNanos()
+
+/**
+ * @brief Called by Unity before each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void setUp()
+{
+} // setUp()
+
+/**
+ * @brief Called by Unity after each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void tearDown()
+{
+} // tearDown()
+
+#if !defined(ARDUINO_ARCH_ESP32)
+/**
+ * @brief Masks put each pin in its bank, and a negative pin in none.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_mask_of()
+{
+   TEST_ASSERT_EQUAL_UINT32(1 << 25, gpioMaskOf(25).bank0);
+   TEST_ASSERT_EQUAL_UINT32(0, gpioMaskOf(25).bank1);
+   TEST_ASSERT_EQUAL_UINT32(0, gpioMaskOf(33).bank0);
+   TEST_ASSERT_EQUAL_UINT32(1 << 1, gpioMaskOf(33).bank1);
+   TEST_ASSERT_EQUAL_UINT32(0, gpioMaskOf(-1).bank0 | gpioMaskOf(-1).bank1);
+   TEST_ASSERT_EQUAL_UINT32(gpioMaskOf(inA1).bank0 | gpioMaskOf(inA2).bank0, motorAInputs.bank0);
+} // test_mask_of()
+
+/**
+ * @brief A reversal is one write that clears both inputs and sets one, and
+ * a pin in both masks ends high.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_update_clears_then_sets()
+{
+   gpioMask in1 = gpioMaskOf(inA1);
+   gpioMask in2 = gpioMaskOf(inA2);
+   gpioUpdate(gpioNone, in1);
+   uint32_t writes = gpioFakeWrites;
+   gpioUpdate(motorAInputs, in2);
+   TEST_ASSERT_EQUAL_UINT32(writes + 1, gpioFakeWrites);
+   TEST_ASSERT_EQUAL_UINT32(in2.bank0, gpioFakeLevels.bank0 & motorAInputs.bank0);
+   const gpioFakeWrite& entry = gpioFakeLog[writes % gpioFakeLogSize];
+   TEST_ASSERT_EQUAL_UINT32(motorAInputs.bank0, entry.clear.bank0);
+   TEST_ASSERT_EQUAL_UINT32(in2.bank0, entry.set.bank0);
+   gpioMask high33 = gpioMaskOf(33);
+   gpioUpdate(high33, high33);
+   TEST_ASSERT_EQUAL_UINT32(high33.bank1, gpioFakeLevels.bank1 & high33.bank1);
+   gpioUpdate(high33 | motorAInputs, gpioNone);
+} // test_update_clears_then_sets()
+
+/**
+ * @brief gpioDetach() drives the pins low and marks them detached.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_detach_cuts_pins()
+{
+   gpioUpdate(gpioNone, allBridgePins);
+   gpioDetach(allBridgePins);
+   TEST_ASSERT_EQUAL_UINT32(0, gpioFakeLevels.bank0 & allBridgePins.bank0);
+   TEST_ASSERT_EQUAL_UINT32(0, gpioFakeLevels.bank1 & allBridgePins.bank1);
+   TEST_ASSERT_EQUAL_UINT32(allBridgePins.bank0, gpioFakeDetached.bank0 & allBridgePins.bank0);
+   TEST_ASSERT_EQUAL_UINT32(allBridgePins.bank1, gpioFakeDetached.bank1 & allBridgePins.bank1);
+} // test_detach_cuts_pins()
+#endif
+
+/**
+ * @brief Reverse the motor A inputs over and over with register writes and
+ * with digitalWrite(), and print the time and skew of each.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_reverse_benchmark()
+{
+   gpioMask in1 = gpioMaskOf(inA1);
+   gpioMask in2 = gpioMaskOf(inA2);
+   pinMode(enA1, OUTPUT);
+   digitalWrite(enA1, LOW); // Motor A stays off.
+   pinMode(inA1, OUTPUT);
+   pinMode(inA2, OUTPUT);
+   for(uint8_t path = 0; path < 2; path++)
+   {
+      uint64_t total = 0;
+      uint32_t worst = 0;
+      for(uint32_t i = 0; i < benchReversals; i++)
+      {
+         bool forward = (i & 1) == 0;
+         uint32_t start = benchNanos();
+         if(path == 0)
+         {
+            gpioUpdate(motorAInputs, forward ? in2 : in1);
+         } // if
+         else
+         {
+            digitalWrite(forward ? inA2 : inA1, HIGH);
+            digitalWrite(forward ? inA1 : inA2, LOW);
+         } // else
+         uint32_t took = benchNanos() - start;
+         total += took;
+         worst = max(worst, took);
+      } // for
+      // One call clears before it sets, so only two calls can pass through
+      // both high. Check that in one more reversal, outside the timing.
+      bool bothHigh = false;
+      if(path == 1)
+      {
+         digitalWrite(inA1, HIGH);
+         digitalWrite(inA2, HIGH);
+         bothHigh = digitalRead(inA1) == HIGH && digitalRead(inA2) == HIGH;
+         digitalWrite(inA1, LOW);
+      } // if
+      printf("gpio reverse %s: ns_avg=%.1f ns_max=%lu writes=%u both_high=%s\n",
+             (path == 0) ? "register" : "digitalWrite", (double)total / benchReversals,
+             (unsigned long)worst, (path == 0) ? 1 : 2, bothHigh ? "yes" : "no");
+   } // for
+   gpioUpdate(motorAInputs, gpioNone);
+} // test_reverse_benchmark()
+
+/**
+ * @brief Run the tests.
+ *
+ * @param NA No parameters.
+ *
+ * @return Number of failed tests.
+ */
+int runTests()
+{
+   UNITY_BEGIN();
+#if !defined(ARDUINO_ARCH_ESP32)
+   RUN_TEST(test_mask_of);
+   RUN_TEST(test_update_clears_then_sets);
+   RUN_TEST(test_detach_cuts_pins);
+#endif
+   RUN_TEST(test_reverse_benchmark);
+   return UNITY_END();
+} // runTests()
+
+#if defined(ARDUINO_ARCH_ESP32)
+/**
+ * @brief Run the tests on the device once the serial monitor is up.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void setup()
+{
+   delay(2000);
+   runTests();
+} // setup()
+
+/**
+ * @brief Nothing more to do.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void loop()
+{
+} // loop()
+#else
+/**
+ * @brief Run the tests on the host.
+ *
+ * @param argc Not used.
+ * @param argv Not used.
+ *
+ * @return Number of failed tests.
+ */
+int main(int argc, char** argv)
+{
+   return runTests();
+} // main()
+#endif
@@ -0,0 +1,383 @@
+/******************************************************************************
+ * @file test_main.cpp
+ *
+ * @brief Unity tests of queueBatch(), the JSON command batch parser in
+ * main.cpp, and of the JsonPool allocator it parses into.
+ *
+ * @details The firmware is built into the test, so queueBatch() is called
+ * with the same commandQueue, jsonPool and jsonBatch as on the device. The
+ * tests cover a valid batch, the ways a batch is rejected whole, a stop in a
+ * batch and the pool moving a block that is not the last one. The last test
+ * times the parse against the String path, where the payload is copied into
+ * a String, parsed by a JsonDocument on the heap and each name copied into a
+ * String too, and prints one line per path:
+ *
+ *    batch parse <path>: ns_per_batch, ns_per_command, allocs_per_batch
+ *
+ * Times are host CPU time and only mean something against the other path
+ * on the same machine. Run with pio test -e native.
+ ******************************************************************************/
+#include <unity.h> // Unity test framework. Comes with PlatformIO.
+#include <hostSim.h> // Allocation count, quiet Serial.
+#include <commandQueue.h> // Where a batch lands.
+#include <jsonPool.h> // Heap free memory for ArduinoJson.
+#include <chrono> // Host time.
+#include <stdio.h> // Benchmark lines.
+
+extern CommandQueue commandQueue; // From main.cpp.
+extern JsonPool jsonPool; // From main.cpp.
+uint8_t queueBatch(byte* payload, unsigned int length);
+int8_t findActuator(const char* name, size_t length);
+bool setpointInRange(uint8_t actuator, int32_t value);
+
+const uint32_t benchBatches = 20000; // Batches per pass.
+const uint8_t benchPasses = 5; // Passes per path, the fastest counts.
+const char* const benchBatch =
+   "[{\"m\":\"slew\",\"v\":-120},{\"m\":\"hoist\",\"v\":200},{\"m\":\"luff\",\"v\":35},{\"m\":\"servo\",\"v\":90}]";
+const uint8_t benchCommands = 4; // Commands in benchBatch.
+
+// Heap allocator for the String path that counts what it is asked for.
+class CountingHeap : public ArduinoJson::Allocator
+{
+   public:
+      void* allocate(size_t size) override
+      {
+         this->calls++;
+         return malloc(size);
+      } // allocate()
+      void deallocate(void* pointer) override
+      {
+         free(pointer);
+      } // deallocate()
+      void* reallocate(void* pointer, size_t size) override
+      {
+         this->calls++;
+         return realloc(pointer, size);
+      } // reallocate()
+      uint64_t calls = 0; // allocate() and reallocate() calls.
+}; // class CountingHeap
+
+/**
+ * @brief Host time in nano-seconds.
+ *
+ * @param NA No parameters.
+ *
+ * @return Nano-seconds from an arbitrary start.
+ */
+static uint64_t benchNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+} // benchNanos()
+
+/**
+ * @brief Run one batch through queueBatch() from a writable copy, as it
+ * would lie in the PubSubClient receive buffer.
+ *
+ * @param text The batch.
+ *
+ * @return What queueBatch() returned.
+ */
+static uint8_t batch(const char* text)
+{
+   static byte buffer[512];
+   size_t length = strlen(text);
+   memcpy(buffer, text, length);
+   return queueBatch(buffer, length);
+} // batch()
+
+/**
+ * @brief The String path: the same checks as queueBatch(), on a copy of the
+ * payload, a heap document and a String per name.
+ *
+ * @param queue Where the batch lands.
+ * @param document Parses onto the heap.
+ * @param payload The batch, zero terminated.
+ *
+ * @return Number of commands, 0 if rejected.
+ */
+static uint8_t stringBatch(CommandQueue& queue, JsonDocument& document, const char* payload)
+{
+   String message = payload;
+   if(deserializeJson(document, message.c_str(), message.length()) || !document.is<JsonArray>())
+   {
+      return 0;
+   } // if
+   uint8_t count = 0;
+   for(JsonVariant item : document.as<JsonArray>())
+   {
+      String name = item["m"] | "";
+      int8_t axis = (name == "servo") ? (int8_t)ACT_SERVO : findActuator(name.c_str(), name.length());
+      int32_t value = item["v"].as<int32_t>();
+      if(axis < 0 || !item["v"].is<int32_t>() || !setpointInRange(axis, value) || !queue.stage(axis, value))
+      {
+         queue.abandon();
+         return 0;
+      } // if
+      count++;
+   } // for
+   queue.commit();
+   return count;
+} // stringBatch()
+
+/**
+ * @brief Called by Unity before each test. Empties the command queue.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void setUp()
+{
+   hostSimSetQuiet(true);
+   int16_t latest[ACT_COUNT];
+   commandQueue.takeStop();
+   commandQueue.collect(latest);
+} // setUp()
+
+/**
+ * @brief Called by Unity after each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void tearDown()
+{
+} // tearDown()
+
+/**
+ * @brief A valid batch is queued whole and lands in one collect().
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_valid_batch()
+{
+   int16_t latest[ACT_COUNT] = {0};
+   TEST_ASSERT_EQUAL_UINT8(3, batch("[{\"m\":\"hoist\",\"v\":40},{\"m\":\"servo\",\"v\":120},"
+                                    "{\"m\":\"slew\",\"v\":-255}]"));
+   TEST_ASSERT_EQUAL_UINT8((1 << ACT_HOIST) | (1 << ACT_SERVO) | (1 << ACT_SLEW), commandQueue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(40, latest[ACT_HOIST]);
+   TEST_ASSERT_EQUAL_INT16(120, latest[ACT_SERVO]);
+   TEST_ASSERT_EQUAL_INT16(-255, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_UINT8(1, batch("[{\"m\":\"pos\",\"v\":0}]"));
+   TEST_ASSERT_EQUAL_UINT8(1 << ACT_SERVO, commandQueue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(0, latest[ACT_SERVO]);
+} // test_valid_batch()
+
+/**
+ * @brief An unknown actuator anywhere in the batch rejects all of it.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_unknown_actuator()
+{
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":40},{\"m\":\"jib\",\"v\":1}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoistx\",\"v\":40}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"v\":40}]"));
+   TEST_ASSERT_EQUAL_UINT16(0, commandQueue.getDepth());
+} // test_unknown_actuator()
+
+/**
+ * @brief A value out of range for its actuator rejects the batch instead of
+ * being narrowed or clamped.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_out_of_range_value()
+{
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"luff\",\"v\":10},{\"m\":\"hoist\",\"v\":256}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"slew\",\"v\":-256}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"servo\",\"v\":181}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"servo\",\"v\":-1}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":65576}]")); // 40 once narrowed to int16_t.
+   TEST_ASSERT_EQUAL_UINT16(0, commandQueue.getDepth());
+} // test_out_of_range_value()
+
+/**
+ * @brief Only whole numbers that fit an int32_t pass the is<int32_t>()
+ * check, so strings, fractions, booleans, nulls, missing values and numbers
+ * too big for as<int32_t>() all reject the batch.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_value_must_be_whole_number()
+{
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":\"40\"}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":40.5}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":true}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":null}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\"}]"));
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"hoist\",\"v\":4294967336}]")); // 40 once narrowed to int32_t.
+   TEST_ASSERT_EQUAL_UINT16(0, commandQueue.getDepth());
+} // test_value_must_be_whole_number()
+
+/**
+ * @brief A batch that does not fit in the queue is abandoned whole, and
+ * what was queued before it is untouched.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_full_queue()
+{
+   int16_t latest[ACT_COUNT] = {0};
+   for(uint16_t i = 0; i < commandQueueSize - 1; i++)
+   {
+      TEST_ASSERT_TRUE(commandQueue.push(ACT_LUFF, i));
+   } // for
+   uint32_t drops = commandQueue.getDrops();
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"slew\",\"v\":1},{\"m\":\"hoist\",\"v\":2}]"));
+   TEST_ASSERT_EQUAL_UINT32(drops + 1, commandQueue.getDrops());
+   TEST_ASSERT_EQUAL_UINT16(commandQueueSize - 1, commandQueue.getDepth());
+   TEST_ASSERT_EQUAL_UINT8(1 << ACT_LUFF, commandQueue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(commandQueueSize - 2, latest[ACT_LUFF]);
+   TEST_ASSERT_EQUAL_UINT8(2, batch("[{\"m\":\"slew\",\"v\":1},{\"m\":\"hoist\",\"v\":2}]"));
+} // test_full_queue()
+
+/**
+ * @brief A stop anywhere in a batch flushes what was queued before the
+ * batch, and every setpoint in the batch lands after it.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_stop_goes_first()
+{
+   int16_t latest[ACT_COUNT] = {0};
+   commandQueue.push(ACT_HOIST, 100);
+   TEST_ASSERT_EQUAL_UINT8(3, batch("[{\"m\":\"slew\",\"v\":50},{\"m\":\"stop\"},{\"m\":\"luff\",\"v\":-20}]"));
+   TEST_ASSERT_TRUE(commandQueue.takeStop());
+   TEST_ASSERT_EQUAL_UINT8((1 << ACT_SLEW) | (1 << ACT_LUFF), commandQueue.collect(latest));
+   TEST_ASSERT_EQUAL_INT16(50, latest[ACT_SLEW]);
+   TEST_ASSERT_EQUAL_INT16(-20, latest[ACT_LUFF]);
+   TEST_ASSERT_EQUAL_UINT8(0, batch("[{\"m\":\"stop\"},{\"m\":\"jib\",\"v\":1}]"));
+   TEST_ASSERT_FALSE(commandQueue.takeStop()); // A rejected batch stops nothing.
+} // test_stop_goes_first()
+
+/**
+ * @brief The most recent block grows and shrinks in place, an older one is
+ * copied to a new block with its contents, and a request that does not fit
+ * fails and is counted.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_pool_reallocates_older_block()
+{
+   alignas(8) static uint8_t memory[256];
+   JsonPool pool(memory, sizeof(memory));
+   uint8_t* first = (uint8_t*)pool.allocate(16);
+   uint8_t* second = (uint8_t*)pool.allocate(8);
+   TEST_ASSERT_NOT_NULL(first);
+   TEST_ASSERT_NOT_NULL(second);
+   for(uint8_t i = 0; i < 16; i++)
+   {
+      first[i] = i + 1;
+   } // for
+   TEST_ASSERT_EQUAL_PTR(second, pool.reallocate(second, 24)); // Last, in place.
+   uint8_t* moved = (uint8_t*)pool.reallocate(first, 40); // Not last, copied.
+   TEST_ASSERT_NOT_NULL(moved);
+   TEST_ASSERT_TRUE(moved > second);
+   for(uint8_t i = 0; i < 16; i++)
+   {
+      TEST_ASSERT_EQUAL_UINT8(i + 1, moved[i]);
+   } // for
+   TEST_ASSERT_EQUAL_UINT32(24 + 32 + 48, pool.getHighWaterMark()); // Each with an 8 byte header.
+   pool.deallocate(second); // Not last any more, stays until reset().
+   TEST_ASSERT_EQUAL_PTR(moved, pool.reallocate(moved, 8)); // Last again, shrinks in place.
+   TEST_ASSERT_NULL(pool.reallocate(second, 200));
+   TEST_ASSERT_EQUAL_UINT32(1, pool.getFailures());
+   pool.reset();
+   TEST_ASSERT_EQUAL_PTR(first, pool.allocate(16));
+} // test_pool_reallocates_older_block()
+
+/**
+ * @brief Time the batch parse in the pool against the String path and
+ * check that only the String path touches the heap.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_parse_benchmark()
+{
+   static byte buffer[256];
+   size_t length = strlen(benchBatch);
+   int16_t latest[ACT_COUNT];
+   CommandQueue stringQueue;
+   CountingHeap heap;
+   JsonDocument heapDocument(&heap);
+   for(uint8_t path = 0; path < 2; path++)
+   {
+      uint64_t best = UINT64_MAX;
+      uint64_t allocations = 0;
+      for(uint8_t pass = 0; pass < benchPasses; pass++)
+      {
+         uint64_t stringsBefore = hostSimAllocations();
+         uint64_t heapBefore = heap.calls;
+         uint64_t start = benchNanos();
+         for(uint32_t i = 0; i < benchBatches; i++)
+         {
+            if(path == 0)
+            {
+               memcpy(buffer, benchBatch, length); // As it arrives in the receive buffer.
+               TEST_ASSERT_EQUAL_UINT8(benchCommands, queueBatch(buffer, length));
+               commandQueue.collect(latest);
+            } // if
+            else
+            {
+               TEST_ASSERT_EQUAL_UINT8(benchCommands, stringBatch(stringQueue, heapDocument, benchBatch));
+               stringQueue.collect(latest);
+            } // else
+         } // for
+         best = min(best, benchNanos() - start);
+         allocations = hostSimAllocations() - stringsBefore + heap.calls - heapBefore;
+      } // for
+      printf("batch parse %s: ns_per_batch=%.0f ns_per_command=%.0f allocs_per_batch=%.2f\n",
+             (path == 0) ? "pool" : "string", (double)best / benchBatches,
+             (double)best / benchBatches / benchCommands, (double)allocations / benchBatches);
+      if(path == 0)
+      {
+         TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)allocations);
+      } // if
+      else
+      {
+         TEST_ASSERT_TRUE(allocations > 0);
+      } // else
+   } // for
+   TEST_ASSERT_EQUAL_UINT32(0, jsonPool.getFailures());
+} // test_parse_benchmark()
+
+/**
+ * @brief Run the tests.
+ *
+ * @param argc Not used.
+ * @param argv Not used.
+ *
+ * @return Number of failed tests.
+ */
+int main(int argc, char** argv)
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_valid_batch);
+   RUN_TEST(test_unknown_actuator);
+   RUN_TEST(test_out_of_range_value);
+   RUN_TEST(test_value_must_be_whole_number);
+   RUN_TEST(test_full_queue);
+   RUN_TEST(test_stop_goes_first);
+   RUN_TEST(test_pool_reallocates_older_block);
+   RUN_TEST(test_parse_benchmark);
+   return UNITY_END();
+} // main()
@@ -0,0 +1,311 @@
+/******************************************************************************
+ * @file test_main.cpp
+ *
+ * @brief Throughput, allocation and latency figures for MqttLogger.
+ *
+ * @details Run with pio test -e native -f test_logger_bench -v. Every
+ * MqttLoggerMode is measured both synchronous and with the ring buffer of
+ * setAsync(), each with three kinds of line:
+ * 1. literal : One println() of a string literal, the cheapest possible line.
+ * 2. macro : The same text written the way the LOG, LOGNF and LOGLNF
+ *    macros write it, one print() per piece.
+ * 3. long : A 300 character String, longer than the logger buffer.
+ *
+ * The logger publishes to a connected broker and Serial output is thrown
+ * away, so the figures are for the logger code itself. Times are host CPU
+ * time and only mean something against another run on the same machine.
+ * Allocation counts are exact for this build but the ESP32 String keeps
+ * short text inside the object up to a different length. Each run prints
+ * one JSON object per line, which tools/benchcompare.py picks out of the
+ * test output:
+ *
+ *    bench, mode, async, line, lines, bytes, lines_per_s, bytes_per_s,
+ *    ns_per_byte, allocs_per_line, publishes_per_line, line_ns_p50,
+ *    line_ns_p99, line_ns_max, drain_ns_max, dropped_bytes
+ *
+ * Each run is several passes. The rates come from the fastest pass and the
+ * latencies from all of them. In async runs the ring is emptied every few
+ * lines. The line times exclude that, since the firmware drains from its own
+ * task, but lines_per_s and bytes_per_s include it.
+ *
+ * Each mode is one test. It fails if a line allocates, if bytes are
+ * dropped, or if lines are not published when the mode should publish them.
+ ******************************************************************************/
+#include <unity.h> // Unity test framework. Comes with PlatformIO.
+#include <hostSim.h> // Virtual clock, allocation count.
+#include <Arduino.h> // Host stand-in for the Arduino core.
+#include <WiFi.h> // Connect to the simulated Access Point.
+#include <PubSubClient.h> // Simulated broker connection.
+#include <MqttLogger.h> // The code under measurement.
+#include <latencyHistogram.h> // Per line time distribution.
+#include <chrono> // Host time.
+#include <string> // Long line text.
+#include <stdio.h> // Result lines.
+
+const uint32_t benchLines = 20000; // Lines per pass.
+const uint8_t benchPasses = 5; // Passes per run, the fastest gives the rates.
+const uint8_t benchDrainEvery = 4; // Lines between drain() calls in async runs.
+const uint16_t benchRingSize = 2048; // Ring size for async runs, as LOG_RING_SIZE.
+const uint16_t benchShortLength = 45; // Characters in the literal and macro lines.
+const uint16_t benchLongLength = 300; // Characters in a long line.
+const char* const benchModeNames[] = {"MqttAndSerialFallback", "SerialOnly", "MqttOnly", "MqttAndSerial"};
+WiFiClient benchWifiClient; // Socket of benchClient.
+PubSubClient benchClient(benchWifiClient); // Connected once by main().
+
+/**
+ * @brief Host time in nano-seconds.
+ *
+ * @param NA No parameters.
+ *
+ * @return Nano-seconds from an arbitrary start.
+ */
+static uint64_t benchNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+} // benchNanos()
+
+/**
+ * @brief Log one line the way the LOG macros do.
+ *
+ * @param logger Logger under measurement.
+ * @param value Number logged in the middle of the line.
+ *
+ * @return NA No return value.
+ */
+static void benchMacroLine(MqttLogger& logger, uint32_t value)
+{
+   logger.print('<');
+   logger.print("networkManager");
+   logger.print("> ");
+   logger.print("Retry in ");
+   logger.print(value);
+   logger.println(" milli-seconds.");
+} // benchMacroLine()
+
+/**
+ * @brief Log the same text as benchMacroLine() in one call.
+ *
+ * @param logger Logger under measurement.
+ * @param value Ignored, the literal already holds a number.
+ *
+ * @return NA No return value.
+ */
+static void benchLiteralLine(MqttLogger& logger, uint32_t value)
+{
+   logger.println("<networkManager> Retry in 1234 milli-seconds.");
+} // benchLiteralLine()
+
+/**
+ * @brief Log one line longer than the logger buffer.
+ *
+ * @param logger Logger under measurement.
+ * @param value Ignored.
+ *
+ * @return NA No return value.
+ */
+static void benchLongLine(MqttLogger& logger, uint32_t value)
+{
+   static const String text(std::string(benchLongLength, 'x').c_str());
+   logger.println(text);
+} // benchLongLine()
+
+/**
+ * @brief Empty the ring. Each drain() sends at most one packet.
+ *
+ * @param logger Logger under measurement.
+ *
+ * @return NA No return value.
+ */
+static void benchDrain(MqttLogger& logger)
+{
+   uint16_t queued = logger.getQueuedBytes();
+   while(queued > 0)
+   {
+      logger.drain();
+      uint16_t left = logger.getQueuedBytes();
+      if(left == queued)
+      {
+         return; // No progress, the mode holds lines back.
+      } // if
+      queued = left;
+   } // while
+} // benchDrain()
+
+/**
+ * @brief Measure one mode, ring setting and kind of line.
+ *
+ * @param mode Logger mode.
+ * @param async True to use the ring buffer.
+ * @param name Kind of line.
+ * @param line Function that logs one line.
+ * @param bytesPerLine Characters in the line.
+ *
+ * @return NA No return value.
+ */
+static void benchRun(MqttLoggerMode mode, bool async, const char* name,
+                     void (*line)(MqttLogger&, uint32_t), uint32_t bytesPerLine)
+{
+   MqttLogger logger(benchClient, "mqttlogger/log", mode, false);
+   logger.setAsync(async ? benchRingSize : 0);
+   LatencyHistogram lineNs;
+   uint64_t drainMax = 0;
+   line(logger, 1234); // Warm up so the first line is not all page faults.
+   logger.drain();
+   uint64_t allocations = hostSimAllocations();
+   uint32_t publishes = hostSimPublishes();
+   double seconds = 0;
+   for(uint8_t pass = 0; pass < benchPasses; pass++)
+   {
+      uint64_t started = benchNanos();
+      for(uint32_t i = 0; i < benchLines; i++)
+      {
+         uint64_t before = benchNanos();
+         line(logger, 1234);
+         uint64_t after = benchNanos();
+         lineNs.record((uint32_t)min<uint64_t>(after - before, UINT32_MAX));
+         if(async && (i % benchDrainEvery) == benchDrainEvery - 1)
+         {
+            benchDrain(logger);
+            drainMax = max(drainMax, benchNanos() - after);
+         } // if
+      } // for
+      benchDrain(logger);
+      double passSeconds = (benchNanos() - started) / 1e9;
+      seconds = (pass == 0) ? passSeconds : min(seconds, passSeconds); // Fastest pass, least disturbed.
+   } // for
+   allocations = (hostSimAllocations() - allocations) / benchPasses;
+   publishes = (hostSimPublishes() - publishes) / benchPasses;
+   printf("{\"bench\": \"mqttLogger\", \"mode\": \"%s\", \"async\": %s, \"line\": \"%s\", "
+           "\"lines\": %u, \"bytes\": %u, \"lines_per_s\": %.0f, \"bytes_per_s\": %.0f, "
+           "\"ns_per_byte\": %.2f, \"allocs_per_line\": %.2f, \"publishes_per_line\": %.2f, "
+           "\"line_ns_p50\": %u, \"line_ns_p99\": %u, \"line_ns_max\": %u, "
+           "\"drain_ns_max\": %llu, \"dropped_bytes\": %u}\n",
+           benchModeNames[mode], async ? "true" : "false", name, benchLines, benchLines * bytesPerLine,
+           benchLines / seconds, benchLines * bytesPerLine / seconds, seconds * 1e9 / (benchLines * bytesPerLine),
+           (double)allocations / benchLines, (double)publishes / benchLines, lineNs.getPercentile(50), lineNs.getPercentile(99), lineNs.getMax(),
+           (unsigned long long)drainMax, logger.getDroppedBytes());
+   TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)allocations);
+   TEST_ASSERT_EQUAL_UINT32(0, logger.getDroppedBytes());
+   if(mode == SerialOnly)
+   {
+      TEST_ASSERT_EQUAL_UINT32(0, publishes);
+   } // if
+   else
+   {
+      TEST_ASSERT_TRUE(publishes > 0 && publishes <= benchLines);
+   } // else
+} // benchRun()
+
+/**
+ * @brief Measure one mode with every ring setting and kind of line.
+ *
+ * @param mode Logger mode.
+ *
+ * @return NA No return value.
+ */
+static void benchMode(MqttLoggerMode mode)
+{
+   for(uint8_t async = 0; async < 2; async++)
+   {
+      benchRun(mode, async, "literal", benchLiteralLine, benchShortLength);
+      benchRun(mode, async, "macro", benchMacroLine, benchShortLength);
+      benchRun(mode, async, "long", benchLongLine, benchLongLength);
+   } // for
+} // benchMode()
+
+/**
+ * @brief Called by Unity before each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void setUp()
+{
+} // setUp()
+
+/**
+ * @brief Called by Unity after each test.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void tearDown()
+{
+} // tearDown()
+
+/**
+ * @brief Serial when offline, else MQTT.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_mqtt_and_serial_fallback()
+{
+   benchMode(MqttAndSerialFallback);
+} // test_mqtt_and_serial_fallback()
+
+/**
+ * @brief Serial only, nothing published.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_serial_only()
+{
+   benchMode(SerialOnly);
+} // test_serial_only()
+
+/**
+ * @brief MQTT only.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_mqtt_only()
+{
+   benchMode(MqttOnly);
+} // test_mqtt_only()
+
+/**
+ * @brief MQTT and Serial.
+ *
+ * @param NA No parameters.
+ *
+ * @return NA No return value.
+ */
+void test_mqtt_and_serial()
+{
+   benchMode(MqttAndSerial);
+} // test_mqtt_and_serial()
+
+/**
+ * @brief Connect to the simulated broker and run the tests.
+ *
+ * @param argc Not used.
+ * @param argv Not used.
+ *
+ * @return Number of failed tests, 1 if the broker could not be reached.
+ */
+int main(int argc, char** argv)
+{
+   WiFi.begin(hostSimApSsid());
+   hostSimAdvance(1000000); // Long enough to associate.
+   if(!benchClient.connect("loggerBench"))
+   {
+      fprintf(stderr, "loggerBench: no broker connection\n");
+      return 1;
+   } // if
+   hostSimSetQuiet(true);
+   UNITY_BEGIN();
+   RUN_TEST(test_mqtt_and_serial_fallback);
+   RUN_TEST(test_serial_only);
+   RUN_TEST(test_mqtt_only);
+   RUN_TEST(test_mqtt_and_serial);
+   return UNITY_END();
+} // main()
@@ -0,0 +1,92 @@
+"""Compare two benchmark result files and report regressions.
+
+Each file holds one JSON object per line as written by the native build.
+Lines that are not JSON objects are skipped, so the verbose output of a
+benchmark test can be compared as it is, for example:
+  pio test -e native -f test_logger_bench -v > after.txt
+  .pio/build/native/program --bench-router after.jsonl
+  python3 tools/benchcompare.py before.txt after.txt
+
+Runs are matched on every text and true/false field. A run regresses when a
+rate falls, or an allocation or drop count rises, by more than the
+threshold. The latency fields come from a histogram with 25% wide buckets
+and a single preempted call sets the maximum, so they are not compared.
+Host timings are noisy so compare runs made on the same machine.
+
+Usage: python3 tools/benchcompare.py [--threshold PERCENT] BEFORE AFTER
+  --threshold  allowed change in percent before a run is flagged (default 10).
+Exits 1 if anything regressed.
+"""
+import json
+import sys
+
+HIGHER_IS_BETTER = ("_per_s",)
+LOWER_IS_BETTER = ("allocs_per_line", "allocs_per_msg", "dropped_bytes")
+
+
+def describe(run):
+    """Descriptive fields of a run in file order."""
+    return [(k, v) for k, v in run.items() if isinstance(v, (str, bool))]
+
+
+def load(path):
+    """Runs in a file keyed by their descriptive fields."""
+    runs = {}
+    with open(path) as lines:
+        for line in lines:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            run = json.loads(line)
+            key = tuple(sorted(describe(run), key=str))
+            runs[key] = run
+    return runs
+
+
+def direction(field):
+    """+1 if a bigger value is better, -1 if smaller is better, 0 if neither."""
+    if field.endswith(HIGHER_IS_BETTER):
+        return 1
+    if field.endswith(LOWER_IS_BETTER):
+        return -1
+    return 0
+
+
+def main(arguments):
+    threshold = 10.0
+    if "--threshold" in arguments:
+        index = arguments.index("--threshold")
+        threshold = float(arguments[index + 1])
+        del arguments[index:index + 2]
+    if len(arguments) != 2:
+        sys.stderr.write(__doc__)
+        return 2
+    before, after = load(arguments[0]), load(arguments[1])
+    regressed = 0
+    for key, run in sorted(after.items()):
+        name = " ".join(str(v) for _, v in describe(run))
+        if key not in before:
+            print("new      %s" % name)
+            continue
+        for field, value in sorted(run.items()):
+            sign = direction(field)
+            old = before[key].get(field)
+            if sign == 0 or not isinstance(old, (int, float)):
+                continue
+            if old == 0:
+                change = 0.0 if value == 0 else 100.0
+            else:
+                change = 100.0 * (value - old) / old
+            if -sign * change > threshold:
+                regressed += 1
+                print("worse    %s %s %g -> %g (%+.0f%%)" % (name, field, old, value, change))
+            elif sign * change > threshold:
+                print("better   %s %s %g -> %g (%+.0f%%)" % (name, field, old, value, change))
+    for key in sorted(set(before) - set(after)):
+        print("missing  %s" % " ".join(str(v) for _, v in describe(before[key])))
+    print("%d regression(s) over %g%%" % (regressed, threshold))
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,107 @@
+"""Decode LOG_TOKENIZED log records back into text.
+
+Reads one hex encoded payload per line on stdin and prints the decoded log
+text. Both sources of records are accepted:
+  * MQTT: mosquitto_sub -t mqttlogger/log -F %x | python3 tools/logdecode.py
+  * Serial: lines starting with '#' as printed by MqttLogger. Other serial
+    lines are passed through unchanged.
+
+The dictionary is produced by tools/logtokens.py, normally as
+.pio/build/<env>/logtokens.json. Record layout is described in
+include/logToken.h.
+
+Usage: python3 tools/logdecode.py [-t] logtokens.json
+  -t  prefix every line with the device timestamp in milli-seconds.
+"""
+import ast
+import json
+import struct
+import sys
+
+ARG_NONE, ARG_INT, ARG_UINT, ARG_FLOAT, ARG_STRING = range(5)
+END_OF_LINE = 0x80
+
+
+def literal(text):
+    """Value of a C string literal as spelled in the source."""
+    try:
+        return ast.literal_eval(text)
+    except (ValueError, SyntaxError):
+        return text
+
+
+def argument(kind, raw):
+    if kind == ARG_INT:
+        return str(struct.unpack("<i", raw)[0])
+    if kind == ARG_UINT:
+        return str(struct.unpack("<I", raw)[0])
+    if kind == ARG_FLOAT:
+        return "%.2f" % struct.unpack("<f", raw)[0]
+    return raw.decode("utf-8", "replace")
+
+
+def records(payload):
+    """Split one payload into (token, timestamp, flags, argument) tuples."""
+    offset = 0
+    while offset < len(payload):
+        length = payload[offset]
+        body = payload[offset + 1:offset + 1 + length]
+        offset += 1 + length
+        if len(body) < 9:
+            break
+        token, stamp, flags = struct.unpack("<IIB", body[:9])
+        yield token, stamp, flags, body[9:]
+
+
+class Decoder:
+    def __init__(self, dictionary, timestamps):
+        self.dictionary = dictionary
+        self.timestamps = timestamps
+        self.line = ""
+        self.stamp = None
+
+    def text(self, token, flags, raw):
+        entry = self.dictionary.get("%08x" % token)
+        if entry is None:
+            return "<unknown token %08x>" % token
+        kind = flags & 0x07
+        value = literal(entry["text"]) if kind == ARG_NONE else argument(kind, raw)
+        if entry["macro"] in ("LOG", "LOGLN"):
+            return "<%s> %s" % (entry["function"], value)
+        return value
+
+    def feed(self, payload, output):
+        for token, stamp, flags, raw in records(payload):
+            if self.stamp is None:
+                self.stamp = stamp
+            self.line += self.text(token, flags, raw)
+            if flags & END_OF_LINE:
+                prefix = "[%10d] " % self.stamp if self.timestamps else ""
+                output.write(prefix + self.line + "\n")
+                self.line = ""
+                self.stamp = None
+
+
+def main(arguments):
+    timestamps = "-t" in arguments
+    arguments = [a for a in arguments if a != "-t"]
+    if len(arguments) != 1:
+        sys.stderr.write(__doc__)
+        return 2
+    with open(arguments[0], encoding="utf-8") as source:
+        decoder = Decoder(json.load(source), timestamps)
+    for line in sys.stdin:
+        line = line.strip()
+        serial = line.startswith("#")
+        try:
+            payload = bytes.fromhex(line[1:] if serial else line)
+        except ValueError:
+            sys.stdout.write(line + "\n")
+            continue
+        decoder.feed(payload, sys.stdout)
+        sys.stdout.flush()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,183 @@
+"""Build the token dictionary used to decode LOG_TOKENIZED log records.
+
+Scans the firmware sources for LOG, LOGNF, LOGLN and LOGLNF call sites and
+writes a JSON dictionary that maps each call site token (see
+include/logToken.h) to the macro, enclosing function and argument text.
+
+Runs two ways:
+  * As a PlatformIO extra script (extra_scripts = pre:tools/logtokens.py).
+    The dictionary is written to logtokens.json in the build directory on
+    every build, so it always matches the firmware that was flashed.
+  * Standalone: python3 tools/logtokens.py [-o logtokens.json] src/*.cpp
+"""
+import glob
+import json
+import os
+import re
+import sys
+
+LOG_MACROS = ("LOG", "LOGNF", "LOGLN", "LOGLNF")
+CALL_RE = re.compile(r"\b(LOGLNF|LOGLN|LOGNF|LOG)\s*\(")
+FUNCTION_RE = re.compile(r"^[A-Za-z_][\w:<>\*&\s]*?\b([A-Za-z_~][\w:~]*)\s*\([^;]*\)\s*(\{.*)?$")
+NOT_FUNCTIONS = ("if", "else", "while", "for", "switch", "return", "do")
+
+
+def fnv1a(data, value=2166136261):
+    """FNV-1a over bytes, identical to fnv1a() in logToken.h."""
+    for octet in data:
+        value = ((value ^ octet) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def log_token(text, line):
+    """Token of a call site, identical to logToken() in logToken.h."""
+    value = fnv1a(text.encode("utf-8"))
+    return fnv1a(bytes((line & 0xFF, (line >> 8) & 0xFF)), value)
+
+
+def stringize(argument):
+    """Mimic the preprocessor # operator: collapse white space outside of
+    string and character literals and trim both ends."""
+    result = []
+    quote = None
+    pending_space = False
+    i = 0
+    while i < len(argument):
+        char = argument[i]
+        if quote:
+            result.append(char)
+            if char == "\\" and i + 1 < len(argument):
+                result.append(argument[i + 1])
+                i += 1
+            elif char == quote:
+                quote = None
+        elif char.isspace():
+            pending_space = bool(result)
+        else:
+            if pending_space:
+                result.append(" ")
+                pending_space = False
+            if char in "\"'":
+                quote = char
+            result.append(char)
+        i += 1
+    return "".join(result)
+
+
+def macro_argument(line, start):
+    """Return the text between the parenthesis opened at line[start - 1]
+    and its matching close, or None if it is not on this line."""
+    depth = 1
+    quote = None
+    i = start
+    while i < len(line):
+        char = line[i]
+        if quote:
+            if char == "\\":
+                i += 1
+            elif char == quote:
+                quote = None
+        elif char in "\"'":
+            quote = char
+        elif char == "(":
+            depth += 1
+        elif char == ")":
+            depth -= 1
+            if depth == 0:
+                return line[start:i]
+        i += 1
+    return None
+
+
+def strip_comment(line):
+    """Drop a trailing // comment that is not inside a literal."""
+    quote = None
+    i = 0
+    while i < len(line):
+        char = line[i]
+        if quote:
+            if char == "\\":
+                i += 1
+            elif char == quote:
+                quote = None
+        elif char in "\"'":
+            quote = char
+        elif line.startswith("//", i):
+            return line[:i]
+        i += 1
+    return line
+
+
+def scan(path):
+    """Yield dictionary entries for every log call site in one source."""
+    function = ""
+    in_block_comment = False
+    with open(path, encoding="utf-8") as source:
+        for number, raw in enumerate(source, start=1):
+            line = strip_comment(raw.rstrip("\n"))
+            stripped = line.strip()
+            if in_block_comment:
+                if "*/" in stripped:
+                    in_block_comment = False
+                continue
+            if stripped.startswith("/*"):
+                in_block_comment = "*/" not in stripped
+                continue
+            if stripped.startswith("#"):
+                continue
+            match = FUNCTION_RE.match(line)
+            if match and not line.rstrip().endswith(";"):
+                name = match.group(1).split("::")[-1]
+                if name not in NOT_FUNCTIONS:
+                    function = name
+            for call in CALL_RE.finditer(line):
+                argument = macro_argument(line, call.end())
+                if argument is None:
+                    continue
+                text = stringize(argument)
+                yield {
+                    "token": "%08x" % log_token(text, number),
+                    "macro": call.group(1),
+                    "function": function,
+                    "text": text,
+                    "file": os.path.basename(path),
+                    "line": number,
+                }
+
+
+def build(paths):
+    """Dictionary keyed by token for all sources."""
+    dictionary = {}
+    for path in paths:
+        for entry in scan(path):
+            token = entry.pop("token")
+            if token in dictionary and dictionary[token] != entry:
+                sys.stderr.write("logtokens: token collision %s at %s:%d\n"
+                                 % (token, entry["file"], entry["line"]))
+            dictionary[token] = entry
+    return dictionary
+
+
+def write(dictionary, output):
+    with open(output, "w", encoding="utf-8") as target:
+        json.dump(dictionary, target, indent=1, sort_keys=True)
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons.
+except NameError:
+    env = None
+
+if env is not None:
+    project = env.subst("$PROJECT_DIR")
+    sources = sorted(glob.glob(os.path.join(project, "src", "*.cpp")))
+    build_dir = env.subst("$BUILD_DIR")
+    os.makedirs(build_dir, exist_ok=True)
+    write(build(sources), os.path.join(build_dir, "logtokens.json"))
+elif __name__ == "__main__":
+    arguments = sys.argv[1:]
+    output = "logtokens.json"
+    if len(arguments) >= 2 and arguments[0] == "-o":
+        output = arguments[1]
+        arguments = arguments[2:]
+    write(build(arguments or sorted(glob.glob("src/*.cpp"))), output)
@@ -0,0 +1,177 @@
+"""Convert command recordings to and from CSV and predict replay timing.
+
+A recording is what record,save writes to /recording.bin, or the hex dump
+that record,dump publishes on the response topic in several messages, saved
+one after another in a text file. Both are accepted as input. The layout is described in include/commandRecorder.h.
+
+CSV columns are time_us, kind, actuator, value, duty. time_us counts from
+the start of the recording. kind is setpoint, stop, move or sync. A
+coordinated move is a run of sync rows, one per axis it moves, closed by a
+sync row for actuator plan with the duration in milli-seconds as the value.
+The last row is kind end at the length of one replay cycle.
+
+  tocsv FILE          print the recording as CSV.
+  fromcsv CSV OUT     write a recording for data/recording.bin, to be put on
+                      the device with pio run -t uploadfs and record,load.
+  fidelity FILE       predict how far replay moves each entry. Replay applies
+                      an entry on the first motor tick at or after its time,
+                      so with --period-ms P every entry is up to P late and
+                      setpoints for one actuator that share a tick are
+                      superseded. Compare with the replay late figures of
+                      the stats command.
+
+Usage: python3 tools/recording.py tocsv|fromcsv|fidelity FILE [OUT]
+       [--period-ms 20]
+"""
+import csv
+import struct
+import sys
+
+KINDS = ["setpoint", "stop", "move", "sync"]
+ACTUATORS = ["slew", "hoist", "luff", "servo", "plan"]
+HEADER = struct.Struct("<2sBBIHH")
+VERSION = 1
+
+
+def varint(data, offset):
+    value = shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def put_varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def read(path):
+    """Header duration and entries as (time_us, kind, actuator, value, duty)."""
+    with open(path, "rb") as source:
+        raw = source.read()
+    try:
+        raw = bytes.fromhex("".join(raw.decode("ascii").split()))
+    except (UnicodeDecodeError, ValueError):
+        pass  # Already binary.
+    magic, version, _, duration, count, length = HEADER.unpack_from(raw)
+    if magic != b"CR" or version != VERSION:
+        raise ValueError("%s is not a version %d recording" % (path, VERSION))
+    data = raw[HEADER.size:HEADER.size + length]
+    entries = []
+    offset = time = 0
+    while offset < len(data):
+        delta, offset = varint(data, offset)
+        time += delta
+        kind, actuator = data[offset] >> 4, data[offset] & 0x0F
+        offset += 1
+        value = duty = 0
+        if kind != 1:
+            zigzag, offset = varint(data, offset)
+            value = (zigzag >> 1) ^ -(zigzag & 1)
+        if kind in (2, 3):
+            duty = data[offset]
+            offset += 1
+        entries.append((time, kind, actuator, value, duty))
+    if len(entries) != count:
+        sys.stderr.write("header says %d entries, found %d\n" % (count, len(entries)))
+    return duration, entries
+
+
+def write(path, duration, entries):
+    data = bytearray()
+    last = 0
+    for time, kind, actuator, value, duty in entries:
+        data += put_varint(time - last)
+        data.append(kind << 4 | actuator)
+        if kind != 1:
+            data += put_varint(((value << 1) ^ (value >> 31)) & 0xFFFFFFFF)
+        if kind in (2, 3):
+            data.append(duty)
+        last = time
+    with open(path, "wb") as out:
+        out.write(HEADER.pack(b"CR", VERSION, 0, max(duration, last), len(entries), len(data)))
+        out.write(data)
+
+
+def to_csv(path):
+    duration, entries = read(path)
+    out = csv.writer(sys.stdout, lineterminator="\n")
+    out.writerow(["time_us", "kind", "actuator", "value", "duty"])
+    for time, kind, actuator, value, duty in entries:
+        out.writerow([time, KINDS[kind], "" if kind == 1 else ACTUATORS[actuator],
+                      "" if kind == 1 else value, duty if kind in (2, 3) else ""])
+    out.writerow([duration, "end", "", "", ""])
+
+
+def from_csv(path, out):
+    entries = []
+    duration = 0
+    with open(path, newline="") as source:
+        for row in csv.DictReader(source):
+            time = int(row["time_us"])
+            if row["kind"] == "end":
+                duration = time
+                continue
+            kind = KINDS.index(row["kind"])
+            actuator = ACTUATORS.index(row["actuator"]) if kind != 1 else 0
+            value = int(row["value"] or 0)
+            duty = int(row["duty"] or 0)
+            if entries and time < entries[-1][0]:
+                raise ValueError("time_us goes backwards at %d" % time)
+            entries.append((time, kind, actuator, value, duty))
+    write(out, duration, entries)
+
+
+def percentile(values, percent):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, len(ordered) * percent // 100)] if ordered else 0
+
+
+def fidelity(path, period_us):
+    duration, entries = read(path)
+    late = []
+    superseded = 0
+    applied = {}
+    for time, kind, actuator, value, duty in entries:
+        tick = -(-time // period_us) * period_us
+        late.append(tick - time)
+        key = (tick, actuator)
+        if kind == 0 and key in applied:
+            superseded += 1
+        applied[key] = True
+    gaps = [abs((late[i] - late[i - 1])) for i in range(1, len(late))]
+    print("entries %d over %.3f s, replay cycle %.3f s" % (len(entries), entries[-1][0] / 1e6 if entries else 0,
+                                                          duration / 1e6))
+    print("late us p50/p99/max %d/%d/%d" % (percentile(late, 50), percentile(late, 99), max(late or [0])))
+    print("spacing error between entries us p99/max %d/%d" % (percentile(gaps, 99), max(gaps or [0])))
+    print("setpoints superseded by a later one in the same tick %d" % superseded)
+
+
+def main(arguments):
+    period_ms = 20
+    if "--period-ms" in arguments:
+        at = arguments.index("--period-ms")
+        period_ms = int(arguments[at + 1])
+        del arguments[at:at + 2]
+    if len(arguments) == 2 and arguments[0] == "tocsv":
+        to_csv(arguments[1])
+    elif len(arguments) == 3 and arguments[0] == "fromcsv":
+        from_csv(arguments[1], arguments[2])
+    elif len(arguments) == 2 and arguments[0] == "fidelity":
+        fidelity(arguments[1], period_ms * 1000)
+    else:
+        sys.stderr.write(__doc__)
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
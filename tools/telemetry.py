@@ -0,0 +1,107 @@
+"""Decode the binary telemetry frames published to <clientID>/tel.
+
+Reads one hex encoded frame per line on stdin, optionally preceded by the
+topic, and prints one line of text per frame. Frame layout is described in
+include/telemetry.h. Gaps in the sequence number are reported.
+  mosquitto_sub -t '+/tel' -F '%t %x' | python3 tools/telemetry.py
+
+With --budget, prints instead the MQTT traffic per device per hour of the
+old 1 Hz text keep-alive next to the change driven telemetry.
+
+Usage: python3 tools/telemetry.py [--budget [--moving MINUTES]]
+  --moving  minutes per hour the motors are ramping (default 5). Taken as
+            one frame every TELEMETRY_CHECK milli-seconds, a worst case.
+"""
+import struct
+import sys
+
+FRAME = struct.Struct("<BBHI3h3hBbI")
+VERSION = 1
+REASONS = ("first", "change", "interval")
+
+# Defaults from platformio.ini.
+CLIENT_ID = "GENERIC" + "AA:BB:CC:DD:EE:FF"
+BUILD_VERSION = "1.0.1"
+TELEMETRY_CHECK = 0.1  # Seconds.
+TELEMETRY_MAX_INTERVAL = 60  # Seconds.
+MQTT_KEEP_ALIVE = 15  # Seconds.
+
+
+def decode(payload):
+    """Text for one frame."""
+    if len(payload) != FRAME.size or payload[0] != VERSION:
+        return None, "<not a version %d frame: %s>" % (VERSION, payload.hex())
+    fields = FRAME.unpack(payload)
+    _, reason, sequence, uptime = fields[:4]
+    speed, setpoint = fields[4:7], fields[7:10]
+    servo, rssi, heap = fields[10:]
+    reason = REASONS[reason] if reason < len(REASONS) else str(reason)
+    axes = " ".join("%s=%d/%d" % (name, speed[i], setpoint[i])
+                    for i, name in enumerate(("slew", "hoist", "luff")))
+    return sequence, "#%u %-8s up=%.1fs %s servo=%d rssi=%d heap=%d" % (
+        sequence, reason, uptime / 1000.0, axes, servo, rssi, heap)
+
+
+def publish_bytes(topic, payload):
+    """Bytes on the wire for one QoS 0 MQTT PUBLISH."""
+    remaining = 2 + len(topic) + payload
+    length_bytes = 1 if remaining < 128 else 2 if remaining < 16384 else 3
+    return 1 + length_bytes + remaining
+
+
+def budget(moving_minutes):
+    log_topic = "mqttlogger/log"
+    rsp_topic = CLIENT_ID + "/rsp"
+    tel_topic = CLIENT_ID + "/tel"
+    # What the text keep-alive sent every second.
+    old = (publish_bytes(log_topic, len("<mqttSendKeepAlive> 1234567"))
+           + publish_bytes(log_topic, len("192.168.100.100"))
+           + publish_bytes(rsp_topic, len("Build version = " + BUILD_VERSION)))
+    old_hour = old * 3600
+    frame = publish_bytes(tel_topic, FRAME.size)
+    ping = 4  # PINGREQ plus PINGRESP.
+    idle_seconds = 3600 - moving_minutes * 60
+    idle = (idle_seconds / TELEMETRY_MAX_INTERVAL) * frame + (idle_seconds / MQTT_KEEP_ALIVE) * ping
+    moving = (moving_minutes * 60 / TELEMETRY_CHECK) * frame
+    print("Per device per hour (MQTT bytes, no TCP/IP headers)")
+    print("  text keep-alive, 3 publishes/s     %8d" % old_hour)
+    print("  telemetry, idle all hour           %8d" % ((3600 / TELEMETRY_MAX_INTERVAL) * frame
+                                                       + (3600 / MQTT_KEEP_ALIVE) * ping))
+    print("  telemetry, ramping %2d min/hour     %8d" % (moving_minutes, idle + moving))
+    print("  one frame                          %8d" % frame)
+
+
+def main(arguments):
+    if "--budget" in arguments:
+        moving = 5
+        if "--moving" in arguments:
+            moving = int(arguments[arguments.index("--moving") + 1])
+        budget(moving)
+        return 0
+    if arguments:
+        sys.stderr.write(__doc__)
+        return 2
+    expected = {}
+    for line in sys.stdin:
+        parts = line.split()
+        if not parts:
+            continue
+        topic = parts[0] if len(parts) > 1 else ""
+        try:
+            payload = bytes.fromhex(parts[-1])
+        except ValueError:
+            sys.stdout.write(line)
+            continue
+        sequence, text = decode(payload)
+        if sequence is not None and topic in expected and sequence != expected[topic]:
+            sys.stdout.write("%s<%d frame(s) lost>\n" % (topic + " " if topic else "",
+                                                        (sequence - expected[topic]) & 0xFFFF))
+        if sequence is not None:
+            expected[topic] = (sequence + 1) & 0xFFFF
+        sys.stdout.write((topic + " " if topic else "") + text + "\n")
+        sys.stdout.flush()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))